@@ -0,0 +1,38 @@
+// compare two benchmark result files written by bench/run.js
+//
+//   node bench/compare.js base.json head.json
+const fs = require('fs');
+
+if (process.argv.length < 4) {
+    console.error('usage: node bench/compare.js base.json head.json');
+    process.exit(1);
+}
+
+var base = JSON.parse(fs.readFileSync(process.argv[2]));
+var head = JSON.parse(fs.readFileSync(process.argv[3]));
+
+function delta(a, b)
+{
+    if (!a) {
+        return '';
+    }
+    var percent = (b - a) / a * 100;
+    return (percent > 0 ? '+' : '') + percent.toFixed(1) + '%';
+}
+
+console.log('base', base.label, base.date);
+console.log('head', head.label, head.date);
+console.log('');
+console.log('scenario'.padEnd(16), 'mean base'.padStart(12), 'mean head'.padStart(12), 'delta'.padStart(9), 'p95 base'.padStart(12), 'p95 head'.padStart(12), 'delta'.padStart(9));
+
+Object.keys(base.scenarios).forEach((name) => {
+    var a = base.scenarios[name];
+    var b = head.scenarios[name];
+    if (!b) {
+        console.log(name.padEnd(16), 'missing in head');
+        return;
+    }
+    console.log(name.padEnd(16),
+        a.stats.mean.toFixed(3).padStart(12), b.stats.mean.toFixed(3).padStart(12), delta(a.stats.mean, b.stats.mean).padStart(9),
+        a.stats.p95.toFixed(3).padStart(12), b.stats.p95.toFixed(3).padStart(12), delta(a.stats.p95, b.stats.p95).padStart(9));
+});
@@ -0,0 +1,114 @@
+// benchmark harness for the fake device build
+//
+//   npm run build:fake
+//   node bench/run.js [--out results.json] [--label name] [--addon path] [scenario...]
+//
+// writes one json file per run, compare two runs with bench/compare.js
+const fs = require('fs');
+const path = require('path');
+const os = require('os');
+const childProcess = require('child_process');
+const scenarios = require('./scenarios.js');
+
+function parseArgs(argv)
+{
+    var args = { out: null, label: null, addon: path.join(__dirname, '..', 'build', 'Release', 'luck-node-mtp.node'), names: [] };
+    for (var i = 0; i < argv.length; i++) {
+        switch (argv[i]) {
+            case '--out': args.out = argv[++i]; break;
+            case '--label': args.label = argv[++i]; break;
+            case '--addon': args.addon = argv[++i]; break;
+            default: args.names.push(argv[i]);
+        }
+    }
+    return args;
+}
+
+function fakeEnv(fake)
+{
+    return Object.keys(fake).map((key) => key + '=' + fake[key]).join(';');
+}
+
+function percentile(sorted, p)
+{
+    if (sorted.length == 0) {
+        return 0;
+    }
+    var index = Math.min(sorted.length - 1, Math.ceil(p / 100 * sorted.length) - 1);
+    return sorted[Math.max(0, index)];
+}
+
+function summarize(samples)
+{
+    var sorted = samples.slice().sort((a, b) => a - b);
+    var total = sorted.reduce((sum, value) => sum + value, 0);
+    return {
+        count: sorted.length,
+        min: sorted[0] || 0,
+        mean: sorted.length ? total / sorted.length : 0,
+        p50: percentile(sorted, 50),
+        p95: percentile(sorted, 95),
+        p99: percentile(sorted, 99),
+        max: sorted[sorted.length - 1] || 0
+    };
+}
+
+function gitRevision()
+{
+    try {
+        return childProcess.execSync('git rev-parse --short HEAD', { cwd: path.join(__dirname, '..'), stdio: ['ignore', 'pipe', 'ignore'] }).toString().trim();
+    } catch (e) {
+        return null;
+    }
+}
+
+var args = parseArgs(process.argv.slice(2));
+var names = args.names.length ? args.names : Object.keys(scenarios);
+var revision = gitRevision();
+
+var result = {
+    version: 1,
+    label: args.label || revision || 'unknown',
+    date: new Date().toISOString(),
+    git: revision,
+    node: process.version,
+    platform: os.platform(),
+    arch: os.arch(),
+    cpus: os.cpus().length ? os.cpus()[0].model : null,
+    scenarios: {}
+};
+
+names.forEach((name) => {
+    var scenario = scenarios[name];
+    if (!scenario) {
+        console.error('unknown scenario', name);
+        process.exit(1);
+    }
+
+    var env = Object.assign({}, process.env, { LUCK_MTP_FAKE: fakeEnv(scenario.fake) });
+    var child = childProcess.spawnSync(process.execPath, [path.join(__dirname, 'worker.js'), name, args.addon], { env: env, maxBuffer: 64 * 1024 * 1024 });
+    if (child.status !== 0) {
+        console.error(name, 'failed:', child.stderr.toString());
+        process.exit(1);
+    }
+
+    var output = JSON.parse(child.stdout.toString());
+    var stats = summarize(output.samples);
+    result.scenarios[name] = {
+        fake: scenario.fake,
+        iterations: scenario.iterations,
+        wallMs: output.wallMs,
+        bytes: output.bytes,
+        throughputMBps: output.bytes ? output.bytes / (1024 * 1024) / (output.wallMs / 1000) : null,
+        stats: stats,
+        samples: output.samples
+    };
+
+    console.log(name.padEnd(16), 'mean', stats.mean.toFixed(3).padStart(10), 'ms  p95', stats.p95.toFixed(3).padStart(10), 'ms',
+        output.bytes ? '  ' + result.scenarios[name].throughputMBps.toFixed(1) + ' MB/s' : '');
+});
+
+var out = args.out || path.join(__dirname, 'results', result.label + '.json');
+fs.mkdirSync(path.dirname(out), { recursive: true });
+fs.writeFileSync(out, JSON.stringify(result, null, 2));
+console.log('results written to', out);
@@ -0,0 +1,123 @@
+// benchmark scenarios, run against the fake device of src/backend/fake_libmtp.cc
+//
+// each scenario runs in its own process, `fake` is passed to the fake device
+// through the LUCK_MTP_FAKE environment variable.
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+
+const MB = 1024 * 1024;
+
+function deepPath(depth)
+{
+    var parts = ['bench', 'deep'];
+    for (var i = 1; i <= depth; i++) {
+        parts.push('d' + i);
+    }
+    parts.push('leaf.bin');
+    return parts.join('/');
+}
+
+function tmpDir(name)
+{
+    return fs.mkdtempSync(path.join(os.tmpdir(), 'luck-mtp-bench-' + name + '-'));
+}
+
+function writeLocalFile(filePath, size)
+{
+    var chunk = Buffer.alloc(Math.min(size, 4 * MB), 0x5a);
+    var fd = fs.openSync(filePath, 'w');
+    for (var written = 0; written < size; written += chunk.length) {
+        fs.writeSync(fd, chunk, 0, Math.min(chunk.length, size - written));
+    }
+    fs.closeSync(fd);
+}
+
+module.exports = {
+    // listing of a folder with many entries, one GetObjectInfo per entry
+    'list-wide': {
+        fake: { latencyUs: 200, wideEntries: 2000 },
+        iterations: 10,
+        run: function (mtp, sample) {
+            sample(() => mtp.getList('/bench/wide'));
+        }
+    },
+
+    // resolving a path lists every ancestor folder
+    'resolve-deep': {
+        fake: { latencyUs: 200, depth: 16 },
+        iterations: 20,
+        run: function (mtp, sample) {
+            var target = deepPath(16);
+            sample(() => mtp.get(target));
+        }
+    },
+
+    // many small files, dominated by per file round trips
+    'small-download': {
+        fake: { latencyUs: 200, bandwidth: 30 * MB, smallFiles: 200, smallSize: 16 * 1024 },
+        iterations: 1,
+        run: function (mtp, sample) {
+            var dir = tmpDir('small-download');
+            var files = mtp.getList('/bench/small');
+            files.forEach((file) => {
+                sample(() => mtp.download('/bench/small/' + file.name, path.join(dir, file.name)), file.size);
+            });
+            fs.rmSync(dir, { recursive: true, force: true });
+        }
+    },
+
+    'small-upload': {
+        fake: { latencyUs: 200, bandwidth: 30 * MB },
+        iterations: 1,
+        run: function (mtp, sample) {
+            var dir = tmpDir('small-upload');
+            var size = 16 * 1024;
+            mtp.createFolder('/bench', 'small-up');
+            for (var i = 0; i < 200; i++) {
+                var filePath = path.join(dir, 'up_' + i + '.bin');
+                writeLocalFile(filePath, size);
+                sample(() => mtp.upload(filePath, '/bench/small-up'), size);
+            }
+            fs.rmSync(dir, { recursive: true, force: true });
+        }
+    },
+
+    // one large file, dominated by bandwidth and local disk writes
+    'large-download': {
+        fake: { latencyUs: 200, bandwidth: 40 * MB, largeSize: 256 * MB },
+        iterations: 3,
+        run: function (mtp, sample) {
+            var dir = tmpDir('large-download');
+            var target = path.join(dir, 'large.bin');
+            sample(() => mtp.download('/bench/large.bin', target), 256 * MB);
+            fs.rmSync(dir, { recursive: true, force: true });
+        }
+    },
+
+    'large-upload': {
+        fake: { latencyUs: 200, bandwidth: 40 * MB, keepData: 0 },
+        iterations: 3,
+        setup: function () {
+            var dir = tmpDir('large-upload');
+            var filePath = path.join(dir, 'large.bin');
+            writeLocalFile(filePath, 256 * MB);
+            return { dir: dir, filePath: filePath };
+        },
+        run: function (mtp, sample, state) {
+            sample(() => mtp.upload(state.filePath, '/bench'), 256 * MB);
+        },
+        teardown: function (state) {
+            fs.rmSync(state.dir, { recursive: true, force: true });
+        }
+    },
+
+    // no simulated latency, measures turning libmtp lists into js objects
+    'marshal': {
+        fake: { latencyUs: 0, wideEntries: 50000 },
+        iterations: 20,
+        run: function (mtp, sample) {
+            sample(() => mtp.getList('/bench/wide'));
+        }
+    }
+};
@@ -0,0 +1,43 @@
+// runs one benchmark scenario and prints its samples as json, @see run.js
+const path = require('path');
+const scenarios = require('./scenarios.js');
+
+const name = process.argv[2];
+const addonPath = process.argv[3];
+const scenario = scenarios[name];
+
+const mtp = require(path.resolve(addonPath));
+
+var samples = [];
+var bytes = 0;
+
+function sample(fn, size)
+{
+    var start = process.hrtime.bigint();
+    fn();
+    samples.push(Number(process.hrtime.bigint() - start) / 1e6);
+    bytes += size || 0;
+}
+
+mtp.connect();
+
+var device = mtp.getDeviceInfo()[0];
+if (device.vendor !== 'luck-node-mtp') {
+    mtp.release();
+    console.error('the addon is not linked with the fake device, run `npm run build:fake` first');
+    process.exit(2);
+}
+
+var state = scenario.setup ? scenario.setup() : undefined;
+var start = process.hrtime.bigint();
+for (var i = 0; i < scenario.iterations; i++) {
+    scenario.run(mtp, sample, state);
+}
+var wallMs = Number(process.hrtime.bigint() - start) / 1e6;
+if (scenario.teardown) {
+    scenario.teardown(state);
+}
+
+mtp.release();
+
+process.stdout.write(JSON.stringify({ samples: samples, bytes: bytes, wallMs: wallMs }));
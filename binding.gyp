@@ -1,8 +1,13 @@
 {
+  'variables': {
+    # 'libmtp' links the system libmtp, 'fake' links the in-memory device of src/backend/fake_libmtp.cc,
+    # 'replay' plays back a trace recorded with startRecording, see src/backend/replay_libmtp.cc
+    'mtp_backend%': 'libmtp'
+  },
   'targets': [
     {
       'target_name': 'luck-node-mtp',
-      'sources': [ 'src/luck_mtp.cc', 'src/utils.h','src/utils.cc'],
+      'sources': [ 'src/luck_mtp.cc', 'src/utils.h','src/utils.cc','src/discovery.h','src/discovery.cc','src/persistent_index.h','src/persistent_index.cc','src/call_trace.h','src/call_trace.cc','src/mtp_call.h','src/mtp_call.cc','src/stats.h','src/stats.cc','src/timeline.h','src/timeline.cc','src/checksum.h','src/checksum.cc','src/transfer.h','src/transfer.cc','src/archive.h','src/archive.cc','src/buffer_pool.h','src/buffer_pool.cc','src/file_writer.h','src/file_writer.cc','src/waiter.h','src/thumbnail_cache.h','src/thumbnail_cache.cc','src/scheduler.h','src/scheduler.cc','src/rate_limit.h','src/rate_limit.cc','src/device_pipe.h','src/device_pipe.cc','src/broadcast.h','src/broadcast.cc','src/watcher.h','src/watcher.cc','src/mirror.h','src/mirror.cc','src/change_journal.h','src/change_journal.cc','src/device_events.h','src/device_events.cc'],
       'include_dirs': ["<!@(node -p \"require('node-addon-api').include\")"],
       'dependencies': ["<!(node -p \"require('node-addon-api').gyp\")"],
       'cflags!': [ '-fno-exceptions' ],
@@ -16,7 +21,17 @@
         'VCCLCompilerTool': { 'ExceptionHandling': 1 },
       },
       'conditions': [
-            ['OS!="win"',
+            ['mtp_backend=="fake"',
+              {
+                'sources': [ 'src/backend/fake_libmtp.cc', 'src/backend/libmtp_structs.cc' ]
+              }
+            ],
+            ['mtp_backend=="replay"',
+              {
+                'sources': [ 'src/backend/replay_libmtp.cc', 'src/backend/libmtp_structs.cc' ]
+              }
+            ],
+            ['OS!="win" and mtp_backend=="libmtp"',
               {
                 "library_dirs": [
                     "../lib"
@@ -26,7 +41,7 @@
                 ],
               }
             ],
-            ['OS=="win"',
+            ['OS=="win" and mtp_backend=="libmtp"',
               {
                   'library_dirs': [
                       '../lib'
@@ -7,13 +7,259 @@ declare module 'luck-node-mtp' {
       modificationdate: number,
       parent_id: number,
       storage_id: number,
+      persistent_id?: string,
+    }
+
+    interface StatColumns {
+      found: Uint8Array,
+      id: Uint32Array,
+      size: Float64Array,
+      modificationdate: Float64Array,
+      parent_id: Uint32Array,
+      storage_id: Uint32Array,
+      folder: Uint8Array
+    }
+
+    interface PersistentIdOptions {
+      persistentId?: boolean
     }
 
     interface DeviceInfo {
-      vendor: string,
+      vendor: string | null,
       vendor_id: number,
-      product: string,
-      product_id: number
+      product: string | null,
+      product_id: number,
+      bus_location: number,
+      devnum: number,
+      serial: string | null
+    }
+
+    interface ConnectOptions {
+      mode?: 'uncached' | 'cached',
+      serial?: string,
+      vendor_id?: number,
+      product_id?: number
+    }
+
+    interface ConnectResult {
+      device: DeviceInfo,
+      serial: string | null,
+      mode: 'uncached' | 'cached',
+      storage_id: number,
+      opened: number,
+      timing: {
+        detect: number,
+        open: number,
+        total: number
+      }
+    }
+
+    interface LatencyStats {
+      total: number,
+      min: number,
+      mean: number,
+      p50: number,
+      p90: number,
+      p99: number,
+      p999: number,
+      max: number
+    }
+
+    interface FunctionStats {
+      calls: number,
+      bytes: number,
+      throughput: number,
+      latency: LatencyStats
+    }
+
+    interface ExportStats extends FunctionStats {
+      errors: number,
+      mtpCalls: number,
+      functions: { [libmtpFunction: string]: number }
+    }
+
+    interface PoolStats {
+      slabSize: number,
+      acquired: number,
+      hits: number,
+      hitRate: number,
+      allocated: number,
+      inUse: number,
+      highWater: number
+    }
+
+    interface ThumbnailCacheStats {
+      memoryHits: number,
+      diskHits: number,
+      misses: number,
+      entries: number,
+      bytes: number
+    }
+
+    type Priority = 'interactive' | 'normal' | 'bulk';
+
+    interface SchedulerQueueStats {
+      queued: number,
+      maxQueued: number,
+      acquired: number,
+      waited: number,
+      wait: LatencyStats
+    }
+
+    interface RateLimitStats {
+      limit: number,
+      bytes: number,
+      delayed: number,
+      throughput: number
+    }
+
+    interface Stats {
+      enabled: boolean,
+      elapsed: number,
+      functions: { [libmtpFunction: string]: FunctionStats },
+      exports: { [method: string]: ExportStats },
+      pool: PoolStats,
+      thumbnails: ThumbnailCacheStats,
+      scheduler: { [priority in Priority]: SchedulerQueueStats },
+      rateLimits: { device: RateLimitStats, named: { [name: string]: RateLimitStats } }
+    }
+
+    interface ThumbnailOptions {
+      cacheDir?: string,
+      memoryCache?: number
+    }
+
+    type HashAlgorithm = 'sha256' | 'xxh3' | 'crc32c';
+
+    interface TransferOptions {
+      hash?: HashAlgorithm | HashAlgorithm[],
+      rateLimit?: number | string
+    }
+
+    interface DownloadOptions extends TransferOptions {
+      fsync?: 'none' | 'end' | number,
+      async?: boolean,
+      priority?: Priority,
+      sliceSize?: number
+    }
+
+    type CopyProgress = (copied: number, total: number) => boolean | void;
+
+    interface CopyOptions {
+      stream?: boolean
+    }
+
+    interface TransferResult {
+      id: number,
+      files: number,
+      folders: number,
+      bytes: number
+    }
+
+    interface BroadcastOptions {
+      name?: string,
+      lagWindow?: number
+    }
+
+    interface BroadcastResult {
+      uploaded: number,
+      bytesRead: number,
+      devices: {
+        serial: string,
+        uploaded: boolean,
+        id?: number,
+        sent?: number,
+        lagged?: boolean,
+        error?: string
+      }[]
+    }
+
+    interface WatchEvent {
+      op: 'create' | 'update' | 'rename' | 'delete' | 'error',
+      path: string,
+      from?: string,
+      id: number,
+      error?: string
+    }
+
+    interface WatchOptions {
+      debounce?: number,
+      pollInterval?: number,
+      polling?: boolean,
+      initialSync?: boolean
+    }
+
+    interface ChangeJournalOptions {
+      events?: boolean,
+      path?: string,
+      capacity?: number
+    }
+
+    interface Changes {
+      token: string,
+      resync: boolean,
+      added: number[],
+      removed: number[],
+      modified: number[]
+    }
+
+    interface ZipEntry {
+      name: string,
+      size: number,
+      compressedSize: number,
+      mtime: number,
+      folder: boolean
+    }
+
+    interface ZipListing {
+      entries: ZipEntry[],
+      size: number,
+      bytesRead: number
+    }
+
+    interface ZipExtractResult {
+      size: number,
+      bytesRead: number
+    }
+
+    interface HashResult {
+      size: number,
+      hash: { [algorithm in HashAlgorithm]?: string }
+    }
+
+    interface UploadOptions extends TransferOptions {
+      ifChanged?: boolean,
+      delta?: boolean
+    }
+
+    interface UploadChangeResult {
+      uploaded: boolean,
+      delta: boolean,
+      id: number,
+      size: number,
+      bytesAvoided: number,
+      sampled: number,
+      hash?: { [algorithm in HashAlgorithm]?: string }
+    }
+
+    interface ArchiveOptions {
+      format?: 'tar' | 'zip',
+      compression?: 'none' | 'gzip' | 'deflate',
+      level?: number,
+      rateLimit?: number | string
+    }
+
+    interface ArchiveResult {
+      files: number,
+      folders: number,
+      bytes: number,
+      size: number
+    }
+
+    interface ArchiveUploadResult {
+      files: number,
+      folders: number,
+      bytes: number
     }
 
     interface StorageInfo {
@@ -32,6 +278,15 @@ declare module 'luck-node-mtp' {
      */
     export function connect(vendorId?: number, productId?: number): boolean;
 
+    /**
+     * Connect to a device on a worker thread, selected by serial number or vendor and product id.
+     *
+     * @param {ConnectOptions} options
+     *
+     * @return {Promise.<ConnectResult>} the connected device and the time spent in each phase in milliseconds
+     */
+    export function connect(options: ConnectOptions): Promise<ConnectResult>;
+
     /**
      * Release the currently connected device.
      *
@@ -43,10 +298,11 @@ declare module 'luck-node-mtp' {
      * Get a list of objects within a given mtp device parent path. A file tree can be build by using this method.
      *
      * @param {string} parentPath
+     * @param {PersistentIdOptions} options set persistentId to add the persistent unique object id of each object
      *
      * @return {Array.<ListObject>}
      */
-    export function getList(parentPath: string): [ListObject];
+    export function getList(parentPath: string, options?: PersistentIdOptions): [ListObject];
 
     /**
      * Returns a list of valid connected devices.
@@ -55,6 +311,69 @@ declare module 'luck-node-mtp' {
      */
     export function getDeviceInfo(): [DeviceInfo];
 
+    /**
+     * Rescan the usb bus and update the cached device list.
+     *
+     * @return {Array.<DeviceInfo>}
+     */
+    export function refreshDevices(): [DeviceInfo];
+
+    /**
+     * Poll the usb bus on a background thread and report devices plugged in or removed.
+     *
+     * @param {number} intervalMs
+     * @param {Function} callback
+     *
+     * @return {boolean}
+     */
+    export function startDiscovery(intervalMs: number, callback: (event: 'attach' | 'detach', device: DeviceInfo) => void): boolean;
+
+    /**
+     * Stop polling the usb bus.
+     *
+     * @return {boolean}
+     */
+    export function stopDiscovery(): boolean;
+
+    /**
+     * Download a file from the MTP device in a background job.
+     *
+     * @param {string} sourcePath
+     * @param {string} targetPath
+     * @param {Function} callback
+     * @param {DownloadOptions} options
+     *
+     * @return {Promise<boolean | HashResult>}
+     */
+    export function download(sourcePath: string, targetPath: string, callback: Function | undefined, options: DownloadOptions & { async: true }): Promise<boolean | HashResult>;
+    export function download(sourcePath: string, targetPath: string, options: DownloadOptions & { async: true }): Promise<boolean | HashResult>;
+
+    /**
+     * Download a file from the MTP device and compute its checksums while it is transferred.
+     *
+     * @param {string} sourcePath
+     * @param {string} targetPath
+     * @param {Function} callback
+     * @param {DownloadOptions} options
+     *
+     * @return {HashResult}
+     */
+    export function download(sourcePath: string, targetPath: string, callback: Function | undefined, options: DownloadOptions & Required<TransferOptions>): HashResult;
+    export function download(sourcePath: string, targetPath: string, options: DownloadOptions & Required<TransferOptions>): HashResult;
+
+    /**
+     * Download a file from the MTP device.
+     *
+     * @param {string} sourcePath
+     * @param {string} targetPath
+     * @param {Function} callback
+     * @param {DownloadOptions} options fsync policy of the local file
+     *
+     * @return {boolean}
+     */
+    export function download(sourcePath: string, targetPath: string, callback?: Function, options?: DownloadOptions): boolean;
+    export function download(sourcePath: string, targetPath: string, options: DownloadOptions): boolean;
+
     /**
      * Upload a file to the MTP device.
      *
@@ -66,8 +385,92 @@ declare module 'luck-node-mtp' {
      */
     export function upload(sourcePath: string, targetPath: string, callback?: Function): boolean;
 
+    /**
+     * Upload a file to the MTP device unless the target folder already has an identical file of the same name,
+     * or only send the blocks that differ from it.
+     *
+     * @param {string} sourcePath
+     * @param {string} targetPath
+     * @param {Function} callback
+     * @param {UploadOptions} options
+     *
+     * @return {UploadChangeResult}
+     */
+    export function upload(sourcePath: string, targetPath: string, callback: Function | undefined, options: UploadOptions & ({ ifChanged: true } | { delta: true })): UploadChangeResult;
+    export function upload(sourcePath: string, targetPath: string, options: UploadOptions & ({ ifChanged: true } | { delta: true })): UploadChangeResult;
+
+    /**
+     * Upload a file to the MTP device and compute its checksums while it is transferred.
+     *
+     * @param {string} sourcePath
+     * @param {string} targetPath
+     * @param {Function} callback
+     * @param {TransferOptions} options
+     *
+     * @return {HashResult}
+     */
+    export function upload(sourcePath: string, targetPath: string, callback: Function | undefined, options: TransferOptions): HashResult;
+    export function upload(sourcePath: string, targetPath: string, options: TransferOptions): HashResult;
+
+    /**
+     * Download a device folder into a single tar or zip archive, streaming each file into it.
+     *
+     * @param {string} sourcePath
+     * @param {string | NodeJS.WritableStream} target archive path or writable stream
+     * @param {Function} callback
+     * @param {ArchiveOptions} options
+     *
+     * @return {ArchiveResult}
+     */
+    export function downloadArchive(sourcePath: string, target: string | NodeJS.WritableStream, callback?: Function, options?: ArchiveOptions): ArchiveResult;
+    export function downloadArchive(sourcePath: string, target: string | NodeJS.WritableStream, options: ArchiveOptions): ArchiveResult;
+
+    /**
+     * Upload the content of a local tar, tar.gz or zip archive into a device folder without extracting it.
+     *
+     * @param {string} archivePath
+     * @param {string} targetPath
+     * @param {Function} callback
+     *
+     * @return {ArchiveUploadResult}
+     */
+    export function uploadArchive(archivePath: string, targetPath: string, callback?: Function): ArchiveUploadResult;
+
+    /**
+     * Read a file of the MTP device into memory.
+     *
+     * @param {string} sourcePath
+     *
+     * @return {Buffer}
+     */
+    export function readFile(sourcePath: string): Buffer;
+
+    /**
+     * Write a file to the MTP device from memory.
+     *
+     * @param {string} targetPath the parent folder
+     * @param {string} name
+     * @param {Buffer} data
+     *
+     * @return {number} the object id of the new file
+     */
+    export function writeFile(targetPath: string, name: string, data: Buffer): number;
+
+    /**
+     * Get the thumbnails of many objects in one background job, cached in memory and optionally on disk.
+     *
+     * @param {Array} items object ids or file paths
+     * @param {Function} callback called with each thumbnail as it arrives
+     * @param {ThumbnailOptions} options
+     *
+     * @return {Promise} the thumbnails in the order of the items, null for an object without thumbnail
+     */
+    export function getThumbnails(items: (number | string)[], callback?: (index: number, thumbnail: Buffer | null) => void, options?: ThumbnailOptions): Promise<(Buffer | null)[]>;
+    export function getThumbnails(items: (number | string)[], options: ThumbnailOptions): Promise<(Buffer | null)[]>;
+
     /**
      * This function deletes a single file, track, playlist, folder or any other object from the MTP device, identified by the object ID.
+     * A folder is deleted with everything inside it, children first (earlier versions deleted only the folder object).
      *
      * @param {string} sourcePath
      * @param {string} targetPath
@@ -81,30 +484,224 @@ declare module 'luck-node-mtp' {
      * Obtain information about an object on the device.
      *
      * @param {string} targetPath
+     * @param {PersistentIdOptions} options set persistentId to add the persistent unique object id
      *
      * @return {ListObject}
      */
-    export function getObject(targetPath: string): ListObject;
+    export function getObject(targetPath: string, options?: PersistentIdOptions): ListObject;
+
+    /**
+     * Obtain information about many objects, each distinct parent folder is listed once.
+     *
+     * @param {string[]} paths
+     * @param {Object} options set columnar to get typed arrays by field
+     *
+     * @return {Array} an object or null per path, in the order of the paths
+     */
+    export function statMany(paths: string[], options?: { columnar?: false }): (ListObject | null)[];
+    export function statMany(paths: string[], options: { columnar: true }): StatColumns;
+
+    /**
+     * Index the persistent unique object ids of the objects below a folder.
+     *
+     * @param {string} folderPath
+     * @param {Object} options recursive defaults to true
+     *
+     * @return {number} the number of objects indexed
+     */
+    export function buildPersistentIndex(folderPath: string, options?: { recursive?: boolean }): number;
+
+    /**
+     * Find an object by its persistent unique object id, which stays the same across sessions.
+     *
+     * @param {string} persistentId
+     * @param {Object} options scan defaults to true, walk the storage if the id is not indexed
+     *
+     * @return {ListObject | null}
+     */
+    export function resolveByPersistentId(persistentId: string, options?: { scan?: boolean }): ListObject | null;
+
+    /**
+     * Record every libmtp call into a binary trace file, for playback by the replay backend.
+     *
+     * @param {string} tracePath
+     *
+     * @return {boolean}
+     */
+    export function startRecording(tracePath: string): boolean;
+
+    /**
+     * Stop recording libmtp calls.
+     *
+     * @return {number} the number of calls recorded
+     */
+    export function stopRecording(): number;
+
+    /**
+     * Limit the bytes per second of the transfers of the device, or of the transfers given a named limit.
+     *
+     * @param {number} bytesPerSecond 0 for no limit
+     * @param {string} name the shared limit, the limit of each device when not given
+     *
+     * @return {boolean}
+     */
+    export function setRateLimit(bytesPerSecond: number, name?: string): boolean;
+
+    /**
+     * Enable or disable the collection of call statistics.
+     *
+     * @param {boolean} enabled defaults to true
+     *
+     * @return {boolean} whether statistics were enabled before
+     */
+    export function enableStats(enabled?: boolean): boolean;
+
+    /**
+     * Get the libmtp call statistics, by libmtp function and by method, latencies in milliseconds.
+     *
+     * @return {Stats}
+     */
+    export function getStats(): Stats;
+
+    /**
+     * Clear the call statistics.
+     *
+     * @return {boolean}
+     */
+    export function resetStats(): boolean;
+
+    /**
+     * Write a timeline of the native operations as Chrome trace event json.
+     *
+     * @param {string} jsonPath
+     *
+     * @return {boolean}
+     */
+    export function startTracing(jsonPath: string): boolean;
+
+    /**
+     * Stop tracing and close the json file.
+     *
+     * @return {Object} the number of spans written and dropped
+     */
+    export function stopTracing(): { events: number, dropped: number };
 
     /**
      * Copy a file from one place on the device to another place on the device.
+     * A device without CopyObject gets the file copied through the host.
      *
      * @param {string} sourcePath
      * @param {string} targetPath
+     * @param {Function} callback progress of a copy through the host, return false to cancel it
+     * @param {CopyOptions} options
      *
      * @return {boolean}
      */
-    export function copy(sourcePath: string, targetPath: string): boolean;
+    export function copy(sourcePath: string, targetPath: string, callback?: CopyProgress, options?: CopyOptions): boolean;
+    export function copy(sourcePath: string, targetPath: string, options: CopyOptions): boolean;
 
     /**
      * Move a file from one place on the device to another place on the device.
+     * A device without MoveObject gets the file copied through the host, and the source deleted once the copy is verified.
      *
      * @param {string} sourcePath
      * @param {string} targetPath
+     * @param {Function} callback progress of a move through the host, return false to cancel it
+     * @param {CopyOptions} options
      *
      * @return {boolean}
      */
-    export function copy(sourcePath: string, targetPath: string): boolean;
+    export function move(sourcePath: string, targetPath: string, callback?: CopyProgress, options?: CopyOptions): boolean;
+    export function move(sourcePath: string, targetPath: string, options: CopyOptions): boolean;
+
+    /**
+     * Copy a file or folder tree from one device to another, both usb links transfer at the same time.
+     *
+     * @param {string} sourceSerial serial number of the source device
+     * @param {string} sourcePath
+     * @param {string} targetSerial serial number of the target device
+     * @param {string} targetPath parent folder on the target device
+     * @param {Function} callback progress, return false to cancel the transfer
+     *
+     * @return {TransferResult}
+     */
+    export function transfer(sourceSerial: string, sourcePath: string, targetSerial: string, targetPath: string, callback?: CopyProgress): TransferResult;
+
+    /**
+     * Upload the same file to many devices at once, the local file is read once for all of them.
+     *
+     * @param {string | Buffer} source local file path or content
+     * @param {string[]} devices serial numbers of the devices
+     * @param {string} targetPath parent folder on every device
+     * @param {Function} callback progress over all the devices, return false to cancel the upload
+     * @param {BroadcastOptions} options
+     *
+     * @return {BroadcastResult}
+     */
+    export function broadcastUpload(source: string | Buffer, devices: string[], targetPath: string, callback?: CopyProgress, options?: BroadcastOptions): BroadcastResult;
+
+    /**
+     * Keep a folder of the connected device a copy of a local directory, until stopWatch is called.
+     *
+     * @param {string} localDir local directory
+     * @param {string} targetPath folder on the device
+     * @param {Function} callback called with every operation applied
+     * @param {WatchOptions} options
+     *
+     * @return {boolean}
+     */
+    export function watchAndPush(localDir: string, targetPath: string, callback: (event: WatchEvent) => void, options?: WatchOptions): boolean;
+
+    /**
+     * Stop the watch started by watchAndPush.
+     *
+     * @return {boolean}
+     */
+    export function stopWatch(): boolean;
+
+    /**
+     * Start journaling the object changes of the connected device.
+     *
+     * @param {ChangeJournalOptions} options
+     *
+     * @return {string} the current token
+     */
+    export function startChangeJournal(options?: ChangeJournalOptions): string;
+
+    /**
+     * Get the object changes since a token.
+     *
+     * @param {string} token a token returned by startChangeJournal or getChanges
+     *
+     * @return {Changes}
+     */
+    export function getChanges(token?: string): Changes;
+
+    /**
+     * Stop journaling the object changes.
+     *
+     * @return {boolean}
+     */
+    export function stopChangeJournal(): boolean;
+
+    /**
+     * List the entries of a zip archive on the device, only its central directory is read.
+     * @param {string} archivePath
+     *
+     * @return {ZipListing}
+     */
+    export function listZip(archivePath: string): ZipListing;
+
+    /**
+     * Extract a single entry of a zip archive on the device, only the byte range of the entry is read.
+     * @param {string} archivePath
+     * @param {string} entryName the name of the entry, as listed by listZip
+     * @param {string | NodeJS.WritableStream} target the local file path, or a writable stream
+     * @param {Function} callback called with the bytes of the entry extracted, returning false cancels
+     *
+     * @return {ZipExtractResult}
+     */
+    export function extractZipEntry(archivePath: string, entryName: string, target: string | NodeJS.WritableStream, callback?: Function): ZipExtractResult;
 
     /**
      * Set the file name of an object on the device.
@@ -0,0 +1,1269 @@
+#include <string.h>
+#include <memory>
+#include <algorithm>
+#include <zlib.h>
+#include "archive.h"
+#include "utils.h"
+
+using namespace std;
+
+static const size_t ARCHIVE_BUFFER_SIZE = 1024 * 1024;
+static const size_t DEFLATE_CHUNK_SIZE = 64 * 1024;
+
+FileOutput::~FileOutput()
+{
+  if (_fd)
+    fclose(_fd);
+}
+
+bool FileOutput::open(const string &path)
+{
+  _fd = fopen(path.c_str(), "wb");
+  if (!_fd)
+    return false;
+  // many small entries, let stdio batch them into large writes
+  _buffer.resize(ARCHIVE_BUFFER_SIZE);
+  setvbuf(_fd, _buffer.data(), _IOFBF, _buffer.size());
+  return true;
+}
+
+bool FileOutput::put(const unsigned char *data, size_t length)
+{
+  return _fd && fwrite(data, 1, length, _fd) == length;
+}
+
+bool FileOutput::close()
+{
+  if (!_fd)
+    return false;
+  bool ok = fclose(_fd) == 0;
+  _fd = NULL;
+  return ok;
+}
+
+/**
+ * zlib deflate stream writing its output to an archive output
+ */
+class Deflater
+{
+public:
+  Deflater() : _initialized(false) {}
+
+  ~Deflater()
+  {
+    if (_initialized)
+      deflateEnd(&_stream);
+  }
+
+  /**
+   * start a new stream
+   *
+   * @param level zlib compression level
+   * @param windowBits -15 for raw deflate, 31 for gzip
+   */
+  bool begin(int level, int windowBits)
+  {
+    if (_initialized)
+      return deflateReset(&_stream) == Z_OK;
+
+    memset(&_stream, 0, sizeof(_stream));
+    _initialized = deflateInit2(&_stream, level, Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+    return _initialized;
+  }
+
+  /**
+   * @param flush Z_NO_FLUSH, or Z_FINISH to end the stream
+   */
+  bool deflate(ArchiveOutput *output, const unsigned char *data, size_t length, int flush)
+  {
+    _stream.next_in = (Bytef *)data;
+    _stream.avail_in = (uInt)length;
+    do
+    {
+      _stream.next_out = _out;
+      _stream.avail_out = sizeof(_out);
+      int ret = ::deflate(&_stream, flush);
+      if (ret == Z_STREAM_ERROR)
+        return false;
+      size_t produced = sizeof(_out) - _stream.avail_out;
+      if (produced && !output->write(_out, produced))
+        return false;
+    } while (_stream.avail_out == 0 || _stream.avail_in > 0);
+    return true;
+  }
+
+private:
+  z_stream _stream;
+  bool _initialized;
+  unsigned char _out[DEFLATE_CHUNK_SIZE];
+};
+
+/**
+ * gzip compressed output, for tar.gz
+ */
+class GzipOutput : public ArchiveOutput
+{
+public:
+  GzipOutput(ArchiveOutput *target, int level) : _target(target)
+  {
+    _ready = _deflater.begin(level, 15 + 16);
+  }
+
+  bool close() override
+  {
+    return _ready && _deflater.deflate(_target, NULL, 0, Z_FINISH) && _target->close();
+  }
+
+protected:
+  bool put(const unsigned char *data, size_t length) override
+  {
+    return _ready && _deflater.deflate(_target, data, length, Z_NO_FLUSH);
+  }
+
+private:
+  ArchiveOutput *_target;
+  Deflater _deflater;
+  bool _ready;
+};
+
+/*
+ * tar
+ */
+
+static const size_t TAR_BLOCK = 512;
+static const size_t TAR_RECORD = 20 * TAR_BLOCK;
+static const uint64_t TAR_MAX_OCTAL_SIZE = 077777777777ULL;
+
+/**
+ * helper function to write a number as a zero padded octal field
+ */
+static void tarOctal(char *field, size_t width, uint64_t value)
+{
+  snprintf(field, width, "%0*llo", (int)width - 1, (unsigned long long)value);
+}
+
+/**
+ * helper function to split a path into the ustar prefix and name fields
+ *
+ * @return false if the path does not fit, a pax header is needed
+ */
+static bool tarSplitName(const string &path, string &prefix, string &name)
+{
+  if (path.length() <= 100)
+  {
+    prefix.clear();
+    name = path;
+    return true;
+  }
+
+  size_t slash = path.find('/', path.length() > 101 ? path.length() - 101 : 0);
+  while (slash != string::npos && slash <= 155)
+  {
+    if (path.length() - slash - 1 <= 100 && slash > 0)
+    {
+      prefix = path.substr(0, slash);
+      name = path.substr(slash + 1);
+      return true;
+    }
+    slash = path.find('/', slash + 1);
+  }
+  return false;
+}
+
+/**
+ * helper function to append a pax record, its length includes the length digits
+ */
+static void paxRecord(string &records, const string &key, const string &value)
+{
+  size_t length = key.length() + value.length() + 3;
+  size_t total = length + to_string(length).length();
+  if (to_string(total).length() != to_string(length).length())
+    total++;
+  records += to_string(total) + " " + key + "=" + value + "\n";
+}
+
+class TarWriter : public ArchiveWriter
+{
+public:
+  TarWriter(ArchiveOutput *output, ArchiveOutput *compressed)
+      : _output(compressed ? compressed : output), _compressed(compressed), _remaining(0), _padding(0) {}
+
+  bool addFolder(const string &name, time_t mtime) override
+  {
+    return header(name + "/", 0, mtime, '5', 0755);
+  }
+
+  bool beginFile(const string &name, uint64_t size, time_t mtime) override
+  {
+    if (!header(name, size, mtime, '0', 0644))
+      return false;
+    _remaining = size;
+    _padding = (TAR_BLOCK - size % TAR_BLOCK) % TAR_BLOCK;
+    return true;
+  }
+
+  bool write(const unsigned char *data, size_t length) override
+  {
+    if (length > _remaining)
+      return false;
+    _remaining -= length;
+    return _output->write(data, length);
+  }
+
+  bool endFile() override
+  {
+    if (_remaining != 0)
+      return false;
+    return zeros(_padding);
+  }
+
+  bool finish() override
+  {
+    // two zero blocks end the archive, padded to a whole record like tar does
+    uint64_t end = _output->size() + 2 * TAR_BLOCK;
+    if (!zeros(2 * TAR_BLOCK + (TAR_RECORD - end % TAR_RECORD) % TAR_RECORD))
+      return false;
+    return _output->close();
+  }
+
+private:
+  bool zeros(size_t length)
+  {
+    static const unsigned char block[TAR_RECORD] = {0};
+    return length == 0 || _output->write(block, length);
+  }
+
+  bool header(const string &path, uint64_t size, time_t mtime, char type, int mode)
+  {
+    string prefix, name;
+    bool fits = tarSplitName(path, prefix, name);
+    if (!fits || size > TAR_MAX_OCTAL_SIZE)
+    {
+      string records;
+      if (!fits)
+        paxRecord(records, "path", path);
+      if (size > TAR_MAX_OCTAL_SIZE)
+        paxRecord(records, "size", to_string(size));
+
+      string paxName = "PaxHeader/" + path.substr(path.find_last_of('/') + 1);
+      if (!block(paxName.substr(0, 100), "", records.length(), mtime, 'x', 0644))
+        return false;
+      if (!_output->write((const unsigned char *)records.data(), records.length()))
+        return false;
+      if (!zeros((TAR_BLOCK - records.length() % TAR_BLOCK) % TAR_BLOCK))
+        return false;
+
+      // the ustar fields keep a truncated name for readers without pax support
+      if (!fits)
+      {
+        prefix.clear();
+        name = path.substr(0, 100);
+      }
+    }
+    return block(name, prefix, size > TAR_MAX_OCTAL_SIZE ? 0 : size, mtime, type, mode);
+  }
+
+  bool block(const string &name, const string &prefix, uint64_t size, time_t mtime, char type, int mode)
+  {
+    char header[TAR_BLOCK];
+    memset(header, 0, sizeof(header));
+    memcpy(header, name.data(), name.length());
+    tarOctal(header + 100, 8, mode);
+    tarOctal(header + 108, 8, 0);
+    tarOctal(header + 116, 8, 0);
+    tarOctal(header + 124, 12, size);
+    tarOctal(header + 136, 12, mtime > 0 ? (uint64_t)mtime : 0);
+    header[156] = type;
+    memcpy(header + 257, "ustar", 6);
+    memcpy(header + 263, "00", 2);
+    memcpy(header + 345, prefix.data(), prefix.length());
+
+    // the checksum is computed with its own field filled with spaces
+    memset(header + 148, ' ', 8);
+    unsigned int checksum = 0;
+    for (size_t i = 0; i < TAR_BLOCK; i++)
+      checksum += (unsigned char)header[i];
+    snprintf(header + 148, 8, "%06o", checksum);
+
+    return _output->write((const unsigned char *)header, sizeof(header));
+  }
+
+  ArchiveOutput *_output;
+  unique_ptr<ArchiveOutput> _compressed;
+  uint64_t _remaining;
+  size_t _padding;
+};
+
+/*
+ * zip
+ */
+
+static const uint32_t ZIP_LOCAL_HEADER = 0x04034b50;
+static const uint32_t ZIP_DATA_DESCRIPTOR = 0x08074b50;
+static const uint32_t ZIP_CENTRAL_HEADER = 0x02014b50;
+static const uint32_t ZIP64_END_RECORD = 0x06064b50;
+static const uint32_t ZIP64_END_LOCATOR = 0x07064b50;
+static const uint32_t ZIP_END_RECORD = 0x06054b50;
+static const uint16_t ZIP_FLAG_DESCRIPTOR = 0x0008;
+static const uint16_t ZIP_FLAG_UTF8 = 0x0800;
+static const uint16_t ZIP_VERSION = 20;
+static const uint16_t ZIP64_VERSION = 45;
+static const uint16_t ZIP_MADE_BY_UNIX = 3 << 8;
+static const uint32_t ZIP_MAX32 = 0xFFFFFFFF;
+static const uint16_t ZIP_MAX16 = 0xFFFF;
+// files that may come close to 4GB once deflated get zip64 sizes
+static const uint64_t ZIP64_FILE_SIZE = 0xFFFF0000ULL;
+
+static void le16(vector<unsigned char> &out, uint16_t value)
+{
+  out.push_back(value & 0xff);
+  out.push_back(value >> 8);
+}
+
+static void le32(vector<unsigned char> &out, uint32_t value)
+{
+  le16(out, value & 0xffff);
+  le16(out, value >> 16);
+}
+
+static void le64(vector<unsigned char> &out, uint64_t value)
+{
+  le32(out, value & 0xffffffff);
+  le32(out, value >> 32);
+}
+
+/**
+ * helper function to convert a time to the MS-DOS date and time of zip headers, in local time
+ */
+static void dosTime(time_t mtime, uint16_t &date, uint16_t &time)
+{
+  struct tm local;
+#ifdef _WIN32
+  bool ok = localtime_s(&local, &mtime) == 0;
+#else
+  bool ok = localtime_r(&mtime, &local) != NULL;
+#endif
+  if (!ok || local.tm_year < 80)
+  {
+    // 1980-01-01 00:00, the earliest MS-DOS date
+    date = (1 << 5) | 1;
+    time = 0;
+    return;
+  }
+  date = ((local.tm_year - 80) << 9) | ((local.tm_mon + 1) << 5) | local.tm_mday;
+  time = (local.tm_hour << 11) | (local.tm_min << 5) | (local.tm_sec / 2);
+}
+
+struct ZipEntry
+{
+  string name;
+  time_t mtime;
+  bool folder;
+  bool zip64;
+  uint16_t method;
+  uint32_t crc;
+  uint64_t compressedSize;
+  uint64_t size;
+  uint64_t offset;
+};
+
+class ZipWriter : public ArchiveWriter
+{
+public:
+  ZipWriter(ArchiveOutput *output, bool deflate, int level)
+      : _output(output), _deflate(deflate), _level(level), _entry(NULL), _start(0) {}
+
+  bool addFolder(const string &name, time_t mtime) override
+  {
+    _entries.push_back(ZipEntry{name + "/", mtime, true, false, 0, 0, 0, 0, _output->size()});
+    return localHeader(_entries.back());
+  }
+
+  bool beginFile(const string &name, uint64_t size, time_t mtime) override
+  {
+    _entries.push_back(ZipEntry{name, mtime, false, size >= ZIP64_FILE_SIZE, (uint16_t)(_deflate ? 8 : 0),
+                                (uint32_t)crc32(0, NULL, 0), 0, size, _output->size()});
+    _entry = &_entries.back();
+    _written = 0;
+    if (!localHeader(*_entry))
+      return false;
+    _start = _output->size();
+    return !_deflate || _deflater.begin(_level, -15);
+  }
+
+  bool write(const unsigned char *data, size_t length) override
+  {
+    if (!_entry || length > _entry->size - _written)
+      return false;
+    _written += length;
+
+    // zlib crc32 takes an unsigned int length
+    for (size_t done = 0; done < length;)
+    {
+      uInt chunk = (uInt)min<size_t>(length - done, 1 << 30);
+      _entry->crc = crc32(_entry->crc, data + done, chunk);
+      done += chunk;
+    }
+
+    if (_deflate)
+      return _deflater.deflate(_output, data, length, Z_NO_FLUSH);
+    return _output->write(data, length);
+  }
+
+  bool endFile() override
+  {
+    if (!_entry || _written != _entry->size)
+      return false;
+    if (_deflate && !_deflater.deflate(_output, NULL, 0, Z_FINISH))
+      return false;
+    _entry->compressedSize = _output->size() - _start;
+
+    vector<unsigned char> descriptor;
+    le32(descriptor, ZIP_DATA_DESCRIPTOR);
+    le32(descriptor, _entry->crc);
+    if (_entry->zip64)
+    {
+      le64(descriptor, _entry->compressedSize);
+      le64(descriptor, _entry->size);
+    }
+    else
+    {
+      if (_entry->compressedSize > ZIP_MAX32)
+        return false;
+      le32(descriptor, (uint32_t)_entry->compressedSize);
+      le32(descriptor, (uint32_t)_entry->size);
+    }
+    _entry = NULL;
+    return _output->write(descriptor.data(), descriptor.size());
+  }
+
+  bool finish() override
+  {
+    uint64_t directoryOffset = _output->size();
+    vector<unsigned char> out;
+    for (const ZipEntry &entry : _entries)
+    {
+      centralHeader(out, entry);
+      if (out.size() >= ARCHIVE_BUFFER_SIZE)
+      {
+        if (!_output->write(out.data(), out.size()))
+          return false;
+        out.clear();
+      }
+    }
+    uint64_t directorySize = _output->size() + out.size() - directoryOffset;
+    uint64_t endOffset = directoryOffset + directorySize;
+
+    if (_entries.size() >= ZIP_MAX16 || directoryOffset >= ZIP_MAX32 || directorySize >= ZIP_MAX32)
+    {
+      le32(out, ZIP64_END_RECORD);
+      le64(out, 44);
+      le16(out, ZIP_MADE_BY_UNIX | ZIP64_VERSION);
+      le16(out, ZIP64_VERSION);
+      le32(out, 0);
+      le32(out, 0);
+      le64(out, _entries.size());
+      le64(out, _entries.size());
+      le64(out, directorySize);
+      le64(out, directoryOffset);
+
+      le32(out, ZIP64_END_LOCATOR);
+      le32(out, 0);
+      le64(out, endOffset);
+      le32(out, 1);
+    }
+
+    le32(out, ZIP_END_RECORD);
+    le16(out, 0);
+    le16(out, 0);
+    le16(out, (uint16_t)min<size_t>(_entries.size(), ZIP_MAX16));
+    le16(out, (uint16_t)min<size_t>(_entries.size(), ZIP_MAX16));
+    le32(out, (uint32_t)min<uint64_t>(directorySize, ZIP_MAX32));
+    le32(out, (uint32_t)min<uint64_t>(directoryOffset, ZIP_MAX32));
+    le16(out, 0);
+
+    return _output->write(out.data(), out.size()) && _output->close();
+  }
+
+private:
+  /**
+   * helper function to add the extended timestamp field, the mtime in UTC
+   */
+  static void timestampField(vector<unsigned char> &out, time_t mtime)
+  {
+    le16(out, 0x5455);
+    le16(out, 5);
+    out.push_back(1);
+    le32(out, (uint32_t)(mtime > 0 ? mtime : 0));
+  }
+
+  bool localHeader(const ZipEntry &entry)
+  {
+    uint16_t date, time;
+    dosTime(entry.mtime, date, time);
+
+    vector<unsigned char> out;
+    le32(out, ZIP_LOCAL_HEADER);
+    le16(out, entry.zip64 ? ZIP64_VERSION : ZIP_VERSION);
+    le16(out, ZIP_FLAG_UTF8 | (entry.folder ? 0 : ZIP_FLAG_DESCRIPTOR));
+    le16(out, entry.method);
+    le16(out, time);
+    le16(out, date);
+    // crc and sizes follow the data in the descriptor
+    le32(out, 0);
+    le32(out, entry.zip64 ? ZIP_MAX32 : 0);
+    le32(out, entry.zip64 ? ZIP_MAX32 : 0);
+    le16(out, (uint16_t)entry.name.length());
+    le16(out, entry.zip64 ? 29 : 9);
+    out.insert(out.end(), entry.name.begin(), entry.name.end());
+    if (entry.zip64)
+    {
+      le16(out, 0x0001);
+      le16(out, 16);
+      le64(out, 0);
+      le64(out, 0);
+    }
+    timestampField(out, entry.mtime);
+    return _output->write(out.data(), out.size());
+  }
+
+  void centralHeader(vector<unsigned char> &out, const ZipEntry &entry)
+  {
+    uint16_t date, time;
+    dosTime(entry.mtime, date, time);
+
+    bool largeSize = entry.zip64 || entry.size >= ZIP_MAX32 || entry.compressedSize >= ZIP_MAX32;
+    bool largeOffset = entry.offset >= ZIP_MAX32;
+    uint16_t zip64Length = (largeSize ? 16 : 0) + (largeOffset ? 8 : 0);
+
+    le32(out, ZIP_CENTRAL_HEADER);
+    le16(out, ZIP_MADE_BY_UNIX | ZIP64_VERSION);
+    le16(out, entry.zip64 || zip64Length ? ZIP64_VERSION : ZIP_VERSION);
+    le16(out, ZIP_FLAG_UTF8 | (entry.folder ? 0 : ZIP_FLAG_DESCRIPTOR));
+    le16(out, entry.method);
+    le16(out, time);
+    le16(out, date);
+    le32(out, entry.crc);
+    le32(out, largeSize ? ZIP_MAX32 : (uint32_t)entry.compressedSize);
+    le32(out, largeSize ? ZIP_MAX32 : (uint32_t)entry.size);
+    le16(out, (uint16_t)entry.name.length());
+    le16(out, (zip64Length ? zip64Length + 4 : 0) + 9);
+    le16(out, 0);
+    le16(out, 0);
+    le16(out, 0);
+    // unix mode in the high 16 bits, MS-DOS directory attribute in the low ones
+    le32(out, entry.folder ? (040755u << 16) | 0x10 : (0100644u << 16));
+    le32(out, largeOffset ? ZIP_MAX32 : (uint32_t)entry.offset);
+    out.insert(out.end(), entry.name.begin(), entry.name.end());
+    if (zip64Length)
+    {
+      le16(out, 0x0001);
+      le16(out, zip64Length);
+      if (largeSize)
+      {
+        le64(out, entry.size);
+        le64(out, entry.compressedSize);
+      }
+      if (largeOffset)
+        le64(out, entry.offset);
+    }
+    timestampField(out, entry.mtime);
+  }
+
+  ArchiveOutput *_output;
+  bool _deflate;
+  int _level;
+  Deflater _deflater;
+  vector<ZipEntry> _entries;
+  // the file being written, entries are not added until it ends
+  ZipEntry *_entry;
+  uint64_t _start;
+  uint64_t _written;
+};
+
+ArchiveWriter *newArchiveWriter(const string &format, const string &compression, int level, ArchiveOutput *output)
+{
+  if (level < -1 || level > 9)
+    return NULL;
+
+  if (format == "tar")
+  {
+    if (compression == "none")
+      return new TarWriter(output, NULL);
+    if (compression == "gzip")
+      return new TarWriter(output, new GzipOutput(output, level));
+    return NULL;
+  }
+
+  if (format == "zip")
+  {
+    if (compression == "none" || compression == "deflate")
+      return new ZipWriter(output, compression == "deflate", level);
+    return NULL;
+  }
+
+  return NULL;
+}
+
+/*
+ * readers
+ */
+
+static const size_t INFLATE_CHUNK_SIZE = 64 * 1024;
+
+/**
+ * helper function to clean up the path of an entry
+ *
+ * @return false if the path leaves the archive root
+ */
+static bool entryPath(string path, string &clean)
+{
+  for (char &c : path)
+  {
+    if (c == '\\')
+      c = '/';
+  }
+
+  clean.clear();
+  size_t start = 0;
+  while (start <= path.length())
+  {
+    size_t end = path.find('/', start);
+    if (end == string::npos)
+      end = path.length();
+
+    string part = path.substr(start, end - start);
+    if (part == "..")
+      return false;
+    if (!part.empty() && part != ".")
+      clean += (clean.empty() ? "" : "/") + part;
+    start = end + 1;
+  }
+  return true;
+}
+
+/**
+ * sequential source of the bytes of a tar archive
+ */
+class TarSource
+{
+public:
+  TarSource(FILE *fd, bool gzip) : _fd(fd), _gzip(gzip), _consumed(0), _ended(false)
+  {
+    if (_gzip)
+    {
+      memset(&_stream, 0, sizeof(_stream));
+      // 15 + 32 detects the gzip header
+      _gzip = inflateInit2(&_stream, 15 + 32) == Z_OK;
+      _failed = !_gzip;
+    }
+    else
+    {
+      _failed = false;
+    }
+  }
+
+  ~TarSource()
+  {
+    if (_gzip)
+      inflateEnd(&_stream);
+    fclose(_fd);
+  }
+
+  /**
+   * @return the number of bytes read, less than length at the end of the data or on error
+   */
+  size_t read(unsigned char *data, size_t length)
+  {
+    if (!_gzip)
+    {
+      size_t got = fread(data, 1, length, _fd);
+      _consumed += got;
+      return got;
+    }
+
+    _stream.next_out = data;
+    _stream.avail_out = (uInt)length;
+    while (_stream.avail_out > 0 && !_ended && !_failed)
+    {
+      if (_stream.avail_in == 0)
+      {
+        size_t got = fread(_in, 1, sizeof(_in), _fd);
+        _consumed += got;
+        if (got == 0)
+        {
+          _failed = true;
+          break;
+        }
+        _stream.next_in = _in;
+        _stream.avail_in = (uInt)got;
+      }
+
+      int ret = inflate(&_stream, Z_NO_FLUSH);
+      if (ret == Z_STREAM_END)
+      {
+        // concatenated gzip members form one stream
+        if (_stream.avail_in > 0 || !feof(_fd))
+          _failed = inflateReset(&_stream) != Z_OK;
+        else
+          _ended = true;
+      }
+      else if (ret != Z_OK && ret != Z_BUF_ERROR)
+      {
+        _failed = true;
+      }
+    }
+    return length - _stream.avail_out;
+  }
+
+  uint64_t consumed() const { return _consumed; }
+
+private:
+  FILE *_fd;
+  bool _gzip;
+  z_stream _stream;
+  unsigned char _in[INFLATE_CHUNK_SIZE];
+  uint64_t _consumed;
+  bool _ended;
+  bool _failed;
+};
+
+/**
+ * helper function to parse a numeric tar header field, octal or GNU base-256
+ */
+static uint64_t tarNumber(const char *field, size_t width)
+{
+  if ((unsigned char)field[0] & 0x80)
+  {
+    uint64_t value = (unsigned char)field[0] & 0x7f;
+    for (size_t i = 1; i < width; i++)
+      value = (value << 8) | (unsigned char)field[i];
+    return value;
+  }
+
+  uint64_t value = 0;
+  for (size_t i = 0; i < width && field[i]; i++)
+  {
+    if (field[i] >= '0' && field[i] <= '7')
+      value = value * 8 + (field[i] - '0');
+  }
+  return value;
+}
+
+/**
+ * helper function to read a nul terminated header field
+ */
+static string tarString(const char *field, size_t width)
+{
+  return string(field, strnlen(field, width));
+}
+
+class TarReader : public ArchiveReader
+{
+public:
+  TarReader(FILE *fd, bool gzip) : _source(fd, gzip), _remaining(0), _padding(0) {}
+
+  bool next(ArchiveEntry &entry) override
+  {
+    if (_failed || !skip(_remaining + _padding))
+      return false;
+    _remaining = 0;
+    _padding = 0;
+
+    string longName;
+    string paxPath;
+    int64_t paxSize = -1;
+    int64_t paxMtime = -1;
+
+    while (true)
+    {
+      char header[TAR_BLOCK];
+      size_t got = _source.read((unsigned char *)header, sizeof(header));
+      // archives cut after the last entry are accepted, like tar does
+      if (got == 0)
+        return false;
+      if (got != sizeof(header))
+        return fail();
+
+      bool zero = true;
+      for (size_t i = 0; i < sizeof(header) && zero; i++)
+        zero = header[i] == 0;
+      if (zero)
+        return false;
+
+      unsigned int checksum = 0;
+      for (size_t i = 0; i < sizeof(header); i++)
+        checksum += (i >= 148 && i < 156) ? ' ' : (unsigned char)header[i];
+      if (checksum != tarNumber(header + 148, 8))
+        return fail();
+
+      uint64_t size = paxSize >= 0 ? (uint64_t)paxSize : tarNumber(header + 124, 12);
+      char type = header[156];
+
+      if (type == 'x' || type == 'g' || type == 'L' || type == 'K')
+      {
+        size = tarNumber(header + 124, 12);
+        // extended headers are small, anything big is not a valid archive
+        if (size > 1024 * 1024)
+          return fail();
+        string data(size, '\0');
+        if (_source.read((unsigned char *)&data[0], size) != size || !skip((TAR_BLOCK - size % TAR_BLOCK) % TAR_BLOCK))
+          return fail();
+
+        if (type == 'L')
+          longName = data.c_str();
+        else if (type == 'x')
+          parsePax(data, paxPath, paxSize, paxMtime);
+        continue;
+      }
+
+      string name = tarString(header, 100);
+      if (memcmp(header + 257, "ustar", 5) == 0 && header[345])
+        name = tarString(header + 345, 155) + "/" + name;
+      if (!longName.empty())
+        name = longName;
+      if (!paxPath.empty())
+        name = paxPath;
+
+      entry.size = size;
+      entry.mtime = paxMtime >= 0 ? (time_t)paxMtime : (time_t)tarNumber(header + 136, 12);
+      entry.folder = type == '5';
+
+      if (!entryPath(name, entry.name))
+        return fail();
+
+      bool file = type == '0' || type == '\0' || type == '7';
+      if ((!file && !entry.folder) || entry.name.empty())
+      {
+        // links, devices and the archive root are skipped
+        if (!skip(size + (TAR_BLOCK - size % TAR_BLOCK) % TAR_BLOCK))
+          return fail();
+        longName.clear();
+        paxPath.clear();
+        paxSize = -1;
+        paxMtime = -1;
+        continue;
+      }
+
+      if (entry.folder)
+        entry.size = 0;
+      _remaining = entry.size;
+      _padding = (TAR_BLOCK - entry.size % TAR_BLOCK) % TAR_BLOCK;
+      return true;
+    }
+  }
+
+  size_t read(unsigned char *data, size_t length) override
+  {
+    if (_failed)
+      return 0;
+    size_t want = (size_t)min<uint64_t>(length, _remaining);
+    size_t got = _source.read(data, want);
+    _remaining -= got;
+    if (got != want)
+      fail();
+    return got;
+  }
+
+  uint64_t consumed() const override { return _source.consumed(); }
+
+private:
+  bool fail()
+  {
+    _failed = true;
+    return false;
+  }
+
+  bool skip(uint64_t length)
+  {
+    unsigned char buffer[TAR_BLOCK * 16];
+    while (length > 0)
+    {
+      size_t want = (size_t)min<uint64_t>(length, sizeof(buffer));
+      if (_source.read(buffer, want) != want)
+        return fail();
+      length -= want;
+    }
+    return true;
+  }
+
+  static void parsePax(const string &data, string &path, int64_t &size, int64_t &mtime)
+  {
+    size_t start = 0;
+    while (start < data.length())
+    {
+      size_t space = data.find(' ', start);
+      if (space == string::npos)
+        return;
+      size_t length = strtoull(data.c_str() + start, NULL, 10);
+      if (length == 0 || length > data.length() - start || space + 2 > start + length)
+        return;
+
+      string record = data.substr(space + 1, start + length - space - 2);
+      size_t eq = record.find('=');
+      if (eq != string::npos)
+      {
+        string key = record.substr(0, eq);
+        string value = record.substr(eq + 1);
+        if (key == "path")
+          path = value;
+        else if (key == "size")
+          size = strtoll(value.c_str(), NULL, 10);
+        else if (key == "mtime")
+          mtime = strtoll(value.c_str(), NULL, 10);
+      }
+      start += length;
+    }
+  }
+
+  TarSource _source;
+  uint64_t _remaining;
+  size_t _padding;
+};
+
+static uint16_t readLE16(const unsigned char *p)
+{
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t readLE32(const unsigned char *p)
+{
+  return (uint32_t)readLE16(p) | ((uint32_t)readLE16(p + 2) << 16);
+}
+
+static uint64_t readLE64(const unsigned char *p)
+{
+  return (uint64_t)readLE32(p) | ((uint64_t)readLE32(p + 4) << 32);
+}
+
+/**
+ * helper function to convert the MS-DOS date and time of zip headers, in local time
+ */
+static time_t fromDosTime(uint16_t date, uint16_t time)
+{
+  struct tm local;
+  memset(&local, 0, sizeof(local));
+  local.tm_year = (date >> 9) + 80;
+  local.tm_mon = ((date >> 5) & 0xf) - 1;
+  local.tm_mday = date & 0x1f;
+  local.tm_hour = time >> 11;
+  local.tm_min = (time >> 5) & 0x3f;
+  local.tm_sec = (time & 0x1f) * 2;
+  local.tm_isdst = -1;
+  return mktime(&local);
+}
+
+/**
+ * archive input reading a local file
+ */
+class FileInput : public ArchiveInput
+{
+public:
+  FileInput(FILE *fd, uint64_t size) : _fd(fd), _size(size), _position(UINT64_MAX) {}
+  ~FileInput() { fclose(_fd); }
+
+  uint64_t size() const override { return _size; }
+
+  bool readAt(uint64_t offset, unsigned char *data, size_t length) override
+  {
+    // sequential reads keep the stdio buffer
+    if (offset != _position && !seekFile(_fd, offset))
+      return false;
+    size_t got = fread(data, 1, length, _fd);
+    _position = got == length ? offset + got : UINT64_MAX;
+    return got == length;
+  }
+
+private:
+  FILE *_fd;
+  uint64_t _size;
+  uint64_t _position;
+};
+
+// room for the name and extra field of a local header, read along with it
+static const uint64_t ZIP_LOCAL_HEADER_SLACK = 1024;
+
+class ZipReader : public ZipArchiveReader
+{
+public:
+  explicit ZipReader(ArchiveInput *input)
+      : _input(input), _size(input->size()), _index(0), _position(0), _inflating(false)
+  {
+    memset(&_stream, 0, sizeof(_stream));
+    _failed = inflateInit2(&_stream, -15) != Z_OK || !readDirectory();
+  }
+
+  ~ZipReader()
+  {
+    inflateEnd(&_stream);
+    delete _input;
+  }
+
+  const vector<ZipReaderEntry> &entries() const override { return _entries; }
+
+  bool select(size_t index, ArchiveEntry &entry) override
+  {
+    _index = index;
+    return next(entry);
+  }
+
+  bool next(ArchiveEntry &entry) override
+  {
+    if (_failed || _index >= _entries.size())
+      return false;
+
+    _current = _entries[_index++];
+    _input->expect(_current.offset, 30 + ZIP_LOCAL_HEADER_SLACK + (_current.entry.folder ? 0 : _current.compressedSize));
+    unsigned char header[30];
+    if (!_input->readAt(_current.offset, header, sizeof(header)) || readLE32(header) != ZIP_LOCAL_HEADER)
+      return fail();
+
+    _position = _current.offset + sizeof(header) + readLE16(header + 26) + readLE16(header + 28);
+
+    // encrypted entries and methods other than store and deflate are not supported
+    if ((_current.flags & 0x0001) || (_current.method != 0 && _current.method != 8))
+      return fail();
+
+    _compressedLeft = _current.entry.folder ? 0 : _current.compressedSize;
+    _left = _current.entry.folder ? 0 : _current.entry.size;
+    _crc = (uint32_t)crc32(0, NULL, 0);
+    _inflating = _current.method == 8;
+    if (_inflating)
+    {
+      inflateReset(&_stream);
+      _stream.avail_in = 0;
+    }
+
+    entry = _current.entry;
+    return true;
+  }
+
+  size_t read(unsigned char *data, size_t length) override
+  {
+    if (_failed || _left == 0)
+      return 0;
+
+    size_t want = (size_t)min<uint64_t>(length, _left);
+    size_t got = 0;
+    if (!_inflating)
+    {
+      got = _input->readAt(_position, data, want) ? want : 0;
+      _compressedLeft -= got;
+      _position += got;
+    }
+    else
+    {
+      _stream.next_out = data;
+      _stream.avail_out = (uInt)want;
+      while (_stream.avail_out > 0)
+      {
+        if (_stream.avail_in == 0)
+        {
+          size_t in = (size_t)min<uint64_t>(sizeof(_in), _compressedLeft);
+          if (in == 0 || !_input->readAt(_position, _in, in))
+            break;
+          _compressedLeft -= in;
+          _position += in;
+          _stream.next_in = _in;
+          _stream.avail_in = (uInt)in;
+        }
+        int ret = inflate(&_stream, Z_NO_FLUSH);
+        if (ret != Z_OK && ret != Z_STREAM_END)
+          break;
+        if (ret == Z_STREAM_END)
+          break;
+      }
+      got = want - _stream.avail_out;
+    }
+
+    _crc = (uint32_t)crc32(_crc, data, (uInt)got);
+    _left -= got;
+    if (got == 0 || (_left == 0 && _crc != _current.crc))
+    {
+      fail();
+      return 0;
+    }
+    return got;
+  }
+
+  uint64_t consumed() const override { return _position; }
+
+private:
+  bool fail()
+  {
+    _failed = true;
+    return false;
+  }
+
+  bool readDirectory()
+  {
+    // the end record is at most 64KB of comment away from the end of the file
+    size_t tail = (size_t)min<uint64_t>(_size, 22 + 0xFFFF);
+    vector<unsigned char> buffer(tail);
+    if (tail < 22 || !_input->readAt(_size - tail, buffer.data(), tail))
+      return false;
+
+    size_t end = tail - 22 + 1;
+    while (end-- > 0 && readLE32(&buffer[end]) != ZIP_END_RECORD)
+      ;
+    if (end == (size_t)-1)
+      return false;
+
+    uint64_t count = readLE16(&buffer[end + 10]);
+    uint64_t directorySize = readLE32(&buffer[end + 12]);
+    uint64_t directoryOffset = readLE32(&buffer[end + 16]);
+
+    uint64_t endOffset = _size - tail + end;
+    if ((count == ZIP_MAX16 || directorySize == ZIP_MAX32 || directoryOffset == ZIP_MAX32) && endOffset >= 20)
+    {
+      unsigned char locator[20], record[56];
+      if (!_input->readAt(endOffset - 20, locator, 20) || readLE32(locator) != ZIP64_END_LOCATOR)
+        return false;
+      if (!_input->readAt(readLE64(locator + 8), record, 56) || readLE32(record) != ZIP64_END_RECORD)
+        return false;
+      count = readLE64(record + 32);
+      directorySize = readLE64(record + 40);
+      directoryOffset = readLE64(record + 48);
+    }
+
+    // written not to wrap around with crafted zip64 values
+    if (directorySize > _size || directoryOffset > _size - directorySize)
+      return false;
+
+    vector<unsigned char> directory(directorySize);
+    if (!_input->readAt(directoryOffset, directory.data(), directorySize))
+      return false;
+
+    size_t at = 0;
+    for (uint64_t i = 0; i < count; i++)
+    {
+      if (at + 46 > directory.size() || readLE32(&directory[at]) != ZIP_CENTRAL_HEADER)
+        return false;
+      const unsigned char *h = &directory[at];
+      uint16_t nameLength = readLE16(h + 28);
+      uint16_t extraLength = readLE16(h + 30);
+      uint16_t commentLength = readLE16(h + 32);
+      if (at + 46 + nameLength + extraLength + commentLength > directory.size())
+        return false;
+
+      ZipReaderEntry entry;
+      entry.flags = readLE16(h + 8);
+      entry.method = readLE16(h + 10);
+      entry.crc = readLE32(h + 16);
+      entry.compressedSize = readLE32(h + 20);
+      entry.entry.size = readLE32(h + 24);
+      entry.offset = readLE32(h + 42);
+      entry.entry.mtime = fromDosTime(readLE16(h + 14), readLE16(h + 12));
+
+      string name((const char *)h + 46, nameLength);
+      entry.entry.folder = !name.empty() && (name.back() == '/' || name.back() == '\\');
+
+      const unsigned char *extra = h + 46 + nameLength;
+      for (size_t e = 0; e + 4 <= extraLength;)
+      {
+        uint16_t tag = readLE16(extra + e);
+        uint16_t length = readLE16(extra + e + 2);
+        const unsigned char *field = extra + e + 4;
+        if (e + 4 + length > extraLength)
+          break;
+
+        if (tag == 0x0001)
+        {
+          // zip64 values are only present for the fields set to the maximum
+          size_t f = 0;
+          if (entry.entry.size == ZIP_MAX32 && f + 8 <= length)
+            entry.entry.size = readLE64(field + f), f += 8;
+          if (entry.compressedSize == ZIP_MAX32 && f + 8 <= length)
+            entry.compressedSize = readLE64(field + f), f += 8;
+          if (entry.offset == ZIP_MAX32 && f + 8 <= length)
+            entry.offset = readLE64(field + f), f += 8;
+        }
+        else if (tag == 0x5455 && length >= 5 && (field[0] & 1))
+        {
+          entry.entry.mtime = (time_t)readLE32(field + 1);
+        }
+        e += 4 + length;
+      }
+
+      if (!entryPath(name, entry.entry.name))
+        return false;
+      if (entry.entry.folder)
+        entry.entry.size = 0;
+      if (!entry.entry.name.empty())
+        _entries.push_back(entry);
+      at += 46 + nameLength + extraLength + commentLength;
+    }
+
+    // read the data in file order, the central directory may list it differently
+    sort(_entries.begin(), _entries.end(),
+         [](const ZipReaderEntry &a, const ZipReaderEntry &b) { return a.offset < b.offset; });
+    return true;
+  }
+
+  ArchiveInput *_input;
+  uint64_t _size;
+  vector<ZipReaderEntry> _entries;
+  size_t _index;
+  ZipReaderEntry _current;
+  uint64_t _position;
+  uint64_t _compressedLeft;
+  uint64_t _left;
+  uint32_t _crc;
+  bool _inflating;
+  z_stream _stream;
+  unsigned char _in[INFLATE_CHUNK_SIZE];
+};
+
+ZipArchiveReader *openZipReader(ArchiveInput *input)
+{
+  ZipReader *reader = new ZipReader(input);
+  if (reader->failed())
+  {
+    delete reader;
+    return NULL;
+  }
+  return reader;
+}
+
+ArchiveReader *openArchiveReader(const string &path, uint64_t &size)
+{
+  FILE *fd = fopen(path.c_str(), "rb");
+  if (!fd)
+    return NULL;
+
+  unsigned char magic[TAR_BLOCK];
+  size_t got = fread(magic, 1, sizeof(magic), fd);
+  if (!seekFile(fd, 0) || fseek(fd, 0, SEEK_END) != 0)
+  {
+    fclose(fd);
+    return NULL;
+  }
+#ifdef _WIN32
+  size = (uint64_t)_ftelli64(fd);
+#else
+  size = (uint64_t)ftello(fd);
+#endif
+  seekFile(fd, 0);
+
+  ArchiveReader *reader = NULL;
+  if (got >= 4 && readLE32(magic) == ZIP_LOCAL_HEADER)
+    reader = new ZipReader(new FileInput(fd, size));
+  else if (got >= 22 && readLE32(magic) == ZIP_END_RECORD)
+    reader = new ZipReader(new FileInput(fd, size));
+  else if (got >= 2 && magic[0] == 0x1f && magic[1] == 0x8b)
+    reader = new TarReader(fd, true);
+  else if (got == sizeof(magic) && memcmp(magic + 257, "ustar", 5) == 0)
+    reader = new TarReader(fd, false);
+
+  if (!reader)
+  {
+    fclose(fd);
+    return NULL;
+  }
+  if (reader->failed())
+  {
+    delete reader;
+    return NULL;
+  }
+  return reader;
+}
@@ -0,0 +1,248 @@
+#ifndef LUCK_MTP_ARCHIVE
+#define LUCK_MTP_ARCHIVE
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+ * where an archive is written to, counts the bytes written
+ */
+class ArchiveOutput
+{
+public:
+  virtual ~ArchiveOutput() {}
+
+  /**
+   * @return false if the data could not be written
+   */
+  bool write(const unsigned char *data, size_t length)
+  {
+    _size += length;
+    return put(data, length);
+  }
+
+  /**
+   * flush the buffered data
+   */
+  virtual bool close() { return true; }
+
+  /**
+   * @return the number of bytes written
+   */
+  uint64_t size() const { return _size; }
+
+protected:
+  virtual bool put(const unsigned char *data, size_t length) = 0;
+
+private:
+  uint64_t _size = 0;
+};
+
+/**
+ * archive written to a local file
+ */
+class FileOutput : public ArchiveOutput
+{
+public:
+  FileOutput() : _fd(NULL) {}
+  ~FileOutput();
+
+  /**
+   * @param path the local file, overwritten
+   * @return false if the file can not be created
+   */
+  bool open(const string &path);
+
+  bool close() override;
+
+protected:
+  bool put(const unsigned char *data, size_t length) override;
+
+private:
+  FILE *_fd;
+  vector<char> _buffer;
+};
+
+/**
+ * streaming tar or zip writer
+ *
+ * entries are written one after the other while their data arrives, nothing
+ * is kept in memory except the zip central directory. a file entry must be
+ * given exactly the size announced in <code>beginFile</code>.
+ */
+class ArchiveWriter
+{
+public:
+  virtual ~ArchiveWriter() {}
+
+  /**
+   * @param name entry path inside the archive, '/' separated, without trailing '/'
+   * @param mtime modification time
+   */
+  virtual bool addFolder(const string &name, time_t mtime) = 0;
+
+  /**
+   * start a file entry, followed by <code>write</code> calls and <code>endFile</code>
+   *
+   * @param name entry path inside the archive
+   * @param size the size of the file
+   * @param mtime modification time
+   */
+  virtual bool beginFile(const string &name, uint64_t size, time_t mtime) = 0;
+
+  virtual bool write(const unsigned char *data, size_t length) = 0;
+
+  /**
+   * @return false if the file data was not the announced size
+   */
+  virtual bool endFile() = 0;
+
+  /**
+   * write the end of the archive and close the output
+   */
+  virtual bool finish() = 0;
+};
+
+/**
+ * create an archive writer
+ *
+ * @param format tar or zip
+ * @param compression none, or gzip for tar and deflate for zip
+ * @param level zlib compression level, -1 for the default
+ * @param output the archive output, must live as long as the writer
+ * @return the writer, NULL if the format or compression is not supported
+ */
+ArchiveWriter *newArchiveWriter(const string &format, const string &compression, int level, ArchiveOutput *output);
+
+/**
+ * an entry of an archive being read
+ */
+struct ArchiveEntry
+{
+  string name;
+  uint64_t size;
+  time_t mtime;
+  bool folder;
+};
+
+/**
+ * sequential tar, tar.gz or zip reader
+ *
+ * the entries are read in the order of their data in the archive file, the
+ * data of an entry is decompressed while it is read.
+ */
+class ArchiveReader
+{
+public:
+  virtual ~ArchiveReader() {}
+
+  /**
+   * move to the next entry, the rest of the current entry is skipped
+   *
+   * @param entry receives the entry, paths are '/' separated without trailing '/'
+   * @return false at the end of the archive or on error, @see failed()
+   */
+  virtual bool next(ArchiveEntry &entry) = 0;
+
+  /**
+   * read data of the current entry
+   *
+   * @return the number of bytes read, 0 at the end of the entry or on error
+   */
+  virtual size_t read(unsigned char *data, size_t length) = 0;
+
+  /**
+   * @return true if the archive is corrupt, unsupported or could not be read
+   */
+  bool failed() const { return _failed; }
+
+  /**
+   * @return the number of bytes of the archive file read so far
+   */
+  virtual uint64_t consumed() const = 0;
+
+protected:
+  bool _failed = false;
+};
+
+/**
+ * random access to the bytes of an archive
+ */
+class ArchiveInput
+{
+public:
+  virtual ~ArchiveInput() {}
+
+  virtual uint64_t size() const = 0;
+
+  /**
+   * @return false unless all the bytes could be read
+   */
+  virtual bool readAt(uint64_t offset, unsigned char *data, size_t length) = 0;
+
+  /**
+   * hint that the next reads fall within this range, an input with a costly
+   * access may fetch it in larger parts
+   */
+  virtual void expect(uint64_t /* offset */, uint64_t /* length */) {}
+};
+
+/**
+ * a zip entry as listed in the central directory
+ */
+struct ZipReaderEntry
+{
+  ArchiveEntry entry;
+  uint16_t flags;
+  uint16_t method;
+  uint32_t crc;
+  uint64_t compressedSize;
+  // of the local header
+  uint64_t offset;
+};
+
+/**
+ * zip reader with random access to its entries
+ */
+class ZipArchiveReader : public ArchiveReader
+{
+public:
+  /**
+   * @return the entries of the central directory, in the order of their data in the archive
+   */
+  virtual const vector<ZipReaderEntry> &entries() const = 0;
+
+  /**
+   * make an entry the current one, its data is then read with <code>read</code>
+   *
+   * @param index the index of the entry in <code>entries()</code>
+   * @param entry receives the entry
+   * @return false if the local header can not be read or the entry is not supported
+   */
+  virtual bool select(size_t index, ArchiveEntry &entry) = 0;
+};
+
+/**
+ * open a zip archive through a random access input, only the end records and
+ * the central directory are read
+ *
+ * @param input the archive, deleted with the reader
+ * @return the reader, NULL if the input is not a zip archive, the input is then deleted
+ */
+ZipArchiveReader *openZipReader(ArchiveInput *input);
+
+/**
+ * open an archive, the format is detected from its content
+ *
+ * @param path the local archive
+ * @param size receives the size of the archive file
+ * @return the reader, NULL if the file can not be read or is not a tar or zip archive
+ */
+ArchiveReader *openArchiveReader(const string &path, uint64_t &size);
+
+#endif
@@ -0,0 +1,1041 @@
+/**
+ * link-time stand-in for the subset of libmtp used by the addon
+ *
+ * simulates one or more devices holding an in-memory object tree, with a
+ * configurable latency for each PTP operation and a configurable usb
+ * bandwidth, so that the addon can be benchmarked without a phone.
+ *
+ * the device is configured by the <code>LUCK_MTP_FAKE</code> environment
+ * variable, read by <code>LIBMTP_Init</code>, as <code>key=value</code> pairs
+ * separated by <code>;</code>, e.g. <code>latencyUs=2000;bandwidth=20000000</code>.
+ * @see FakeConfig for the keys.
+ *
+ * every device holds the same generated tree:
+ *
+ * <code>
+ * data/com.ahyungui.android/db/upload.zip   the file used by the test scripts
+ * Music/, Pictures/                         the default folders of audio and image files
+ * bench/wide/                               wideEntries files
+ * bench/small/                              smallFiles files of smallSize bytes
+ * bench/large.bin                           largeSize bytes
+ * bench/deep/d1/d2/.../d{depth}/leaf.bin    a path of depth nested folders
+ * </code>
+ *
+ * file content is generated from the object id and offset unless the file
+ * has been uploaded.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include "../libmtp.h"
+#include "libmtp_structs.h"
+
+using namespace std;
+
+/**
+ * fake device configuration, each field is also the key of the <code>LUCK_MTP_FAKE</code> variable
+ */
+struct FakeConfig
+{
+  uint32_t devices = 1;         // number of devices attached
+  uint32_t latencyUs = 0;       // latency of each PTP operation
+  uint32_t openLatencyMs = 0;   // extra latency of opening a session
+  uint32_t detectLatencyMs = 0; // latency of a usb bus scan
+  uint64_t bandwidth = 0;       // bytes per second, 0 for unlimited
+  uint32_t chunkSize = 512 * 1024;
+  uint32_t wideEntries = 1000;
+  uint32_t smallFiles = 100;
+  uint64_t smallSize = 16 * 1024;
+  uint64_t largeSize = 64 * 1024 * 1024;
+  uint32_t depth = 8;
+  uint32_t propList = 0; // 1 if listing a folder costs one GetObjPropList instead of one GetObjectInfo per object
+  uint32_t renumber = 1; // 1 to number the object handles differently in each session
+  uint32_t keepData = 1; // 0 to drop the content of uploaded files
+  uint32_t copyObject = 1;
+  uint32_t moveObject = 1;
+  uint32_t partialObject = 1; // 0 if GetPartialObject is not supported
+  uint32_t editObjects = 1;   // 0 if objects can not be edited in place
+  uint32_t eventMs = 0;       // milliseconds between two changes made on the device itself, 0 for none
+};
+
+struct FakeObject
+{
+  uint32_t oid;
+  uint32_t parent; // 0 for the root
+  string name;
+  bool folder;
+  uint64_t size;
+  time_t mtime;
+  bool hasData;
+  bool editing;
+  vector<unsigned char> data;
+};
+
+struct FakeDevice
+{
+  uint32_t index;
+  uint32_t session;
+  uint32_t nextOid;
+  map<uint32_t, FakeObject> objects;
+  map<uint32_t, vector<uint32_t>> children;
+  // the changes made on the device itself, a photo taken then deleted in turn
+  chrono::steady_clock::time_point nextEvent;
+  uint32_t eventObject;
+  uint32_t eventCount;
+};
+
+/**
+ * an event read waiting for the next change of a device
+ */
+struct FakeEventRead
+{
+  LIBMTP_mtpdevice_t *device;
+  LIBMTP_event_cb_fn callback;
+  void *data;
+};
+
+static const uint32_t FAKE_STORAGE_ID = 0x00010001;
+// the payload of the first usb packet of a PTP data phase, libmtp asks for it on its own
+static const uint32_t FAKE_FIRST_PACKET = 500;
+static const uint32_t FAKE_SESSION_STRIDE = 0x100000;
+
+static FakeConfig __config;
+static vector<FakeDevice *> __devices;
+static vector<FakeEventRead> __eventReads;
+static mutex __mutex;
+
+/**
+ * helper function to wait for the simulated duration of an operation
+ */
+static void fakeSleepUs(uint64_t us)
+{
+  if (us > 0)
+    this_thread::sleep_for(chrono::microseconds(us));
+}
+
+static void fakeOps(uint64_t count)
+{
+  fakeSleepUs(count * __config.latencyUs);
+}
+
+static void fakeTransfer(uint64_t bytes)
+{
+  if (__config.bandwidth > 0)
+    fakeSleepUs(bytes * 1000000 / __config.bandwidth);
+}
+
+static unsigned char fakeByte(uint32_t oid, uint64_t offset)
+{
+  return (unsigned char)((offset * 31 + oid * 7) ^ (offset >> 9));
+}
+
+static void parseConfig(const char *text)
+{
+  if (!text)
+    return;
+
+  string config = text;
+  size_t start = 0;
+  while (start < config.length())
+  {
+    size_t end = config.find(';', start);
+    if (end == string::npos)
+      end = config.length();
+
+    string pair = config.substr(start, end - start);
+    size_t eq = pair.find('=');
+    if (eq != string::npos)
+    {
+      string key = pair.substr(0, eq);
+      uint64_t value = strtoull(pair.substr(eq + 1).c_str(), NULL, 10);
+
+#define FAKE_KEY(name)               \
+  if (key == #name)                  \
+  {                                  \
+    __config.name = value;           \
+  }
+      FAKE_KEY(devices)
+      FAKE_KEY(latencyUs)
+      FAKE_KEY(openLatencyMs)
+      FAKE_KEY(detectLatencyMs)
+      FAKE_KEY(bandwidth)
+      FAKE_KEY(chunkSize)
+      FAKE_KEY(wideEntries)
+      FAKE_KEY(smallFiles)
+      FAKE_KEY(smallSize)
+      FAKE_KEY(largeSize)
+      FAKE_KEY(depth)
+      FAKE_KEY(propList)
+      FAKE_KEY(renumber)
+      FAKE_KEY(keepData)
+      FAKE_KEY(copyObject)
+      FAKE_KEY(moveObject)
+      FAKE_KEY(partialObject)
+      FAKE_KEY(editObjects)
+      FAKE_KEY(eventMs)
+#undef FAKE_KEY
+    }
+    start = end + 1;
+  }
+
+  if (__config.chunkSize == 0)
+    __config.chunkSize = 512 * 1024;
+}
+
+static uint32_t addObject(FakeDevice *device, uint32_t parent, const string &name, bool folder, uint64_t size)
+{
+  FakeObject object;
+  object.oid = device->nextOid++;
+  object.parent = parent;
+  object.name = name;
+  object.folder = folder;
+  object.size = size;
+  object.mtime = 1672041505 + object.oid;
+  object.hasData = false;
+  object.editing = false;
+
+  device->objects[object.oid] = object;
+  device->children[parent].push_back(object.oid);
+  return object.oid;
+}
+
+static void removeChild(FakeDevice *device, uint32_t parent, uint32_t oid)
+{
+  vector<uint32_t> &siblings = device->children[parent];
+  siblings.erase(remove(siblings.begin(), siblings.end(), oid), siblings.end());
+}
+
+static void buildTree(FakeDevice *device)
+{
+  uint32_t data = addObject(device, 0, "data", true, 0);
+  uint32_t app = addObject(device, data, "com.ahyungui.android", true, 0);
+  uint32_t db = addObject(device, app, "db", true, 0);
+  addObject(device, db, "upload.zip", false, 8893742);
+
+  addObject(device, 0, "Music", true, 0);
+  addObject(device, 0, "Pictures", true, 0);
+
+  uint32_t bench = addObject(device, 0, "bench", true, 0);
+
+  uint32_t wide = addObject(device, bench, "wide", true, 0);
+  for (uint32_t i = 0; i < __config.wideEntries; i++)
+    addObject(device, wide, "entry_" + to_string(i) + ".jpg", false, 4096);
+
+  uint32_t small = addObject(device, bench, "small", true, 0);
+  for (uint32_t i = 0; i < __config.smallFiles; i++)
+    addObject(device, small, "small_" + to_string(i) + ".bin", false, __config.smallSize);
+
+  addObject(device, bench, "large.bin", false, __config.largeSize);
+
+  uint32_t parent = addObject(device, bench, "deep", true, 0);
+  for (uint32_t i = 1; i <= __config.depth; i++)
+    parent = addObject(device, parent, "d" + to_string(i), true, 0);
+  addObject(device, parent, "leaf.bin", false, 1024);
+}
+
+static FakeDevice *fakeDevice(LIBMTP_mtpdevice_t *device)
+{
+  return device ? (FakeDevice *)device->params : NULL;
+}
+
+static uint32_t toHandle(FakeDevice *device, uint32_t oid)
+{
+  if (oid == 0)
+    return 0;
+  return oid + (__config.renumber ? device->session * FAKE_SESSION_STRIDE : 0);
+}
+
+/**
+ * helper function to find the handle of a folder at the root by name, like libmtp looks up the default folders
+ *
+ * @return the handle, 0 if there is no such folder
+ */
+static uint32_t rootFolder(FakeDevice *device, const char *name)
+{
+  for (uint32_t oid : device->children[0])
+  {
+    const FakeObject &object = device->objects[oid];
+    if (object.folder && object.name == name)
+      return toHandle(device, oid);
+  }
+  return 0;
+}
+
+/**
+ * helper function to find an object by the handle of the current session
+ */
+static FakeObject *findObject(FakeDevice *device, uint32_t handle)
+{
+  uint32_t base = __config.renumber ? device->session * FAKE_SESSION_STRIDE : 0;
+  if (handle <= base)
+    return NULL;
+
+  auto it = device->objects.find(handle - base);
+  return it == device->objects.end() ? NULL : &it->second;
+}
+
+static LIBMTP_file_t *newFile(FakeDevice *device, const FakeObject &object)
+{
+  LIBMTP_file_t *file = LIBMTP_new_file_t();
+  file->item_id = toHandle(device, object.oid);
+  file->parent_id = toHandle(device, object.parent);
+  file->storage_id = FAKE_STORAGE_ID;
+  file->filename = strdup(object.name.c_str());
+  file->filesize = object.folder ? 0 : object.size;
+  file->modificationdate = object.mtime;
+  file->filetype = object.folder ? LIBMTP_FILETYPE_FOLDER : LIBMTP_FILETYPE_UNKNOWN;
+  return file;
+}
+
+static void removeTree(FakeDevice *device, uint32_t oid)
+{
+  vector<uint32_t> children = device->children[oid];
+  for (uint32_t child : children)
+    removeTree(device, child);
+
+  device->children.erase(oid);
+  device->objects.erase(oid);
+}
+
+static uint32_t copyTree(FakeDevice *device, uint32_t oid, uint32_t parent)
+{
+  FakeObject source = device->objects[oid];
+  uint32_t copy = addObject(device, parent, source.name, source.folder, source.size);
+
+  FakeObject &object = device->objects[copy];
+  object.hasData = source.hasData;
+  object.data = source.data;
+
+  vector<uint32_t> children = device->children[oid];
+  for (uint32_t child : children)
+    copyTree(device, child, copy);
+  return copy;
+}
+
+static uint32_t countObjects(FakeDevice *device)
+{
+  return device->objects.size();
+}
+
+/**
+ * helper function to read the content of an object
+ */
+static void readObject(const FakeObject &object, uint64_t offset, unsigned char *buffer, uint32_t length)
+{
+  if (object.hasData)
+  {
+    memcpy(buffer, object.data.data() + offset, length);
+    return;
+  }
+  for (uint32_t i = 0; i < length; i++)
+    buffer[i] = fakeByte(object.oid, offset + i);
+}
+
+extern "C"
+{
+
+  void LIBMTP_Init(void)
+  {
+    lock_guard<mutex> lock(__mutex);
+    if (!__devices.empty())
+      return;
+
+    parseConfig(getenv("LUCK_MTP_FAKE"));
+
+    for (uint32_t i = 0; i < __config.devices; i++)
+    {
+      FakeDevice *device = new FakeDevice();
+      device->index = i;
+      device->session = 0;
+      device->nextOid = 1;
+      buildTree(device);
+      __devices.push_back(device);
+    }
+  }
+
+  LIBMTP_error_number_t LIBMTP_Detect_Raw_Devices(LIBMTP_raw_device_t **devices, int *numdevs)
+  {
+    fakeSleepUs((uint64_t)__config.detectLatencyMs * 1000);
+
+    *devices = NULL;
+    *numdevs = 0;
+    if (__devices.empty())
+      return LIBMTP_ERROR_NO_DEVICE_ATTACHED;
+
+    LIBMTP_raw_device_t *rawdevices = (LIBMTP_raw_device_t *)calloc(__devices.size(), sizeof(LIBMTP_raw_device_t));
+    for (size_t i = 0; i < __devices.size(); i++)
+    {
+      rawdevices[i].device_entry.vendor = (char *)"luck-node-mtp";
+      rawdevices[i].device_entry.vendor_id = 0x1209;
+      rawdevices[i].device_entry.product = (char *)"Fake MTP device";
+      rawdevices[i].device_entry.product_id = 0x0001;
+      rawdevices[i].bus_location = 1;
+      rawdevices[i].devnum = i + 1;
+    }
+    *devices = rawdevices;
+    *numdevs = __devices.size();
+    return LIBMTP_ERROR_NONE;
+  }
+
+  LIBMTP_mtpdevice_t *LIBMTP_Open_Raw_Device_Uncached(LIBMTP_raw_device_t *rawdevice)
+  {
+    if (!rawdevice || rawdevice->devnum < 1 || rawdevice->devnum > __devices.size())
+      return NULL;
+
+    fakeSleepUs((uint64_t)__config.openLatencyMs * 1000);
+    // OpenSession, GetDeviceInfo, GetStorageIDs, GetStorageInfo
+    fakeOps(4);
+
+    FakeDevice *fake = __devices[rawdevice->devnum - 1];
+    {
+      lock_guard<mutex> lock(__mutex);
+      fake->session++;
+    }
+
+    LIBMTP_mtpdevice_t *device = (LIBMTP_mtpdevice_t *)calloc(1, sizeof(LIBMTP_mtpdevice_t));
+    device->object_bitsize = 32;
+    device->params = fake;
+    {
+      lock_guard<mutex> lock(__mutex);
+      device->default_music_folder = rootFolder(fake, "Music");
+      device->default_picture_folder = rootFolder(fake, "Pictures");
+    }
+    LIBMTP_Get_Storage(device, LIBMTP_STORAGE_SORTBY_NOTSORTED);
+    return device;
+  }
+
+  LIBMTP_mtpdevice_t *LIBMTP_Open_Raw_Device(LIBMTP_raw_device_t *rawdevice)
+  {
+    LIBMTP_mtpdevice_t *device = LIBMTP_Open_Raw_Device_Uncached(rawdevice);
+    if (device)
+    {
+      // the cached mode reads the metadata of every object when opening
+      fakeOps(1 + (__config.propList ? 1 : countObjects(fakeDevice(device))));
+      device->cached = 1;
+    }
+    return device;
+  }
+
+  void LIBMTP_Release_Device(LIBMTP_mtpdevice_t *device)
+  {
+    if (!device)
+      return;
+
+    // CloseSession
+    fakeOps(1);
+    {
+      lock_guard<mutex> lock(__mutex);
+      __eventReads.erase(remove_if(__eventReads.begin(), __eventReads.end(),
+                                   [device](const FakeEventRead &read) { return read.device == device; }),
+                         __eventReads.end());
+    }
+    freeDevice(device);
+  }
+
+  char *LIBMTP_Get_Serialnumber(LIBMTP_mtpdevice_t *device)
+  {
+    FakeDevice *fake = fakeDevice(device);
+    if (!fake)
+      return NULL;
+
+    char serial[32];
+    snprintf(serial, sizeof(serial), "FAKE%012u", fake->index + 1);
+    return strdup(serial);
+  }
+
+  int LIBMTP_Get_Storage(LIBMTP_mtpdevice_t *device, int const sortby)
+  {
+    if (!device)
+      return -1;
+
+    fakeOps(2);
+    if (device->storage)
+      return 0;
+
+    LIBMTP_devicestorage_t *storage = (LIBMTP_devicestorage_t *)calloc(1, sizeof(LIBMTP_devicestorage_t));
+    storage->id = FAKE_STORAGE_ID;
+    storage->StorageType = 3;
+    storage->FilesystemType = 2;
+    storage->AccessCapability = 0;
+    storage->MaxCapacity = 64ULL * 1024 * 1024 * 1024;
+    storage->FreeSpaceInBytes = 32ULL * 1024 * 1024 * 1024;
+    storage->FreeSpaceInObjects = 0xffffffff;
+    storage->StorageDescription = strdup("Internal shared storage");
+    storage->VolumeIdentifier = strdup("");
+    device->storage = storage;
+    return 0;
+  }
+
+  LIBMTP_file_t *LIBMTP_Get_Files_And_Folders(LIBMTP_mtpdevice_t *device, uint32_t const storage, uint32_t const parent)
+  {
+    FakeDevice *fake = fakeDevice(device);
+    if (!fake)
+      return NULL;
+
+    vector<LIBMTP_file_t *> files;
+    {
+      lock_guard<mutex> lock(__mutex);
+
+      uint32_t parentOid = 0;
+      if (parent != LIBMTP_FILES_AND_FOLDERS_ROOT && parent != 0)
+      {
+        FakeObject *object = findObject(fake, parent);
+        if (!object)
+          return NULL;
+        parentOid = object->oid;
+      }
+
+      auto it = fake->children.find(parentOid);
+      if (it != fake->children.end())
+      {
+        for (uint32_t oid : it->second)
+          files.push_back(newFile(fake, fake->objects[oid]));
+      }
+    }
+
+    // GetObjectHandles, then the object info of every handle
+    fakeOps(1 + (__config.propList ? 1 : files.size()));
+
+    LIBMTP_file_t *head = NULL, *tail = NULL;
+    for (LIBMTP_file_t *file : files)
+    {
+      if (tail)
+        tail->next = file;
+      else
+        head = file;
+      tail = file;
+    }
+    return head;
+  }
+
+  LIBMTP_file_t *LIBMTP_Get_Filemetadata(LIBMTP_mtpdevice_t *device, uint32_t const id)
+  {
+    FakeDevice *fake = fakeDevice(device);
+    if (!fake)
+      return NULL;
+
+    fakeOps(1);
+    lock_guard<mutex> lock(__mutex);
+    FakeObject *object = findObject(fake, id);
+    return object ? newFile(fake, *object) : NULL;
+  }
+
+  uint64_t LIBMTP_Get_u64_From_Object(LIBMTP_mtpdevice_t *device, uint32_t const id,
+                                      LIBMTP_property_t const property, uint64_t const value_default)
+  {
+    FakeDevice *fake = fakeDevice(device);
+    if (!fake)
+      return value_default;
+
+    fakeOps(1);
+    lock_guard<mutex> lock(__mutex);
+    FakeObject *object = findObject(fake, id);
+    if (!object)
+      return value_default;
+
+    switch (property)
+    {
+    case LIBMTP_PROPERTY_PersistantUniqueObjectIdentifier:
+      return 0x5eed000000000000ULL | ((uint64_t)fake->index << 32) | object->oid;
+    case LIBMTP_PROPERTY_ObjectSize:
+      return object->size;
+    default:
+      return value_default;
+    }
+  }
+
+  int LIBMTP_Get_File_To_Handler(LIBMTP_mtpdevice_t *device, uint32_t const id, MTPDataPutFunc put_func,
+                                 void *priv, LIBMTP_progressfunc_t const callback, void const *const data)
+  {
+    FakeDevice *fake = fakeDevice(device);
+    if (!fake)
+      return -1;
+
+    FakeObject object;
+    {
+      lock_guard<mutex> lock(__mutex);
+      FakeObject *found = findObject(fake, id);
+      if (!found || found->folder)
+        return -1;
+      object = *found;
+    }
+
+    // GetObjectInfo, GetObject
+    fakeOps(2);
+
+    vector<unsigned char> buffer(__config.chunkSize);
+    uint64_t sent = 0;
+    while (sent < object.size)
+    {
+      uint32_t length = (uint32_t)min<uint64_t>(buffer.size(), object.size - sent);
+      readObject(object, sent, buffer.data(), length);
+      fakeTransfer(length);
+
+      uint32_t written = 0;
+      if (put_func(NULL, priv, length, buffer.data(), &written) != LIBMTP_HANDLER_RETURN_OK || written != length)
+        return -1;
+      sent += length;
+
+      if (callback && callback(sent, object.size, data) != 0)
+        return -1;
+    }
+    return 0;
+  }
+
+  /**
+   * helper function to write the chunks of a download into a file
+   */
+  static uint16_t putToFile(void *params, void *priv, uint32_t sendlen, unsigned char *data, uint32_t *putlen)
+  {
+    *putlen = fwrite(data, 1, sendlen, (FILE *)priv);
+    return *putlen == sendlen ? LIBMTP_HANDLER_RETURN_OK : LIBMTP_HANDLER_RETURN_ERROR;
+  }
+
+  int LIBMTP_Get_File_To_File(LIBMTP_mtpdevice_t *device, uint32_t id, char const *const path,
+                              LIBMTP_progressfunc_t const callback, void const *const data)
+  {
+    if (!fakeDevice(device))
+      return -1;
+
+    FILE *fd = fopen(path, "wb");
+    if (!fd)
+      return -1;
+
+    int ret = LIBMTP_Get_File_To_Handler(device, id, putToFile, fd, callback, data);
+    fclose(fd);
+    return ret;
+  }
+
+  int LIBMTP_Send_File_From_Handler(LIBMTP_mtpdevice_t *device, MTPDataGetFunc get_func, void *priv,
+                                    LIBMTP_file_t *const filedata, LIBMTP_progressfunc_t const callback,
+                                    void const *const data)
+  {
+    FakeDevice *fake = fakeDevice(device);
+    if (!fake || !filedata || !filedata->filename)
+      return -1;
+
+    // SendObjectInfo, SendObject
+    fakeOps(2);
+
+    // like libmtp, exactly filesize bytes are requested from the handler. the first
+    // packet is always asked for, with 0 bytes for an empty file, and must come full
+    vector<unsigned char> content;
+    vector<unsigned char> buffer(max(__config.chunkSize, FAKE_FIRST_PACKET));
+    uint64_t sent = 0;
+    for (bool first = true; first || sent < filedata->filesize; first = false)
+    {
+      uint32_t wanted = (uint32_t)min<uint64_t>(first ? FAKE_FIRST_PACKET : buffer.size(), filedata->filesize - sent);
+      uint32_t length = 0;
+      if (get_func(NULL, priv, wanted, buffer.data(), &length) != LIBMTP_HANDLER_RETURN_OK ||
+          (first ? length != wanted : length == 0))
+        return -1;
+      fakeTransfer(length);
+      if (__config.keepData)
+        content.insert(content.end(), buffer.begin(), buffer.begin() + length);
+      sent += length;
+
+      if (callback && callback(sent, filedata->filesize, data) != 0)
+        return -1;
+    }
+
+    // like libmtp, parent 0 is the default folder of the file type, the root if the device has none
+    uint32_t parentId = filedata->parent_id;
+    if (parentId == 0)
+    {
+      if (LIBMTP_FILETYPE_IS_AUDIO(filedata->filetype))
+        parentId = device->default_music_folder;
+      else if (LIBMTP_FILETYPE_IS_IMAGE(filedata->filetype))
+        parentId = device->default_picture_folder;
+    }
+
+    lock_guard<mutex> lock(__mutex);
+    uint32_t parentOid = 0;
+    if (parentId != 0 && parentId != filedata->storage_id && parentId != LIBMTP_FILES_AND_FOLDERS_ROOT)
+    {
+      FakeObject *parent = findObject(fake, parentId);
+      if (!parent || !parent->folder)
+        return -1;
+      parentOid = parent->oid;
+    }
+
+    uint32_t oid = addObject(fake, parentOid, filedata->filename, false, sent);
+    FakeObject &object = fake->objects[oid];
+    object.hasData = __config.keepData != 0;
+    object.data.swap(content);
+    filedata->item_id = toHandle(fake, oid);
+    filedata->storage_id = FAKE_STORAGE_ID;
+    return 0;
+  }
+
+  /**
+   * helper function to read the chunks of an upload from a file
+   */
+  static uint16_t getFromFile(void *params, void *priv, uint32_t wantlen, unsigned char *data, uint32_t *gotlen)
+  {
+    *gotlen = wantlen > 0 ? fread(data, 1, wantlen, (FILE *)priv) : 0;
+    return *gotlen > 0 || wantlen == 0 ? LIBMTP_HANDLER_RETURN_OK : LIBMTP_HANDLER_RETURN_ERROR;
+  }
+
+  int LIBMTP_Send_File_From_File(LIBMTP_mtpdevice_t *device, char const *const path,
+                                 LIBMTP_file_t *const filedata, LIBMTP_progressfunc_t const callback,
+                                 void const *const data)
+  {
+    if (!fakeDevice(device) || !filedata || !filedata->filename)
+      return -1;
+
+    FILE *fd = fopen(path, "rb");
+    if (!fd)
+      return -1;
+
+    int ret = LIBMTP_Send_File_From_Handler(device, getFromFile, fd, filedata, callback, data);
+    fclose(fd);
+    return ret;
+  }
+
+  int LIBMTP_Delete_Object(LIBMTP_mtpdevice_t *device, uint32_t id)
+  {
+    FakeDevice *fake = fakeDevice(device);
+    if (!fake)
+      return -1;
+
+    fakeOps(1);
+    lock_guard<mutex> lock(__mutex);
+    FakeObject *object = findObject(fake, id);
+    if (!object)
+      return -1;
+
+    removeChild(fake, object->parent, object->oid);
+    removeTree(fake, object->oid);
+    return 0;
+  }
+
+  int LIBMTP_Move_Object(LIBMTP_mtpdevice_t *device, uint32_t id, uint32_t storage, uint32_t parent)
+  {
+    FakeDevice *fake = fakeDevice(device);
+    if (!fake || !__config.moveObject)
+      return -1;
+
+    fakeOps(1);
+    lock_guard<mutex> lock(__mutex);
+    FakeObject *object = findObject(fake, id);
+    FakeObject *target = parent == 0 ? NULL : findObject(fake, parent);
+    if (!object || (parent != 0 && (!target || !target->folder)))
+      return -1;
+
+    removeChild(fake, object->parent, object->oid);
+    object->parent = target ? target->oid : 0;
+    fake->children[object->parent].push_back(object->oid);
+    return 0;
+  }
+
+  int LIBMTP_Copy_Object(LIBMTP_mtpdevice_t *device, uint32_t id, uint32_t storage, uint32_t parent)
+  {
+    FakeDevice *fake = fakeDevice(device);
+    if (!fake || !__config.copyObject)
+      return -1;
+
+    fakeOps(1);
+    lock_guard<mutex> lock(__mutex);
+    FakeObject *object = findObject(fake, id);
+    FakeObject *target = parent == 0 ? NULL : findObject(fake, parent);
+    if (!object || (parent != 0 && (!target || !target->folder)))
+      return -1;
+
+    // the copy happens inside the device, model it at the usb bandwidth
+    fakeTransfer(object->size);
+    copyTree(fake, object->oid, target ? target->oid : 0);
+    return 0;
+  }
+
+  int LIBMTP_Set_File_Name(LIBMTP_mtpdevice_t *device, LIBMTP_file_t *file, const char *newname)
+  {
+    FakeDevice *fake = fakeDevice(device);
+    if (!fake || !file || !newname)
+      return -1;
+
+    fakeOps(1);
+    lock_guard<mutex> lock(__mutex);
+    FakeObject *object = findObject(fake, file->item_id);
+    if (!object)
+      return -1;
+
+    object->name = newname;
+    free(file->filename);
+    file->filename = strdup(newname);
+    return 0;
+  }
+
+  int LIBMTP_Set_Folder_Name(LIBMTP_mtpdevice_t *device, LIBMTP_folder_t *folder, const char *newname)
+  {
+    FakeDevice *fake = fakeDevice(device);
+    if (!fake || !folder || !newname)
+      return -1;
+
+    fakeOps(1);
+    lock_guard<mutex> lock(__mutex);
+    FakeObject *object = findObject(fake, folder->folder_id);
+    if (!object || !object->folder)
+      return -1;
+
+    object->name = newname;
+    return 0;
+  }
+
+  uint32_t LIBMTP_Create_Folder(LIBMTP_mtpdevice_t *device, char *name, uint32_t parent_id, uint32_t storage_id)
+  {
+    FakeDevice *fake = fakeDevice(device);
+    if (!fake || !name)
+      return 0;
+
+    fakeOps(2);
+    lock_guard<mutex> lock(__mutex);
+    uint32_t parentOid = 0;
+    if (parent_id != 0 && parent_id != LIBMTP_FILES_AND_FOLDERS_ROOT)
+    {
+      FakeObject *parent = findObject(fake, parent_id);
+      if (!parent || !parent->folder)
+        return 0;
+      parentOid = parent->oid;
+    }
+
+    return toHandle(fake, addObject(fake, parentOid, name, true, 0));
+  }
+
+  int LIBMTP_Get_Thumbnail(LIBMTP_mtpdevice_t *device, uint32_t const id, unsigned char **data, unsigned int *size)
+  {
+    FakeDevice *fake = fakeDevice(device);
+    if (!fake)
+      return -1;
+
+    // GetThumb
+    fakeOps(1);
+    uint32_t oid;
+    {
+      lock_guard<mutex> lock(__mutex);
+      FakeObject *object = findObject(fake, id);
+      if (!object || object->folder)
+        return -1;
+      oid = object->oid;
+    }
+
+    // a jpeg sized small thumbnail, different for each object
+    *size = 4096 + oid % 4096;
+    *data = (unsigned char *)malloc(*size);
+    for (unsigned int i = 0; i < *size; i++)
+      (*data)[i] = fakeByte(oid, i);
+    (*data)[0] = 0xff;
+    (*data)[1] = 0xd8;
+    fakeTransfer(*size);
+    return 0;
+  }
+
+  int LIBMTP_Check_Capability(LIBMTP_mtpdevice_t *device, LIBMTP_devicecap_t cap)
+  {
+    if (!fakeDevice(device))
+      return 0;
+
+    switch (cap)
+    {
+    case LIBMTP_DEVICECAP_GetPartialObject:
+      return __config.partialObject != 0;
+    case LIBMTP_DEVICECAP_SendPartialObject:
+    case LIBMTP_DEVICECAP_EditObjects:
+      return __config.editObjects != 0;
+    case LIBMTP_DEVICECAP_MoveObject:
+      return __config.moveObject != 0;
+    case LIBMTP_DEVICECAP_CopyObject:
+      return __config.copyObject != 0;
+    default:
+      return 0;
+    }
+  }
+
+  int LIBMTP_GetPartialObject(LIBMTP_mtpdevice_t *device, uint32_t const id, uint64_t offset, uint32_t maxbytes,
+                              unsigned char **data, unsigned int *size)
+  {
+    FakeDevice *fake = fakeDevice(device);
+    if (!fake || !__config.partialObject)
+      return -1;
+
+    // GetPartialObject, or GetPartialObject64 past 4GB
+    fakeOps(1);
+    unique_lock<mutex> lock(__mutex);
+    FakeObject *object = findObject(fake, id);
+    if (!object || object->folder)
+      return -1;
+
+    uint32_t length = offset < object->size ? (uint32_t)min<uint64_t>(maxbytes, object->size - offset) : 0;
+    *data = (unsigned char *)malloc(length > 0 ? length : 1);
+    readObject(*object, offset, *data, length);
+    *size = length;
+    lock.unlock();
+
+    fakeTransfer(length);
+    return 0;
+  }
+
+  /**
+   * helper function to find a file being edited, the mutex must be held
+   */
+  static FakeObject *findEditing(LIBMTP_mtpdevice_t *device, uint32_t id)
+  {
+    FakeDevice *fake = fakeDevice(device);
+    if (!fake || !__config.editObjects)
+      return NULL;
+
+    FakeObject *object = findObject(fake, id);
+    return object && object->editing ? object : NULL;
+  }
+
+  /**
+   * helper function to keep the content of a generated file before it is edited, the mutex must be held
+   */
+  static void materialize(FakeObject &object)
+  {
+    if (object.hasData || !__config.keepData)
+      return;
+
+    object.data.resize(object.size);
+    readObject(object, 0, object.data.data(), (uint32_t)object.size);
+    object.hasData = true;
+  }
+
+  int LIBMTP_SendPartialObject(LIBMTP_mtpdevice_t *device, uint32_t const id, uint64_t offset,
+                               unsigned char *data, unsigned int size)
+  {
+    // SendPartialObject
+    fakeOps(1);
+    fakeTransfer(size);
+    lock_guard<mutex> lock(__mutex);
+    FakeObject *object = findEditing(device, id);
+    // a write may extend the file, not leave a hole in it
+    if (!object || offset > object->size)
+      return -1;
+
+    materialize(*object);
+    object->size = max<uint64_t>(object->size, offset + size);
+    if (object->hasData)
+    {
+      object->data.resize(object->size);
+      memcpy(object->data.data() + offset, data, size);
+    }
+    return 0;
+  }
+
+  int LIBMTP_TruncateObject(LIBMTP_mtpdevice_t *device, uint32_t const id, uint64_t offset)
+  {
+    fakeOps(1);
+    lock_guard<mutex> lock(__mutex);
+    FakeObject *object = findEditing(device, id);
+    if (!object || offset > object->size)
+      return -1;
+
+    materialize(*object);
+    object->size = offset;
+    if (object->hasData)
+      object->data.resize(offset);
+    return 0;
+  }
+
+  int LIBMTP_BeginEditObject(LIBMTP_mtpdevice_t *device, uint32_t const id)
+  {
+    FakeDevice *fake = fakeDevice(device);
+    if (!fake || !__config.editObjects)
+      return -1;
+
+    fakeOps(1);
+    lock_guard<mutex> lock(__mutex);
+    FakeObject *object = findObject(fake, id);
+    if (!object || object->folder || object->editing)
+      return -1;
+    object->editing = true;
+    return 0;
+  }
+
+  int LIBMTP_EndEditObject(LIBMTP_mtpdevice_t *device, uint32_t const id)
+  {
+    fakeOps(1);
+    lock_guard<mutex> lock(__mutex);
+    FakeObject *object = findEditing(device, id);
+    if (!object)
+      return -1;
+    object->editing = false;
+    object->mtime = time(NULL);
+    return 0;
+  }
+
+  int LIBMTP_Read_Event_Async(LIBMTP_mtpdevice_t *device, LIBMTP_event_cb_fn cb, void *user_data)
+  {
+    FakeDevice *fake = fakeDevice(device);
+    if (!fake || !cb)
+      return -1;
+
+    lock_guard<mutex> lock(__mutex);
+    if (fake->eventCount == 0 && fake->eventObject == 0)
+      fake->nextEvent = chrono::steady_clock::now() + chrono::milliseconds(__config.eventMs);
+    __eventReads.push_back({device, cb, user_data});
+    return 0;
+  }
+
+  int LIBMTP_Handle_Events_Timeout_Completed(struct timeval *tv, int *completed)
+  {
+    auto deadline = chrono::steady_clock::now() + chrono::seconds(tv ? tv->tv_sec : 0) +
+                    chrono::microseconds(tv ? tv->tv_usec : 0);
+    while (!(completed && *completed))
+    {
+      FakeEventRead read = {NULL, NULL, NULL};
+      LIBMTP_event_t event = LIBMTP_EVENT_NONE;
+      uint32_t handle = 0;
+      {
+        lock_guard<mutex> lock(__mutex);
+        auto now = chrono::steady_clock::now();
+        for (auto it = __eventReads.begin(); __config.eventMs > 0 && it != __eventReads.end(); it++)
+        {
+          FakeDevice *fake = fakeDevice(it->device);
+          if (now < fake->nextEvent)
+            continue;
+
+          // a photo appears in the root, and is deleted the next time
+          auto object = fake->objects.find(fake->eventObject);
+          if (fake->eventObject && object != fake->objects.end())
+          {
+            handle = toHandle(fake, fake->eventObject);
+            removeChild(fake, object->second.parent, fake->eventObject);
+            removeTree(fake, fake->eventObject);
+            fake->eventObject = 0;
+            event = LIBMTP_EVENT_OBJECT_REMOVED;
+          }
+          else
+          {
+            fake->eventObject = addObject(fake, 0, "IMG_" + to_string(++fake->eventCount) + ".jpg", false, 4096);
+            handle = toHandle(fake, fake->eventObject);
+            event = LIBMTP_EVENT_OBJECT_ADDED;
+          }
+          fake->nextEvent = now + chrono::milliseconds(__config.eventMs);
+          read = *it;
+          __eventReads.erase(it);
+          break;
+        }
+      }
+
+      if (read.callback)
+      {
+        read.callback(0, event, handle, read.data);
+        continue;
+      }
+      if (chrono::steady_clock::now() >= deadline)
+        break;
+      this_thread::sleep_for(min<chrono::steady_clock::duration>(chrono::milliseconds(5),
+                                                                 deadline - chrono::steady_clock::now()));
+    }
+    return 0;
+  }
+}
@@ -0,0 +1,64 @@
+/**
+ * the libmtp struct helpers and globals shared by the link-time backends
+ */
+#include <stdlib.h>
+#include "libmtp_structs.h"
+
+int LIBMTP_debug = 0;
+
+void freeStorage(LIBMTP_devicestorage_t *storage)
+{
+  while (storage)
+  {
+    LIBMTP_devicestorage_t *next = storage->next;
+    free(storage->StorageDescription);
+    free(storage->VolumeIdentifier);
+    free(storage);
+    storage = next;
+  }
+}
+
+void freeDevice(LIBMTP_mtpdevice_t *device)
+{
+  freeStorage(device->storage);
+  free(device);
+}
+
+extern "C"
+{
+
+  void LIBMTP_Set_Debug(int level)
+  {
+    LIBMTP_debug = level;
+  }
+
+  LIBMTP_file_t *LIBMTP_new_file_t(void)
+  {
+    LIBMTP_file_t *file = (LIBMTP_file_t *)calloc(1, sizeof(LIBMTP_file_t));
+    file->filetype = LIBMTP_FILETYPE_UNKNOWN;
+    return file;
+  }
+
+  void LIBMTP_destroy_file_t(LIBMTP_file_t *file)
+  {
+    if (!file)
+      return;
+    free(file->filename);
+    free(file);
+  }
+
+  LIBMTP_folder_t *LIBMTP_new_folder_t(void)
+  {
+    return (LIBMTP_folder_t *)calloc(1, sizeof(LIBMTP_folder_t));
+  }
+
+  void LIBMTP_destroy_folder_t(LIBMTP_folder_t *folder)
+  {
+    if (!folder)
+      return;
+    LIBMTP_destroy_folder_t(folder->child);
+    LIBMTP_destroy_folder_t(folder->sibling);
+    free(folder->name);
+    free(folder);
+  }
+}
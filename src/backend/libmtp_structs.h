@@ -0,0 +1,16 @@
+#ifndef LUCK_MTP_BACKEND_LIBMTP_STRUCTS
+#define LUCK_MTP_BACKEND_LIBMTP_STRUCTS
+
+#include "../libmtp.h"
+
+/**
+ * free a storage list
+ */
+void freeStorage(LIBMTP_devicestorage_t *storage);
+
+/**
+ * free a device allocated by a link-time backend and its storage list
+ */
+void freeDevice(LIBMTP_mtpdevice_t *device);
+
+#endif
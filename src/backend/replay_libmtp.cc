@@ -0,0 +1,557 @@
+/**
+ * link-time stand-in for libmtp playing back a trace recorded with <code>startRecording</code>
+ *
+ * the trace file is read by <code>LIBMTP_Init</code> from the path in the
+ * <code>LUCK_MTP_REPLAY</code> environment variable. every call is matched
+ * with a recorded call of the same function and the same arguments, in
+ * recording order, and returns the recorded results after waiting for the
+ * recorded wall time. a call made with arguments never recorded is matched
+ * with the next recorded call of the same function, so a replay still runs
+ * when object handles or names differ from the recording.
+ *
+ * <code>LUCK_MTP_REPLAY_SPEED</code> divides the recorded wall times, 0 skips
+ * the waits, default 1.
+ *
+ * downloaded files are filled with zeros up to the recorded size, the content
+ * of the device is not part of the trace.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include "../libmtp.h"
+#include "../call_trace.h"
+#include "libmtp_structs.h"
+
+using namespace std;
+
+static vector<TraceRecord> __records;
+static map<string, vector<size_t>> __byKey;
+static map<string, size_t> __keyCursors;
+static vector<vector<size_t>> __byFunction(MTP_FN_COUNT);
+static vector<size_t> __functionCursors(MTP_FN_COUNT);
+static double __speed = 1;
+static bool __loaded = false;
+static mutex __mutex;
+
+static const size_t REPLAY_CHUNK_SIZE = 512 * 1024;
+
+/**
+ * helper function to take the next recorded call matching a call
+ *
+ * @return the recorded call, NULL if the function was never recorded
+ */
+static const TraceRecord *nextRecord(MtpFunction function, const vector<TraceValue> &args)
+{
+  lock_guard<mutex> lock(__mutex);
+
+  auto it = __byKey.find(traceRecordKey(function, args));
+  if (it != __byKey.end())
+  {
+    size_t &cursor = __keyCursors[it->first];
+    return &__records[it->second[cursor++ % it->second.size()]];
+  }
+
+  const vector<size_t> &calls = __byFunction[function];
+  if (calls.empty())
+    return NULL;
+
+  size_t &cursor = __functionCursors[function];
+  return &__records[calls[cursor++ % calls.size()]];
+}
+
+/**
+ * helper function to wait for a part of the recorded wall time of a call
+ */
+static void replaySleep(const TraceRecord *record, double fraction = 1)
+{
+  if (!record || __speed <= 0)
+    return;
+  uint64_t ns = (uint64_t)(record->elapsedNs * fraction / __speed);
+  if (ns > 0)
+    this_thread::sleep_for(chrono::nanoseconds(ns));
+}
+
+static int64_t resultInt(const TraceRecord *record, int64_t defaultValue)
+{
+  return record && record->result.tag == TRACE_INT ? record->result.number : defaultValue;
+}
+
+static const TraceValue *outValue(const TraceRecord *record, size_t index, TraceTag tag)
+{
+  if (!record || index >= record->outs.size() || record->outs[index].tag != tag)
+    return NULL;
+  return &record->outs[index];
+}
+
+static LIBMTP_file_t *newFiles(const TraceValue &value)
+{
+  LIBMTP_file_t *head = NULL, *tail = NULL;
+  for (const TraceFile &recorded : value.files)
+  {
+    LIBMTP_file_t *file = LIBMTP_new_file_t();
+    file->item_id = recorded.item_id;
+    file->parent_id = recorded.parent_id;
+    file->storage_id = recorded.storage_id;
+    file->filesize = recorded.filesize;
+    file->modificationdate = (time_t)recorded.modificationdate;
+    file->filetype = (LIBMTP_filetype_t)recorded.filetype;
+    file->filename = strdup(recorded.filename.c_str());
+
+    if (tail)
+      tail->next = file;
+    else
+      head = file;
+    tail = file;
+  }
+  return head;
+}
+
+static void setStorages(LIBMTP_mtpdevice_t *device, const TraceValue *value)
+{
+  if (!value)
+    return;
+
+  LIBMTP_devicestorage_t *previous = NULL;
+  for (const TraceStorage &recorded : value->storages)
+  {
+    LIBMTP_devicestorage_t *storage = (LIBMTP_devicestorage_t *)calloc(1, sizeof(LIBMTP_devicestorage_t));
+    storage->id = recorded.id;
+    storage->StorageType = recorded.StorageType;
+    storage->FilesystemType = recorded.FilesystemType;
+    storage->AccessCapability = recorded.AccessCapability;
+    storage->MaxCapacity = recorded.MaxCapacity;
+    storage->FreeSpaceInBytes = recorded.FreeSpaceInBytes;
+    storage->FreeSpaceInObjects = recorded.FreeSpaceInObjects;
+    storage->StorageDescription = strdup(recorded.StorageDescription.c_str());
+    storage->VolumeIdentifier = strdup(recorded.VolumeIdentifier.c_str());
+    storage->prev = previous;
+
+    if (previous)
+      previous->next = storage;
+    else
+      device->storage = storage;
+    previous = storage;
+  }
+}
+
+static LIBMTP_mtpdevice_t *replayOpen(MtpFunction function, LIBMTP_raw_device_t *rawdevice)
+{
+  const TraceRecord *record = nextRecord(function, {traceInt(rawdevice ? rawdevice->devnum : 0)});
+  replaySleep(record);
+  if (resultInt(record, 0) == 0)
+    return NULL;
+
+  LIBMTP_mtpdevice_t *device = (LIBMTP_mtpdevice_t *)calloc(1, sizeof(LIBMTP_mtpdevice_t));
+  device->object_bitsize = 32;
+  device->cached = function == MTP_FN_Open_Raw_Device;
+  setStorages(device, outValue(record, 0, TRACE_STORAGES));
+  return device;
+}
+
+static int replayMove(MtpFunction function, uint32_t id, uint32_t storage, uint32_t parent)
+{
+  const TraceRecord *record = nextRecord(function, {traceInt(id), traceInt(storage), traceInt(parent)});
+  replaySleep(record);
+  return resultInt(record, -1);
+}
+
+extern "C"
+{
+
+  void LIBMTP_Init(void)
+  {
+    lock_guard<mutex> lock(__mutex);
+    if (__loaded)
+      return;
+    __loaded = true;
+
+    const char *speed = getenv("LUCK_MTP_REPLAY_SPEED");
+    if (speed)
+      __speed = atof(speed);
+
+    const char *path = getenv("LUCK_MTP_REPLAY");
+    if (!path || !readTraceFile(path, __records))
+    {
+      fprintf(stderr, "luck-node-mtp: can not read the trace file of LUCK_MTP_REPLAY\n");
+      __records.clear();
+      return;
+    }
+
+    for (size_t i = 0; i < __records.size(); i++)
+    {
+      const TraceRecord &record = __records[i];
+      if (record.function >= MTP_FN_COUNT)
+        continue;
+      __byKey[traceRecordKey(record.function, record.args)].push_back(i);
+      __byFunction[record.function].push_back(i);
+    }
+  }
+
+  LIBMTP_error_number_t LIBMTP_Detect_Raw_Devices(LIBMTP_raw_device_t **devices, int *numdevs)
+  {
+    const TraceRecord *record = nextRecord(MTP_FN_Detect_Raw_Devices, {});
+    replaySleep(record);
+
+    *devices = NULL;
+    *numdevs = 0;
+
+    LIBMTP_error_number_t err = (LIBMTP_error_number_t)resultInt(record, LIBMTP_ERROR_NO_DEVICE_ATTACHED);
+    const TraceValue *recorded = outValue(record, 0, TRACE_RAWDEVICES);
+    if (err != LIBMTP_ERROR_NONE || !recorded || recorded->devices.empty())
+      return err;
+
+    LIBMTP_raw_device_t *rawdevices = (LIBMTP_raw_device_t *)calloc(recorded->devices.size(), sizeof(LIBMTP_raw_device_t));
+    for (size_t i = 0; i < recorded->devices.size(); i++)
+    {
+      const TraceRawDevice &device = recorded->devices[i];
+      // the records are kept until the process exits, the strings can be shared
+      rawdevices[i].device_entry.vendor = device.vendor.empty() ? NULL : (char *)device.vendor.c_str();
+      rawdevices[i].device_entry.vendor_id = device.vendor_id;
+      rawdevices[i].device_entry.product = device.product.empty() ? NULL : (char *)device.product.c_str();
+      rawdevices[i].device_entry.product_id = device.product_id;
+      rawdevices[i].bus_location = device.bus_location;
+      rawdevices[i].devnum = device.devnum;
+    }
+    *devices = rawdevices;
+    *numdevs = recorded->devices.size();
+    return err;
+  }
+
+  LIBMTP_mtpdevice_t *LIBMTP_Open_Raw_Device(LIBMTP_raw_device_t *rawdevice)
+  {
+    return replayOpen(MTP_FN_Open_Raw_Device, rawdevice);
+  }
+
+  LIBMTP_mtpdevice_t *LIBMTP_Open_Raw_Device_Uncached(LIBMTP_raw_device_t *rawdevice)
+  {
+    return replayOpen(MTP_FN_Open_Raw_Device_Uncached, rawdevice);
+  }
+
+  void LIBMTP_Release_Device(LIBMTP_mtpdevice_t *device)
+  {
+    replaySleep(nextRecord(MTP_FN_Release_Device, {}));
+    if (device)
+      freeDevice(device);
+  }
+
+  char *LIBMTP_Get_Serialnumber(LIBMTP_mtpdevice_t *device)
+  {
+    const TraceRecord *record = nextRecord(MTP_FN_Get_Serialnumber, {});
+    replaySleep(record);
+    if (!record || record->result.tag != TRACE_STR)
+      return NULL;
+    return strdup(record->result.text.c_str());
+  }
+
+  int LIBMTP_Get_Storage(LIBMTP_mtpdevice_t *device, int const sortby)
+  {
+    const TraceRecord *record = nextRecord(MTP_FN_Get_Storage, {});
+    replaySleep(record);
+
+    const TraceValue *storages = outValue(record, 0, TRACE_STORAGES);
+    if (device && storages)
+    {
+      freeStorage(device->storage);
+      device->storage = NULL;
+      setStorages(device, storages);
+    }
+    return resultInt(record, -1);
+  }
+
+  LIBMTP_file_t *LIBMTP_Get_Files_And_Folders(LIBMTP_mtpdevice_t *device, uint32_t const storage, uint32_t const parent)
+  {
+    const TraceRecord *record = nextRecord(MTP_FN_Get_Files_And_Folders, {traceInt(storage), traceInt(parent)});
+    replaySleep(record);
+    return record && record->result.tag == TRACE_FILES ? newFiles(record->result) : NULL;
+  }
+
+  LIBMTP_file_t *LIBMTP_Get_Filemetadata(LIBMTP_mtpdevice_t *device, uint32_t const id)
+  {
+    const TraceRecord *record = nextRecord(MTP_FN_Get_Filemetadata, {traceInt(id)});
+    replaySleep(record);
+    return record && record->result.tag == TRACE_FILES ? newFiles(record->result) : NULL;
+  }
+
+  uint64_t LIBMTP_Get_u64_From_Object(LIBMTP_mtpdevice_t *device, uint32_t const id,
+                                      LIBMTP_property_t const property, uint64_t const value_default)
+  {
+    const TraceRecord *record = nextRecord(MTP_FN_Get_u64_From_Object,
+                                           {traceInt(id), traceInt(property), traceInt(value_default)});
+    replaySleep(record);
+    return (uint64_t)resultInt(record, value_default);
+  }
+
+  int LIBMTP_Get_File_To_File(LIBMTP_mtpdevice_t *device, uint32_t id, char const *const path,
+                              LIBMTP_progressfunc_t const callback, void const *const data)
+  {
+    const TraceRecord *record = nextRecord(MTP_FN_Get_File_To_File, {traceInt(id), traceString(path, false)});
+    int ret = resultInt(record, -1);
+    if (ret != 0)
+    {
+      replaySleep(record);
+      return ret;
+    }
+
+    FILE *fd = fopen(path, "wb");
+    if (!fd)
+      return -1;
+
+    vector<char> buffer(REPLAY_CHUNK_SIZE, 0);
+    uint64_t sent = 0;
+    if (record->size == 0)
+      replaySleep(record);
+    while (sent < record->size)
+    {
+      size_t length = (size_t)min<uint64_t>(buffer.size(), record->size - sent);
+      replaySleep(record, (double)length / record->size);
+
+      if (fwrite(buffer.data(), 1, length, fd) != length)
+      {
+        fclose(fd);
+        return -1;
+      }
+      sent += length;
+
+      if (callback && callback(sent, record->size, data) != 0)
+      {
+        fclose(fd);
+        return -1;
+      }
+    }
+
+    fclose(fd);
+    return 0;
+  }
+
+  int LIBMTP_Send_File_From_File(LIBMTP_mtpdevice_t *device, char const *const path,
+                                 LIBMTP_file_t *const filedata, LIBMTP_progressfunc_t const callback,
+                                 void const *const data)
+  {
+    if (!filedata)
+      return -1;
+
+    const TraceRecord *record = nextRecord(MTP_FN_Send_File_From_File,
+                                           {traceString(path, false), traceInt(filedata->parent_id), traceString(filedata->filename)});
+    replaySleep(record);
+
+    int ret = resultInt(record, -1);
+    if (ret != 0)
+      return ret;
+
+    const TraceValue *itemId = outValue(record, 0, TRACE_INT);
+    const TraceValue *storageId = outValue(record, 1, TRACE_INT);
+    filedata->item_id = itemId ? itemId->number : 0;
+    filedata->storage_id = storageId ? storageId->number : filedata->storage_id;
+
+    if (callback && callback(filedata->filesize, filedata->filesize, data) != 0)
+      return -1;
+    return 0;
+  }
+
+  int LIBMTP_Get_File_To_Handler(LIBMTP_mtpdevice_t *device, uint32_t const id, MTPDataPutFunc put_func,
+                                 void *priv, LIBMTP_progressfunc_t const callback, void const *const data)
+  {
+    const TraceRecord *record = nextRecord(MTP_FN_Get_File_To_Handler, {traceInt(id)});
+    int ret = resultInt(record, -1);
+    if (ret != 0)
+    {
+      replaySleep(record);
+      return ret;
+    }
+
+    vector<unsigned char> buffer(REPLAY_CHUNK_SIZE, 0);
+    uint64_t sent = 0;
+    if (record->size == 0)
+      replaySleep(record);
+    while (sent < record->size)
+    {
+      uint32_t length = (uint32_t)min<uint64_t>(buffer.size(), record->size - sent);
+      replaySleep(record, (double)length / record->size);
+
+      uint32_t written = 0;
+      if (put_func(NULL, priv, length, buffer.data(), &written) != LIBMTP_HANDLER_RETURN_OK || written != length)
+        return -1;
+      sent += length;
+
+      if (callback && callback(sent, record->size, data) != 0)
+        return -1;
+    }
+    return 0;
+  }
+
+  int LIBMTP_Send_File_From_Handler(LIBMTP_mtpdevice_t *device, MTPDataGetFunc get_func, void *priv,
+                                    LIBMTP_file_t *const filedata, LIBMTP_progressfunc_t const callback,
+                                    void const *const data)
+  {
+    if (!filedata)
+      return -1;
+
+    const TraceRecord *record = nextRecord(MTP_FN_Send_File_From_Handler,
+                                           {traceInt(filedata->parent_id), traceString(filedata->filename)});
+    int ret = resultInt(record, -1);
+    if (ret != 0)
+    {
+      replaySleep(record);
+      return ret;
+    }
+
+    // the handler is drained like libmtp would, the recorded time is spread over the chunks
+    vector<unsigned char> buffer(REPLAY_CHUNK_SIZE);
+    uint64_t sent = 0;
+    if (filedata->filesize == 0)
+      replaySleep(record);
+    while (sent < filedata->filesize)
+    {
+      uint32_t wanted = (uint32_t)min<uint64_t>(buffer.size(), filedata->filesize - sent);
+      uint32_t length = 0;
+      if (get_func(NULL, priv, wanted, buffer.data(), &length) != LIBMTP_HANDLER_RETURN_OK || length == 0)
+        return -1;
+      replaySleep(record, (double)length / filedata->filesize);
+      sent += length;
+
+      if (callback && callback(sent, filedata->filesize, data) != 0)
+        return -1;
+    }
+
+    const TraceValue *itemId = outValue(record, 0, TRACE_INT);
+    const TraceValue *storageId = outValue(record, 1, TRACE_INT);
+    filedata->item_id = itemId ? itemId->number : 0;
+    filedata->storage_id = storageId ? storageId->number : filedata->storage_id;
+    return 0;
+  }
+
+  int LIBMTP_Delete_Object(LIBMTP_mtpdevice_t *device, uint32_t id)
+  {
+    const TraceRecord *record = nextRecord(MTP_FN_Delete_Object, {traceInt(id)});
+    replaySleep(record);
+    return resultInt(record, -1);
+  }
+
+  int LIBMTP_Move_Object(LIBMTP_mtpdevice_t *device, uint32_t id, uint32_t storage, uint32_t parent)
+  {
+    return replayMove(MTP_FN_Move_Object, id, storage, parent);
+  }
+
+  int LIBMTP_Copy_Object(LIBMTP_mtpdevice_t *device, uint32_t id, uint32_t storage, uint32_t parent)
+  {
+    return replayMove(MTP_FN_Copy_Object, id, storage, parent);
+  }
+
+  int LIBMTP_Set_File_Name(LIBMTP_mtpdevice_t *device, LIBMTP_file_t *file, const char *newname)
+  {
+    if (!file || !newname)
+      return -1;
+
+    const TraceRecord *record = nextRecord(MTP_FN_Set_File_Name, {traceInt(file->item_id), traceString(newname)});
+    replaySleep(record);
+
+    int ret = resultInt(record, -1);
+    if (ret == 0)
+    {
+      free(file->filename);
+      file->filename = strdup(newname);
+    }
+    return ret;
+  }
+
+  int LIBMTP_Set_Folder_Name(LIBMTP_mtpdevice_t *device, LIBMTP_folder_t *folder, const char *newname)
+  {
+    if (!folder || !newname)
+      return -1;
+
+    const TraceRecord *record = nextRecord(MTP_FN_Set_Folder_Name, {traceInt(folder->folder_id), traceString(newname)});
+    replaySleep(record);
+    return resultInt(record, -1);
+  }
+
+  uint32_t LIBMTP_Create_Folder(LIBMTP_mtpdevice_t *device, char *name, uint32_t parent_id, uint32_t storage_id)
+  {
+    const TraceRecord *record = nextRecord(MTP_FN_Create_Folder,
+                                           {traceString(name), traceInt(parent_id), traceInt(storage_id)});
+    replaySleep(record);
+    return (uint32_t)resultInt(record, 0);
+  }
+
+  int LIBMTP_Get_Thumbnail(LIBMTP_mtpdevice_t *device, uint32_t const id, unsigned char **data, unsigned int *size)
+  {
+    const TraceRecord *record = nextRecord(MTP_FN_Get_Thumbnail, {traceInt(id)});
+    replaySleep(record);
+    int ret = resultInt(record, -1);
+    if (ret != 0)
+      return ret;
+
+    *size = (unsigned int)record->size;
+    *data = (unsigned char *)calloc(*size > 0 ? *size : 1, 1);
+    return 0;
+  }
+
+  int LIBMTP_Check_Capability(LIBMTP_mtpdevice_t *device, LIBMTP_devicecap_t cap)
+  {
+    const TraceRecord *record = nextRecord(MTP_FN_Check_Capability, {traceInt(cap)});
+    return resultInt(record, 0);
+  }
+
+  int LIBMTP_GetPartialObject(LIBMTP_mtpdevice_t *device, uint32_t const id, uint64_t offset, uint32_t maxbytes,
+                              unsigned char **data, unsigned int *size)
+  {
+    const TraceRecord *record = nextRecord(MTP_FN_GetPartialObject, {traceInt(id), traceInt(offset), traceInt(maxbytes)});
+    replaySleep(record);
+    int ret = resultInt(record, -1);
+    if (ret != 0)
+      return ret;
+
+    *size = (unsigned int)min<uint64_t>(record->size, maxbytes);
+    *data = (unsigned char *)calloc(*size > 0 ? *size : 1, 1);
+    return 0;
+  }
+
+  int LIBMTP_SendPartialObject(LIBMTP_mtpdevice_t *device, uint32_t const id, uint64_t offset,
+                               unsigned char *data, unsigned int size)
+  {
+    const TraceRecord *record = nextRecord(MTP_FN_SendPartialObject, {traceInt(id), traceInt(offset)});
+    replaySleep(record);
+    return resultInt(record, -1);
+  }
+
+  int LIBMTP_TruncateObject(LIBMTP_mtpdevice_t *device, uint32_t const id, uint64_t offset)
+  {
+    const TraceRecord *record = nextRecord(MTP_FN_TruncateObject, {traceInt(id), traceInt(offset)});
+    replaySleep(record);
+    return resultInt(record, -1);
+  }
+
+  int LIBMTP_BeginEditObject(LIBMTP_mtpdevice_t *device, uint32_t const id)
+  {
+    const TraceRecord *record = nextRecord(MTP_FN_BeginEditObject, {traceInt(id)});
+    replaySleep(record);
+    return resultInt(record, -1);
+  }
+
+  int LIBMTP_EndEditObject(LIBMTP_mtpdevice_t *device, uint32_t const id)
+  {
+    const TraceRecord *record = nextRecord(MTP_FN_EndEditObject, {traceInt(id)});
+    replaySleep(record);
+    return resultInt(record, -1);
+  }
+
+  // the events themselves are not in the trace, none is ever delivered
+  int LIBMTP_Read_Event_Async(LIBMTP_mtpdevice_t *device, LIBMTP_event_cb_fn cb, void *user_data)
+  {
+    const TraceRecord *record = nextRecord(MTP_FN_Read_Event_Async, {});
+    return resultInt(record, -1);
+  }
+
+  int LIBMTP_Handle_Events_Timeout_Completed(struct timeval *tv, int *completed)
+  {
+    const TraceRecord *record = nextRecord(MTP_FN_Handle_Events_Timeout_Completed, {});
+    replaySleep(record);
+    return resultInt(record, -1);
+  }
+}
@@ -0,0 +1,310 @@
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "buffer_pool.h"
+#include "mtp_call.h"
+#include "utils.h"
+#include "broadcast.h"
+
+using namespace std;
+
+BroadcastSource::Chunk::~Chunk()
+{
+  if (data)
+    poolRelease(data);
+}
+
+BroadcastSource::~BroadcastSource()
+{
+  for (Reader &reader : _readers)
+  {
+    if (reader.fd)
+      fclose(reader.fd);
+  }
+}
+
+bool BroadcastSource::open(const char *path, size_t readers, uint64_t window)
+{
+  _readers.resize(readers);
+  // every device reads through its own descriptor, a lagging one reads the rest of the file with it
+  for (Reader &reader : _readers)
+  {
+    reader.fd = fopen(path, "rb");
+    if (!reader.fd)
+      return false;
+  }
+
+  FILE *fd = _readers.empty() ? NULL : _readers[0].fd;
+  if (!fd || fseek(fd, 0, SEEK_END) != 0)
+    return false;
+#ifdef _WIN32
+  _size = (uint64_t)_ftelli64(fd);
+#else
+  _size = (uint64_t)ftello(fd);
+#endif
+  _window = max<uint64_t>(1, (window + POOL_SLAB_SIZE - 1) / POOL_SLAB_SIZE);
+  return true;
+}
+
+void BroadcastSource::open(const unsigned char *data, uint64_t size, size_t readers)
+{
+  _memory = data;
+  _size = size;
+  _readers.resize(readers);
+}
+
+size_t BroadcastSource::read(size_t reader, uint64_t offset, unsigned char *data, size_t length)
+{
+  if (offset >= _size)
+    return 0;
+  length = (size_t)min<uint64_t>(length, _size - offset);
+
+  if (_memory)
+  {
+    memcpy(data, _memory + offset, length);
+    return length;
+  }
+
+  size_t done = 0;
+  while (done < length)
+  {
+    shared_ptr<Chunk> shared = chunk(reader, offset / POOL_SLAB_SIZE);
+    if (!shared)
+    {
+      if (!lagged(reader))
+        return 0;
+      // out of the window, the rest is read from the file
+      size_t got = readFile(_readers[reader], offset, data + done, length - done);
+      return got == length - done ? length : 0;
+    }
+
+    // the chunk stays alive while it is copied, even if the window moves on
+    size_t start = offset % POOL_SLAB_SIZE;
+    size_t take = min(length - done, shared->length - start);
+    memcpy(data + done, shared->data + start, take);
+    done += take;
+    offset += take;
+
+    lock_guard<mutex> lock(_mutex);
+    _readers[reader].position = offset;
+    evict();
+  }
+  return done;
+}
+
+void BroadcastSource::finish(size_t reader)
+{
+  lock_guard<mutex> lock(_mutex);
+  _readers[reader].done = true;
+  evict();
+}
+
+bool BroadcastSource::lagged(size_t reader)
+{
+  lock_guard<mutex> lock(_mutex);
+  return _readers[reader].lagged;
+}
+
+uint64_t BroadcastSource::bytesRead()
+{
+  lock_guard<mutex> lock(_mutex);
+  return _read;
+}
+
+/**
+ * helper function to get a chunk of the file, read by the first device that needs it
+ *
+ * @return the chunk, NULL if the device lags behind the window or the chunk can not be read
+ */
+shared_ptr<BroadcastSource::Chunk> BroadcastSource::chunk(size_t reader, uint64_t index)
+{
+  unique_lock<mutex> lock(_mutex);
+  Reader &self = _readers[reader];
+
+  // the slowest devices are left behind rather than holding the others back
+  while (!self.lagged)
+  {
+    uint64_t low = slowest();
+    if (index < low + _window)
+      break;
+    for (Reader &other : _readers)
+    {
+      if (!other.done && !other.lagged && other.position / POOL_SLAB_SIZE == low)
+        other.lagged = true;
+    }
+    evict();
+  }
+  if (self.lagged)
+    return NULL;
+
+  auto found = _chunks.find(index);
+  if (found != _chunks.end())
+  {
+    shared_ptr<Chunk> shared = found->second;
+    _cond.wait(lock, [&shared] { return shared->ready || shared->failed; });
+    return shared->failed ? NULL : shared;
+  }
+
+  shared_ptr<Chunk> shared = make_shared<Chunk>();
+  _chunks[index] = shared;
+  lock.unlock();
+
+  uint64_t offset = index * POOL_SLAB_SIZE;
+  size_t length = (size_t)min<uint64_t>(POOL_SLAB_SIZE, _size - offset);
+  unsigned char *data = poolAcquire();
+  bool ok = data && readFile(self, offset, data, length) == length;
+
+  lock.lock();
+  shared->data = data;
+  shared->length = length;
+  shared->ready = ok;
+  shared->failed = !ok;
+  _cond.notify_all();
+  return ok ? shared : NULL;
+}
+
+/**
+ * helper function to read a part of the file with the descriptor of a device
+ */
+size_t BroadcastSource::readFile(Reader &reader, uint64_t offset, unsigned char *data, size_t length)
+{
+  if (!seekFile(reader.fd, offset))
+    return 0;
+  size_t got = fread(data, 1, length, reader.fd);
+  lock_guard<mutex> lock(_mutex);
+  _read += got;
+  return got;
+}
+
+/**
+ * @return the chunk of the slowest device still in the window, the mutex must be held
+ */
+uint64_t BroadcastSource::slowest()
+{
+  uint64_t low = UINT64_MAX;
+  for (const Reader &reader : _readers)
+  {
+    if (!reader.done && !reader.lagged)
+      low = min<uint64_t>(low, reader.position / POOL_SLAB_SIZE);
+  }
+  return low;
+}
+
+/**
+ * drop the chunks every device in the window is past, the mutex must be held
+ */
+void BroadcastSource::evict()
+{
+  uint64_t low = slowest();
+  while (!_chunks.empty() && _chunks.begin()->first < low)
+    _chunks.erase(_chunks.begin());
+}
+
+/**
+ * the upload of one device
+ */
+struct BroadcastUpload
+{
+  BroadcastSource *source;
+  size_t reader;
+  uint64_t position;
+  atomic<uint64_t> sent;
+  const atomic<bool> *cancelled;
+};
+
+static uint16_t getFromBroadcast(void *params, void *priv, uint32_t wantlen, unsigned char *data, uint32_t *gotlen)
+{
+  BroadcastUpload *upload = (BroadcastUpload *)priv;
+  if (*upload->cancelled)
+    return LIBMTP_HANDLER_RETURN_CANCEL;
+  *gotlen = (uint32_t)upload->source->read(upload->reader, upload->position, data, wantlen);
+  upload->position += *gotlen;
+  upload->sent = upload->position;
+  // the first packet of an empty file asks for 0 bytes
+  return *gotlen > 0 || wantlen == 0 ? LIBMTP_HANDLER_RETURN_OK : LIBMTP_HANDLER_RETURN_ERROR;
+}
+
+size_t broadcastUpload(BroadcastSource &source, const string &filename, time_t mtime, vector<BroadcastTarget> &targets,
+                       LIBMTP_progressfunc_t const callback, void const *const data)
+{
+  size_t count = targets.size();
+  atomic<bool> cancelled(false);
+  unique_ptr<BroadcastUpload[]> uploads(new BroadcastUpload[count]);
+  mutex finishedMutex;
+  condition_variable finishedCond;
+  size_t finished = 0;
+
+  vector<thread> threads;
+  for (size_t i = 0; i < count; i++)
+  {
+    uploads[i].source = &source;
+    uploads[i].reader = i;
+    uploads[i].position = 0;
+    uploads[i].sent = 0;
+    uploads[i].cancelled = &cancelled;
+
+    threads.emplace_back([&, i] {
+      BroadcastTarget &target = targets[i];
+      LIBMTP_file_t *genfile = LIBMTP_new_file_t();
+      genfile->filesize = source.size();
+      genfile->filename = strdup(filename.c_str());
+      genfile->filetype = find_filetype(filename.c_str());
+      genfile->modificationdate = mtime;
+      genfile->parent_id = target.parent;
+      genfile->storage_id = target.storage;
+
+      int ret = mtpSendFileFromHandler(target.device, getFromBroadcast, &uploads[i], genfile, NULL, NULL);
+      target.id = ret == 0 ? genfile->item_id : 0;
+      // a partial file is not left on the device
+      if (ret != 0 && genfile->item_id != 0)
+        mtpDeleteObject(target.device, genfile->item_id);
+      LIBMTP_destroy_file_t(genfile);
+      source.finish(i);
+
+      lock_guard<mutex> lock(finishedMutex);
+      finished++;
+      finishedCond.notify_all();
+    });
+  }
+
+  // the progress is reported from the calling thread, where the callback may run javascript
+  uint64_t total = source.size() * count;
+  unique_lock<mutex> lock(finishedMutex);
+  while (finished < count)
+  {
+    finishedCond.wait_for(lock, chrono::milliseconds(100));
+    if (!callback || cancelled)
+      continue;
+
+    uint64_t sent = 0;
+    for (size_t i = 0; i < count; i++)
+      sent += uploads[i].sent;
+    lock.unlock();
+    if (callback(sent, total, data) != 0)
+      cancelled = true;
+    lock.lock();
+  }
+  lock.unlock();
+
+  if (callback && !cancelled)
+  {
+    uint64_t sent = 0;
+    for (size_t i = 0; i < count; i++)
+      sent += uploads[i].sent;
+    callback(sent, total, data);
+  }
+
+  size_t uploaded = 0;
+  for (size_t i = 0; i < count; i++)
+  {
+    threads[i].join();
+    targets[i].sent = uploads[i].sent;
+    targets[i].lagged = source.lagged(i);
+    if (targets[i].id != 0)
+      uploaded++;
+  }
+  return uploaded;
+}
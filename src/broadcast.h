@@ -0,0 +1,143 @@
+#ifndef LUCK_MTP_BROADCAST
+#define LUCK_MTP_BROADCAST
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "libmtp.h"
+
+using namespace std;
+
+/**
+ * the source of an upload to many devices at once, read once for all of them
+ *
+ * the file is read in chunks of a pooled slab, each chunk by the first device
+ * that needs it, and shared by reference with the other devices until the
+ * last one is past it. the chunks kept in memory are bounded by a lag window:
+ * a device more than the window behind the fastest one is left behind and
+ * reads the rest of the file on its own, so a slow device never holds the
+ * others back nor the memory. a source in memory is simply shared.
+ */
+class BroadcastSource
+{
+public:
+  BroadcastSource() {}
+  BroadcastSource(const BroadcastSource &) = delete;
+  BroadcastSource &operator=(const BroadcastSource &) = delete;
+  ~BroadcastSource();
+
+  /**
+   * @param path the local file
+   * @param readers the number of devices
+   * @param window the lag window in bytes, rounded up to whole chunks
+   * @return false if the file can not be opened
+   */
+  bool open(const char *path, size_t readers, uint64_t window);
+
+  /**
+   * @param data the content, kept by the caller until the upload is done
+   * @param size the size of the content
+   * @param readers the number of devices
+   */
+  void open(const unsigned char *data, uint64_t size, size_t readers);
+
+  uint64_t size() const { return _size; }
+
+  /**
+   * read the source for one device, from the thread of its upload
+   *
+   * @param reader the index of the device
+   * @param offset the position of the device in the source
+   * @return the number of bytes read, less than <code>length</code> only at the end of the source, 0 on error
+   */
+  size_t read(size_t reader, uint64_t offset, unsigned char *data, size_t length);
+
+  /**
+   * the device is done with the source, the chunks it held can go
+   */
+  void finish(size_t reader);
+
+  /**
+   * @return true if the device fell out of the lag window and read on its own
+   */
+  bool lagged(size_t reader);
+
+  /**
+   * @return the bytes read from the local file, shared chunks and reads of the lagging devices
+   */
+  uint64_t bytesRead();
+
+private:
+  struct Chunk
+  {
+    unsigned char *data = NULL;
+    size_t length = 0;
+    bool ready = false;
+    bool failed = false;
+    ~Chunk();
+  };
+
+  struct Reader
+  {
+    FILE *fd = NULL;
+    uint64_t position = 0;
+    bool lagged = false;
+    bool done = false;
+  };
+
+  shared_ptr<Chunk> chunk(size_t reader, uint64_t index);
+  size_t readFile(Reader &reader, uint64_t offset, unsigned char *data, size_t length);
+  uint64_t slowest();
+  void evict();
+
+  const unsigned char *_memory = NULL;
+  uint64_t _size = 0;
+  uint64_t _window = 0;
+  uint64_t _read = 0;
+  vector<Reader> _readers;
+  map<uint64_t, shared_ptr<Chunk>> _chunks;
+  mutex _mutex;
+  condition_variable _cond;
+};
+
+/**
+ * a device of an upload to many devices, and its outcome
+ */
+struct BroadcastTarget
+{
+  LIBMTP_mtpdevice_t *device;
+  uint32_t storage;
+  // the target folder id, LIBMTP_FILES_AND_FOLDERS_ROOT for the root of the storage
+  uint32_t parent;
+
+  // the object id of the new file, 0 if the upload failed
+  uint32_t id;
+  uint64_t sent;
+  bool lagged;
+};
+
+/**
+ * upload the same source to many devices at once, each device on a thread of
+ * its own, @see BroadcastSource
+ *
+ * a device that fails does not stop the others, its partial file is deleted.
+ *
+ * @param source the opened source
+ * @param filename the name of the new file
+ * @param mtime the modification date of the new file
+ * @param targets the devices, receive their outcome
+ * @param callback libmtp progress callback, called on the calling thread with the bytes sent to all the
+ * devices about every 100ms, a nonzero return cancels the upload of all the devices
+ * @param data user data of the progress callback
+ * @return the number of devices the file was uploaded to
+ */
+size_t broadcastUpload(BroadcastSource &source, const string &filename, time_t mtime, vector<BroadcastTarget> &targets,
+                       LIBMTP_progressfunc_t const callback, void const *const data);
+
+#endif
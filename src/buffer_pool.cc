@@ -0,0 +1,143 @@
+#include <stdlib.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include "buffer_pool.h"
+
+using namespace std;
+
+// free slabs kept by each thread, and by the shared list
+static const size_t POOL_THREAD_SLABS = 8;
+static const size_t POOL_SHARED_SLABS = 64;
+
+static atomic<uint64_t> __acquired(0);
+static atomic<uint64_t> __hits(0);
+static atomic<uint64_t> __allocated(0);
+static atomic<uint64_t> __inUse(0);
+static atomic<uint64_t> __highWater(0);
+
+static mutex __sharedMutex;
+static vector<unsigned char *> __shared;
+
+static unsigned char *allocateSlab()
+{
+#ifdef _WIN32
+  return (unsigned char *)_aligned_malloc(POOL_SLAB_SIZE, POOL_SLAB_ALIGNMENT);
+#else
+  void *slab = NULL;
+  return posix_memalign(&slab, POOL_SLAB_ALIGNMENT, POOL_SLAB_SIZE) == 0 ? (unsigned char *)slab : NULL;
+#endif
+}
+
+static void freeSlab(unsigned char *slab)
+{
+#ifdef _WIN32
+  _aligned_free(slab);
+#else
+  free(slab);
+#endif
+}
+
+/**
+ * helper function to keep a free slab in the shared list, or free it when the list is full
+ */
+static void releaseShared(unsigned char *slab)
+{
+  {
+    lock_guard<mutex> lock(__sharedMutex);
+    if (__shared.size() < POOL_SHARED_SLABS)
+    {
+      __shared.push_back(slab);
+      return;
+    }
+  }
+  freeSlab(slab);
+  __allocated--;
+}
+
+/**
+ * the free slabs of one thread, given to the shared list when the thread exits
+ */
+struct ThreadSlabs
+{
+  vector<unsigned char *> slabs;
+
+  ~ThreadSlabs()
+  {
+    for (unsigned char *slab : slabs)
+      releaseShared(slab);
+  }
+};
+
+static thread_local ThreadSlabs __threadSlabs;
+
+unsigned char *poolAcquire()
+{
+  __acquired++;
+  uint64_t inUse = ++__inUse;
+  uint64_t highWater = __highWater.load(memory_order_relaxed);
+  while (inUse > highWater && !__highWater.compare_exchange_weak(highWater, inUse))
+    ;
+
+  vector<unsigned char *> &slabs = __threadSlabs.slabs;
+  if (!slabs.empty())
+  {
+    unsigned char *slab = slabs.back();
+    slabs.pop_back();
+    __hits++;
+    return slab;
+  }
+
+  {
+    lock_guard<mutex> lock(__sharedMutex);
+    if (!__shared.empty())
+    {
+      unsigned char *slab = __shared.back();
+      __shared.pop_back();
+      __hits++;
+      return slab;
+    }
+  }
+
+  unsigned char *slab = allocateSlab();
+  if (!slab)
+  {
+    __inUse--;
+    return NULL;
+  }
+  __allocated++;
+  return slab;
+}
+
+void poolRelease(unsigned char *slab)
+{
+  if (!slab)
+    return;
+
+  __inUse--;
+  vector<unsigned char *> &slabs = __threadSlabs.slabs;
+  if (slabs.size() < POOL_THREAD_SLABS)
+  {
+    slabs.push_back(slab);
+    return;
+  }
+  releaseShared(slab);
+}
+
+BufferPoolStats poolStats()
+{
+  BufferPoolStats stats;
+  stats.acquired = __acquired;
+  stats.hits = __hits;
+  stats.allocated = __allocated;
+  stats.inUse = __inUse;
+  stats.highWater = __highWater;
+  return stats;
+}
+
+void resetPoolStats()
+{
+  __acquired = 0;
+  __hits = 0;
+  __highWater = __inUse.load();
+}
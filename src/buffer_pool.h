@@ -0,0 +1,53 @@
+#ifndef LUCK_MTP_BUFFER_POOL
+#define LUCK_MTP_BUFFER_POOL
+
+#include <stdint.h>
+#include <stddef.h>
+
+using namespace std;
+
+/**
+ * pool of fixed size, page aligned transfer buffers
+ *
+ * every thread keeps a few free slabs of its own, so the common acquire and
+ * release pairs never take a lock. a thread that frees more slabs than it
+ * uses (e.g. the main thread running the finalizers of buffers lent to
+ * javascript) hands the extra ones to a shared list, which keeps a bounded
+ * number of slabs and frees the rest.
+ */
+
+static const size_t POOL_SLAB_SIZE = 256 * 1024;
+static const size_t POOL_SLAB_ALIGNMENT = 4096;
+
+struct BufferPoolStats
+{
+  uint64_t acquired;
+  uint64_t hits;
+  uint64_t allocated;
+  uint64_t inUse;
+  uint64_t highWater;
+};
+
+/**
+ * get a slab of POOL_SLAB_SIZE bytes, reused when one is free
+ *
+ * @return the slab, NULL if the memory can not be allocated
+ */
+unsigned char *poolAcquire();
+
+/**
+ * give a slab back to the pool, may be called from any thread
+ */
+void poolRelease(unsigned char *slab);
+
+/**
+ * @return the counters of the pool, since the last reset for acquired and hits
+ */
+BufferPoolStats poolStats();
+
+/**
+ * clear the acquire counters and set the high water mark to the slabs in use
+ */
+void resetPoolStats();
+
+#endif
@@ -0,0 +1,427 @@
+#include <string.h>
+#include "call_trace.h"
+
+using namespace std;
+
+static const char TRACE_MAGIC[] = "LMTPTRC1";
+static const size_t TRACE_MAGIC_LENGTH = 8;
+static const size_t TRACE_FLUSH_SIZE = 64 * 1024;
+
+static const char *__functionNames[] = {
+#define MTP_FUNCTION_NAME(name) #name,
+    MTP_FUNCTIONS(MTP_FUNCTION_NAME)
+#undef MTP_FUNCTION_NAME
+};
+
+const char *mtpFunctionName(uint16_t function)
+{
+  return function < MTP_FN_COUNT ? __functionNames[function] : "Unknown";
+}
+
+TraceValue traceInt(int64_t number)
+{
+  TraceValue value;
+  value.tag = TRACE_INT;
+  value.number = number;
+  return value;
+}
+
+TraceValue traceString(const char *text, bool key)
+{
+  TraceValue value;
+  value.key = key;
+  if (text)
+  {
+    value.tag = TRACE_STR;
+    value.text = text;
+  }
+  return value;
+}
+
+TraceValue traceFiles(const LIBMTP_file_t *files, bool list)
+{
+  TraceValue value;
+  value.tag = TRACE_FILES;
+  for (const LIBMTP_file_t *file = files; file != NULL; file = list ? file->next : NULL)
+  {
+    value.files.push_back({file->item_id,
+                           file->parent_id,
+                           file->storage_id,
+                           file->filesize,
+                           (int64_t)file->modificationdate,
+                           (uint32_t)file->filetype,
+                           file->filename ? file->filename : ""});
+  }
+  return value;
+}
+
+TraceValue traceRawDevices(const LIBMTP_raw_device_t *devices, int count)
+{
+  TraceValue value;
+  value.tag = TRACE_RAWDEVICES;
+  for (int i = 0; devices && i < count; i++)
+  {
+    const LIBMTP_raw_device_t &device = devices[i];
+    value.devices.push_back({device.device_entry.vendor_id,
+                             device.device_entry.product_id,
+                             device.bus_location,
+                             device.devnum,
+                             device.device_entry.vendor ? device.device_entry.vendor : "",
+                             device.device_entry.product ? device.device_entry.product : ""});
+  }
+  return value;
+}
+
+TraceValue traceStorages(const LIBMTP_devicestorage_t *storage)
+{
+  TraceValue value;
+  value.tag = TRACE_STORAGES;
+  for (; storage != NULL; storage = storage->next)
+  {
+    value.storages.push_back({storage->id,
+                              storage->StorageType,
+                              storage->FilesystemType,
+                              storage->AccessCapability,
+                              storage->MaxCapacity,
+                              storage->FreeSpaceInBytes,
+                              storage->FreeSpaceInObjects,
+                              storage->StorageDescription ? storage->StorageDescription : "",
+                              storage->VolumeIdentifier ? storage->VolumeIdentifier : ""});
+  }
+  return value;
+}
+
+static void putVarint(string &out, uint64_t value)
+{
+  while (value >= 0x80)
+  {
+    out.push_back((char)(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back((char)value);
+}
+
+static void putSigned(string &out, int64_t value)
+{
+  putVarint(out, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+static void putString(string &out, const string &text)
+{
+  putVarint(out, text.length());
+  out.append(text);
+}
+
+static bool getVarint(const unsigned char *&p, const unsigned char *end, uint64_t &value)
+{
+  value = 0;
+  for (int shift = 0; shift < 64; shift += 7)
+  {
+    if (p >= end)
+      return false;
+    unsigned char byte = *p++;
+    value |= (uint64_t)(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+      return true;
+  }
+  return false;
+}
+
+static bool getSigned(const unsigned char *&p, const unsigned char *end, int64_t &value)
+{
+  uint64_t encoded;
+  if (!getVarint(p, end, encoded))
+    return false;
+  value = (int64_t)(encoded >> 1) ^ -(int64_t)(encoded & 1);
+  return true;
+}
+
+static bool getString(const unsigned char *&p, const unsigned char *end, string &text)
+{
+  uint64_t length;
+  if (!getVarint(p, end, length) || length > (uint64_t)(end - p))
+    return false;
+  text.assign((const char *)p, length);
+  p += length;
+  return true;
+}
+
+static void encodeValue(const TraceValue &value, string &out)
+{
+  out.push_back((char)(value.tag | (value.key ? 0 : 0x80)));
+  switch (value.tag)
+  {
+  case TRACE_INT:
+    putSigned(out, value.number);
+    break;
+  case TRACE_STR:
+    putString(out, value.text);
+    break;
+  case TRACE_FILES:
+    putVarint(out, value.files.size());
+    for (const TraceFile &file : value.files)
+    {
+      putVarint(out, file.item_id);
+      putVarint(out, file.parent_id);
+      putVarint(out, file.storage_id);
+      putVarint(out, file.filesize);
+      putSigned(out, file.modificationdate);
+      putVarint(out, file.filetype);
+      putString(out, file.filename);
+    }
+    break;
+  case TRACE_RAWDEVICES:
+    putVarint(out, value.devices.size());
+    for (const TraceRawDevice &device : value.devices)
+    {
+      putVarint(out, device.vendor_id);
+      putVarint(out, device.product_id);
+      putVarint(out, device.bus_location);
+      putVarint(out, device.devnum);
+      putString(out, device.vendor);
+      putString(out, device.product);
+    }
+    break;
+  case TRACE_STORAGES:
+    putVarint(out, value.storages.size());
+    for (const TraceStorage &storage : value.storages)
+    {
+      putVarint(out, storage.id);
+      putVarint(out, storage.StorageType);
+      putVarint(out, storage.FilesystemType);
+      putVarint(out, storage.AccessCapability);
+      putVarint(out, storage.MaxCapacity);
+      putVarint(out, storage.FreeSpaceInBytes);
+      putVarint(out, storage.FreeSpaceInObjects);
+      putString(out, storage.StorageDescription);
+      putString(out, storage.VolumeIdentifier);
+    }
+    break;
+  case TRACE_NONE:
+  default:
+    break;
+  }
+}
+
+static bool decodeValue(const unsigned char *&p, const unsigned char *end, TraceValue &value)
+{
+  if (p >= end)
+    return false;
+
+  unsigned char tag = *p++;
+  value.tag = (TraceTag)(tag & 0x7f);
+  value.key = !(tag & 0x80);
+
+  uint64_t count, number;
+  switch (value.tag)
+  {
+  case TRACE_NONE:
+    return true;
+  case TRACE_INT:
+    return getSigned(p, end, value.number);
+  case TRACE_STR:
+    return getString(p, end, value.text);
+  case TRACE_FILES:
+    // every entry takes a few bytes, a larger count is a corrupt trace
+    if (!getVarint(p, end, count) || count > (uint64_t)(end - p))
+      return false;
+    value.files.resize(count);
+    for (TraceFile &file : value.files)
+    {
+      if (!getVarint(p, end, number))
+        return false;
+      file.item_id = number;
+      if (!getVarint(p, end, number))
+        return false;
+      file.parent_id = number;
+      if (!getVarint(p, end, number))
+        return false;
+      file.storage_id = number;
+      if (!getVarint(p, end, file.filesize) || !getSigned(p, end, file.modificationdate) || !getVarint(p, end, number))
+        return false;
+      file.filetype = number;
+      if (!getString(p, end, file.filename))
+        return false;
+    }
+    return true;
+  case TRACE_RAWDEVICES:
+    if (!getVarint(p, end, count) || count > (uint64_t)(end - p))
+      return false;
+    value.devices.resize(count);
+    for (TraceRawDevice &device : value.devices)
+    {
+      uint64_t vid, pid, bus, devnum;
+      if (!getVarint(p, end, vid) || !getVarint(p, end, pid) || !getVarint(p, end, bus) || !getVarint(p, end, devnum))
+        return false;
+      device.vendor_id = vid;
+      device.product_id = pid;
+      device.bus_location = bus;
+      device.devnum = devnum;
+      if (!getString(p, end, device.vendor) || !getString(p, end, device.product))
+        return false;
+    }
+    return true;
+  case TRACE_STORAGES:
+    if (!getVarint(p, end, count) || count > (uint64_t)(end - p))
+      return false;
+    value.storages.resize(count);
+    for (TraceStorage &storage : value.storages)
+    {
+      uint64_t id, type, fs, access;
+      if (!getVarint(p, end, id) || !getVarint(p, end, type) || !getVarint(p, end, fs) || !getVarint(p, end, access))
+        return false;
+      storage.id = id;
+      storage.StorageType = type;
+      storage.FilesystemType = fs;
+      storage.AccessCapability = access;
+      if (!getVarint(p, end, storage.MaxCapacity) || !getVarint(p, end, storage.FreeSpaceInBytes) ||
+          !getVarint(p, end, storage.FreeSpaceInObjects) ||
+          !getString(p, end, storage.StorageDescription) || !getString(p, end, storage.VolumeIdentifier))
+        return false;
+    }
+    return true;
+  default:
+    return false;
+  }
+}
+
+void encodeTraceRecord(const TraceRecord &record, string &out)
+{
+  putVarint(out, record.function);
+  putVarint(out, record.elapsedNs);
+  putVarint(out, record.size);
+  putVarint(out, record.args.size());
+  for (const TraceValue &value : record.args)
+    encodeValue(value, out);
+  encodeValue(record.result, out);
+  putVarint(out, record.outs.size());
+  for (const TraceValue &value : record.outs)
+    encodeValue(value, out);
+}
+
+bool decodeTraceRecord(const unsigned char *&p, const unsigned char *end, TraceRecord &record)
+{
+  uint64_t function, count;
+  if (!getVarint(p, end, function) || !getVarint(p, end, record.elapsedNs) || !getVarint(p, end, record.size))
+    return false;
+  record.function = function;
+
+  if (!getVarint(p, end, count) || count > (uint64_t)(end - p))
+    return false;
+  record.args.resize(count);
+  for (TraceValue &value : record.args)
+  {
+    if (!decodeValue(p, end, value))
+      return false;
+  }
+
+  if (!decodeValue(p, end, record.result))
+    return false;
+
+  if (!getVarint(p, end, count) || count > (uint64_t)(end - p))
+    return false;
+  record.outs.resize(count);
+  for (TraceValue &value : record.outs)
+  {
+    if (!decodeValue(p, end, value))
+      return false;
+  }
+  return true;
+}
+
+string traceRecordKey(uint16_t function, const vector<TraceValue> &args)
+{
+  string key;
+  putVarint(key, function);
+  for (const TraceValue &value : args)
+  {
+    if (value.key)
+      encodeValue(value, key);
+  }
+  return key;
+}
+
+TraceWriter::~TraceWriter()
+{
+  close();
+}
+
+bool TraceWriter::open(const string &path)
+{
+  lock_guard<mutex> lock(_mutex);
+  if (_file)
+    return false;
+
+  _file = fopen(path.c_str(), "wb");
+  if (!_file)
+    return false;
+
+  _records = 0;
+  _buffer.assign(TRACE_MAGIC, TRACE_MAGIC_LENGTH);
+  return true;
+}
+
+void TraceWriter::write(const TraceRecord &record)
+{
+  lock_guard<mutex> lock(_mutex);
+  if (!_file)
+    return;
+
+  encodeTraceRecord(record, _buffer);
+  _records++;
+  if (_buffer.size() >= TRACE_FLUSH_SIZE)
+    flush();
+}
+
+uint64_t TraceWriter::close()
+{
+  lock_guard<mutex> lock(_mutex);
+  if (!_file)
+    return 0;
+
+  flush();
+  fclose(_file);
+  _file = NULL;
+  return _records;
+}
+
+bool TraceWriter::isOpen()
+{
+  lock_guard<mutex> lock(_mutex);
+  return _file != NULL;
+}
+
+void TraceWriter::flush()
+{
+  if (!_buffer.empty())
+    fwrite(_buffer.data(), 1, _buffer.size(), _file);
+  _buffer.clear();
+}
+
+bool readTraceFile(const string &path, vector<TraceRecord> &records)
+{
+  FILE *file = fopen(path.c_str(), "rb");
+  if (!file)
+    return false;
+
+  string data;
+  char buffer[64 * 1024];
+  size_t length;
+  while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    data.append(buffer, length);
+  fclose(file);
+
+  if (data.size() < TRACE_MAGIC_LENGTH || data.compare(0, TRACE_MAGIC_LENGTH, TRACE_MAGIC) != 0)
+    return false;
+
+  const unsigned char *p = (const unsigned char *)data.data() + TRACE_MAGIC_LENGTH;
+  const unsigned char *end = (const unsigned char *)data.data() + data.size();
+  while (p < end)
+  {
+    TraceRecord record;
+    if (!decodeTraceRecord(p, end, record))
+      return false;
+    records.push_back(record);
+  }
+  return true;
+}
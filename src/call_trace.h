@@ -0,0 +1,196 @@
+#ifndef LUCK_MTP_CALL_TRACE
+#define LUCK_MTP_CALL_TRACE
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <mutex>
+#include "libmtp.h"
+
+using namespace std;
+
+/**
+ * the libmtp functions called by the addon
+ *
+ * the position of a function is its id in trace files, only append to this list
+ */
+#define MTP_FUNCTIONS(X)       \
+  X(Detect_Raw_Devices)        \
+  X(Open_Raw_Device)           \
+  X(Open_Raw_Device_Uncached)  \
+  X(Release_Device)            \
+  X(Get_Serialnumber)          \
+  X(Get_Storage)               \
+  X(Get_Files_And_Folders)     \
+  X(Get_Filemetadata)          \
+  X(Get_u64_From_Object)       \
+  X(Get_File_To_File)          \
+  X(Send_File_From_File)       \
+  X(Delete_Object)             \
+  X(Move_Object)               \
+  X(Copy_Object)               \
+  X(Set_File_Name)             \
+  X(Set_Folder_Name)           \
+  X(Create_Folder)             \
+  X(Get_File_To_Handler)       \
+  X(Send_File_From_Handler)    \
+  X(Get_Thumbnail)             \
+  X(Check_Capability)          \
+  X(GetPartialObject)          \
+  X(SendPartialObject)         \
+  X(TruncateObject)            \
+  X(BeginEditObject)           \
+  X(EndEditObject)             \
+  X(Read_Event_Async)          \
+  X(Handle_Events_Timeout_Completed)
+
+enum MtpFunction
+{
+#define MTP_FUNCTION_ENUM(name) MTP_FN_##name,
+  MTP_FUNCTIONS(MTP_FUNCTION_ENUM)
+#undef MTP_FUNCTION_ENUM
+      MTP_FN_COUNT
+};
+
+/**
+ * @return the libmtp name of a function, without the LIBMTP_ prefix
+ */
+const char *mtpFunctionName(uint16_t function);
+
+enum TraceTag
+{
+  TRACE_NONE,
+  TRACE_INT,
+  TRACE_STR,
+  TRACE_FILES,
+  TRACE_RAWDEVICES,
+  TRACE_STORAGES
+};
+
+struct TraceFile
+{
+  uint32_t item_id;
+  uint32_t parent_id;
+  uint32_t storage_id;
+  uint64_t filesize;
+  int64_t modificationdate;
+  uint32_t filetype;
+  string filename;
+};
+
+struct TraceRawDevice
+{
+  uint16_t vendor_id;
+  uint16_t product_id;
+  uint32_t bus_location;
+  uint8_t devnum;
+  string vendor;
+  string product;
+};
+
+struct TraceStorage
+{
+  uint32_t id;
+  uint16_t StorageType;
+  uint16_t FilesystemType;
+  uint16_t AccessCapability;
+  uint64_t MaxCapacity;
+  uint64_t FreeSpaceInBytes;
+  uint64_t FreeSpaceInObjects;
+  string StorageDescription;
+  string VolumeIdentifier;
+};
+
+/**
+ * an argument, result or output parameter of a recorded call
+ *
+ * values with <code>key</code> unset, such as local file paths, are recorded
+ * but not used to match a call when replaying
+ */
+struct TraceValue
+{
+  TraceTag tag = TRACE_NONE;
+  bool key = true;
+  int64_t number = 0;
+  string text;
+  vector<TraceFile> files;
+  vector<TraceRawDevice> devices;
+  vector<TraceStorage> storages;
+};
+
+TraceValue traceInt(int64_t number);
+TraceValue traceString(const char *text, bool key = true);
+TraceValue traceFiles(const LIBMTP_file_t *files, bool list = true);
+TraceValue traceRawDevices(const LIBMTP_raw_device_t *devices, int count);
+TraceValue traceStorages(const LIBMTP_devicestorage_t *storage);
+
+/**
+ * one libmtp call: function, arguments, result, output parameters,
+ * size of the transferred data and wall time
+ */
+struct TraceRecord
+{
+  uint16_t function = 0;
+  uint64_t elapsedNs = 0;
+  uint64_t size = 0;
+  vector<TraceValue> args;
+  TraceValue result;
+  vector<TraceValue> outs;
+};
+
+/**
+ * encode a record, values are written as LEB128 varints
+ */
+void encodeTraceRecord(const TraceRecord &record, string &out);
+
+/**
+ * decode a record
+ *
+ * @param p read position, advanced past the record
+ * @param end end of the data
+ * @param record receives the record
+ * @return false if the data is truncated or corrupt
+ */
+bool decodeTraceRecord(const unsigned char *&p, const unsigned char *end, TraceRecord &record);
+
+/**
+ * the key matching a recorded call with a replayed one: function and key arguments
+ */
+string traceRecordKey(uint16_t function, const vector<TraceValue> &args);
+
+/**
+ * buffered, thread safe trace file writer
+ */
+class TraceWriter
+{
+public:
+  ~TraceWriter();
+
+  bool open(const string &path);
+  void write(const TraceRecord &record);
+
+  /**
+   * @return the number of records written
+   */
+  uint64_t close();
+
+  bool isOpen();
+
+private:
+  void flush();
+
+  mutex _mutex;
+  FILE *_file = NULL;
+  string _buffer;
+  uint64_t _records = 0;
+};
+
+/**
+ * read all the records of a trace file
+ *
+ * @return false if the file can not be read or is not a trace file
+ */
+bool readTraceFile(const string &path, vector<TraceRecord> &records);
+
+#endif
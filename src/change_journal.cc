@@ -0,0 +1,208 @@
+#include <stdio.h>
+#include <ctype.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <unordered_map>
+#include "change_journal.h"
+
+using namespace std;
+
+ChangeJournal __changeJournal;
+
+/**
+ * helper function to pick the epoch of a new journal, tokens of another journal never match it
+ */
+static uint64_t newEpoch()
+{
+  random_device random;
+  uint64_t epoch = ((uint64_t)random() << 32) ^ random();
+  return epoch ^ (uint64_t)chrono::system_clock::now().time_since_epoch().count();
+}
+
+/**
+ * helper function to get the serial number as written in the state file, a single word
+ */
+static string savedSerial(const string &serial)
+{
+  string saved = serial.empty() ? "-" : serial;
+  for (char &c : saved)
+  {
+    if (isspace((unsigned char)c))
+      c = '_';
+  }
+  return saved;
+}
+
+void ChangeJournal::start(const void *device, const string &serial, size_t capacity, const string &path)
+{
+  lock_guard<mutex> lock(_mutex);
+  _serial = serial;
+  _path = path;
+  _capacity = capacity > 0 ? capacity : 1;
+  _changes.clear();
+  _epoch = newEpoch();
+  _sequence = 0;
+  if (!_path.empty())
+    load();
+  _oldest = _sequence;
+  save();
+  _device = device;
+}
+
+void ChangeJournal::stop()
+{
+  lock_guard<mutex> lock(_mutex);
+  if (!_device.load())
+    return;
+  _device = NULL;
+  save();
+  _changes.clear();
+}
+
+void ChangeJournal::record(const void *device, ChangeType type, uint32_t id)
+{
+  lock_guard<mutex> lock(_mutex);
+  if (!device || _device.load() != device)
+    return;
+
+  if (type == CHANGE_RESYNC)
+  {
+    _changes.clear();
+    _oldest = ++_sequence;
+    return;
+  }
+
+  // a transfer in ranges modifies the same object many times in a row
+  if (!_changes.empty() && _changes.back().type == type && _changes.back().id == id)
+    return;
+
+  _changes.push_back({++_sequence, type, id});
+  while (_changes.size() > _capacity)
+  {
+    _oldest = _changes.front().sequence;
+    _changes.pop_front();
+  }
+}
+
+void ChangeJournal::changes(const string &token, ChangeSet &changes)
+{
+  lock_guard<mutex> lock(_mutex);
+  changes.token = this->token();
+  changes.resync = true;
+  changes.added.clear();
+  changes.removed.clear();
+  changes.modified.clear();
+  save();
+
+  unsigned long long epoch, sequence;
+  if (sscanf(token.c_str(), "%llx-%llu", &epoch, &sequence) != 2 || epoch != _epoch || sequence < _oldest ||
+      sequence > _sequence)
+    return;
+  changes.resync = false;
+
+  auto first = lower_bound(_changes.begin(), _changes.end(), (uint64_t)sequence + 1,
+                           [](const Change &change, uint64_t value) { return change.sequence < value; });
+
+  // the net change of every object, in the order the objects first changed
+  unordered_map<uint32_t, ChangeType> net;
+  vector<uint32_t> order;
+  for (auto change = first; change != _changes.end(); change++)
+  {
+    auto found = net.find(change->id);
+    if (found == net.end())
+    {
+      net[change->id] = change->type;
+      order.push_back(change->id);
+      continue;
+    }
+
+    ChangeType &state = found->second;
+    if (change->type == CHANGE_REMOVED)
+      state = state == CHANGE_ADDED ? CHANGE_RESYNC : CHANGE_REMOVED;
+    else if (state == CHANGE_RESYNC)
+      state = CHANGE_ADDED;
+    else if (state == CHANGE_REMOVED)
+      state = CHANGE_MODIFIED;
+  }
+
+  // an object added then removed is left out, it is marked CHANGE_RESYNC above
+  for (uint32_t id : order)
+  {
+    switch (net[id])
+    {
+    case CHANGE_ADDED:
+      changes.added.push_back(id);
+      break;
+    case CHANGE_REMOVED:
+      changes.removed.push_back(id);
+      break;
+    case CHANGE_MODIFIED:
+      changes.modified.push_back(id);
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+size_t ChangeJournal::size()
+{
+  lock_guard<mutex> lock(_mutex);
+  return _changes.size();
+}
+
+/**
+ * the token of the current sequence, the mutex must be held
+ */
+string ChangeJournal::token()
+{
+  char text[48];
+  snprintf(text, sizeof(text), "%016llx-%llu", (unsigned long long)_epoch, (unsigned long long)_sequence);
+  return text;
+}
+
+/**
+ * take over the epoch and the sequence saved for the same device, the mutex must be held
+ */
+void ChangeJournal::load()
+{
+  FILE *fd = fopen(_path.c_str(), "r");
+  if (!fd)
+    return;
+
+  char serial[256];
+  unsigned long long epoch, sequence;
+  if (fscanf(fd, "%255s %llx %llu", serial, &epoch, &sequence) == 3 && savedSerial(_serial) == serial)
+  {
+    _epoch = epoch;
+    // nothing is known of what happened since, every token issued before gets a resync
+    _sequence = sequence + 1;
+  }
+  fclose(fd);
+}
+
+/**
+ * save the epoch and the sequence, the mutex must be held
+ *
+ * written under a temporary name, a crash never leaves half a file
+ */
+void ChangeJournal::save()
+{
+  if (_path.empty())
+    return;
+
+  string temporary = _path + ".tmp";
+  FILE *fd = fopen(temporary.c_str(), "w");
+  if (!fd)
+    return;
+  bool ok = fprintf(fd, "%s %016llx %llu\n", savedSerial(_serial).c_str(), (unsigned long long)_epoch,
+                    (unsigned long long)_sequence) > 0;
+  ok = fclose(fd) == 0 && ok;
+#ifdef _WIN32
+  // rename does not replace an existing file on windows
+  remove(_path.c_str());
+#endif
+  if (!ok || rename(temporary.c_str(), _path.c_str()) != 0)
+    remove(temporary.c_str());
+}
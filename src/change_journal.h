@@ -0,0 +1,137 @@
+#ifndef LUCK_MTP_CHANGE_JOURNAL
+#define LUCK_MTP_CHANGE_JOURNAL
+
+#include <stdint.h>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+enum ChangeType
+{
+  CHANGE_ADDED,
+  CHANGE_REMOVED,
+  CHANGE_MODIFIED,
+  // changes were missed, e.g. a storage came or went, every older token needs a full resync
+  CHANGE_RESYNC
+};
+
+/**
+ * the changes since a token, each object id is in one list at most
+ */
+struct ChangeSet
+{
+  // the token to ask for the next changes
+  string token;
+  // the changes since the token are not known, the device has to be listed again
+  bool resync;
+  vector<uint32_t> added;
+  vector<uint32_t> removed;
+  vector<uint32_t> modified;
+};
+
+/**
+ * journal of the object changes of the connected device
+ *
+ * every change gets the next sequence number, and a token is the journal
+ * epoch with a sequence number. the changes after a token are folded per
+ * object: an object added then removed is left out, an object added then
+ * modified is only added. the journal keeps the last <code>capacity</code>
+ * changes, a token older than that gets a resync, so does a token of another
+ * epoch, from another journal.
+ *
+ * the libmtp wrappers record the changes made by the addon, @see recordChange,
+ * the device events reader those made on the device. thread safe.
+ */
+class ChangeJournal
+{
+public:
+  ChangeJournal() {}
+  ChangeJournal(const ChangeJournal &) = delete;
+  ChangeJournal &operator=(const ChangeJournal &) = delete;
+
+  /**
+   * start recording the changes of a device, the previous changes are dropped
+   *
+   * with a path, the epoch and the sequence saved there for the same serial
+   * number are taken over, the changes made while the journal did not run are
+   * not known so the tokens issued before get a resync. the file is updated
+   * every time a token is issued.
+   *
+   * @param device the journaled device
+   * @param serial the serial number of the device
+   * @param capacity the number of changes kept
+   * @param path the file the journal state is saved to, empty for none
+   */
+  void start(const void *device, const string &serial, size_t capacity, const string &path);
+
+  /**
+   * stop recording, the state is saved one last time
+   */
+  void stop();
+
+  bool running() const { return _device.load() != NULL; }
+
+  /**
+   * @param device the device changed, ignored if not the journaled one
+   * @param type the change
+   * @param id the object id
+   */
+  void record(const void *device, ChangeType type, uint32_t id);
+
+  /**
+   * @param token a token returned earlier, empty to get the current token only
+   * @param changes receives the changes since the token and the next token
+   */
+  void changes(const string &token, ChangeSet &changes);
+
+  /**
+   * @return the number of changes kept
+   */
+  size_t size();
+
+  /**
+   * @return true if the device of a libmtp call is journaled, without taking the lock
+   */
+  bool journaled(const void *device) const { return device && _device.load(memory_order_relaxed) == device; }
+
+private:
+  struct Change
+  {
+    uint64_t sequence;
+    ChangeType type;
+    uint32_t id;
+  };
+
+  void load();
+  void save();
+  string token();
+
+  atomic<const void *> _device{NULL};
+  mutex _mutex;
+  string _serial;
+  string _path;
+  size_t _capacity = 0;
+  uint64_t _epoch = 0;
+  // the sequence of the last change
+  uint64_t _sequence = 0;
+  // tokens before this sequence can not be answered
+  uint64_t _oldest = 0;
+  deque<Change> _changes;
+};
+
+extern ChangeJournal __changeJournal;
+
+/**
+ * record a change made by a libmtp call, the only cost when no journal runs is a pointer comparison
+ */
+inline void recordChange(const void *device, ChangeType type, uint32_t id)
+{
+  if (__changeJournal.journaled(device))
+    __changeJournal.record(device, type, id);
+}
+
+#endif
@@ -0,0 +1,656 @@
+#include <string.h>
+#include <stdio.h>
+#include "checksum.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define LUCK_MTP_X86_INTRINSICS 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+static inline uint32_t readLE32(const unsigned char *p)
+{
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint64_t readLE64(const unsigned char *p)
+{
+  return (uint64_t)readLE32(p) | ((uint64_t)readLE32(p + 4) << 32);
+}
+
+static inline uint32_t readBE32(const unsigned char *p)
+{
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static string hexString(const unsigned char *bytes, size_t length)
+{
+  static const char digits[] = "0123456789abcdef";
+  string hex(length * 2, '0');
+  for (size_t i = 0; i < length; i++)
+  {
+    hex[i * 2] = digits[bytes[i] >> 4];
+    hex[i * 2 + 1] = digits[bytes[i] & 0xf];
+  }
+  return hex;
+}
+
+static string hexNumber(uint64_t value, int bytes)
+{
+  unsigned char be[8];
+  for (int i = 0; i < bytes; i++)
+    be[i] = (unsigned char)(value >> ((bytes - 1 - i) * 8));
+  return hexString(be, bytes);
+}
+
+#ifdef LUCK_MTP_X86_INTRINSICS
+static bool cpuHasSha()
+{
+  unsigned int eax, ebx, ecx, edx;
+  return __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && (ebx & (1u << 29));
+}
+
+static bool cpuHasSse42()
+{
+  unsigned int eax, ebx, ecx, edx;
+  return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & (1u << 20));
+}
+#endif
+
+/*
+ * SHA-256
+ */
+
+static const uint32_t SHA256_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+static inline uint32_t rotr32(uint32_t x, int n)
+{
+  return (x >> n) | (x << (32 - n));
+}
+
+static void sha256Blocks(uint32_t state[8], const unsigned char *data, size_t blocks)
+{
+  for (; blocks > 0; blocks--, data += 64)
+  {
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++)
+      w[i] = readBE32(data + i * 4);
+    for (int i = 16; i < 64; i++)
+    {
+      uint32_t s0 = rotr32(w[i - 15], 7) ^ rotr32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+      uint32_t s1 = rotr32(w[i - 2], 17) ^ rotr32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+      w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 64; i++)
+    {
+      uint32_t t1 = h + (rotr32(e, 6) ^ rotr32(e, 11) ^ rotr32(e, 25)) + ((e & f) ^ (~e & g)) + SHA256_K[i] + w[i];
+      uint32_t t2 = (rotr32(a, 2) ^ rotr32(a, 13) ^ rotr32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+      h = g;
+      g = f;
+      f = e;
+      e = d + t1;
+      d = c;
+      c = b;
+      b = a;
+      a = t1 + t2;
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+  }
+}
+
+#ifdef LUCK_MTP_X86_INTRINSICS
+__attribute__((target("sha,sse4.1"))) static void sha256BlocksShaNi(uint32_t state[8], const unsigned char *data, size_t blocks)
+{
+  const __m128i MASK = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+  __m128i tmp = _mm_loadu_si128((const __m128i *)&state[0]);
+  __m128i state1 = _mm_loadu_si128((const __m128i *)&state[4]);
+  tmp = _mm_shuffle_epi32(tmp, 0xB1);          // CDAB
+  state1 = _mm_shuffle_epi32(state1, 0x1B);    // EFGH
+  __m128i state0 = _mm_alignr_epi8(tmp, state1, 8); // ABEF
+  state1 = _mm_blend_epi16(state1, tmp, 0xF0); // CDGH
+
+  for (; blocks > 0; blocks--, data += 64)
+  {
+    __m128i abefSave = state0;
+    __m128i cdghSave = state1;
+
+    __m128i msg[4];
+    for (int i = 0; i < 4; i++)
+      msg[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + i * 16)), MASK);
+
+    // 16 groups of 4 rounds, the message schedule is computed 4 words ahead
+    for (int r = 0; r < 16; r++)
+    {
+      __m128i m = _mm_add_epi32(msg[r & 3], _mm_loadu_si128((const __m128i *)&SHA256_K[r * 4]));
+      state1 = _mm_sha256rnds2_epu32(state1, state0, m);
+      if (r >= 3 && r < 15)
+      {
+        __m128i next = _mm_add_epi32(msg[(r + 1) & 3], _mm_alignr_epi8(msg[r & 3], msg[(r - 1) & 3], 4));
+        msg[(r + 1) & 3] = _mm_sha256msg2_epu32(next, msg[r & 3]);
+      }
+      m = _mm_shuffle_epi32(m, 0x0E);
+      state0 = _mm_sha256rnds2_epu32(state0, state1, m);
+      if (r >= 1 && r < 13)
+        msg[(r - 1) & 3] = _mm_sha256msg1_epu32(msg[(r - 1) & 3], msg[r & 3]);
+    }
+
+    state0 = _mm_add_epi32(state0, abefSave);
+    state1 = _mm_add_epi32(state1, cdghSave);
+  }
+
+  tmp = _mm_shuffle_epi32(state0, 0x1B);       // FEBA
+  state1 = _mm_shuffle_epi32(state1, 0xB1);    // DCHG
+  state0 = _mm_blend_epi16(tmp, state1, 0xF0); // DCBA
+  state1 = _mm_alignr_epi8(state1, tmp, 8);    // ABEF
+  _mm_storeu_si128((__m128i *)&state[0], state0);
+  _mm_storeu_si128((__m128i *)&state[4], state1);
+}
+#endif
+
+typedef void (*Sha256BlocksFunc)(uint32_t state[8], const unsigned char *data, size_t blocks);
+
+static Sha256BlocksFunc sha256Implementation()
+{
+#ifdef LUCK_MTP_X86_INTRINSICS
+  if (cpuHasSha() && cpuHasSse42())
+    return sha256BlocksShaNi;
+#endif
+  return sha256Blocks;
+}
+
+static const Sha256BlocksFunc __sha256Blocks = sha256Implementation();
+
+Sha256::Sha256() : _buffered(0), _total(0)
+{
+  static const uint32_t init[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                                   0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+  memcpy(_state, init, sizeof(init));
+}
+
+void Sha256::update(const unsigned char *data, size_t length)
+{
+  _total += length;
+
+  if (_buffered)
+  {
+    size_t take = length < 64 - _buffered ? length : 64 - _buffered;
+    memcpy(_buffer + _buffered, data, take);
+    _buffered += take;
+    data += take;
+    length -= take;
+    if (_buffered < 64)
+      return;
+    __sha256Blocks(_state, _buffer, 1);
+    _buffered = 0;
+  }
+
+  if (length >= 64)
+  {
+    __sha256Blocks(_state, data, length / 64);
+    data += length / 64 * 64;
+    length %= 64;
+  }
+
+  memcpy(_buffer, data, length);
+  _buffered = length;
+}
+
+string Sha256::hexDigest()
+{
+  uint64_t bits = _total * 8;
+  unsigned char padding[72] = {0x80};
+  size_t padLength = (_buffered < 56 ? 56 : 120) - _buffered;
+  for (int i = 0; i < 8; i++)
+    padding[padLength + i] = (unsigned char)(bits >> ((7 - i) * 8));
+  update(padding, padLength + 8);
+
+  unsigned char digest[32];
+  for (int i = 0; i < 8; i++)
+  {
+    digest[i * 4] = (unsigned char)(_state[i] >> 24);
+    digest[i * 4 + 1] = (unsigned char)(_state[i] >> 16);
+    digest[i * 4 + 2] = (unsigned char)(_state[i] >> 8);
+    digest[i * 4 + 3] = (unsigned char)_state[i];
+  }
+  return hexString(digest, sizeof(digest));
+}
+
+/*
+ * XXH3 64 bits, following the reference implementation of xxHash 0.8
+ */
+
+static const uint32_t XXH_PRIME32_1 = 0x9E3779B1U;
+static const uint32_t XXH_PRIME32_2 = 0x85EBCA77U;
+static const uint32_t XXH_PRIME32_3 = 0xC2B2AE3DU;
+static const uint64_t XXH_PRIME64_1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t XXH_PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t XXH_PRIME64_3 = 0x165667B19E3779F9ULL;
+static const uint64_t XXH_PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t XXH_PRIME64_5 = 0x27D4EB2F165667C5ULL;
+static const uint64_t XXH_PRIME_MX1 = 0x165667919E3779F9ULL;
+static const uint64_t XXH_PRIME_MX2 = 0x9FB21C651E98DF25ULL;
+
+static const size_t XXH_SECRET_SIZE = 192;
+static const size_t XXH_STRIPE_LEN = 64;
+static const uint32_t XXH_STRIPES_PER_BLOCK = (XXH_SECRET_SIZE - XXH_STRIPE_LEN) / 8;
+
+static const unsigned char XXH_SECRET[XXH_SECRET_SIZE] = {
+    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+    0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+    0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+    0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+    0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+    0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+    0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+    0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+    0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+    0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+    0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+    0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e};
+
+static inline uint64_t rotl64(uint64_t x, int n)
+{
+  return (x << n) | (x >> (64 - n));
+}
+
+static inline uint64_t swap64(uint64_t x)
+{
+#ifdef _MSC_VER
+  return _byteswap_uint64(x);
+#else
+  return __builtin_bswap64(x);
+#endif
+}
+
+static inline uint64_t mul128Fold64(uint64_t a, uint64_t b)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+  uint64_t high;
+  uint64_t low = _umul128(a, b, &high);
+  return low ^ high;
+#elif defined(__SIZEOF_INT128__)
+  unsigned __int128 product = (unsigned __int128)a * b;
+  return (uint64_t)product ^ (uint64_t)(product >> 64);
+#else
+  uint64_t lowLow = (a & 0xFFFFFFFF) * (b & 0xFFFFFFFF);
+  uint64_t highLow = (a >> 32) * (b & 0xFFFFFFFF);
+  uint64_t lowHigh = (a & 0xFFFFFFFF) * (b >> 32);
+  uint64_t highHigh = (a >> 32) * (b >> 32);
+  uint64_t cross = (lowLow >> 32) + (highLow & 0xFFFFFFFF) + lowHigh;
+  uint64_t upper = (highLow >> 32) + (cross >> 32) + highHigh;
+  uint64_t lower = (cross << 32) | (lowLow & 0xFFFFFFFF);
+  return lower ^ upper;
+#endif
+}
+
+static inline uint64_t xxh64Avalanche(uint64_t h)
+{
+  h ^= h >> 33;
+  h *= XXH_PRIME64_2;
+  h ^= h >> 29;
+  h *= XXH_PRIME64_3;
+  return h ^ (h >> 32);
+}
+
+static inline uint64_t xxh3Avalanche(uint64_t h)
+{
+  h ^= h >> 37;
+  h *= XXH_PRIME_MX1;
+  return h ^ (h >> 32);
+}
+
+static inline uint64_t xxh3Rrmxmx(uint64_t h, uint64_t length)
+{
+  h ^= rotl64(h, 49) ^ rotl64(h, 24);
+  h *= XXH_PRIME_MX2;
+  h ^= (h >> 35) + length;
+  h *= XXH_PRIME_MX2;
+  return h ^ (h >> 28);
+}
+
+static inline uint64_t xxh3Mix16(const unsigned char *input, const unsigned char *secret)
+{
+  return mul128Fold64(readLE64(input) ^ readLE64(secret), readLE64(input + 8) ^ readLE64(secret + 8));
+}
+
+/**
+ * helper function to hash an input of at most 240 bytes in one shot
+ */
+static uint64_t xxh3Short(const unsigned char *input, size_t length)
+{
+  const unsigned char *secret = XXH_SECRET;
+
+  if (length == 0)
+    return xxh64Avalanche(readLE64(secret + 56) ^ readLE64(secret + 64));
+
+  if (length <= 3)
+  {
+    uint32_t combined = ((uint32_t)input[0] << 16) | ((uint32_t)input[length >> 1] << 24) |
+                        (uint32_t)input[length - 1] | ((uint32_t)length << 8);
+    uint64_t bitflip = readLE32(secret) ^ readLE32(secret + 4);
+    return xxh64Avalanche((uint64_t)combined ^ bitflip);
+  }
+
+  if (length <= 8)
+  {
+    uint64_t bitflip = readLE64(secret + 8) ^ readLE64(secret + 16);
+    uint64_t input64 = readLE32(input + length - 4) + ((uint64_t)readLE32(input) << 32);
+    return xxh3Rrmxmx(input64 ^ bitflip, length);
+  }
+
+  if (length <= 16)
+  {
+    uint64_t low = readLE64(input) ^ (readLE64(secret + 24) ^ readLE64(secret + 32));
+    uint64_t high = readLE64(input + length - 8) ^ (readLE64(secret + 40) ^ readLE64(secret + 48));
+    return xxh3Avalanche(length + swap64(low) + high + mul128Fold64(low, high));
+  }
+
+  uint64_t acc = length * XXH_PRIME64_1;
+
+  if (length <= 128)
+  {
+    if (length > 32)
+    {
+      if (length > 64)
+      {
+        if (length > 96)
+        {
+          acc += xxh3Mix16(input + 48, secret + 96);
+          acc += xxh3Mix16(input + length - 64, secret + 112);
+        }
+        acc += xxh3Mix16(input + 32, secret + 64);
+        acc += xxh3Mix16(input + length - 48, secret + 80);
+      }
+      acc += xxh3Mix16(input + 16, secret + 32);
+      acc += xxh3Mix16(input + length - 32, secret + 48);
+    }
+    acc += xxh3Mix16(input, secret);
+    acc += xxh3Mix16(input + length - 16, secret + 16);
+    return xxh3Avalanche(acc);
+  }
+
+  size_t rounds = length / 16;
+  for (size_t i = 0; i < 8; i++)
+    acc += xxh3Mix16(input + 16 * i, secret + 16 * i);
+  acc = xxh3Avalanche(acc);
+
+  uint64_t accEnd = xxh3Mix16(input + length - 16, secret + 136 - 17);
+  for (size_t i = 8; i < rounds; i++)
+    accEnd += xxh3Mix16(input + 16 * i, secret + 16 * (i - 8) + 3);
+  return xxh3Avalanche(acc + accEnd);
+}
+
+static inline void xxh3Accumulate512(uint64_t acc[8], const unsigned char *input, const unsigned char *secret)
+{
+  for (int i = 0; i < 8; i++)
+  {
+    uint64_t value = readLE64(input + 8 * i);
+    uint64_t key = value ^ readLE64(secret + 8 * i);
+    acc[i ^ 1] += value;
+    acc[i] += (uint64_t)(uint32_t)key * (key >> 32);
+  }
+}
+
+static inline void xxh3Scramble(uint64_t acc[8], const unsigned char *secret)
+{
+  for (int i = 0; i < 8; i++)
+  {
+    uint64_t value = acc[i];
+    value ^= value >> 47;
+    value ^= readLE64(secret + 8 * i);
+    acc[i] = value * XXH_PRIME32_1;
+  }
+}
+
+Xxh3::Xxh3() : _buffered(0), _stripeInBlock(0), _total(0)
+{
+  static const uint64_t init[8] = {XXH_PRIME32_3, XXH_PRIME64_1, XXH_PRIME64_2, XXH_PRIME64_3,
+                                   XXH_PRIME64_4, XXH_PRIME32_2, XXH_PRIME64_5, XXH_PRIME32_1};
+  memcpy(_acc, init, sizeof(init));
+}
+
+void Xxh3::stripe(const unsigned char *data)
+{
+  xxh3Accumulate512(_acc, data, XXH_SECRET + _stripeInBlock * 8);
+  if (++_stripeInBlock == XXH_STRIPES_PER_BLOCK)
+  {
+    xxh3Scramble(_acc, XXH_SECRET + XXH_SECRET_SIZE - XXH_STRIPE_LEN);
+    _stripeInBlock = 0;
+  }
+}
+
+void Xxh3::update(const unsigned char *data, size_t length)
+{
+  // short inputs are hashed in one shot, keep their bytes
+  if (_total < sizeof(_head))
+  {
+    size_t take = length < sizeof(_head) - _total ? length : sizeof(_head) - _total;
+    memcpy(_head + _total, data, take);
+  }
+  _total += length;
+
+  // a stripe is only consumed once a byte follows it, the last stripe is hashed differently
+  while (length > 0)
+  {
+    if (_buffered == XXH_STRIPE_LEN)
+    {
+      stripe(_buffer);
+      memcpy(_lastStripe, _buffer, XXH_STRIPE_LEN);
+      _buffered = 0;
+    }
+
+    if (_buffered == 0 && length > XXH_STRIPE_LEN)
+    {
+      while (length > XXH_STRIPE_LEN)
+      {
+        stripe(data);
+        data += XXH_STRIPE_LEN;
+        length -= XXH_STRIPE_LEN;
+      }
+      memcpy(_lastStripe, data - XXH_STRIPE_LEN, XXH_STRIPE_LEN);
+    }
+
+    size_t take = length < XXH_STRIPE_LEN - _buffered ? length : XXH_STRIPE_LEN - _buffered;
+    memcpy(_buffer + _buffered, data, take);
+    _buffered += take;
+    data += take;
+    length -= take;
+  }
+}
+
+string Xxh3::hexDigest()
+{
+  if (_total <= sizeof(_head))
+    return hexNumber(xxh3Short(_head, _total), 8);
+
+  // the last stripe is the last 64 bytes of the input, partly consumed already
+  unsigned char last[XXH_STRIPE_LEN];
+  size_t fromLast = XXH_STRIPE_LEN - _buffered;
+  memcpy(last, _lastStripe + XXH_STRIPE_LEN - fromLast, fromLast);
+  memcpy(last + fromLast, _buffer, _buffered);
+
+  uint64_t acc[8];
+  memcpy(acc, _acc, sizeof(acc));
+  xxh3Accumulate512(acc, last, XXH_SECRET + XXH_SECRET_SIZE - XXH_STRIPE_LEN - 7);
+
+  uint64_t result = _total * XXH_PRIME64_1;
+  for (int i = 0; i < 4; i++)
+    result += mul128Fold64(acc[2 * i] ^ readLE64(XXH_SECRET + 11 + 16 * i),
+                           acc[2 * i + 1] ^ readLE64(XXH_SECRET + 11 + 16 * i + 8));
+  return hexNumber(xxh3Avalanche(result), 8);
+}
+
+/*
+ * CRC-32C
+ */
+
+static uint32_t __crc32cTable[8][256];
+
+static bool crc32cInitTable()
+{
+  for (uint32_t i = 0; i < 256; i++)
+  {
+    uint32_t crc = i;
+    for (int j = 0; j < 8; j++)
+      crc = (crc >> 1) ^ (0x82F63B78 & (0 - (crc & 1)));
+    __crc32cTable[0][i] = crc;
+  }
+  for (uint32_t i = 0; i < 256; i++)
+  {
+    for (int t = 1; t < 8; t++)
+      __crc32cTable[t][i] = (__crc32cTable[t - 1][i] >> 8) ^ __crc32cTable[0][__crc32cTable[t - 1][i] & 0xff];
+  }
+  return true;
+}
+
+static uint32_t crc32cSoftware(uint32_t crc, const unsigned char *data, size_t length)
+{
+  // slicing by 8 bytes
+  while (length >= 8)
+  {
+    uint64_t word = readLE64(data) ^ crc;
+    crc = __crc32cTable[7][word & 0xff] ^ __crc32cTable[6][(word >> 8) & 0xff] ^
+          __crc32cTable[5][(word >> 16) & 0xff] ^ __crc32cTable[4][(word >> 24) & 0xff] ^
+          __crc32cTable[3][(word >> 32) & 0xff] ^ __crc32cTable[2][(word >> 40) & 0xff] ^
+          __crc32cTable[1][(word >> 48) & 0xff] ^ __crc32cTable[0][word >> 56];
+    data += 8;
+    length -= 8;
+  }
+  while (length-- > 0)
+    crc = (crc >> 8) ^ __crc32cTable[0][(crc ^ *data++) & 0xff];
+  return crc;
+}
+
+#ifdef LUCK_MTP_X86_INTRINSICS
+__attribute__((target("sse4.2"))) static uint32_t crc32cSse42(uint32_t crc, const unsigned char *data, size_t length)
+{
+#ifdef __x86_64__
+  uint64_t crc64 = crc;
+  while (length >= 8)
+  {
+    crc64 = _mm_crc32_u64(crc64, readLE64(data));
+    data += 8;
+    length -= 8;
+  }
+  crc = (uint32_t)crc64;
+#endif
+  while (length-- > 0)
+    crc = _mm_crc32_u8(crc, *data++);
+  return crc;
+}
+#endif
+
+typedef uint32_t (*Crc32cFunc)(uint32_t crc, const unsigned char *data, size_t length);
+
+static Crc32cFunc crc32cImplementation()
+{
+#ifdef LUCK_MTP_X86_INTRINSICS
+  if (cpuHasSse42())
+    return crc32cSse42;
+#endif
+  crc32cInitTable();
+  return crc32cSoftware;
+}
+
+static const Crc32cFunc __crc32c = crc32cImplementation();
+
+Crc32c::Crc32c() : _crc(0xFFFFFFFF)
+{
+}
+
+void Crc32c::update(const unsigned char *data, size_t length)
+{
+  _crc = __crc32c(_crc, data, length);
+}
+
+string Crc32c::hexDigest()
+{
+  return hexNumber(_crc ^ 0xFFFFFFFF, 4);
+}
+
+/*
+ * StreamHash
+ */
+
+StreamHash::~StreamHash()
+{
+  delete _sha256;
+  delete _xxh3;
+  delete _crc32c;
+}
+
+bool StreamHash::add(const string &name)
+{
+  if (name == "sha256")
+  {
+    if (!_sha256)
+      _sha256 = new Sha256();
+  }
+  else if (name == "xxh3")
+  {
+    if (!_xxh3)
+      _xxh3 = new Xxh3();
+  }
+  else if (name == "crc32c")
+  {
+    if (!_crc32c)
+      _crc32c = new Crc32c();
+  }
+  else
+  {
+    return false;
+  }
+  return true;
+}
+
+bool StreamHash::empty() const
+{
+  return !_sha256 && !_xxh3 && !_crc32c;
+}
+
+void StreamHash::update(const unsigned char *data, size_t length)
+{
+  if (_sha256)
+    _sha256->update(data, length);
+  if (_xxh3)
+    _xxh3->update(data, length);
+  if (_crc32c)
+    _crc32c->update(data, length);
+}
+
+vector<pair<string, string>> StreamHash::digests()
+{
+  vector<pair<string, string>> re;
+  if (_sha256)
+    re.push_back({"sha256", _sha256->hexDigest()});
+  if (_xxh3)
+    re.push_back({"xxh3", _xxh3->hexDigest()});
+  if (_crc32c)
+    re.push_back({"crc32c", _crc32c->hexDigest()});
+  return re;
+}
@@ -0,0 +1,111 @@
+#ifndef LUCK_MTP_CHECKSUM
+#define LUCK_MTP_CHECKSUM
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+ * streaming SHA-256, with the x86 SHA extensions when the cpu has them
+ */
+class Sha256
+{
+public:
+  Sha256();
+
+  void update(const unsigned char *data, size_t length);
+
+  /**
+   * @return the lowercase hex digest, the hash can not be updated afterwards
+   */
+  string hexDigest();
+
+private:
+  uint32_t _state[8];
+  unsigned char _buffer[64];
+  size_t _buffered;
+  uint64_t _total;
+};
+
+/**
+ * streaming 64 bit XXH3 with the default secret and seed 0
+ */
+class Xxh3
+{
+public:
+  Xxh3();
+
+  void update(const unsigned char *data, size_t length);
+
+  /**
+   * @return the canonical (big endian) hex digest
+   */
+  string hexDigest();
+
+private:
+  void stripe(const unsigned char *data);
+
+  uint64_t _acc[8];
+  unsigned char _head[240];
+  unsigned char _buffer[64];
+  unsigned char _lastStripe[64];
+  size_t _buffered;
+  uint32_t _stripeInBlock;
+  uint64_t _total;
+};
+
+/**
+ * streaming CRC-32C (Castagnoli), with the SSE 4.2 crc32 instruction when the cpu has it
+ */
+class Crc32c
+{
+public:
+  Crc32c();
+
+  void update(const unsigned char *data, size_t length);
+
+  /**
+   * @return the big endian hex digest
+   */
+  string hexDigest();
+
+private:
+  uint32_t _crc;
+};
+
+/**
+ * the set of checksums requested for one transfer, updated with every chunk as it passes through
+ */
+class StreamHash
+{
+public:
+  StreamHash() {}
+  StreamHash(const StreamHash &) = delete;
+  StreamHash &operator=(const StreamHash &) = delete;
+  ~StreamHash();
+
+  /**
+   * @param name sha256, xxh3 or crc32c
+   * @return false if the algorithm is not supported
+   */
+  bool add(const string &name);
+
+  bool empty() const;
+
+  void update(const unsigned char *data, size_t length);
+
+  /**
+   * @return the names and hex digests of the requested algorithms
+   */
+  vector<pair<string, string>> digests();
+
+private:
+  Sha256 *_sha256 = NULL;
+  Xxh3 *_xxh3 = NULL;
+  Crc32c *_crc32c = NULL;
+};
+
+#endif
@@ -0,0 +1,92 @@
+#include "mtp_call.h"
+#include "device_events.h"
+
+using namespace std;
+
+// how long the usb events are handled before the thread checks whether it has to stop
+static const long EVENT_POLL_US = 200 * 1000;
+// the wait before a failed read is queued again
+static const int EVENT_RETRY_MS = 1000;
+
+bool DeviceEventReader::start(LIBMTP_mtpdevice_t *device, DeviceEventCallback callback)
+{
+  lock_guard<mutex> lock(_mutex);
+  if (_running)
+    return false;
+
+  // a read queued on a device released since was cancelled with it
+  if (device != _device)
+    _pending = false;
+  _device = device;
+  _callback = callback;
+  _running = true;
+  _thread = thread(&DeviceEventReader::run, this);
+  return true;
+}
+
+void DeviceEventReader::stop()
+{
+  lock_guard<mutex> lock(_mutex);
+  if (!_running)
+    return;
+  _running = false;
+  _thread.join();
+}
+
+bool DeviceEventReader::running()
+{
+  return _running;
+}
+
+/**
+ * libmtp event callback, called from the usb event handling of the reader thread
+ */
+void DeviceEventReader::received(int ret, LIBMTP_event_t event, uint32_t param, void *data)
+{
+  DeviceEventReader *reader = (DeviceEventReader *)data;
+  reader->_ret = ret;
+  reader->_event = event;
+  reader->_param = param;
+  reader->_completed = 1;
+}
+
+/**
+ * reader thread, queues a read, handles the usb events until it completes and passes the event on
+ */
+void DeviceEventReader::run()
+{
+  bool failing = false;
+  while (_running)
+  {
+    if (!_pending)
+    {
+      _completed = 0;
+      _pending = mtpReadEventAsync(_device, received, this) == 0;
+    }
+
+    if (_pending)
+    {
+      struct timeval tv = {0, EVENT_POLL_US};
+      mtpHandleEventsTimeoutCompleted(&tv, &_completed);
+      if (!_completed)
+        continue;
+      _pending = false;
+
+      if (_ret == 0)
+      {
+        // the events missed while failing are not known
+        if (failing)
+          _callback(false, LIBMTP_EVENT_NONE, 0);
+        failing = false;
+        _callback(true, _event, _param);
+        continue;
+      }
+    }
+
+    if (!failing)
+      _callback(false, LIBMTP_EVENT_NONE, 0);
+    failing = true;
+    for (int waited = 0; _running && waited < EVENT_RETRY_MS; waited += 50)
+      this_thread::sleep_for(chrono::milliseconds(50));
+  }
+}
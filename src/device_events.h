@@ -0,0 +1,67 @@
+#ifndef LUCK_MTP_DEVICE_EVENTS
+#define LUCK_MTP_DEVICE_EVENTS
+
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include "libmtp.h"
+
+using namespace std;
+
+/**
+ * called on the reader thread with every event, <code>ok</code> is false
+ * when events may have been lost, when a read fails or starts working again
+ */
+typedef function<void(bool ok, LIBMTP_event_t event, uint32_t param)> DeviceEventCallback;
+
+/**
+ * read the events of a device on a background thread
+ *
+ * an event read is queued with LIBMTP_Read_Event_Async and the usb events
+ * are handled with a timeout, so the thread can be stopped while no event
+ * comes. events come on the interrupt endpoint, the reads do not wait for
+ * the session of the device.
+ */
+class DeviceEventReader
+{
+public:
+  DeviceEventReader() {}
+  DeviceEventReader(const DeviceEventReader &) = delete;
+  DeviceEventReader &operator=(const DeviceEventReader &) = delete;
+  ~DeviceEventReader() { stop(); }
+
+  /**
+   * @param device the connected device
+   * @param callback called with every event
+   * @return false if already running
+   */
+  bool start(LIBMTP_mtpdevice_t *device, DeviceEventCallback callback);
+
+  /**
+   * stop the reader thread, waits for it to exit
+   */
+  void stop();
+
+  bool running();
+
+private:
+  static void received(int ret, LIBMTP_event_t event, uint32_t param, void *data);
+  void run();
+
+  LIBMTP_mtpdevice_t *_device = NULL;
+  DeviceEventCallback _callback;
+  // a read is queued, it stays queued when the reader is stopped
+  bool _pending = false;
+  int _completed = 0;
+  int _ret = 0;
+  LIBMTP_event_t _event = LIBMTP_EVENT_NONE;
+  uint32_t _param = 0;
+
+  thread _thread;
+  mutex _mutex;
+  atomic<bool> _running{false};
+};
+
+#endif
@@ -0,0 +1,143 @@
+#include <string.h>
+#include <algorithm>
+#include "buffer_pool.h"
+#include "device_pipe.h"
+
+using namespace std;
+
+DevicePipe::~DevicePipe()
+{
+  // both sides are done, every slab is in a queue or held by one of them
+  if (_current)
+    poolRelease(_current);
+  if (_reading.data)
+    poolRelease(_reading.data);
+  Chunk chunk;
+  while (_full.tryPop(chunk))
+  {
+    if (chunk.data)
+      poolRelease(chunk.data);
+  }
+  unsigned char *slab;
+  while (_free.tryPop(slab))
+    poolRelease(slab);
+}
+
+bool DevicePipe::open()
+{
+  for (size_t i = 0; i < PIPE_SLABS; i++)
+  {
+    unsigned char *slab = poolAcquire();
+    if (!slab)
+      break;
+    _free.tryPush(slab);
+  }
+  return _free.tryPop(_current);
+}
+
+bool DevicePipe::write(const unsigned char *data, size_t length)
+{
+  while (length > 0)
+  {
+    if (!_current)
+      _waiter.wait([this] { return _failed || _free.tryPop(_current); });
+    if (!_current)
+      return false;
+
+    size_t take = min(length, POOL_SLAB_SIZE - _used);
+    memcpy(_current + _used, data, take);
+    _used += take;
+    data += take;
+    length -= take;
+
+    if (_used == POOL_SLAB_SIZE && !submit())
+      return false;
+  }
+  return !_failed;
+}
+
+/**
+ * hand the current slab to the consumer
+ */
+bool DevicePipe::submit()
+{
+  if (!push({_current, _used}))
+    return false;
+  _current = NULL;
+  _used = 0;
+  return true;
+}
+
+bool DevicePipe::endFile()
+{
+  if (_current && _used > 0 && !submit())
+    return false;
+  return push({NULL, 0}) && !_failed;
+}
+
+size_t DevicePipe::read(unsigned char *data, size_t length)
+{
+  size_t done = 0;
+  while (done < length && !_ended)
+  {
+    if (!_reading.data)
+    {
+      Chunk chunk;
+      bool popped = false;
+      _waiter.wait([this, &chunk, &popped] { return (popped = _full.tryPop(chunk)) || _failed; });
+      if (!popped)
+        return 0;
+      _waiter.wake();
+      if (!chunk.data)
+      {
+        _ended = true;
+        break;
+      }
+      _reading = chunk;
+      _offset = 0;
+    }
+
+    size_t take = min(length - done, _reading.length - _offset);
+    memcpy(data + done, _reading.data + _offset, take);
+    done += take;
+    _offset += take;
+
+    if (_offset == _reading.length)
+    {
+      // the queue has room for every slab
+      _free.tryPush(_reading.data);
+      _reading = {NULL, 0};
+      _waiter.wake();
+    }
+  }
+  return _failed ? 0 : done;
+}
+
+bool DevicePipe::nextFile()
+{
+  unsigned char extra;
+  bool longer = !_ended && read(&extra, 1) > 0;
+  bool ended = _ended;
+  _ended = false;
+  return ended && !longer && !_failed;
+}
+
+void DevicePipe::fail()
+{
+  _failed = true;
+  _waiter.wake();
+}
+
+/**
+ * helper function to queue a chunk for the consumer, blocks while the queue is full
+ *
+ * @return false if the pipe failed before the chunk was queued
+ */
+bool DevicePipe::push(const Chunk &chunk)
+{
+  bool pushed = false;
+  _waiter.wait([this, &chunk, &pushed] { return (pushed = _full.tryPush(chunk)) || _failed; });
+  if (pushed)
+    _waiter.wake();
+  return pushed;
+}
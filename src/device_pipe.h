@@ -0,0 +1,107 @@
+#ifndef LUCK_MTP_DEVICE_PIPE
+#define LUCK_MTP_DEVICE_PIPE
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include "file_writer.h"
+#include "waiter.h"
+
+using namespace std;
+
+/**
+ * bounded ring of pooled slabs between the download of one device and the
+ * upload of another
+ *
+ * the producer copies the data of its libmtp get handler into the slabs and
+ * the consumer hands them to its libmtp send handler, each on the thread of
+ * its own device, so both usb links transfer at the same time. the producer
+ * only waits when all the slabs are full, the consumer when all are empty.
+ * a pipe carries several files one after the other, each ended by a marker,
+ * so the producer may already read the next file while the consumer sends
+ * the end of the previous one.
+ */
+class DevicePipe
+{
+public:
+  DevicePipe() {}
+  DevicePipe(const DevicePipe &) = delete;
+  DevicePipe &operator=(const DevicePipe &) = delete;
+  ~DevicePipe();
+
+  /**
+   * @return false if the slabs can not be allocated
+   */
+  bool open();
+
+  /**
+   * queue data of the current file, blocks while all the slabs are full
+   *
+   * @return false if the pipe failed
+   */
+  bool write(const unsigned char *data, size_t length);
+
+  /**
+   * end the current file, the next write starts the next one
+   *
+   * @return false if the pipe failed
+   */
+  bool endFile();
+
+  /**
+   * read data of the current file, blocks while all the slabs are empty
+   *
+   * @return the number of bytes read, less than <code>length</code> at the
+   * end of the file, 0 if the pipe failed
+   */
+  size_t read(unsigned char *data, size_t length);
+
+  /**
+   * skip to the next file once the current one is read
+   *
+   * @return false if the current file has more data or the pipe failed
+   */
+  bool nextFile();
+
+  /**
+   * stop both sides, called by the side that gives up
+   */
+  void fail();
+
+  bool failed() const { return _failed.load(); }
+
+private:
+  // slabs in the ring, about 2MB
+  static const size_t PIPE_SLABS = 8;
+
+  struct Chunk
+  {
+    // NULL for the end of a file
+    unsigned char *data;
+    size_t length;
+  };
+
+  bool submit();
+  bool push(const Chunk &chunk);
+
+  // producer side
+  unsigned char *_current = NULL;
+  size_t _used = 0;
+
+  // consumer side
+  Chunk _reading = {NULL, 0};
+  size_t _offset = 0;
+  bool _ended = false;
+
+  atomic<bool> _failed{false};
+
+  // full slabs and end markers to the consumer, there may be many markers in a row
+  SpscQueue<Chunk, 2 * PIPE_SLABS> _full;
+  // read slabs back to the producer
+  SpscQueue<unsigned char *, PIPE_SLABS> _free;
+
+  // only used to sleep when a queue is empty or full
+  Waiter _waiter;
+};
+
+#endif
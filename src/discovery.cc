@@ -0,0 +1,207 @@
+#include <stdlib.h>
+#include <chrono>
+#include "discovery.h"
+#include "mtp_call.h"
+#include "stats.h"
+
+using namespace std;
+
+bool sameRawDevice(const LIBMTP_raw_device_t &a, const LIBMTP_raw_device_t &b)
+{
+  return a.bus_location == b.bus_location &&
+         a.devnum == b.devnum &&
+         a.device_entry.vendor_id == b.device_entry.vendor_id &&
+         a.device_entry.product_id == b.device_entry.product_id;
+}
+
+/**
+ * helper function to build the key of a raw device in the serial number cache
+ */
+static uint64_t deviceKey(const LIBMTP_raw_device_t &device)
+{
+  return ((uint64_t)device.bus_location << 40) |
+         ((uint64_t)device.devnum << 32) |
+         ((uint64_t)device.device_entry.vendor_id << 16) |
+         device.device_entry.product_id;
+}
+
+/**
+ * helper function to collect the devices of <code>from</code> missing in <code>in</code>
+ */
+static void diffDevices(const vector<LIBMTP_raw_device_t> &from,
+                        const vector<LIBMTP_raw_device_t> &in,
+                        bool attached,
+                        vector<DiscoveryEvent> &events)
+{
+  for (const LIBMTP_raw_device_t &device : from)
+  {
+    bool found = false;
+    for (const LIBMTP_raw_device_t &other : in)
+    {
+      if (sameRawDevice(device, other))
+      {
+        found = true;
+        break;
+      }
+    }
+    if (!found)
+    {
+      events.push_back({attached, device});
+    }
+  }
+}
+
+DeviceDiscovery::DeviceDiscovery()
+    : _lastError(LIBMTP_ERROR_NONE), _scanned(false), _polling(false), _intervalMs(1000)
+{
+}
+
+DeviceDiscovery::~DeviceDiscovery()
+{
+  stop();
+}
+
+LIBMTP_error_number_t DeviceDiscovery::refresh(vector<DiscoveryEvent> *events)
+{
+  // only one bus scan at a time, the polling thread and callers share the cache
+  lock_guard<mutex> scanLock(_scanMutex);
+
+  LIBMTP_raw_device_t *rawdevices = NULL;
+  int numrawdevices = 0;
+
+  LIBMTP_error_number_t err = mtpDetectRawDevices(&rawdevices, &numrawdevices);
+
+  vector<LIBMTP_raw_device_t> found;
+  if (err == LIBMTP_ERROR_NONE && rawdevices)
+  {
+    // device entries only point into the static libmtp device table, a shallow copy is safe
+    found.assign(rawdevices, rawdevices + numrawdevices);
+  }
+  if (rawdevices)
+  {
+    free(rawdevices);
+  }
+
+  // a bus error leaves the last good list in place, an empty bus clears it
+  bool replace = err == LIBMTP_ERROR_NONE || err == LIBMTP_ERROR_NO_DEVICE_ATTACHED;
+
+  lock_guard<mutex> lock(_mutex);
+  if (replace)
+  {
+    if (events)
+    {
+      diffDevices(found, _devices, true, *events);
+      diffDevices(_devices, found, false, *events);
+    }
+    _devices.swap(found);
+
+    // forget the serial numbers of detached devices, their port may be reused
+    for (auto it = _serials.begin(); it != _serials.end();)
+    {
+      bool present = false;
+      for (const LIBMTP_raw_device_t &device : _devices)
+      {
+        if (deviceKey(device) == it->first)
+        {
+          present = true;
+          break;
+        }
+      }
+      it = present ? next(it) : _serials.erase(it);
+    }
+  }
+  _lastError = err;
+  _scanned = true;
+  return err;
+}
+
+LIBMTP_error_number_t DeviceDiscovery::ensureScanned()
+{
+  {
+    lock_guard<mutex> lock(_mutex);
+    if (_scanned)
+      return _lastError;
+  }
+  return refresh();
+}
+
+vector<LIBMTP_raw_device_t> DeviceDiscovery::devices()
+{
+  lock_guard<mutex> lock(_mutex);
+  return _devices;
+}
+
+LIBMTP_error_number_t DeviceDiscovery::lastError()
+{
+  lock_guard<mutex> lock(_mutex);
+  return _lastError;
+}
+
+void DeviceDiscovery::setSerial(const LIBMTP_raw_device_t &device, const string &serial)
+{
+  lock_guard<mutex> lock(_mutex);
+  _serials[deviceKey(device)] = serial;
+}
+
+string DeviceDiscovery::serial(const LIBMTP_raw_device_t &device)
+{
+  lock_guard<mutex> lock(_mutex);
+  auto it = _serials.find(deviceKey(device));
+  return it == _serials.end() ? string() : it->second;
+}
+
+bool DeviceDiscovery::start(uint32_t intervalMs, DiscoveryCallback callback)
+{
+  lock_guard<mutex> lock(_pollMutex);
+  if (_polling)
+    return false;
+
+  _polling = true;
+  _intervalMs = intervalMs > 0 ? intervalMs : 1000;
+  _callback = callback;
+  _thread = thread(&DeviceDiscovery::poll, this);
+  return true;
+}
+
+void DeviceDiscovery::stop()
+{
+  {
+    lock_guard<mutex> lock(_pollMutex);
+    if (!_polling)
+      return;
+    _polling = false;
+  }
+  _pollCond.notify_all();
+  if (_thread.joinable())
+    _thread.join();
+  _callback = nullptr;
+}
+
+bool DeviceDiscovery::running()
+{
+  lock_guard<mutex> lock(_pollMutex);
+  return _polling;
+}
+
+void DeviceDiscovery::poll()
+{
+  while (true)
+  {
+    vector<DiscoveryEvent> events;
+    {
+      ApiScope scope(API_discovery);
+      refresh(&events);
+    }
+
+    for (const DiscoveryEvent &event : events)
+    {
+      _callback(event);
+    }
+
+    unique_lock<mutex> lock(_pollMutex);
+    _pollCond.wait_for(lock, chrono::milliseconds(_intervalMs), [this]
+                       { return !_polling; });
+    if (!_polling)
+      return;
+  }
+}
@@ -0,0 +1,126 @@
+#ifndef LUCK_MTP_DISCOVERY
+#define LUCK_MTP_DISCOVERY
+
+#include <stdint.h>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <string>
+#include "libmtp.h"
+
+using namespace std;
+
+/**
+ * a device plugged in or removed between two bus scans
+ */
+struct DiscoveryEvent
+{
+  bool attached;
+  LIBMTP_raw_device_t device;
+};
+
+typedef function<void(const DiscoveryEvent &)> DiscoveryCallback;
+
+/**
+ * keeps the raw device list of the last bus scan in memory.
+ *
+ * <code>LIBMTP_Detect_Raw_Devices</code> costs a full usb bus scan, so the
+ * list is refreshed on demand or by a background polling thread, and every
+ * reader gets a copy of the last snapshot. The array handed out by libmtp is
+ * freed as soon as it is copied.
+ */
+class DeviceDiscovery
+{
+public:
+  DeviceDiscovery();
+  ~DeviceDiscovery();
+
+  /**
+   * scan the bus and replace the cached device list
+   *
+   * @param events if not null, receives the attach/detach events against the previous snapshot
+   * @return the libmtp detect result
+   */
+  LIBMTP_error_number_t refresh(vector<DiscoveryEvent> *events = NULL);
+
+  /**
+   * scan the bus only if it has never been scanned
+   *
+   * @return the result of the last scan
+   */
+  LIBMTP_error_number_t ensureScanned();
+
+  /**
+   * @return a copy of the cached raw device list
+   */
+  vector<LIBMTP_raw_device_t> devices();
+
+  /**
+   * @return the result of the last scan
+   */
+  LIBMTP_error_number_t lastError();
+
+  /**
+   * remember the serial number read from an opened device
+   *
+   * serial numbers are only known once a session has been opened, they are
+   * kept until the device is detached so that later connects by serial
+   * number do not have to open every device again.
+   *
+   * @param device the raw device
+   * @param serial the serial number
+   */
+  void setSerial(const LIBMTP_raw_device_t &device, const string &serial);
+
+  /**
+   * @param device the raw device
+   * @return the serial number remembered for the device, empty if unknown
+   */
+  string serial(const LIBMTP_raw_device_t &device);
+
+  /**
+   * start the background polling thread
+   *
+   * @param intervalMs polling interval in milliseconds
+   * @param callback called on the polling thread for each attach/detach event
+   * @return false if polling is already running
+   */
+  bool start(uint32_t intervalMs, DiscoveryCallback callback);
+
+  /**
+   * stop the background polling thread and wait for it to exit
+   */
+  void stop();
+
+  /**
+   * @return true if the background polling thread is running
+   */
+  bool running();
+
+private:
+  void poll();
+
+  mutex _mutex;
+  mutex _scanMutex;
+  vector<LIBMTP_raw_device_t> _devices;
+  map<uint64_t, string> _serials;
+  LIBMTP_error_number_t _lastError;
+  bool _scanned;
+
+  thread _thread;
+  mutex _pollMutex;
+  condition_variable _pollCond;
+  bool _polling;
+  uint32_t _intervalMs;
+  DiscoveryCallback _callback;
+};
+
+/**
+ * @return true if two raw devices are the same device on the same usb port
+ */
+bool sameRawDevice(const LIBMTP_raw_device_t &a, const LIBMTP_raw_device_t &b);
+
+#endif
@@ -0,0 +1,241 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <algorithm>
+#ifdef _WIN32
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <unistd.h>
+#endif
+#include "buffer_pool.h"
+#include "file_writer.h"
+
+using namespace std;
+
+/**
+ * helper function to write a whole buffer at an offset of the file
+ */
+static bool writeAt(int fd, const unsigned char *data, size_t length, uint64_t offset)
+{
+#ifdef _WIN32
+  // the writer is the only user of the descriptor and writes in order
+  if (_lseeki64(fd, (__int64)offset, SEEK_SET) < 0)
+    return false;
+#endif
+  while (length > 0)
+  {
+#ifdef _WIN32
+    int done = _write(fd, data, (unsigned int)length);
+#else
+    ssize_t done = pwrite(fd, data, length, (off_t)offset);
+#endif
+    if (done < 0 && errno == EINTR)
+      continue;
+    if (done <= 0)
+      return false;
+    data += done;
+    length -= done;
+    offset += done;
+  }
+  return true;
+}
+
+/**
+ * helper function to flush the data of a file to the disk
+ */
+static bool syncFile(int fd)
+{
+#ifdef _WIN32
+  return _commit(fd) == 0;
+#elif defined(__linux__)
+  return fdatasync(fd) == 0;
+#else
+  return fsync(fd) == 0;
+#endif
+}
+
+static bool truncateFile(int fd, uint64_t size)
+{
+#ifdef _WIN32
+  return _chsize_s(fd, (__int64)size) == 0;
+#else
+  return ftruncate(fd, (off_t)size) == 0;
+#endif
+}
+
+FileWriter::~FileWriter()
+{
+  if (_fd >= 0)
+    abort();
+}
+
+bool FileWriter::open(const char *path, uint64_t size, StreamHash *hash, const FileWriterOptions &options)
+{
+#ifdef _WIN32
+  _fd = _open(path, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+  _fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+#endif
+  if (_fd < 0)
+    return false;
+
+#ifdef __linux__
+  // reserve the blocks in one go, unsupported by some network file systems, which is fine
+  if (size > 0)
+    fallocate(_fd, 0, 0, (off_t)size);
+#endif
+
+  _hash = hash;
+  _options = options;
+  _current = NULL;
+  _used = 0;
+  _synced = 0;
+  _written = 0;
+  _failed = false;
+  _dropping = false;
+
+  for (size_t i = 0; i < WRITER_SLABS; i++)
+  {
+    unsigned char *slab = poolAcquire();
+    if (!slab)
+      break;
+    _free.tryPush(slab);
+  }
+  if (!_free.tryPop(_current))
+  {
+#ifdef _WIN32
+    _close(_fd);
+#else
+    ::close(_fd);
+#endif
+    _fd = -1;
+    return false;
+  }
+
+  _thread = thread(&FileWriter::run, this);
+  return true;
+}
+
+bool FileWriter::write(const unsigned char *data, size_t length)
+{
+  while (length > 0)
+  {
+    if (_failed)
+      return false;
+
+    if (!_current)
+      _waiter.wait([this] { return _failed || _free.tryPop(_current); });
+    if (!_current)
+      return false;
+
+    size_t take = min(length, POOL_SLAB_SIZE - _used);
+    memcpy(_current + _used, data, take);
+    _used += take;
+    data += take;
+    length -= take;
+
+    if (_used == POOL_SLAB_SIZE)
+      submit();
+  }
+  return !_failed;
+}
+
+bool FileWriter::close()
+{
+  return finish(false);
+}
+
+void FileWriter::abort()
+{
+  finish(true);
+}
+
+/**
+ * hand the current slab to the writer thread
+ */
+void FileWriter::submit()
+{
+  // the queue has room for every slab and the end marker
+  _full.tryPush({_current, _used});
+  _current = NULL;
+  _used = 0;
+  _waiter.wake();
+}
+
+/**
+ * stop the writer thread, give the slabs back to the pool and close the file
+ *
+ * @param drop true to skip the data still queued
+ */
+bool FileWriter::finish(bool drop)
+{
+  if (_fd < 0)
+    return false;
+
+  if (drop)
+    _dropping = true;
+  if (_current && _used > 0)
+    submit();
+  _full.tryPush({NULL, 0});
+  _waiter.wake();
+  _thread.join();
+
+  if (_current)
+    poolRelease(_current);
+  _current = NULL;
+  unsigned char *slab;
+  while (_free.tryPop(slab))
+    poolRelease(slab);
+
+  bool ok = !drop && !_failed;
+  if (ok)
+  {
+    // cut the preallocated space of a file shorter than announced
+    ok = truncateFile(_fd, _written);
+    if (ok && _options.fsync != FSYNC_NONE)
+      ok = syncFile(_fd);
+  }
+#ifdef _WIN32
+  ok = _close(_fd) == 0 && ok;
+#else
+  ok = ::close(_fd) == 0 && ok;
+#endif
+  _fd = -1;
+  return ok;
+}
+
+/**
+ * writer thread, drains the full slabs until the end marker
+ */
+void FileWriter::run()
+{
+  for (;;)
+  {
+    Chunk chunk;
+    _waiter.wait([this, &chunk] { return _full.tryPop(chunk); });
+    if (!chunk.data)
+      break;
+
+    if (!_failed && !_dropping)
+    {
+      if (_hash)
+        _hash->update(chunk.data, chunk.length);
+      uint64_t offset = _written;
+      if (writeAt(_fd, chunk.data, chunk.length, offset))
+        _written = offset + chunk.length;
+      else
+        _failed = true;
+
+      if (!_failed && _options.fsync == FSYNC_INTERVAL && _written - _synced >= _options.fsyncInterval)
+      {
+        if (!syncFile(_fd))
+          _failed = true;
+        _synced = _written;
+      }
+    }
+
+    _free.tryPush(chunk.data);
+    _waiter.wake();
+  }
+}
@@ -0,0 +1,152 @@
+#ifndef LUCK_MTP_FILE_WRITER
+#define LUCK_MTP_FILE_WRITER
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <thread>
+#include "checksum.h"
+#include "waiter.h"
+
+using namespace std;
+
+/**
+ * lock free single producer single consumer ring of N values
+ *
+ * only the producer advances <code>tail</code>, only the consumer advances <code>head</code>
+ */
+template <typename T, size_t N>
+class SpscQueue
+{
+public:
+  bool tryPush(const T &value)
+  {
+    uint64_t tail = _tail.load(memory_order_relaxed);
+    if (tail - _head.load(memory_order_acquire) == N)
+      return false;
+    _slots[tail % N] = value;
+    _tail.store(tail + 1, memory_order_release);
+    return true;
+  }
+
+  bool tryPop(T &value)
+  {
+    uint64_t head = _head.load(memory_order_relaxed);
+    if (head == _tail.load(memory_order_acquire))
+      return false;
+    value = _slots[head % N];
+    _head.store(head + 1, memory_order_release);
+    return true;
+  }
+
+private:
+  T _slots[N];
+  alignas(64) atomic<uint64_t> _head{0};
+  alignas(64) atomic<uint64_t> _tail{0};
+};
+
+/**
+ * when the data of a download is flushed to the disk
+ */
+enum FsyncPolicy
+{
+  // leave it to the system
+  FSYNC_NONE,
+  // once, before the file is closed
+  FSYNC_END,
+  // every <code>fsyncInterval</code> bytes and before the file is closed
+  FSYNC_INTERVAL
+};
+
+struct FileWriterOptions
+{
+  FsyncPolicy fsync = FSYNC_NONE;
+  uint64_t fsyncInterval = 0;
+};
+
+/**
+ * double buffered writer of a local file
+ *
+ * <code>write</code> copies the data into pooled slabs on the calling (usb)
+ * thread, full slabs go through a lock free queue to a writer thread that
+ * hashes them and writes them with large aligned pwrites, then hands them
+ * back through a second queue. the usb transfer so only waits for the disk
+ * when all the slabs are queued. the file is preallocated from the expected
+ * size where the file system supports it.
+ */
+class FileWriter
+{
+public:
+  FileWriter() {}
+  FileWriter(const FileWriter &) = delete;
+  FileWriter &operator=(const FileWriter &) = delete;
+  ~FileWriter();
+
+  /**
+   * @param path the local file, overwritten
+   * @param size the expected size of the file, 0 if unknown
+   * @param hash the checksums updated with every chunk, may be NULL
+   * @param options the fsync policy
+   * @return false if the file can not be created
+   */
+  bool open(const char *path, uint64_t size, StreamHash *hash, const FileWriterOptions &options);
+
+  /**
+   * queue data to be written, blocks while all the slabs are waiting for the disk
+   *
+   * @return false if a write failed
+   */
+  bool write(const unsigned char *data, size_t length);
+
+  /**
+   * write the remaining data, set the final size, sync and close the file
+   *
+   * @return false if any write failed
+   */
+  bool close();
+
+  /**
+   * stop writing and close the file, the queued data is dropped
+   */
+  void abort();
+
+  /**
+   * @return the number of bytes written so far by the writer thread
+   */
+  uint64_t written() const { return _written.load(); }
+
+private:
+  // slabs in flight between the two threads
+  static const size_t WRITER_SLABS = 4;
+
+  struct Chunk
+  {
+    unsigned char *data;
+    size_t length;
+  };
+
+  void run();
+  void submit();
+  bool finish(bool drop);
+
+  int _fd = -1;
+  StreamHash *_hash = NULL;
+  FileWriterOptions _options;
+  unsigned char *_current = NULL;
+  size_t _used = 0;
+  uint64_t _synced = 0;
+  atomic<uint64_t> _written{0};
+  atomic<bool> _failed{false};
+  atomic<bool> _dropping{false};
+
+  // full slabs to the writer thread, and the end marker
+  SpscQueue<Chunk, WRITER_SLABS + 1> _full;
+  // written slabs back to the producer
+  SpscQueue<unsigned char *, WRITER_SLABS> _free;
+
+  // only used to sleep when a queue is empty
+  Waiter _waiter;
+  thread _thread;
+};
+
+#endif
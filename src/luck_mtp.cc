@@ -3,25 +3,73 @@
 #include <string.h>
 #include <regex>
 #include <vector>
+#include <memory>
+#include <atomic>
 #include <iostream>
 #include <sys/stat.h>
 #include "libmtp.h"
 #include "utils.h"
+#include "discovery.h"
+#include "persistent_index.h"
+#include "mtp_call.h"
+#include "stats.h"
+#include "timeline.h"
+#include "checksum.h"
+#include "transfer.h"
+#include "broadcast.h"
+#include "watcher.h"
+#include "mirror.h"
+#include "change_journal.h"
+#include "device_events.h"
+#include "archive.h"
+#include "buffer_pool.h"
+#include "thumbnail_cache.h"
+#include "scheduler.h"
+#include "rate_limit.h"
 
 using namespace std;
 
 LIBMTP_mtpdevice_t *__device;
-LIBMTP_raw_device_t *__rawdevices;
-int __numrawdevices;
 uint32_t __storageId;
+DeviceDiscovery __discovery;
+PersistentIndex __persistentIndex;
+Napi::ThreadSafeFunction __discoveryCallback;
+// background jobs using __device, it can not be released while they run
+atomic<int> __deviceJobs(0);
+ThumbnailCache __thumbnails(32 * 1024 * 1024);
+DirectoryWatcher __watcher;
+unique_ptr<DeviceMirror> __mirror;
+Napi::ThreadSafeFunction __watchCallback;
+DeviceEventReader __deviceEvents;
+
+/**
+ * helper function to read a boolean option
+ *
+ * @param options the options value, may be undefined
+ * @param name option name
+ * @param defaultValue value used when the option is not set
+ * @return the option value
+ */
+bool getBoolOption(const Napi::Value &options, const char *name, bool defaultValue)
+{
+  if (!options.IsObject())
+    return defaultValue;
+
+  Napi::Object optionsObj = options.As<Napi::Object>();
+  if (!optionsObj.Has(name) || optionsObj.Get(name).IsUndefined())
+    return defaultValue;
+
+  return optionsObj.Get(name).ToBoolean().Value();
+}
 
 /**
  * helper function to init a file obj
  *
  * @param file a pointer to the file.
  * @param fileObj a reference to the fileObj need init
+ * @param persistentId true to add the persistent unique object id, @see PersistentIndex
  */
-void initFileObj(LIBMTP_file_t *file, Napi::Object &fileObj)
+void initFileObj(const LIBMTP_file_t *file, Napi::Object &fileObj, bool persistentId = false)
 {
   fileObj.Set("name", file->filename);
   fileObj.Set("size", file->filesize);
@@ -37,6 +85,41 @@ void initFileObj(LIBMTP_file_t *file, Napi::Object &fileObj)
   fileObj.Set("modificationdate", file->modificationdate);
   fileObj.Set("parent_id", file->parent_id);
   fileObj.Set("storage_id", file->storage_id);
+  if (persistentId)
+  {
+    fileObj.Set("persistent_id", formatPersistentId(__persistentIndex.get(__device, file->item_id)));
+  }
+}
+
+/**
+ * helper function to make sure the storage list of the connected device is loaded
+ *
+ * a locked android device may report no storage until it is unlocked
+ */
+void ensureStorage()
+{
+  if (__device && !__device->storage)
+  {
+    mtpGetStorage(__device, LIBMTP_STORAGE_SORTBY_NOTSORTED);
+  }
+}
+
+/**
+ * get the current storage id, the first storage is selected if none is set
+ *
+ * @return the current storage id, 0 if the device has no storage
+ */
+uint32_t currentStorageId()
+{
+  if (__storageId == 0 && __device)
+  {
+    ensureStorage();
+    if (__device->storage)
+    {
+      __storageId = __device->storage->id;
+    }
+  }
+  return __storageId;
 }
 
 /**
@@ -57,9 +140,9 @@ LIBMTP_file_t *doFindFile(LIBMTP_mtpdevice_t *device, string &path, LIBMTP_file_
 
   LIBMTP_file_t *files;
 
-  files = LIBMTP_Get_Files_And_Folders(device,
-                                       __storageId,
-                                       parentId);
+  files = mtpGetFilesAndFolders(device,
+                                currentStorageId(),
+                                parentId);
 
   LIBMTP_file_t *file, *tmp;
 
@@ -85,6 +168,7 @@ LIBMTP_file_t *doFindFile(LIBMTP_mtpdevice_t *device, string &path, LIBMTP_file_
  */
 LIBMTP_file_t *findFile(LIBMTP_mtpdevice_t *device, const string &targetPath)
 {
+  TimelineScope span("findFile", "resolve");
 
   LIBMTP_file_t *file = NULL;
   vector<string> subPaths = split(targetPath, "/");
@@ -100,6 +184,146 @@ LIBMTP_file_t *findFile(LIBMTP_mtpdevice_t *device, const string &targetPath)
   return file;
 }
 
+/**
+ * helper function to get the options of a download or upload
+ *
+ * the options are the 4th argument, or the 3rd one when no progress callback is given
+ *
+ * @param info napi callback info
+ * @return the options value, undefined if none was given
+ */
+Napi::Value transferOptions(const Napi::CallbackInfo &info)
+{
+  if (info.Length() >= 4)
+    return info[3];
+  if (info.Length() == 3 && !info[2].IsFunction())
+    return info[2];
+  return info.Env().Undefined();
+}
+
+/**
+ * helper function to check the progress callback and options arguments of a download or upload
+ *
+ * @param info napi callback info
+ * @return true if the arguments are valid
+ */
+bool validTransferArguments(const Napi::CallbackInfo &info)
+{
+  if (info.Length() >= 4 && !info[2].IsFunction() && !info[2].IsUndefined() && !info[2].IsNull())
+    return false;
+
+  Napi::Value options = transferOptions(info);
+  return options.IsUndefined() || options.IsNull() || options.IsObject();
+}
+
+/**
+ * helper function to read the <code>hash</code> option, the list of checksums computed during a transfer
+ *
+ * @param env napi env
+ * @param options the options value, may be undefined
+ * @param hash the checksums to set up
+ */
+void getHashOption(Napi::Env env, const Napi::Value &options, StreamHash &hash)
+{
+  if (!options.IsObject())
+    return;
+
+  Napi::Value names = options.As<Napi::Object>().Get("hash");
+  if (names.IsUndefined() || names.IsNull())
+    return;
+
+  if (names.IsString())
+  {
+    if (!hash.add(names.As<Napi::String>().Utf8Value()))
+      throw Napi::TypeError::New(env, "Unsupported hash algorithm.");
+    return;
+  }
+
+  if (!names.IsArray())
+    throw Napi::TypeError::New(env, "Wrong arguments");
+
+  Napi::Array array = names.As<Napi::Array>();
+  for (uint32_t i = 0; i < array.Length(); i++)
+  {
+    Napi::Value name = array.Get(i);
+    if (!name.IsString() || !hash.add(name.As<Napi::String>().Utf8Value()))
+      throw Napi::TypeError::New(env, "Unsupported hash algorithm.");
+  }
+}
+
+/**
+ * helper function to read the <code>fsync</code> option of a download
+ *
+ * 'none' leaves the flush to the system, 'end' syncs the file once before it
+ * is closed, a number syncs every time that many bytes were written
+ *
+ * @param env napi env
+ * @param options the options value, may be undefined
+ * @param writer the writer options to set up
+ */
+void getFsyncOption(Napi::Env env, const Napi::Value &options, FileWriterOptions &writer)
+{
+  if (!options.IsObject())
+    return;
+
+  Napi::Value fsync = options.As<Napi::Object>().Get("fsync");
+  if (fsync.IsUndefined() || fsync.IsNull())
+    return;
+
+  if (fsync.IsNumber() && fsync.As<Napi::Number>().DoubleValue() > 0)
+  {
+    writer.fsync = FSYNC_INTERVAL;
+    writer.fsyncInterval = (uint64_t)fsync.As<Napi::Number>().DoubleValue();
+    return;
+  }
+
+  string policy = fsync.IsString() ? fsync.As<Napi::String>().Utf8Value() : "";
+  if (policy == "none")
+    writer.fsync = FSYNC_NONE;
+  else if (policy == "end")
+    writer.fsync = FSYNC_END;
+  else
+    throw Napi::TypeError::New(env, "Unsupported fsync policy.");
+}
+
+/**
+ * helper function to build the result of a hashed transfer
+ *
+ * @param env napi env
+ * @param size the number of bytes transferred
+ * @param hash the checksums of the transfer
+ * @return { size, hash: { name: hex digest } }
+ */
+Napi::Object hashResult(Napi::Env env, uint64_t size, StreamHash &hash)
+{
+  Napi::Object digests = Napi::Object::New(env);
+  for (auto &digest : hash.digests())
+    digests.Set(digest.first, Napi::String::New(env, digest.second));
+
+  Napi::Object result = Napi::Object::New(env);
+  result.Set("size", (double)size);
+  result.Set("hash", digests);
+  return result;
+}
+
+/**
+ * progress callback of a javascript function
+ *
+ * @param sent the number of bytes sent so far
+ * @param total the total number of bytes to send
+ * @param data a pointer to the napi function
+ * @return 1 if the function returned false, to cancel the transfer, 0 otherwise
+ */
+int functionProgress(const uint64_t sent, const uint64_t total, void const *const data)
+{
+  TimelineScope span("progress", "callback");
+  Napi::Function *processCallback = (Napi::Function *)data;
+  Napi::Env env = processCallback->Env();
+  Napi::Value ret = processCallback->Call(env.Global(), {Napi::Number::New(env, sent), Napi::Number::New(env, total)});
+  // the callback cancels the transfer by returning false
+  return ret.IsBoolean() && !ret.As<Napi::Boolean>().Value() ? 1 : 0;
+}
+
 /**
  * download or upload porgress callback
  *
@@ -114,68 +338,177 @@ int progress(const uint64_t sent, const uint64_t total, void const *const data)
   if (data)
   {
     Napi::CallbackInfo *info = (Napi::CallbackInfo *)data;
-    Napi::Env env = info->Env();
-    Napi::Function processCallback;
 
-    if (info->Length() >= 3)
-      processCallback = (*info)[2].As<Napi::Function>();
-
-    if (processCallback)
+    if (info->Length() >= 3 && (*info)[2].IsFunction())
     {
-      processCallback.Call(env.Global(), {Napi::Number::New(env, sent), Napi::Number::New(env, total)});
+      Napi::Function processCallback = (*info)[2].As<Napi::Function>();
+      return functionProgress(sent, total, &processCallback);
     }
   }
   return 0;
 }
 
 /**
- * get raw device array into global variable <code>__rawdevices</code> and <code>__numrawdevices</code>
+ * get the error message of a failed raw device detection
  *
- * @param env napi env object
+ * @param err the libmtp detect result
+ * @return the error message, NULL if the detection was successful
  */
-void getRawDevice(Napi::Env env)
+const char *detectErrorMessage(LIBMTP_error_number_t err)
 {
-  LIBMTP_error_number_t err;
-
-  err = LIBMTP_Detect_Raw_Devices(&__rawdevices, &__numrawdevices);
   switch (err)
   {
   case LIBMTP_ERROR_NO_DEVICE_ATTACHED:
     // fprintf(stdout, "   No raw devices found.\n");
-    throw Napi::Error::New(env, "No raw devices found.");
+    return "No raw devices found.";
   case LIBMTP_ERROR_CONNECTING:
     // fprintf(stderr, "Detect: There has been an error connecting. Exiting\n");
-    throw Napi::Error::New(env, "Detect: There has been an error connecting. Exiting.");
+    return "Detect: There has been an error connecting. Exiting.";
   case LIBMTP_ERROR_MEMORY_ALLOCATION:
     // fprintf(stderr, "Detect: Encountered a Memory Allocation Error. Exiting\n");
-    throw Napi::Error::New(env, "NDetect: Encountered a Memory Allocation Error. Exiting.");
+    return "NDetect: Encountered a Memory Allocation Error. Exiting.";
   case LIBMTP_ERROR_NONE:
-    break;
+    return NULL;
   case LIBMTP_ERROR_GENERAL:
   default:
     // fprintf(stderr, "Unknown connection error.\n");
-    throw Napi::Error::New(env, "Unknown connection error.");
+    return "Unknown connection error.";
+  }
+}
+
+/**
+ * throw the napi error matching a failed raw device detection
+ *
+ * @param env napi env object
+ * @param err the libmtp detect result
+ */
+void checkDetectError(Napi::Env env, LIBMTP_error_number_t err)
+{
+  const char *message = detectErrorMessage(err);
+  if (message)
+  {
+    throw Napi::Error::New(env, message);
+  }
+}
+
+/**
+ * helper function to init a raw device obj
+ *
+ * @param env napi env object
+ * @param rawdev the raw device
+ * @return device info object
+ */
+Napi::Object rawDeviceObj(Napi::Env env, const LIBMTP_raw_device_t &rawdev)
+{
+  Napi::Object deviceObj = Napi::Object::New(env);
+  // unknown devices have no vendor or product name in the libmtp device table
+  deviceObj.Set("vendor", rawdev.device_entry.vendor ? Napi::String::New(env, rawdev.device_entry.vendor) : env.Null());
+  deviceObj.Set("vendor_id", rawdev.device_entry.vendor_id);
+  deviceObj.Set("product", rawdev.device_entry.product ? Napi::String::New(env, rawdev.device_entry.product) : env.Null());
+  deviceObj.Set("product_id", rawdev.device_entry.product_id);
+  deviceObj.Set("bus_location", rawdev.bus_location);
+  deviceObj.Set("devnum", rawdev.devnum);
+
+  // the serial number is only known once the device has been opened
+  string serial = __discovery.serial(rawdev);
+  deviceObj.Set("serial", serial.empty() ? env.Null() : Napi::String::New(env, serial));
+  return deviceObj;
+}
+
+/**
+ * pass a discovery event to the js callback registered by <code>startDiscovery</code>
+ *
+ * can be called from any thread
+ *
+ * @param event the attach/detach event
+ */
+void emitDiscoveryEvent(const DiscoveryEvent &event)
+{
+  if (!__discovery.running())
+    return;
+
+  DiscoveryEvent *data = new DiscoveryEvent(event);
+  napi_status status = __discoveryCallback.NonBlockingCall(data, [](Napi::Env env, Napi::Function jsCallback, DiscoveryEvent *data)
+                                                           {
+    jsCallback.Call({Napi::String::New(env, data->attached ? "attach" : "detach"), rawDeviceObj(env, data->device)});
+    delete data; });
+
+  if (status != napi_ok)
+    delete data;
+}
+
+/**
+ * rescan the bus, emitting the attach/detach events found against the cached list
+ *
+ * @return the libmtp detect result
+ */
+LIBMTP_error_number_t refreshRawDevices()
+{
+  vector<DiscoveryEvent> events;
+  LIBMTP_error_number_t err = __discovery.refresh(&events);
+  for (const DiscoveryEvent &event : events)
+  {
+    emitDiscoveryEvent(event);
+  }
+  return err;
+}
+
+/**
+ * get the cached raw device list, the bus is only scanned if it never was
+ *
+ * @param env napi env object
+ * @return raw device list
+ */
+vector<LIBMTP_raw_device_t> getRawDevices(Napi::Env env)
+{
+  checkDetectError(env, __discovery.ensureScanned());
+  return __discovery.devices();
+}
+
+/**
+ * helper function to build the device info array of a raw device list
+ *
+ * @param env napi env
+ * @param devices the raw device list
+ * @return device info array
+ */
+Napi::Array rawDevicesArray(Napi::Env env, const vector<LIBMTP_raw_device_t> &devices)
+{
+  Napi::Array re = Napi::Array::New(env, devices.size());
+
+  for (string::size_type i = 0; i < devices.size(); i++)
+  {
+    re[i] = rawDeviceObj(env, devices[i]);
   }
+
+  return re;
 }
 
 /**
  * helper function to get rawdevice by vid and pid
+ * if vid and pid are not set, the first device is returned
  *
+ * @param devices the raw device list to search
  * @param vid device vendor id
  * @param pid device product id
- * @return a pointer to the raw device for the search result
+ * @return the index of the raw device for the search result, -1 if not found
  */
-LIBMTP_raw_device_t *findRawDevice(int vid, int pid)
+int findRawDevice(const vector<LIBMTP_raw_device_t> &devices, int vid, int pid)
 {
-  for (int i = 0; i < __numrawdevices; i++)
+  if (vid <= 0 || pid <= 0)
+  {
+    return devices.empty() ? -1 : 0;
+  }
+
+  for (string::size_type i = 0; i < devices.size(); i++)
   {
-    LIBMTP_raw_device_t *rawdev = &__rawdevices[i];
-    if (rawdev->device_entry.vendor_id == vid && rawdev->device_entry.product_id == pid)
+    const LIBMTP_raw_device_t &rawdev = devices[i];
+    if (rawdev.device_entry.vendor_id == vid && rawdev.device_entry.product_id == pid)
     {
-      return rawdev;
+      return i;
     }
   }
-  return NULL;
+  return -1;
 }
 
 /**
@@ -188,7 +521,8 @@ LIBMTP_raw_device_t *findRawDevice(int vid, int pid)
 LIBMTP_devicestorage_t *findStorage(LIBMTP_mtpdevice_t *device, uint32_t storageId)
 {
   LIBMTP_devicestorage_t *storage;
-  for (storage = __device->storage; storage != 0; storage = storage->next)
+  ensureStorage();
+  for (storage = device->storage; storage != 0; storage = storage->next)
   {
     if (storage->id == storageId)
     {
@@ -201,28 +535,91 @@ LIBMTP_devicestorage_t *findStorage(LIBMTP_mtpdevice_t *device, uint32_t storage
 /**
  * get device info
  *
+ * reads the device list cached by the last bus scan, the bus is only scanned
+ * on the first call. @see refreshDevices() @see startDiscovery()
+ *
  * @param info napi callback info
  * @return device info array
  */
 Napi::Array getDeviceInfo(const Napi::CallbackInfo &info)
 {
   Napi::Env env = info.Env();
-  getRawDevice(env);
+  ApiScope scope(API_getDeviceInfo);
+  PriorityScope priority(PRIORITY_INTERACTIVE);
+  return rawDevicesArray(env, getRawDevices(env));
+}
+
+/**
+ * rescan the bus and update the cached device list
+ *
+ * @param info napi callback info
+ * @return device info array
+ */
+Napi::Array refreshDevices(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  ApiScope scope(API_refreshDevices);
+  refreshRawDevices();
+  return rawDevicesArray(env, getRawDevices(env));
+}
+
+/**
+ * start polling the bus on a background thread
+ *
+ * the cached device list is refreshed at every interval and the callback is
+ * called with <code>('attach' | 'detach', deviceInfo)</code> when a device is plugged in or removed
+ *
+ * @param info napi callback info
+ *             info[0] [uint32] polling interval in milliseconds
+ *             info[1] [function] the event callback function
+ * @return true if the operate was successful
+ */
+Napi::Boolean startDiscovery(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+
+  if (info.Length() < 2)
+  {
+    throw Napi::Error::New(env, "Wrong number of arguments");
+  }
 
-  Napi::Array re = Napi::Array::New(env, __numrawdevices);
+  if (!info[0].IsNumber() || !info[1].IsFunction())
+  {
+    throw Napi::TypeError::New(env, "Wrong arguments");
+  }
 
-  for (int i = 0; i < __numrawdevices; i++)
+  if (__discovery.running())
   {
-    Napi::Object deviceObj = Napi::Object::New(env);
-    LIBMTP_raw_device_t *rawdev = &__rawdevices[i];
-    deviceObj.Set("vendor", rawdev->device_entry.vendor);
-    deviceObj.Set("vendor_id", rawdev->device_entry.vendor_id);
-    deviceObj.Set("product", rawdev->device_entry.product);
-    deviceObj.Set("product_id", rawdev->device_entry.product_id);
-    re[i] = deviceObj;
+    throw Napi::Error::New(env, "Discovery already started.");
   }
 
-  return re;
+  uint32_t intervalMs = info[0].As<Napi::Number>().Uint32Value();
+
+  __discoveryCallback = Napi::ThreadSafeFunction::New(env, info[1].As<Napi::Function>(), "luck-node-mtp discovery", 0, 1);
+  __discovery.start(intervalMs, emitDiscoveryEvent);
+
+  return Napi::Boolean::New(env, true);
+}
+
+/**
+ * stop the background bus polling, the cached device list is kept
+ *
+ * @param info napi callback info
+ * @return true if the operate was successful
+ */
+Napi::Boolean stopDiscovery(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+
+  if (!__discovery.running())
+  {
+    throw Napi::Error::New(env, "Discovery not started.");
+  }
+
+  __discovery.stop();
+  __discoveryCallback.Release();
+
+  return Napi::Boolean::New(env, true);
 }
 
 /**
@@ -234,6 +631,8 @@ Napi::Array getDeviceInfo(const Napi::CallbackInfo &info)
 Napi::Array getCurrentDeviceStorageInfo(const Napi::CallbackInfo &info)
 {
   Napi::Env env = info.Env();
+  ApiScope scope(API_getCurrentDeviceStorageInfo);
+  PriorityScope priority(PRIORITY_INTERACTIVE);
 
   if (!__device)
   {
@@ -242,6 +641,7 @@ Napi::Array getCurrentDeviceStorageInfo(const Napi::CallbackInfo &info)
 
   vector<Napi::Object> storageArr;
   LIBMTP_devicestorage_t *storage;
+  ensureStorage();
   for (storage = __device->storage; storage != 0; storage = storage->next)
   {
     Napi::Object storageObj = Napi::Object::New(env);
@@ -284,6 +684,7 @@ Napi::Boolean setStorage(const Napi::CallbackInfo &info)
 {
 
   Napi::Env env = info.Env();
+  ApiScope scope(API_setStorage);
 
   if (info.Length() < 1)
   {
@@ -308,68 +709,523 @@ Napi::Boolean setStorage(const Napi::CallbackInfo &info)
 }
 
 /**
- * connect device
- * if parameters vendor id and product id not set,the first device found will be connected
+ * open a session on a raw device
  *
- * @param info napi callback info
- *             info[0] [uint32] device vendor id
- *             info[1] [uint32] device product id
- * @return true if the operate was successful
+ * @param rawdev the raw device
+ * @param cached true to use the cached libmtp mode
+ * @return the opened device, NULL on failure
  */
-Napi::Boolean connectDevice(const Napi::CallbackInfo &info)
+LIBMTP_mtpdevice_t *openRawDevice(LIBMTP_raw_device_t *rawdev, bool cached)
 {
+  LIBMTP_mtpdevice_t *device = cached ? mtpOpenRawDevice(rawdev) : mtpOpenRawDeviceUncached(rawdev);
 
-  Napi::Env env = info.Env();
+  if (device)
+  {
+    // reading the serial number does not cost a round trip, it comes with the device info
+    char *serial = mtpGetSerialnumber(device);
+    if (serial)
+    {
+      __discovery.setSerial(*rawdev, serial);
+      free(serial);
+    }
+  }
+  return device;
+}
 
-  uint32_t vid = 0, pid = 0;
+/**
+ * connect options, @see connectDevice()
+ */
+struct ConnectOptions
+{
+  bool cached = false;
+  uint32_t vid = 0;
+  uint32_t pid = 0;
+  string serial;
+};
 
-  if (info.Length() > 1)
+bool __connecting = false;
+
+/**
+ * async worker opening a device session off the main thread
+ *
+ * resolves with the device, its serial number and a per-phase timing breakdown
+ */
+class ConnectWorker : public Napi::AsyncWorker
+{
+public:
+  ConnectWorker(Napi::Env env, const ConnectOptions &options)
+      : Napi::AsyncWorker(env), _deferred(Napi::Promise::Deferred::New(env)), _options(options)
   {
-    vid = info[0].As<Napi::Number>().Uint32Value();
-    pid = info[1].As<Napi::Number>().Uint32Value();
   }
 
-  getRawDevice(env);
+  Napi::Promise Promise()
+  {
+    return _deferred.Promise();
+  }
+
+protected:
+  void Execute() override
+  {
+    ApiScope scope(API_connect);
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    // detect, the cached device list is used unless it has no matching device
+    LIBMTP_error_number_t err = __discovery.ensureScanned();
+    vector<LIBMTP_raw_device_t> candidates = findCandidates();
+    if (candidates.empty())
+    {
+      err = refreshRawDevices();
+      candidates = findCandidates();
+    }
+    _detectMs = msSince(start);
+
+    if (candidates.empty())
+    {
+      const char *message = detectErrorMessage(err);
+      SetError(message ? message : "Device can not be find.");
+      return;
+    }
+
+    // open, devices whose serial number is already known are not opened to check it
+    chrono::steady_clock::time_point openStart = chrono::steady_clock::now();
+    for (LIBMTP_raw_device_t &rawdev : candidates)
+    {
+      if (!_options.serial.empty())
+      {
+        string known = __discovery.serial(rawdev);
+        if (!known.empty() && known != _options.serial)
+          continue;
+      }
+
+      LIBMTP_mtpdevice_t *device = openRawDevice(&rawdev, _options.cached);
+      _opened++;
+      if (!device)
+        continue;
+
+      if (_options.serial.empty() || __discovery.serial(rawdev) == _options.serial)
+      {
+        _device = device;
+        _rawdev = rawdev;
+        break;
+      }
+      mtpReleaseDevice(device);
+    }
+    _openMs = msSince(openStart);
+
+    if (!_device)
+    {
+      SetError(_options.serial.empty() ? "Unable to open raw device." : "Device can not be find by the serial number.");
+      return;
+    }
+
+    // libmtp reads the storage list while opening, a device reporting none is asked again on first use
+    if (_device->storage)
+    {
+      _storageId = _device->storage->id;
+    }
 
-  LIBMTP_raw_device_t *rawdev = &__rawdevices[0];
+    _totalMs = msSince(start);
+  }
 
-  if (vid > 0 && pid > 0)
+  void OnOK() override
   {
-    rawdev = findRawDevice(vid, pid);
+    Napi::Env env = Env();
+    __connecting = false;
+
+    if (__device)
+    {
+      mtpReleaseDevice(_device);
+      _deferred.Reject(Napi::Error::New(env, "Device already connected.").Value());
+      return;
+    }
+
+    __device = _device;
+    __storageId = _storageId;
+    __persistentIndex.clear();
+
+    Napi::Object timing = Napi::Object::New(env);
+    timing.Set("detect", _detectMs);
+    timing.Set("open", _openMs);
+    timing.Set("total", _totalMs);
+
+    string serial = __discovery.serial(_rawdev);
+
+    Napi::Object re = Napi::Object::New(env);
+    re.Set("device", rawDeviceObj(env, _rawdev));
+    re.Set("serial", serial.empty() ? env.Null() : Napi::String::New(env, serial));
+    re.Set("mode", _options.cached ? "cached" : "uncached");
+    re.Set("storage_id", _storageId);
+    re.Set("opened", _opened);
+    re.Set("timing", timing);
+    _deferred.Resolve(re);
   }
 
-  if (!rawdev)
+  void OnError(const Napi::Error &e) override
   {
-    throw Napi::Error::New(env, "Device can not be find.");
+    __connecting = false;
+    _deferred.Reject(e.Value());
   }
 
-  __device = LIBMTP_Open_Raw_Device_Uncached(rawdev);
+private:
+  vector<LIBMTP_raw_device_t> findCandidates()
+  {
+    vector<LIBMTP_raw_device_t> devices = __discovery.devices();
+    if (_options.vid == 0 || _options.pid == 0)
+      return devices;
 
-  __storageId = __device->storage->id;
+    vector<LIBMTP_raw_device_t> candidates;
+    for (const LIBMTP_raw_device_t &rawdev : devices)
+    {
+      if (rawdev.device_entry.vendor_id == _options.vid && rawdev.device_entry.product_id == _options.pid)
+        candidates.push_back(rawdev);
+    }
+    return candidates;
+  }
 
-  return Napi::Boolean::New(env, true);
-}
+  Napi::Promise::Deferred _deferred;
+  ConnectOptions _options;
+  LIBMTP_mtpdevice_t *_device = NULL;
+  LIBMTP_raw_device_t _rawdev;
+  uint32_t _storageId = 0;
+  uint32_t _opened = 0;
+  double _detectMs = 0;
+  double _openMs = 0;
+  double _totalMs = 0;
+};
 
 /**
- * release current connect device
+ * connect device with options, the session is opened on a worker thread
  *
- * @param info napi callback info
- * @return true if the operate was successful
+ * @param env napi env object
+ * @param optionsObj connect options
+ *                   mode ['uncached' | 'cached'] libmtp open mode, default 'uncached'
+ *                   serial [string] the serial number of the device to connect
+ *                   vendor_id, product_id [uint32] restrict the devices to open
+ * @return a promise of the connect result with the timing breakdown
  */
-Napi::Boolean release(const Napi::CallbackInfo &info)
+Napi::Promise connectDeviceAsync(Napi::Env env, Napi::Object optionsObj)
 {
-  Napi::Env env = info.Env();
+  ConnectOptions options;
 
-  if (!__device)
+  if (optionsObj.Has("mode"))
   {
-    throw Napi::Error::New(env, "Device not connected.");
+    string mode = optionsObj.Get("mode").As<Napi::String>().Utf8Value();
+    if (mode != "cached" && mode != "uncached")
+    {
+      throw Napi::TypeError::New(env, "Wrong connect mode");
+    }
+    options.cached = mode == "cached";
+  }
+  if (optionsObj.Has("serial") && optionsObj.Get("serial").IsString())
+  {
+    options.serial = optionsObj.Get("serial").As<Napi::String>().Utf8Value();
+  }
+  if (optionsObj.Has("vendor_id") && optionsObj.Has("product_id"))
+  {
+    options.vid = optionsObj.Get("vendor_id").As<Napi::Number>().Uint32Value();
+    options.pid = optionsObj.Get("product_id").As<Napi::Number>().Uint32Value();
+  }
+
+  if (__device)
+  {
+    throw Napi::Error::New(env, "Device already connected.");
+  }
+
+  if (__connecting)
+  {
+    throw Napi::Error::New(env, "Device is connecting.");
+  }
+
+  __connecting = true;
+  ConnectWorker *worker = new ConnectWorker(env, options);
+  worker->Queue();
+  return worker->Promise();
+}
+
+/**
+ * connect device
+ * if parameters vendor id and product id not set,the first device found will be connected
+ *
+ * if an options object is passed instead, the device is connected on a worker thread
+ * and a promise is returned, @see connectDeviceAsync()
+ *
+ * @param info napi callback info
+ *             info[0] [uint32] device vendor id, or [object] connect options
+ *             info[1] [uint32] device product id
+ * @return true if the operate was successful
+ */
+Napi::Value connectDevice(const Napi::CallbackInfo &info)
+{
+
+  Napi::Env env = info.Env();
+
+  if (info.Length() > 0 && info[0].IsObject())
+  {
+    return connectDeviceAsync(env, info[0].As<Napi::Object>());
+  }
+
+  ApiScope scope(API_connect);
+
+  if (__device)
+  {
+    throw Napi::Error::New(env, "Device already connected.");
+  }
+
+  // an async connect would take over the device once its worker finishes
+  if (__connecting)
+  {
+    throw Napi::Error::New(env, "Device is connecting.");
+  }
+
+  uint32_t vid = 0, pid = 0;
+
+  if (info.Length() > 1)
+  {
+    vid = info[0].As<Napi::Number>().Uint32Value();
+    pid = info[1].As<Napi::Number>().Uint32Value();
+  }
+
+  __discovery.ensureScanned();
+  vector<LIBMTP_raw_device_t> devices = __discovery.devices();
+  int index = findRawDevice(devices, vid, pid);
+
+  // the cached list may be stale, scan once more before giving up
+  if (index < 0)
+  {
+    checkDetectError(env, refreshRawDevices());
+    devices = __discovery.devices();
+    index = findRawDevice(devices, vid, pid);
+  }
+
+  if (index < 0)
+  {
+    throw Napi::Error::New(env, "Device can not be find.");
+  }
+
+  __device = openRawDevice(&devices[index], false);
+
+  if (!__device)
+  {
+    throw Napi::Error::New(env, "Unable to open raw device.");
+  }
+
+  __storageId = 0;
+  __persistentIndex.clear();
+  currentStorageId();
+
+  return Napi::Boolean::New(env, true);
+}
+
+/**
+ * release current connect device
+ *
+ * @param info napi callback info
+ * @return true if the operate was successful
+ */
+Napi::Boolean release(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  ApiScope scope(API_release);
+
+  if (!__device)
+  {
+    throw Napi::Error::New(env, "Device not connected.");
+  }
+
+  if (__deviceJobs > 0)
+  {
+    throw Napi::Error::New(env, "Device busy.");
   }
 
-  LIBMTP_Release_Device(__device);
+  // the event reader uses the device
+  __deviceEvents.stop();
+  __changeJournal.stop();
+  mtpReleaseDevice(__device);
   __device = NULL;
+  __storageId = 0;
+  __persistentIndex.clear();
   return Napi::Boolean::New(env, true);
 }
 
+// the slice of a background download, about a tenth of a second of usb transfer
+static const uint32_t DOWNLOAD_SLICE_SIZE = 4 * 1024 * 1024;
+
+/**
+ * helper function to read the <code>priority</code> option of a transfer
+ *
+ * @param env napi env
+ * @param options the options value, may be undefined
+ * @param priority the class to set up
+ */
+void getPriorityOption(Napi::Env env, const Napi::Value &options, Priority &priority)
+{
+  if (!options.IsObject())
+    return;
+
+  Napi::Value name = options.As<Napi::Object>().Get("priority");
+  if (name.IsUndefined() || name.IsNull())
+    return;
+
+  if (!name.IsString() || !parsePriority(name.As<Napi::String>().Utf8Value(), priority))
+    throw Napi::TypeError::New(env, "Unsupported priority.");
+}
+
+/**
+ * helper function to read the <code>rateLimit</code> option of a transfer
+ *
+ * a number is a limit of the transfer alone in bytes per second, a string
+ * the name of a limit shared with the other transfers given it, @see setRateLimit
+ *
+ * @param env napi env
+ * @param options the options value, may be undefined
+ * @return the bucket of the transfer, empty if none
+ */
+shared_ptr<TokenBucket> getRateOption(Napi::Env env, const Napi::Value &options)
+{
+  if (!options.IsObject())
+    return shared_ptr<TokenBucket>();
+
+  Napi::Value limit = options.As<Napi::Object>().Get("rateLimit");
+  if (limit.IsUndefined() || limit.IsNull())
+    return shared_ptr<TokenBucket>();
+
+  if (limit.IsNumber() && limit.As<Napi::Number>().DoubleValue() >= 0)
+    return make_shared<TokenBucket>((uint64_t)limit.As<Napi::Number>().DoubleValue());
+  if (limit.IsString())
+    return namedRateLimit(limit.As<Napi::String>().Utf8Value());
+
+  throw Napi::TypeError::New(env, "Wrong arguments");
+}
+
+/**
+ * state of a background download shared with the main thread, deleted when the promise is settled
+ */
+struct DownloadJob
+{
+  Napi::Promise::Deferred deferred;
+  unique_ptr<StreamHash> hash;
+  uint64_t size;
+  string error;
+  // a progress event is queued and not yet delivered, later ones are dropped meanwhile
+  atomic<bool> pending;
+};
+
+struct DownloadProgressEvent
+{
+  DownloadJob *job;
+  uint64_t sent;
+  uint64_t total;
+};
+
+/**
+ * async worker downloading a file off the main thread
+ *
+ * the file is read in slices with the priority class of the job, so the
+ * listings of the main thread get the device between two slices. progress
+ * events are delivered to the callback as fast as the main thread takes
+ * them, the ones arriving while one is still queued are dropped.
+ */
+class DownloadWorker : public Napi::AsyncWorker
+{
+public:
+  DownloadWorker(Napi::Env env, Napi::Function callback, const string &source, const string &target,
+                 unique_ptr<StreamHash> hash, const FileWriterOptions &writerOptions, Priority priority,
+                 uint32_t sliceSize, const shared_ptr<TokenBucket> &rateLimit)
+      : Napi::AsyncWorker(env), _device(__device), _storage(currentStorageId()), _source(source), _target(target),
+        _writerOptions(writerOptions), _priority(priority), _sliceSize(sliceSize), _rateLimit(rateLimit),
+        _job(new DownloadJob{Napi::Promise::Deferred::New(env), move(hash), 0, "", {false}})
+  {
+    _callback = Napi::ThreadSafeFunction::New(env, callback, "luck-node-mtp download", 0, 1, _job,
+                                              [](Napi::Env env, DownloadJob *job) {
+                                                if (!job->error.empty())
+                                                  job->deferred.Reject(Napi::Error::New(env, job->error).Value());
+                                                else if (!job->hash->empty())
+                                                  job->deferred.Resolve(hashResult(env, job->size, *job->hash));
+                                                else
+                                                  job->deferred.Resolve(Napi::Boolean::New(env, true));
+                                                delete job;
+                                              });
+    __deviceJobs++;
+  }
+
+  Napi::Promise Promise()
+  {
+    return _job->deferred.Promise();
+  }
+
+protected:
+  void Execute() override
+  {
+    PriorityScope priority(_priority);
+    RateScope rate(_rateLimit);
+    ApiScope scope(API_download);
+
+    PathIndex index(_device, _storage);
+    const LIBMTP_file_t *file = index.find(_source);
+    if (!file || file->filetype == LIBMTP_FILETYPE_FOLDER)
+    {
+      SetError("Can not find the source file.");
+      return;
+    }
+
+    _job->size = file->filesize;
+    if (downloadToFile(_device, file->item_id, _target.c_str(), file->filesize, *_job->hash, _writerOptions,
+                       _sliceSize, progressEvent, this) != 0)
+    {
+      SetError("Error getting file from MTP device.");
+    }
+  }
+
+  void OnOK() override
+  {
+    __deviceJobs--;
+    _callback.Release();
+  }
+
+  void OnError(const Napi::Error &e) override
+  {
+    __deviceJobs--;
+    _job->error = e.Message();
+    _callback.Release();
+  }
+
+private:
+  /**
+   * libmtp progress callback of the worker thread, queues an event to the main thread
+   */
+  static int progressEvent(const uint64_t sent, const uint64_t total, void const *const data)
+  {
+    DownloadWorker *worker = (DownloadWorker *)data;
+    DownloadJob *job = worker->_job;
+    if (job->pending.exchange(true))
+      return 0;
+
+    DownloadProgressEvent *event = new DownloadProgressEvent{job, sent, total};
+    napi_status status = worker->_callback.NonBlockingCall(event, [](Napi::Env env, Napi::Function jsCallback, DownloadProgressEvent *event) {
+      event->job->pending = false;
+      jsCallback.Call({Napi::Number::New(env, event->sent), Napi::Number::New(env, event->total)});
+      delete event;
+    });
+    if (status != napi_ok)
+    {
+      job->pending = false;
+      delete event;
+    }
+    return 0;
+  }
+
+  LIBMTP_mtpdevice_t *_device;
+  uint32_t _storage;
+  string _source;
+  string _target;
+  FileWriterOptions _writerOptions;
+  Priority _priority;
+  uint32_t _sliceSize;
+  shared_ptr<TokenBucket> _rateLimit;
+  DownloadJob *_job;
+  Napi::ThreadSafeFunction _callback;
+};
+
 /**
  * download file from device
  *
@@ -378,9 +1234,18 @@ Napi::Boolean release(const Napi::CallbackInfo &info)
                info[1] [string] the local file path save to
                info[2] [function] the progress callback function
                @see progress()
- * @return true if the operate was successful
+               info[3] [object] options, may be passed as info[2] without a progress callback
+                 hash [string|array] checksums computed while the data is transferred, sha256, xxh3 or crc32c
+                 fsync [string|number] 'none' (default), 'end', or the number of bytes between syncs
+                 async [boolean] download in a background job, a promise is returned
+                 priority [string] 'interactive', 'normal' (default) or 'bulk', the class of the device calls
+                 sliceSize [number] the bytes read per device call, 0 for a single call,
+                   4MB by default for a background download and 0 otherwise
+                 rateLimit [number|string] bytes per second, or the name of a shared limit, @see setRateLimit
+ * @return true if the operate was successful, { size, hash } when checksums were requested,
+ *         a promise of it with async
  */
-Napi::Boolean download(const Napi::CallbackInfo &info)
+Napi::Value download(const Napi::CallbackInfo &info)
 {
   Napi::Env env = info.Env();
 
@@ -389,11 +1254,31 @@ Napi::Boolean download(const Napi::CallbackInfo &info)
     throw Napi::Error::New(env, "Wrong number of arguments");
   }
 
-  if (!info[0].IsString() || !info[1].IsString() || (info.Length() >= 3 && !info[2].IsFunction()))
+  if (!info[0].IsString() || !info[1].IsString() || !validTransferArguments(info))
   {
     throw Napi::TypeError::New(env, "Wrong arguments");
   }
 
+  Napi::Value options = transferOptions(info);
+  unique_ptr<StreamHash> hash(new StreamHash());
+  getHashOption(env, options, *hash);
+  FileWriterOptions writerOptions;
+  getFsyncOption(env, options, writerOptions);
+  Priority priorityClass = PRIORITY_NORMAL;
+  getPriorityOption(env, options, priorityClass);
+  shared_ptr<TokenBucket> rateLimit = getRateOption(env, options);
+  bool async = getBoolOption(options, "async", false);
+  uint32_t sliceSize = async ? DOWNLOAD_SLICE_SIZE : 0;
+  if (options.IsObject() && options.As<Napi::Object>().Has("sliceSize"))
+  {
+    Napi::Value slice = options.As<Napi::Object>().Get("sliceSize");
+    if (!slice.IsNumber())
+    {
+      throw Napi::TypeError::New(env, "Wrong arguments");
+    }
+    sliceSize = slice.As<Napi::Number>().Uint32Value();
+  }
+
   string sourceFilePath = info[0].As<Napi::String>().Utf8Value();
   string targetFilePath = info[1].As<Napi::String>().Utf8Value();
 
@@ -403,6 +1288,21 @@ Napi::Boolean download(const Napi::CallbackInfo &info)
   {
     throw Napi::Error::New(env, "Device not connected.");
   }
+
+  if (async)
+  {
+    Napi::Function callback = info.Length() >= 3 && info[2].IsFunction()
+                                  ? info[2].As<Napi::Function>()
+                                  : Napi::Function::New(env, [](const Napi::CallbackInfo &) {});
+    DownloadWorker *worker = new DownloadWorker(env, callback, sourceFilePath, targetFilePath, move(hash),
+                                                writerOptions, priorityClass, sliceSize, rateLimit);
+    worker->Queue();
+    return worker->Promise();
+  }
+
+  ApiScope scope(API_download);
+  PriorityScope priority(priorityClass);
+  RateScope rate(rateLimit);
   // int fileId = findFile(device, "data/com.ahyungui.android/db/upload.zip");
   LIBMTP_file_t *file = findFile(__device, sourceFilePath);
 
@@ -411,14 +1311,46 @@ Napi::Boolean download(const Napi::CallbackInfo &info)
     throw Napi::Error::New(env, "Can not find the source file.");
   }
 
-  if (LIBMTP_Get_File_To_File(__device, file->item_id, targetFilePath.c_str(), progress, &info) != 0)
+  if (downloadToFile(__device, file->item_id, targetFilePath.c_str(), file->filesize, *hash, writerOptions,
+                     sliceSize, progress, &info) != 0)
   {
     throw Napi::Error::New(env, "Error getting file from MTP device.");
   }
 
+  if (!hash->empty())
+  {
+    return hashResult(env, file->filesize, *hash);
+  }
+
   return Napi::Boolean::New(env, true);
 }
 
+/**
+ * helper function to build the result of an upload with <code>ifChanged</code> or <code>delta</code>
+ *
+ * @param env napi env
+ * @param uploaded false if the upload was skipped
+ * @param delta true if the device file was updated in place
+ * @param id the object id of the device file
+ * @param size the size of the file
+ * @param avoided the number of bytes not sent
+ * @param sampled the number of bytes read from the device to compare
+ * @param hash the checksums of the transfer, not set when empty
+ * @return { uploaded, delta, id, size, bytesAvoided, sampled, hash }
+ */
+Napi::Object uploadResult(Napi::Env env, bool uploaded, bool delta, uint32_t id, uint64_t size, uint64_t avoided,
+                          uint64_t sampled, StreamHash &hash)
+{
+  Napi::Object result = hash.empty() || !uploaded ? Napi::Object::New(env) : hashResult(env, size, hash);
+  result.Set("uploaded", uploaded);
+  result.Set("delta", delta);
+  result.Set("id", id);
+  result.Set("size", (double)size);
+  result.Set("bytesAvoided", (double)avoided);
+  result.Set("sampled", (double)sampled);
+  return result;
+}
+
 /**
  * upload file to device
  *
@@ -427,22 +1359,36 @@ Napi::Boolean download(const Napi::CallbackInfo &info)
                info[1] [string] the device folder path where to upload. May be an empty string if uploading to the root of the storage.
                info[2] [function] the progress callback function
                @see progress()
- * @return true if the operate was successful
+               info[3] [object] options, may be passed as info[2] without a progress callback
+                 hash [string|array] checksums computed while the data is transferred, sha256, xxh3 or crc32c
+                 ifChanged [boolean] skip the upload when the target folder has an identical file of the same name,
+                   replace it when it differs
+                 delta [boolean] update a file of the same name in place, only the blocks that differ are sent
+                 rateLimit [number|string] bytes per second, or the name of a shared limit, @see setRateLimit
+ * @return true if the operate was successful, { size, hash } when checksums were requested,
+ *         { uploaded, delta, id, size, bytesAvoided, sampled, hash } with ifChanged or delta
  */
-Napi::Boolean upload(const Napi::CallbackInfo &info)
+Napi::Value upload(const Napi::CallbackInfo &info)
 {
   Napi::Env env = info.Env();
+  ApiScope scope(API_upload);
 
   if (info.Length() < 2)
   {
     throw Napi::Error::New(env, "Wrong number of arguments");
   }
 
-  if (!info[0].IsString() || !info[1].IsString() || (info.Length() >= 3 && !info[2].IsFunction()))
+  if (!info[0].IsString() || !info[1].IsString() || !validTransferArguments(info))
   {
     throw Napi::TypeError::New(env, "Wrong arguments");
   }
 
+  StreamHash hash;
+  getHashOption(env, transferOptions(info), hash);
+  bool ifChanged = getBoolOption(transferOptions(info), "ifChanged", false);
+  bool delta = getBoolOption(transferOptions(info), "delta", false);
+  RateScope rate(getRateOption(env, transferOptions(info)));
+
   string sourceFilePath = info[0].As<Napi::String>().Utf8Value();
   string targetFolderPath = info[1].As<Napi::String>().Utf8Value();
 
@@ -474,160 +1420,410 @@ Napi::Boolean upload(const Napi::CallbackInfo &info)
     throw Napi::Error::New(env, "Can not find the target parent folder id.");
   }
 
+  // the file of the same name already in the target folder
+  LIBMTP_file_t *existing = NULL;
+  uint64_t sampled = 0;
+  if (ifChanged || delta)
+  {
+    existing = doFindFile(__device, filename, parent);
+    if (existing && existing->filetype == LIBMTP_FILETYPE_FOLDER)
+    {
+      LIBMTP_destroy_file_t(existing);
+      existing = NULL;
+    }
+
+    // the same size and modification date are taken as the same file, otherwise
+    // a few sampled ranges decide, a device without partial reads gets the upload
+    if (ifChanged && existing && existing->filesize == filesize &&
+        (existing->modificationdate == sb.st_mtime ||
+         sampleCompare(__device, existing->item_id, sourceFilePath.c_str(), filesize, sampled) == SAMPLE_IDENTICAL))
+    {
+      Napi::Object result = uploadResult(env, false, false, existing->item_id, filesize, filesize, sampled, hash);
+      LIBMTP_destroy_file_t(existing);
+      return result;
+    }
+  }
+
+  // a device that can not edit files in place gets a full upload
+  if (delta && existing)
+  {
+    DeltaResult changes;
+    int ret = deltaUpload(__device, existing->item_id, existing->filesize, sourceFilePath.c_str(), filesize,
+                          hash, progress, &info, changes);
+    if (ret == 0)
+    {
+      Napi::Object result = uploadResult(env, true, true, existing->item_id, filesize, filesize - changes.sent,
+                                         sampled + changes.read, hash);
+      LIBMTP_destroy_file_t(existing);
+      return result;
+    }
+    if (ret < 0)
+    {
+      LIBMTP_destroy_file_t(existing);
+      throw Napi::Error::New(env, "Error updating the file on the MTP device.");
+    }
+  }
+
   genfile = LIBMTP_new_file_t();
   genfile->filesize = filesize;
   genfile->filename = strdup(filename.c_str());
   genfile->filetype = find_filetype(strdup(filename.c_str()));
   // If the user provided path is an empty string then upload to the root of this storage.
-  genfile->parent_id = targetFolderPath == "" ? __storageId : parent->item_id;
-  genfile->storage_id = __storageId;
+  genfile->parent_id = targetFolderPath == "" ? currentStorageId() : parent->item_id;
+  genfile->storage_id = currentStorageId();
 
-  if (LIBMTP_Send_File_From_File(__device, sourceFilePath.c_str(), genfile, progress, &info) != 0)
+  // through the data handler, where the rate limits are applied, rather than LIBMTP_Send_File_From_File
+  int ret = uploadFromFile(__device, sourceFilePath.c_str(), genfile, hash, progress, &info);
+  uint32_t uploadedId = genfile->item_id;
+  LIBMTP_destroy_file_t(genfile);
+  if (ret != 0)
   {
-    LIBMTP_destroy_file_t(genfile);
+    if (existing)
+      LIBMTP_destroy_file_t(existing);
     throw Napi::Error::New(env, "Error upload file to MTP device.");
   }
 
-  LIBMTP_destroy_file_t(genfile);
+  // the stale copy is only removed once the new one is on the device
+  if (existing)
+  {
+    ret = mtpDeleteObject(__device, existing->item_id);
+    LIBMTP_destroy_file_t(existing);
+    if (ret != 0)
+      throw Napi::Error::New(env, "Error deleting the previous file.");
+  }
+
+  if (ifChanged || delta)
+  {
+    return uploadResult(env, true, false, uploadedId, filesize, 0, sampled, hash);
+  }
+
+  if (!hash.empty())
+  {
+    return hashResult(env, filesize, hash);
+  }
 
   return Napi::Boolean::New(env, true);
 }
 
 /**
- * This function deletes a single file, track, playlist, folder or
- * any other object off the MTP device, identified by the object ID.
+ * helper function to lend a pooled slab to javascript, the finalizer gives it back to the pool
  *
- * If you delete a folder, there is no guarantee that the device will
- * really delete all the files that were in that folder, rather it is
- * expected that they will not be deleted, and will turn up in object
- * listings with parent set to a non-existant object ID. The safe way
- * to do this is to recursively delete all files (and folders) contained
- * in the folder, then the folder itself.
+ * @param env napi env
+ * @param slab a slab from poolAcquire()
+ * @param length the number of bytes of the slab used
+ * @return a Buffer over the slab memory
+ */
+Napi::Buffer<unsigned char> lendSlab(Napi::Env env, unsigned char *slab, size_t length)
+{
+  return Napi::Buffer<unsigned char>::New(env, slab, length, [](Napi::Env, unsigned char *data) {
+    poolRelease(data);
+  });
+}
+
+/**
+ * archive output calling the <code>write</code> method of a node writable stream
  *
- * @param info napi callback info
-               info[0] [string] the file or folder path to be delete
- * @return true if the operate was successful
+ * the data is handed over in pooled slabs lent to javascript, without copying
+ * them again. a javascript exception thrown by <code>write</code> is kept and
+ * thrown again once libmtp has returned
  */
-Napi::Boolean del(const Napi::CallbackInfo &info)
+class StreamOutput : public ArchiveOutput
 {
-  Napi::Env env = info.Env();
+public:
+  explicit StreamOutput(Napi::Object stream)
+      : _stream(stream), _write(stream.Get("write").As<Napi::Function>()), _slab(NULL), _used(0) {}
 
-  if (info.Length() < 1)
+  ~StreamOutput()
   {
-    throw Napi::Error::New(env, "Wrong number of arguments");
+    poolRelease(_slab);
   }
 
-  if (!info[0].IsString())
+  bool close() override { return flush(); }
+
+  /**
+   * throw the exception of a failed write, if any
+   */
+  void rethrow()
   {
-    throw Napi::TypeError::New(env, "Wrong arguments");
+    if (!_error.IsEmpty())
+      throw _error;
   }
 
-  string targetPath = info[0].As<Napi::String>().Utf8Value();
+protected:
+  bool put(const unsigned char *data, size_t length) override
+  {
+    while (length > 0)
+    {
+      if (!_slab && !(_slab = poolAcquire()))
+        return false;
 
-  targetPath = formatMtpPath(targetPath);
+      size_t take = min(length, POOL_SLAB_SIZE - _used);
+      memcpy(_slab + _used, data, take);
+      _used += take;
+      data += take;
+      length -= take;
 
-  if (!__device)
+      if (_used == POOL_SLAB_SIZE && !flush())
+        return false;
+    }
+    return true;
+  }
+
+private:
+  bool flush()
   {
-    throw Napi::Error::New(env, "Device not connected.");
+    if (!_error.IsEmpty())
+      return false;
+    if (!_slab)
+      return true;
+
+    Napi::Env env = _stream.Env();
+    Napi::Buffer<unsigned char> chunk = lendSlab(env, _slab, _used);
+    _slab = NULL;
+    _used = 0;
+    try
+    {
+      _write.Call(_stream, {chunk});
+    }
+    catch (const Napi::Error &e)
+    {
+      _error = e;
+      return false;
+    }
+    return true;
   }
 
-  LIBMTP_file_t *file = findFile(__device, targetPath);
+  Napi::Object _stream;
+  Napi::Function _write;
+  Napi::Error _error;
+  unsigned char *_slab;
+  size_t _used;
+};
 
-  if (!file)
+/**
+ * helper function to guess the archive format and compression from a file name
+ */
+void archiveFormatFromPath(const string &path, string &format, string &compression)
+{
+  auto endsWith = [&path](const char *suffix) {
+    size_t length = strlen(suffix);
+    return path.length() >= length && path.compare(path.length() - length, length, suffix) == 0;
+  };
+
+  if (endsWith(".zip"))
   {
-    throw Napi::Error::New(env, "Can not find the target object.");
+    format = "zip";
   }
-
-  if (LIBMTP_Delete_Object(__device, file->item_id) != 0)
+  else if (endsWith(".tar.gz") || endsWith(".tgz"))
   {
-    throw Napi::Error::New(env, "Error to delete target object.");
+    format = "tar";
+    compression = "gzip";
   }
-
-  return Napi::Boolean::New(env, true);
 }
 
 /**
- * get object list by a mtp device parent path
+ * download a device folder into a single tar or zip archive
+ *
+ * the files are streamed into the archive as they are read from the device,
+ * no intermediate file is created. modification times are kept.
  *
  * @param info napi callback info
-               info[0] [string] parent folder path,the root can be use character / to express
- * @return return all file and folder object list in the parent folder
+               info[0] [string] the device folder path, an empty string for the root of the storage
+               info[1] [string|stream] the local archive path, or a writable stream the archive is written to
+               info[2] [function] the progress callback function, called with the bytes of all the files
+               @see progress()
+               info[3] [object] options, may be passed as info[2] without a progress callback
+                 format [string] tar or zip, guessed from the archive path, tar by default
+                 compression [string] none, gzip for tar or deflate for zip
+                 level [number] compression level from 1 to 9
+ * @return { files, folders, bytes, size }, bytes is the size of the files and size the size of the archive
  */
-Napi::Array getList(const Napi::CallbackInfo &info)
+Napi::Object downloadArchive(const Napi::CallbackInfo &info)
 {
-
   Napi::Env env = info.Env();
+  ApiScope scope(API_downloadArchive);
 
-  if (info.Length() < 1)
+  if (info.Length() < 2)
   {
     throw Napi::Error::New(env, "Wrong number of arguments");
   }
 
-  if (!info[0].IsString())
+  bool toStream = info[1].IsObject() && info[1].As<Napi::Object>().Get("write").IsFunction();
+  if (!info[0].IsString() || (!info[1].IsString() && !toStream) || !validTransferArguments(info))
   {
     throw Napi::TypeError::New(env, "Wrong arguments");
   }
 
-  string parentPath = info[0].As<Napi::String>().Utf8Value();
+  string sourceFolderPath = formatMtpPath(info[0].As<Napi::String>().Utf8Value());
+  string targetFilePath = toStream ? "" : info[1].As<Napi::String>().Utf8Value();
 
-  parentPath = formatMtpPath(parentPath);
+  string format = "tar";
+  string compression = "none";
+  int level = -1;
+  archiveFormatFromPath(targetFilePath, format, compression);
+
+  Napi::Value options = transferOptions(info);
+  if (options.IsObject())
+  {
+    Napi::Object optionsObj = options.As<Napi::Object>();
+    if (optionsObj.Get("format").IsString())
+      format = optionsObj.Get("format").As<Napi::String>().Utf8Value();
+    if (optionsObj.Get("compression").IsString())
+      compression = optionsObj.Get("compression").As<Napi::String>().Utf8Value();
+    if (optionsObj.Get("level").IsNumber())
+      level = optionsObj.Get("level").As<Napi::Number>().Int32Value();
+  }
+  RateScope rate(getRateOption(env, options));
 
   if (!__device)
   {
     throw Napi::Error::New(env, "Device not connected.");
   }
 
-  int parentId = LIBMTP_FILES_AND_FOLDERS_ROOT;
-
-  if (parentPath.length() > 0)
+  uint32_t folderId = LIBMTP_FILES_AND_FOLDERS_ROOT;
+  if (sourceFolderPath != "")
   {
-    LIBMTP_file_t *parent = findFile(__device, parentPath);
-
-    if (!parent)
+    LIBMTP_file_t *folder = findFile(__device, sourceFolderPath);
+    if (!folder || folder->filetype != LIBMTP_FILETYPE_FOLDER)
     {
-      throw Napi::Error::New(env, "Can not find the parent object.");
+      throw Napi::Error::New(env, "Can not find the source folder.");
     }
+    folderId = folder->item_id;
+    LIBMTP_destroy_file_t(folder);
+  }
 
-    parentId = parent->item_id;
+  FileOutput fileOutput;
+  unique_ptr<StreamOutput> streamOutput;
+  ArchiveOutput *output = &fileOutput;
+  if (toStream)
+  {
+    streamOutput.reset(new StreamOutput(info[1].As<Napi::Object>()));
+    output = streamOutput.get();
   }
 
-  LIBMTP_file_t *files;
+  unique_ptr<ArchiveWriter> writer(newArchiveWriter(format, compression, level, output));
+  if (!writer)
+  {
+    throw Napi::TypeError::New(env, "Unsupported archive format or compression.");
+  }
 
-  files = LIBMTP_Get_Files_And_Folders(__device,
-                                       __storageId,
-                                       parentId);
+  vector<TreeEntry> entries;
+  listTree(__device, currentStorageId(), folderId, entries);
 
-  LIBMTP_file_t *file, *tmp;
-  file = files;
+  if (!toStream && !fileOutput.open(targetFilePath))
+  {
+    throw Napi::Error::New(env, "Error to create the archive file.");
+  }
 
-  vector<Napi::Object> fileArr;
-  while (file != NULL)
+  if (downloadToArchive(__device, entries, *writer, progress, &info) != 0)
   {
-    Napi::Object fileObj = Napi::Object::New(env);
-    initFileObj(file, fileObj);
-    fileArr.push_back(fileObj);
-    tmp = file;
-    file = file->next;
-    LIBMTP_destroy_file_t(tmp);
+    if (toStream)
+    {
+      streamOutput->rethrow();
+    }
+    else
+    {
+      fileOutput.close();
+      remove(targetFilePath.c_str());
+    }
+    throw Napi::Error::New(env, "Error getting folder from MTP device.");
   }
 
-  Napi::Array re = Napi::Array::New(env, fileArr.size());
-  for (string::size_type i = 0; i < fileArr.size(); i++)
+  uint32_t files = 0;
+  uint64_t bytes = 0;
+  for (const TreeEntry &entry : entries)
   {
-    re[i] = fileArr[i];
+    files += entry.folder ? 0 : 1;
+    bytes += entry.size;
   }
+
+  Napi::Object re = Napi::Object::New(env);
+  re.Set("files", files);
+  re.Set("folders", (uint32_t)entries.size() - files);
+  re.Set("bytes", (double)bytes);
+  re.Set("size", (double)output->size());
   return re;
 }
 
 /**
- * get object from mtp device
+ * upload the content of a local tar, tar.gz or zip archive into a device folder
+ *
+ * the entries are read one after the other and streamed from the decompressor
+ * into the device, the archive is never extracted to disk
+ *
  * @param info napi callback info
-               info[0] [string] a file path in device
- * @return return file object find by the path
+               info[0] [string] the local archive path
+               info[1] [string] the device folder path where to upload. May be an empty string if uploading to the root of the storage.
+               info[2] [function] the progress callback function, called with the part of the archive read
+               @see progress()
+ * @return { files, folders, bytes }, the number of files uploaded, folders created and bytes uploaded
  */
-Napi::Object getObject(const Napi::CallbackInfo &info)
+Napi::Object uploadArchive(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  ApiScope scope(API_uploadArchive);
+
+  if (info.Length() < 2)
+  {
+    throw Napi::Error::New(env, "Wrong number of arguments");
+  }
+
+  if (!info[0].IsString() || !info[1].IsString() || (info.Length() >= 3 && !info[2].IsFunction()))
+  {
+    throw Napi::TypeError::New(env, "Wrong arguments");
+  }
+
+  string sourceFilePath = info[0].As<Napi::String>().Utf8Value();
+  string targetFolderPath = formatMtpPath(info[1].As<Napi::String>().Utf8Value());
+
+  if (!__device)
+  {
+    throw Napi::Error::New(env, "Device not connected.");
+  }
+
+  uint64_t archiveSize = 0;
+  unique_ptr<ArchiveReader> reader(openArchiveReader(sourceFilePath, archiveSize));
+  if (!reader)
+  {
+    throw Napi::Error::New(env, "Can not read the archive, it must be a tar, tar.gz or zip file.");
+  }
+
+  uint32_t folderId = LIBMTP_FILES_AND_FOLDERS_ROOT;
+  if (targetFolderPath != "")
+  {
+    LIBMTP_file_t *parent = findFile(__device, targetFolderPath);
+    if (!parent || parent->filetype != LIBMTP_FILETYPE_FOLDER)
+    {
+      throw Napi::Error::New(env, "Can not find the target parent folder id.");
+    }
+    folderId = parent->item_id;
+    LIBMTP_destroy_file_t(parent);
+  }
+
+  ArchiveUploadResult result;
+  if (uploadFromArchive(__device, currentStorageId(), folderId, *reader, archiveSize, progress, &info, result) != 0)
+  {
+    throw Napi::Error::New(env, reader->failed() ? "Error reading the archive." : "Error upload file to MTP device.");
+  }
+
+  Napi::Object re = Napi::Object::New(env);
+  re.Set("files", result.files);
+  re.Set("folders", result.folders);
+  re.Set("bytes", (double)result.bytes);
+  return re;
+}
+
+/**
+ * read a file of the device into memory, for small files there is no need to go through a local file
+ *
+ * @param info napi callback info
+               info[0] [string] the file path to be read
+ * @return [Buffer] the file content
+ */
+Napi::Buffer<unsigned char> readFile(const Napi::CallbackInfo &info)
 {
   Napi::Env env = info.Env();
+  ApiScope scope(API_readFile);
 
   if (info.Length() < 1)
   {
@@ -639,153 +1835,1630 @@ Napi::Object getObject(const Napi::CallbackInfo &info)
     throw Napi::TypeError::New(env, "Wrong arguments");
   }
 
-  string targetPath = info[0].As<Napi::String>().Utf8Value();
+  string sourceFilePath = formatMtpPath(info[0].As<Napi::String>().Utf8Value());
 
-  targetPath = formatMtpPath(targetPath);
+  if (!__device)
+  {
+    throw Napi::Error::New(env, "Device not connected.");
+  }
+
+  LIBMTP_file_t *file = findFile(__device, sourceFilePath);
+
+  if (!file || file->filetype == LIBMTP_FILETYPE_FOLDER)
+  {
+    throw Napi::Error::New(env, "Can not find the source file.");
+  }
+
+  uint32_t id = file->item_id;
+  uint64_t filesize = file->filesize;
+  LIBMTP_destroy_file_t(file);
+
+  vector<unsigned char> overflow;
+  uint64_t received = 0;
+
+  // small files go into a pooled slab, lent to javascript only when the file
+  // fills most of it, smaller ones are copied out so the slab goes back at once
+  unsigned char *slab = filesize > 0 && filesize <= POOL_SLAB_SIZE ? poolAcquire() : NULL;
+  if (slab)
+  {
+    if (downloadToMemory(__device, id, slab, POOL_SLAB_SIZE, overflow, received) != 0)
+    {
+      poolRelease(slab);
+      throw Napi::Error::New(env, "Error getting file from MTP device.");
+    }
+    if (overflow.empty() && received > POOL_SLAB_SIZE / 2)
+    {
+      return lendSlab(env, slab, received);
+    }
+    if (overflow.empty())
+    {
+      Napi::Buffer<unsigned char> copy = Napi::Buffer<unsigned char>::Copy(env, slab, received);
+      poolRelease(slab);
+      return copy;
+    }
+    Napi::Buffer<unsigned char> grown = Napi::Buffer<unsigned char>::New(env, received);
+    memcpy(grown.Data(), slab, POOL_SLAB_SIZE);
+    memcpy(grown.Data() + POOL_SLAB_SIZE, overflow.data(), overflow.size());
+    poolRelease(slab);
+    return grown;
+  }
+
+  // the device reports the size, the data is written straight into the returned buffer
+  Napi::Buffer<unsigned char> buffer = Napi::Buffer<unsigned char>::New(env, filesize);
+  if (downloadToMemory(__device, id, buffer.Data(), filesize, overflow, received) != 0)
+  {
+    throw Napi::Error::New(env, "Error getting file from MTP device.");
+  }
+
+  // the file changed size since it was listed
+  if (received < filesize)
+  {
+    return Napi::Buffer<unsigned char>::Copy(env, buffer.Data(), received);
+  }
+  if (!overflow.empty())
+  {
+    Napi::Buffer<unsigned char> grown = Napi::Buffer<unsigned char>::New(env, received);
+    memcpy(grown.Data(), buffer.Data(), filesize);
+    memcpy(grown.Data() + filesize, overflow.data(), overflow.size());
+    return grown;
+  }
+
+  return buffer;
+}
+
+/**
+ * write a file to the device from memory
+ *
+ * @param info napi callback info
+               info[0] [string] the device folder path where to write. May be an empty string for the root of the storage.
+               info[1] [string] the file name
+               info[2] [Buffer] the file content, sent without an intermediate copy
+ * @return the object id of the new file
+ */
+Napi::Number writeFile(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  ApiScope scope(API_writeFile);
+
+  if (info.Length() < 3)
+  {
+    throw Napi::Error::New(env, "Wrong number of arguments");
+  }
+
+  if (!info[0].IsString() || !info[1].IsString() || !info[2].IsBuffer())
+  {
+    throw Napi::TypeError::New(env, "Wrong arguments");
+  }
+
+  string targetFolderPath = formatMtpPath(info[0].As<Napi::String>().Utf8Value());
+  string filename = info[1].As<Napi::String>().Utf8Value();
+  Napi::Buffer<unsigned char> buffer = info[2].As<Napi::Buffer<unsigned char>>();
 
   if (!__device)
   {
     throw Napi::Error::New(env, "Device not connected.");
   }
 
-  LIBMTP_file_t *file = findFile(__device, targetPath);
+  uint32_t parentId = currentStorageId();
+  if (targetFolderPath != "")
+  {
+    LIBMTP_file_t *parent = findFile(__device, targetFolderPath);
+    if (!parent || parent->filetype != LIBMTP_FILETYPE_FOLDER)
+    {
+      throw Napi::Error::New(env, "Can not find the target parent folder id.");
+    }
+    parentId = parent->item_id;
+    LIBMTP_destroy_file_t(parent);
+  }
 
-  if (!file)
+  LIBMTP_file_t *genfile = LIBMTP_new_file_t();
+  genfile->filename = strdup(filename.c_str());
+  genfile->filetype = find_filetype(filename.c_str());
+  genfile->parent_id = parentId;
+  genfile->storage_id = currentStorageId();
+
+  if (uploadFromMemory(__device, buffer.Data(), buffer.Length(), genfile) != 0)
   {
-    throw Napi::Error::New(env, "Can not find the target object.");
+    LIBMTP_destroy_file_t(genfile);
+    throw Napi::Error::New(env, "Error upload file to MTP device.");
   }
-  Napi::Object fileObj = Napi::Object::New(env);
-  initFileObj(file, fileObj);
-  return fileObj;
+
+  uint32_t id = genfile->item_id;
+  LIBMTP_destroy_file_t(genfile);
+  return Napi::Number::New(env, id);
 }
 
 /**
- * The function copies an object from one location on a device to another
- * location.
+ * the state of a thumbnail job shared by its worker and its thread safe
+ * function, which settles the promise once the last thumbnail was delivered
+ */
+struct ThumbnailJob
+{
+  explicit ThumbnailJob(const Napi::Promise::Deferred &deferred) : deferred(deferred) {}
+
+  Napi::Promise::Deferred deferred;
+  vector<Thumbnail> results;
+  string error;
+};
+
+/**
+ * a thumbnail handed to the javascript callback
+ */
+struct ThumbnailEvent
+{
+  uint32_t index;
+  Thumbnail thumbnail;
+};
+
+/**
+ * helper function to convert a thumbnail, null if the object has none
+ */
+Napi::Value thumbnailValue(Napi::Env env, const Thumbnail &thumbnail)
+{
+  if (!thumbnail || thumbnail->empty())
+    return env.Null();
+  return Napi::Buffer<unsigned char>::Copy(env, thumbnail->data(), thumbnail->size());
+}
+
+/**
+ * async worker fetching the thumbnails of a batch of objects off the main thread
  *
- * The semantics of copying a folder are not defined in the spec, but it
- * appears to do the right thing when tested (but devices that implement
- * this operation are rare).
+ * each thumbnail is taken from the cache or fetched from the device, then
+ * handed to the callback right away, so a gallery fills in while the rest
+ * of the batch is fetched
+ */
+class ThumbnailWorker : public Napi::AsyncWorker
+{
+public:
+  /**
+   * @param ids the object ids, used where the path is empty
+   * @param paths the formatted paths
+   */
+  ThumbnailWorker(Napi::Env env, Napi::Function callback, const vector<uint32_t> &ids,
+                  const vector<string> &paths, const string &directory)
+      : Napi::AsyncWorker(env), _device(__device), _storage(currentStorageId()), _ids(ids), _paths(paths),
+        _directory(directory), _job(new ThumbnailJob(Napi::Promise::Deferred::New(env)))
+  {
+    _job->results.resize(ids.size());
+    _callback = Napi::ThreadSafeFunction::New(env, callback, "luck-node-mtp thumbnails", 0, 1, _job,
+                                              [](Napi::Env env, ThumbnailJob *job) {
+                                                if (job->error.empty())
+                                                {
+                                                  Napi::Array re = Napi::Array::New(env, job->results.size());
+                                                  for (uint32_t i = 0; i < job->results.size(); i++)
+                                                    re[i] = thumbnailValue(env, job->results[i]);
+                                                  job->deferred.Resolve(re);
+                                                }
+                                                else
+                                                {
+                                                  job->deferred.Reject(Napi::Error::New(env, job->error).Value());
+                                                }
+                                                delete job;
+                                              });
+    __deviceJobs++;
+  }
+
+  Napi::Promise Promise()
+  {
+    return _job->deferred.Promise();
+  }
+
+protected:
+  void Execute() override
+  {
+    PriorityScope priority(PRIORITY_BULK);
+    ApiScope scope(API_getThumbnails);
+
+    char *serialnumber = mtpGetSerialnumber(_device);
+    string serial = serialnumber ? serialnumber : "";
+    free(serialnumber);
+
+    // the images of a gallery share a few folders, each is listed once
+    PathIndex index(_device, _storage);
+    for (uint32_t i = 0; i < _ids.size(); i++)
+    {
+      LIBMTP_file_t *metadata = _paths[i].empty() ? mtpGetFilemetadata(_device, _ids[i]) : NULL;
+      const LIBMTP_file_t *file = _paths[i].empty() ? metadata : index.find(_paths[i]);
+      Thumbnail thumbnail;
+      if (file && file->filetype != LIBMTP_FILETYPE_FOLDER)
+      {
+        thumbnail = fetch({serial, file->item_id, file->filesize, file->modificationdate}, file->filetype);
+      }
+      if (metadata)
+      {
+        LIBMTP_destroy_file_t(metadata);
+      }
+
+      _job->results[i] = thumbnail;
+      ThumbnailEvent *event = new ThumbnailEvent{i, thumbnail};
+      napi_status status = _callback.NonBlockingCall(event, [](Napi::Env env, Napi::Function jsCallback, ThumbnailEvent *event) {
+        jsCallback.Call({Napi::Number::New(env, event->index), thumbnailValue(env, event->thumbnail)});
+        delete event;
+      });
+      if (status != napi_ok)
+      {
+        delete event;
+      }
+    }
+  }
+
+  void OnOK() override
+  {
+    __deviceJobs--;
+    _callback.Release();
+  }
+
+  void OnError(const Napi::Error &e) override
+  {
+    __deviceJobs--;
+    _job->error = e.Message();
+    _callback.Release();
+  }
+
+private:
+  /**
+   * @param key the object
+   * @param filetype the type of the object
+   * @return the cached thumbnail, or the one fetched from the device which is then cached
+   */
+  Thumbnail fetch(const ThumbnailKey &key, LIBMTP_filetype_t filetype)
+  {
+    Thumbnail thumbnail;
+    if (__thumbnails.get(key, _directory, thumbnail))
+      return thumbnail;
+
+    unsigned char *data = NULL;
+    unsigned int size = 0;
+    if (mtpGetThumbnail(_device, key.id, &data, &size) != 0)
+    {
+      free(data);
+      // libmtp fails the same way for a missing thumbnail and a failed call, e.g. a busy device,
+      // only an object that can not have one is remembered, in memory only, an image is asked again
+      thumbnail = make_shared<const vector<unsigned char>>();
+      if (!LIBMTP_FILETYPE_IS_IMAGE(filetype) && !LIBMTP_FILETYPE_IS_VIDEO(filetype))
+        __thumbnails.put(key, "", thumbnail);
+      return thumbnail;
+    }
+
+    thumbnail = make_shared<const vector<unsigned char>>(data, data + size);
+    free(data);
+    __thumbnails.put(key, _directory, thumbnail);
+    return thumbnail;
+  }
+
+  LIBMTP_mtpdevice_t *_device;
+  uint32_t _storage;
+  vector<uint32_t> _ids;
+  vector<string> _paths;
+  string _directory;
+  ThumbnailJob *_job;
+  Napi::ThreadSafeFunction _callback;
+};
+
+/**
+ * get the thumbnails of many objects in one background job
  *
- * Note that copying an object may take a significant amount of time.
- * MTP does not provide any kind of progress mechanism, so the operation
- * will simply block for the duration.
+ * thumbnails are cached in memory, and on disk when a cache directory is
+ * given, by device serial number, object id, size and modification time
  *
  * @param info napi callback info
-               info[0] [string] the file or folder path to be copy
-               info[1] [string] the parent folder path copy to
- * @return true if the operate was successful
+               info[0] [array] object ids or file paths
+               info[1] [function] called with (index, thumbnail) as each thumbnail arrives, optional
+               info[2] [object] options, may be passed as info[1] without a callback
+                 cacheDir [string] the disk cache directory
+                 memoryCache [number] the size of the memory cache in bytes, 32MB by default
+ * @return a promise of the thumbnails in the order of the items, null for an object without thumbnail
  */
-Napi::Boolean copyObject(const Napi::CallbackInfo &info)
+Napi::Value getThumbnails(const Napi::CallbackInfo &info)
 {
   Napi::Env env = info.Env();
 
-  if (info.Length() < 2)
+  if (info.Length() < 1)
   {
     throw Napi::Error::New(env, "Wrong number of arguments");
   }
 
-  if (!info[0].IsString() || !info[1].IsString())
+  Napi::Value options = info.Length() >= 3 ? info[2] : info.Length() == 2 && !info[1].IsFunction() ? info[1] : env.Undefined();
+  if (!info[0].IsArray() || (info.Length() >= 2 && !info[1].IsFunction() && !info[1].IsObject() && !info[1].IsUndefined()) ||
+      (!options.IsUndefined() && !options.IsObject()))
   {
     throw Napi::TypeError::New(env, "Wrong arguments");
   }
 
-  string sourcePath = info[0].As<Napi::String>().Utf8Value();
-  string targetFolderPath = info[1].As<Napi::String>().Utf8Value();
+  Napi::Array items = info[0].As<Napi::Array>();
+  vector<uint32_t> ids(items.Length(), 0);
+  vector<string> paths(items.Length());
+  for (uint32_t i = 0; i < items.Length(); i++)
+  {
+    Napi::Value item = items.Get(i);
+    if (item.IsNumber())
+      ids[i] = item.As<Napi::Number>().Uint32Value();
+    else if (item.IsString())
+      paths[i] = formatMtpPath(item.As<Napi::String>().Utf8Value());
+    else
+      throw Napi::TypeError::New(env, "Wrong arguments");
+  }
 
-  sourcePath = formatMtpPath(sourcePath);
-  targetFolderPath = formatMtpPath(targetFolderPath);
+  string directory;
+  if (options.IsObject())
+  {
+    Napi::Object optionsObj = options.As<Napi::Object>();
+    if (optionsObj.Has("cacheDir"))
+      directory = optionsObj.Get("cacheDir").As<Napi::String>().Utf8Value();
+    if (optionsObj.Has("memoryCache"))
+      __thumbnails.setCapacity((size_t)optionsObj.Get("memoryCache").As<Napi::Number>().Int64Value());
+  }
 
   if (!__device)
   {
     throw Napi::Error::New(env, "Device not connected.");
   }
 
-  LIBMTP_file_t *sourceFile = findFile(__device, sourcePath);
+  Napi::Function callback = info.Length() >= 2 && info[1].IsFunction()
+                                ? info[1].As<Napi::Function>()
+                                : Napi::Function::New(env, [](const Napi::CallbackInfo &) {});
+  ThumbnailWorker *worker = new ThumbnailWorker(env, callback, ids, paths, directory);
+  worker->Queue();
+  return worker->Promise();
+}
 
-  if (!sourceFile)
+/**
+ * This function deletes a single file, track, playlist, folder or
+ * any other object off the MTP device, identified by the object ID.
+ *
+ * If you delete a folder, there is no guarantee that the device will
+ * really delete all the files that were in that folder, rather it is
+ * expected that they will not be deleted, and will turn up in object
+ * listings with parent set to a non-existant object ID. So the files
+ * (and folders) contained in the folder are deleted recursively first,
+ * then the folder itself, @see deleteTree().
+ *
+ * @param info napi callback info
+               info[0] [string] the file or folder path to be delete
+ * @return true if the operate was successful
+ */
+Napi::Boolean del(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  ApiScope scope(API_del);
+
+  if (info.Length() < 1)
   {
-    throw Napi::Error::New(env, "Can not find the source file to copy.");
+    throw Napi::Error::New(env, "Wrong number of arguments");
   }
 
-  LIBMTP_file_t *parent = findFile(__device, targetFolderPath);
+  if (!info[0].IsString())
+  {
+    throw Napi::TypeError::New(env, "Wrong arguments");
+  }
 
-  if (!parent)
+  string targetPath = info[0].As<Napi::String>().Utf8Value();
+
+  targetPath = formatMtpPath(targetPath);
+
+  if (!__device)
   {
-    throw Napi::Error::New(env, "Can not find the target parent folder copy to.");
+    throw Napi::Error::New(env, "Device not connected.");
+  }
+
+  LIBMTP_file_t *file = findFile(__device, targetPath);
+
+  if (!file)
+  {
+    throw Napi::Error::New(env, "Can not find the target object.");
   }
 
-  if (LIBMTP_Copy_Object(__device, sourceFile->item_id, __storageId, parent->item_id) != 0)
+  vector<uint32_t> deleted;
+  int ret = deleteTree(__device, currentStorageId(), file->item_id, file->filetype == LIBMTP_FILETYPE_FOLDER, &deleted);
+  LIBMTP_destroy_file_t(file);
+  for (uint32_t id : deleted)
+    __persistentIndex.remove(id);
+
+  if (ret != 0)
   {
-    throw Napi::Error::New(env, "Error to copy file");
+    throw Napi::Error::New(env, "Error to delete target object.");
   }
 
   return Napi::Boolean::New(env, true);
 }
 
 /**
- * The function moves an object from one location on a device to another
- * location.
- *
- * The semantics of moving a folder are not defined in the spec, but it
- * appears to do the right thing when tested (but devices that implement
- * this operation are rare).
+ * get object list by a mtp device parent path
  *
- * Note that moving an object may take a significant amount of time,
- * particularly if being moved between storages. MTP does not provide
- * any kind of progress mechanism, so the operation will simply block
- * for the duration.
+ * @param info napi callback info
+               info[0] [string] parent folder path,the root can be use character / to express
+               info[1] [object] options
+                                persistentId [bool] add the persistent unique object id of each object
+ * @return return all file and folder object list in the parent folder
+ */
+Napi::Array getList(const Napi::CallbackInfo &info)
+{
+
+  Napi::Env env = info.Env();
+  ApiScope scope(API_getList);
+  PriorityScope priority(PRIORITY_INTERACTIVE);
+
+  if (info.Length() < 1)
+  {
+    throw Napi::Error::New(env, "Wrong number of arguments");
+  }
+
+  if (!info[0].IsString())
+  {
+    throw Napi::TypeError::New(env, "Wrong arguments");
+  }
+
+  string parentPath = info[0].As<Napi::String>().Utf8Value();
+
+  parentPath = formatMtpPath(parentPath);
+
+  if (!__device)
+  {
+    throw Napi::Error::New(env, "Device not connected.");
+  }
+
+  int parentId = LIBMTP_FILES_AND_FOLDERS_ROOT;
+
+  if (parentPath.length() > 0)
+  {
+    LIBMTP_file_t *parent = findFile(__device, parentPath);
+
+    if (!parent)
+    {
+      throw Napi::Error::New(env, "Can not find the parent object.");
+    }
+
+    parentId = parent->item_id;
+  }
+
+  LIBMTP_file_t *files;
+
+  files = mtpGetFilesAndFolders(__device,
+                                currentStorageId(),
+                                parentId);
+
+  bool persistentId = getBoolOption(info[1], "persistentId", false);
+
+  // the ids are read before marshalling, so the device requests are not mixed with napi calls
+  if (persistentId)
+  {
+    __persistentIndex.readEach(__device, files);
+  }
+
+  TimelineScope span("marshal", "napi");
+  LIBMTP_file_t *file, *tmp;
+  file = files;
+
+  vector<Napi::Object> fileArr;
+  while (file != NULL)
+  {
+    Napi::Object fileObj = Napi::Object::New(env);
+    initFileObj(file, fileObj, persistentId);
+    fileArr.push_back(fileObj);
+    tmp = file;
+    file = file->next;
+    LIBMTP_destroy_file_t(tmp);
+  }
+
+  Napi::Array re = Napi::Array::New(env, fileArr.size());
+  for (string::size_type i = 0; i < fileArr.size(); i++)
+  {
+    re[i] = fileArr[i];
+  }
+  return re;
+}
+
+/**
+ * get object from mtp device
+ * @param info napi callback info
+               info[0] [string] a file path in device
+               info[1] [object] options
+                                persistentId [bool] add the persistent unique object id
+ * @return return file object find by the path
+ */
+Napi::Object getObject(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  ApiScope scope(API_get);
+  PriorityScope priority(PRIORITY_INTERACTIVE);
+
+  if (info.Length() < 1)
+  {
+    throw Napi::Error::New(env, "Wrong number of arguments");
+  }
+
+  if (!info[0].IsString())
+  {
+    throw Napi::TypeError::New(env, "Wrong arguments");
+  }
+
+  string targetPath = info[0].As<Napi::String>().Utf8Value();
+
+  targetPath = formatMtpPath(targetPath);
+
+  if (!__device)
+  {
+    throw Napi::Error::New(env, "Device not connected.");
+  }
+
+  LIBMTP_file_t *file = findFile(__device, targetPath);
+
+  if (!file)
+  {
+    throw Napi::Error::New(env, "Can not find the target object.");
+  }
+  Napi::Object fileObj = Napi::Object::New(env);
+  initFileObj(file, fileObj, getBoolOption(info[1], "persistentId", false));
+  return fileObj;
+}
+
+/**
+ * get many objects by path, each distinct parent folder is listed once
+ *
+ * @param info napi callback info
+               info[0] [array] file or folder paths in device
+               info[1] [object] options
+                                columnar [bool] return typed arrays by field instead of an object per path
+ * @return an object or null per path in the order of the paths, or the columns
+ *         { found, id, size, modificationdate, parent_id, storage_id, folder }
+ */
+Napi::Value statMany(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  ApiScope scope(API_statMany);
+  PriorityScope priority(PRIORITY_INTERACTIVE);
+
+  if (info.Length() < 1)
+  {
+    throw Napi::Error::New(env, "Wrong number of arguments");
+  }
+
+  if (!info[0].IsArray())
+  {
+    throw Napi::TypeError::New(env, "Wrong arguments");
+  }
+
+  Napi::Array pathArr = info[0].As<Napi::Array>();
+  vector<string> paths(pathArr.Length());
+  for (uint32_t i = 0; i < pathArr.Length(); i++)
+  {
+    Napi::Value path = pathArr.Get(i);
+    if (!path.IsString())
+    {
+      throw Napi::TypeError::New(env, "Wrong arguments");
+    }
+    paths[i] = formatMtpPath(path.As<Napi::String>().Utf8Value());
+  }
+
+  if (!__device)
+  {
+    throw Napi::Error::New(env, "Device not connected.");
+  }
+
+  PathIndex index(__device, currentStorageId());
+  vector<const LIBMTP_file_t *> files(paths.size());
+  for (size_t i = 0; i < paths.size(); i++)
+  {
+    files[i] = index.find(paths[i]);
+  }
+
+  TimelineScope span("marshal", "napi");
+  if (getBoolOption(info[1], "columnar", false))
+  {
+    Napi::Uint8Array found = Napi::Uint8Array::New(env, files.size());
+    Napi::Uint32Array id = Napi::Uint32Array::New(env, files.size());
+    Napi::Float64Array size = Napi::Float64Array::New(env, files.size());
+    Napi::Float64Array modificationdate = Napi::Float64Array::New(env, files.size());
+    Napi::Uint32Array parentId = Napi::Uint32Array::New(env, files.size());
+    Napi::Uint32Array storageId = Napi::Uint32Array::New(env, files.size());
+    Napi::Uint8Array folder = Napi::Uint8Array::New(env, files.size());
+    for (size_t i = 0; i < files.size(); i++)
+    {
+      const LIBMTP_file_t *file = files[i];
+      found[i] = file != NULL;
+      id[i] = file ? file->item_id : 0;
+      size[i] = file ? (double)file->filesize : 0;
+      modificationdate[i] = file ? (double)file->modificationdate : 0;
+      parentId[i] = file ? file->parent_id : 0;
+      storageId[i] = file ? file->storage_id : 0;
+      folder[i] = file && file->filetype == LIBMTP_FILETYPE_FOLDER;
+    }
+
+    Napi::Object re = Napi::Object::New(env);
+    re.Set("found", found);
+    re.Set("id", id);
+    re.Set("size", size);
+    re.Set("modificationdate", modificationdate);
+    re.Set("parent_id", parentId);
+    re.Set("storage_id", storageId);
+    re.Set("folder", folder);
+    return re;
+  }
+
+  Napi::Array re = Napi::Array::New(env, files.size());
+  for (uint32_t i = 0; i < files.size(); i++)
+  {
+    if (!files[i])
+    {
+      re[i] = env.Null();
+      continue;
+    }
+    Napi::Object fileObj = Napi::Object::New(env);
+    initFileObj(files[i], fileObj);
+    re[i] = fileObj;
+  }
+  return re;
+}
+
+/**
+ * The function copies an object from one location on a device to another
+ * location.
+ *
+ * The semantics of copying a folder are not defined in the spec, but it
+ * appears to do the right thing when tested (but devices that implement
+ * this operation are rare).
+ *
+ * Note that copying an object may take a significant amount of time.
+ * MTP does not provide any kind of progress mechanism, so the operation
+ * will simply block for the duration.
+ *
+ * A device without CopyObject, or the stream option, gets the object copied
+ * through the host instead, @see copyThroughHost, with progress and
+ * cancellation.
+ *
+ * @param info napi callback info
+               info[0] [string] the file or folder path to be copy
+               info[1] [string] the parent folder path copy to
+               info[2] [function] progress callback of a copy through the host, returns false to cancel it
+               info[3] [object] options
+                                stream [bool] copy through the host even if the device can copy objects
+ * @return true if the operate was successful
+ */
+Napi::Boolean copyObject(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  ApiScope scope(API_copy);
+
+  if (info.Length() < 2)
+  {
+    throw Napi::Error::New(env, "Wrong number of arguments");
+  }
+
+  if (!info[0].IsString() || !info[1].IsString())
+  {
+    throw Napi::TypeError::New(env, "Wrong arguments");
+  }
+
+  string sourcePath = info[0].As<Napi::String>().Utf8Value();
+  string targetFolderPath = info[1].As<Napi::String>().Utf8Value();
+
+  sourcePath = formatMtpPath(sourcePath);
+  targetFolderPath = formatMtpPath(targetFolderPath);
+
+  if (!__device)
+  {
+    throw Napi::Error::New(env, "Device not connected.");
+  }
+
+  LIBMTP_file_t *sourceFile = findFile(__device, sourcePath);
+
+  if (!sourceFile)
+  {
+    throw Napi::Error::New(env, "Can not find the source file to copy.");
+  }
+
+  LIBMTP_file_t *parent = findFile(__device, targetFolderPath);
+
+  if (!parent)
+  {
+    throw Napi::Error::New(env, "Can not find the target parent folder copy to.");
+  }
+
+  bool stream = getBoolOption(transferOptions(info), "stream", false);
+
+  if (!stream && mtpCheckCapability(__device, LIBMTP_DEVICECAP_CopyObject))
+  {
+    if (mtpCopyObject(__device, sourceFile->item_id, currentStorageId(), parent->item_id) != 0)
+    {
+      throw Napi::Error::New(env, "Error to copy file");
+    }
+  }
+  else
+  {
+    CopyResult result;
+    if (copyThroughHost(__device, currentStorageId(), sourceFile, parent->item_id, false, progress, &info, result) != 0)
+    {
+      throw Napi::Error::New(env, "Error to copy file");
+    }
+  }
+
+  return Napi::Boolean::New(env, true);
+}
+
+/**
+ * The function moves an object from one location on a device to another
+ * location.
+ *
+ * The semantics of moving a folder are not defined in the spec, but it
+ * appears to do the right thing when tested (but devices that implement
+ * this operation are rare).
+ *
+ * Note that moving an object may take a significant amount of time,
+ * particularly if being moved between storages. MTP does not provide
+ * any kind of progress mechanism, so the operation will simply block
+ * for the duration.
+ *
+ * A device without MoveObject, or the stream option, gets the object copied
+ * through the host instead, @see copyThroughHost, with progress and
+ * cancellation. The source is deleted only once every copied file has been
+ * verified.
+ *
+ * @param info napi callback info
+               info[0] [string] the file or folder path to be move
+               info[1] [string] the parent folder path move to
+               info[2] [function] progress callback of a move through the host, returns false to cancel it
+               info[3] [object] options
+                                stream [bool] move through the host even if the device can move objects
+ * @return true if the operate was successful
+ */
+Napi::Boolean moveObject(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  ApiScope scope(API_move);
+
+  if (info.Length() < 2)
+  {
+    throw Napi::Error::New(env, "Wrong number of arguments");
+  }
+
+  if (!info[0].IsString() || !info[1].IsString())
+  {
+    throw Napi::TypeError::New(env, "Wrong arguments");
+  }
+
+  string sourcePath = info[0].As<Napi::String>().Utf8Value();
+  string targetFolderPath = info[1].As<Napi::String>().Utf8Value();
+
+  sourcePath = formatMtpPath(sourcePath);
+  targetFolderPath = formatMtpPath(targetFolderPath);
+
+  if (!__device)
+  {
+    throw Napi::Error::New(env, "Device not connected.");
+  }
+
+  LIBMTP_file_t *sourceFile = findFile(__device, sourcePath);
+
+  if (!sourceFile)
+  {
+    throw Napi::Error::New(env, "Can not find the source file to move.");
+  }
+
+  LIBMTP_file_t *parent = findFile(__device, targetFolderPath);
+
+  if (!parent)
+  {
+    throw Napi::Error::New(env, "Can not find the target parent folder move to.");
+  }
+
+  bool stream = getBoolOption(transferOptions(info), "stream", false);
+
+  if (!stream && mtpCheckCapability(__device, LIBMTP_DEVICECAP_MoveObject))
+  {
+    if (mtpMoveObject(__device, sourceFile->item_id, currentStorageId(), parent->item_id) != 0)
+    {
+      throw Napi::Error::New(env, "Error to move file");
+    }
+  }
+  else
+  {
+    CopyResult result;
+    if (copyThroughHost(__device, currentStorageId(), sourceFile, parent->item_id, true, progress, &info, result) != 0)
+    {
+      throw Napi::Error::New(env, "Error to move file");
+    }
+
+    // the copy is complete and verified, the source can go
+    vector<uint32_t> deleted;
+    int ret = deleteTree(__device, currentStorageId(), sourceFile->item_id,
+                         sourceFile->filetype == LIBMTP_FILETYPE_FOLDER, &deleted);
+    for (uint32_t id : deleted)
+      __persistentIndex.remove(id);
+    if (ret != 0)
+    {
+      throw Napi::Error::New(env, "Error to delete the source of the move.");
+    }
+  }
+
+  return Napi::Boolean::New(env, true);
+}
+
+/**
+ * a device of a transfer between devices, released with the transfer if it was opened for it
+ */
+struct TransferDevice
+{
+  LIBMTP_mtpdevice_t *device = NULL;
+  uint32_t storage = 0;
+  bool opened = false;
+
+  ~TransferDevice()
+  {
+    if (opened)
+      mtpReleaseDevice(device);
+  }
+};
+
+/**
+ * helper function to get a device by its serial number, the connected device or another one opened for the call
+ *
+ * @param serial the serial number of the device
+ * @param target receives the device and its first storage
+ * @return false if no device has this serial number or it has no storage
+ */
+bool openTransferDevice(const string &serial, TransferDevice &target)
+{
+  if (__device)
+  {
+    char *current = mtpGetSerialnumber(__device);
+    bool same = current && serial == current;
+    free(current);
+    if (same)
+    {
+      target.device = __device;
+      target.storage = currentStorageId();
+      return target.storage != 0;
+    }
+  }
+
+  __discovery.ensureScanned();
+  vector<LIBMTP_raw_device_t> devices = __discovery.devices();
+  for (LIBMTP_raw_device_t &rawdev : devices)
+  {
+    // devices whose serial number is already known are not opened to check it
+    string known = __discovery.serial(rawdev);
+    if (!known.empty() && known != serial)
+      continue;
+
+    LIBMTP_mtpdevice_t *device = openRawDevice(&rawdev, false);
+    if (!device)
+      continue;
+    if (__discovery.serial(rawdev) != serial)
+    {
+      mtpReleaseDevice(device);
+      continue;
+    }
+
+    target.device = device;
+    target.opened = true;
+    if (!device->storage)
+      mtpGetStorage(device, LIBMTP_STORAGE_SORTBY_NOTSORTED);
+    target.storage = device->storage ? device->storage->id : 0;
+    return target.storage != 0;
+  }
+  return false;
+}
+
+/**
+ * copy a file or a folder tree from one device to another, without intermediate files
+ *
+ * a device is the connected device if it has the serial number, otherwise it
+ * is opened for the transfer and released afterwards. both usb links transfer
+ * at the same time, @see transferBetweenDevices.
+ *
+ * @param info napi callback info
+               info[0] [string] the serial number of the source device
+               info[1] [string] the file or folder path on the source device
+               info[2] [string] the serial number of the target device
+               info[3] [string] the parent folder path on the target device
+               info[4] [function] progress callback, returns false to cancel the transfer
+ * @return { id, files, folders, bytes } the object id of the copy, the number of files and folders and the bytes copied
+ */
+Napi::Value transferBetween(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  ApiScope scope(API_transfer);
+
+  if (info.Length() < 4)
+  {
+    throw Napi::Error::New(env, "Wrong number of arguments");
+  }
+
+  if (!info[0].IsString() || !info[1].IsString() || !info[2].IsString() || !info[3].IsString())
+  {
+    throw Napi::TypeError::New(env, "Wrong arguments");
+  }
+
+  string sourceSerial = info[0].As<Napi::String>().Utf8Value();
+  string sourcePath = formatMtpPath(info[1].As<Napi::String>().Utf8Value());
+  string targetSerial = info[2].As<Napi::String>().Utf8Value();
+  string targetFolderPath = formatMtpPath(info[3].As<Napi::String>().Utf8Value());
+
+  if (sourceSerial == targetSerial)
+  {
+    throw Napi::Error::New(env, "The source and target devices must differ, use copy.");
+  }
+
+  TransferDevice source, target;
+  if (!openTransferDevice(sourceSerial, source))
+  {
+    throw Napi::Error::New(env, "Can not open the source device.");
+  }
+  if (!openTransferDevice(targetSerial, target))
+  {
+    throw Napi::Error::New(env, "Can not open the target device.");
+  }
+
+  PathIndex sourceIndex(source.device, source.storage);
+  const LIBMTP_file_t *sourceFile = sourceIndex.find(sourcePath);
+
+  if (!sourceFile)
+  {
+    throw Napi::Error::New(env, "Can not find the source file to transfer.");
+  }
+
+  // libmtp sends a file with parent 0 to the default folder of its type, not the root
+  uint32_t parentId = LIBMTP_FILES_AND_FOLDERS_ROOT;
+  if (!targetFolderPath.empty())
+  {
+    PathIndex targetIndex(target.device, target.storage);
+    const LIBMTP_file_t *parent = targetIndex.find(targetFolderPath);
+    if (!parent || parent->filetype != LIBMTP_FILETYPE_FOLDER)
+    {
+      throw Napi::Error::New(env, "Can not find the target parent folder transfer to.");
+    }
+    parentId = parent->item_id;
+  }
+
+  Napi::Function callback;
+  if (info.Length() >= 5 && info[4].IsFunction())
+    callback = info[4].As<Napi::Function>();
+
+  CopyResult result;
+  if (transferBetweenDevices(source.device, source.storage, sourceFile, target.device, target.storage, parentId,
+                             callback ? functionProgress : NULL, &callback, result) != 0)
+  {
+    throw Napi::Error::New(env, "Error to transfer file");
+  }
+
+  Napi::Object re = Napi::Object::New(env);
+  re.Set("id", result.id);
+  re.Set("files", result.files);
+  re.Set("folders", result.folders);
+  re.Set("bytes", (double)result.bytes);
+  return re;
+}
+
+// how far the slowest device may fall behind the fastest one in an upload to many devices
+static const uint64_t BROADCAST_LAG_WINDOW = 16 * 1024 * 1024;
+
+/**
+ * upload the same file to many devices at once, the file is read once for all of them
+ *
+ * each device uploads on a thread of its own, the devices are found by their
+ * serial number like in a transfer, @see openTransferDevice. a device that
+ * can not be opened or fails does not stop the others.
+ *
+ * @param info napi callback info
+               info[0] [string] the local file path, or [buffer] the content of the file
+               info[1] [array] the serial numbers of the devices
+               info[2] [string] the parent folder path on every device
+               info[3] [function] progress callback over all the devices, returns false to cancel the upload
+               info[4] [object] options
+                                name [string] the file name, required for a buffer
+                                lagWindow [number] the bytes a device may fall behind the fastest one before it reads the file on its own
+ * @return { uploaded, bytesRead, devices } the number of devices uploaded to, the bytes read from the local file,
+ *         and per device { serial, uploaded, id, sent, lagged, error }
+ */
+Napi::Value broadcastUploadFile(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  ApiScope scope(API_broadcastUpload);
+
+  if (info.Length() < 3)
+  {
+    throw Napi::Error::New(env, "Wrong number of arguments");
+  }
+
+  if ((!info[0].IsString() && !info[0].IsBuffer()) || !info[1].IsArray() || !info[2].IsString())
+  {
+    throw Napi::TypeError::New(env, "Wrong arguments");
+  }
+
+  Napi::Function callback;
+  if (info.Length() >= 4 && info[3].IsFunction())
+    callback = info[3].As<Napi::Function>();
+  Napi::Value options = info.Length() >= 5 ? info[4] : env.Undefined();
+
+  string filename;
+  uint64_t window = BROADCAST_LAG_WINDOW;
+  if (options.IsObject())
+  {
+    Napi::Object optionsObj = options.As<Napi::Object>();
+    if (optionsObj.Get("name").IsString())
+      filename = optionsObj.Get("name").As<Napi::String>().Utf8Value();
+    if (optionsObj.Get("lagWindow").IsNumber())
+      window = (uint64_t)optionsObj.Get("lagWindow").As<Napi::Number>().Int64Value();
+  }
+
+  string sourceFilePath;
+  time_t mtime = time(NULL);
+  if (info[0].IsString())
+  {
+    sourceFilePath = info[0].As<Napi::String>().Utf8Value();
+    struct stat sb;
+    if (stat(sourceFilePath.c_str(), &sb) == -1)
+    {
+      throw Napi::Error::New(env, "Error to read file info.");
+    }
+    mtime = sb.st_mtime;
+    if (filename.empty())
+      filename = sourceFilePath.substr(sourceFilePath.find_last_of("/\\") + 1);
+  }
+  else if (filename.empty())
+  {
+    throw Napi::TypeError::New(env, "The name option is required to upload a buffer.");
+  }
+
+  Napi::Array serials = info[1].As<Napi::Array>();
+  string targetFolderPath = formatMtpPath(info[2].As<Napi::String>().Utf8Value());
+
+  // every device is looked up first, those that can not take the file are reported and left out
+  vector<string> names(serials.Length());
+  vector<string> errors(serials.Length());
+  vector<unique_ptr<TransferDevice>> devices(serials.Length());
+  vector<BroadcastTarget> targets;
+  vector<size_t> targetIndex;
+  for (uint32_t i = 0; i < serials.Length(); i++)
+  {
+    Napi::Value serial = serials.Get(i);
+    if (!serial.IsString())
+    {
+      throw Napi::TypeError::New(env, "Wrong arguments");
+    }
+    names[i] = serial.As<Napi::String>().Utf8Value();
+
+    devices[i].reset(new TransferDevice());
+    if (!openTransferDevice(names[i], *devices[i]))
+    {
+      errors[i] = "Can not open the device.";
+      continue;
+    }
+
+    uint32_t parentId = LIBMTP_FILES_AND_FOLDERS_ROOT;
+    if (!targetFolderPath.empty())
+    {
+      PathIndex index(devices[i]->device, devices[i]->storage);
+      const LIBMTP_file_t *parent = index.find(targetFolderPath);
+      if (!parent || parent->filetype != LIBMTP_FILETYPE_FOLDER)
+      {
+        errors[i] = "Can not find the target parent folder id.";
+        continue;
+      }
+      parentId = parent->item_id;
+    }
+
+    targets.push_back({devices[i]->device, devices[i]->storage, parentId, 0, 0, false});
+    targetIndex.push_back(i);
+  }
+
+  Napi::Array outcomes = Napi::Array::New(env, names.size());
+  for (uint32_t i = 0; i < names.size(); i++)
+  {
+    Napi::Object outcome = Napi::Object::New(env);
+    outcome.Set("serial", names[i]);
+    outcome.Set("uploaded", false);
+    if (!errors[i].empty())
+      outcome.Set("error", errors[i]);
+    outcomes[i] = outcome;
+  }
+
+  // no device can take the file, the source is not even opened
+  Napi::Object re = Napi::Object::New(env);
+  if (targets.empty())
+  {
+    re.Set("uploaded", 0);
+    re.Set("bytesRead", 0);
+    re.Set("devices", outcomes);
+    return re;
+  }
+
+  BroadcastSource source;
+  if (info[0].IsString())
+  {
+    if (!source.open(sourceFilePath.c_str(), targets.size(), window))
+    {
+      throw Napi::Error::New(env, "Error to read file info.");
+    }
+  }
+  else
+  {
+    Napi::Buffer<unsigned char> buffer = info[0].As<Napi::Buffer<unsigned char>>();
+    source.open(buffer.Data(), buffer.Length(), targets.size());
+  }
+
+  size_t uploaded = broadcastUpload(source, filename, mtime, targets, callback ? functionProgress : NULL, &callback);
+
+  for (size_t t = 0; t < targets.size(); t++)
+  {
+    Napi::Object outcome = outcomes.Get(targetIndex[t]).As<Napi::Object>();
+    outcome.Set("uploaded", targets[t].id != 0);
+    outcome.Set("id", targets[t].id);
+    outcome.Set("sent", (double)targets[t].sent);
+    outcome.Set("lagged", targets[t].lagged);
+    if (targets[t].id == 0)
+      outcome.Set("error", "Error upload file to MTP device.");
+  }
+
+  re.Set("uploaded", (double)uploaded);
+  re.Set("bytesRead", (double)source.bytesRead());
+  re.Set("devices", outcomes);
+  return re;
+}
+
+/**
+ * pass a mirror event to the js callback registered by <code>watchAndPush</code>
+ *
+ * called from the watcher thread
+ *
+ * @param event the operation applied to the device
+ */
+void emitMirrorEvent(const MirrorEvent &event)
+{
+  MirrorEvent *data = new MirrorEvent(event);
+  napi_status status = __watchCallback.NonBlockingCall(data, [](Napi::Env env, Napi::Function jsCallback, MirrorEvent *data)
+                                                       {
+    Napi::Object eventObj = Napi::Object::New(env);
+    eventObj.Set("op", data->op);
+    eventObj.Set("path", data->path);
+    if (!data->from.empty())
+      eventObj.Set("from", data->from);
+    eventObj.Set("id", data->id);
+    if (!data->error.empty())
+      eventObj.Set("error", data->error);
+    jsCallback.Call({eventObj});
+    delete data; });
+
+  if (status != napi_ok)
+    delete data;
+}
+
+/**
+ * keep a device folder a copy of a local directory
+ *
+ * the local changes are collected on a background thread, with inotify where
+ * available and by polling otherwise, debounced and applied to the connected
+ * device as a batch, @see DirectoryWatcher and DeviceMirror. the device
+ * folder is listed once, paths are never resolved again afterwards. the
+ * device can not be released until <code>stopWatch</code> is called.
+ *
+ * @param info napi callback info
+               info[0] [string] the local directory
+               info[1] [string] the device folder path, empty for the root of the storage
+               info[2] [function] called with every operation applied, { op, path, from, id, error }
+               info[3] [object] options
+                                debounce [number] milliseconds without change before a batch is applied, 500 by default
+                                pollInterval [number] milliseconds between two scans when polling, 1000 by default
+                                polling [boolean] true to poll even if inotify is available
+                                initialSync [boolean] false to skip pushing the differences found at start
+ * @return true if the operate was successful
+ */
+Napi::Boolean watchAndPush(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  ApiScope scope(API_watchAndPush);
+
+  if (info.Length() < 3)
+  {
+    throw Napi::Error::New(env, "Wrong number of arguments");
+  }
+
+  if (!info[0].IsString() || !info[1].IsString() || !info[2].IsFunction())
+  {
+    throw Napi::TypeError::New(env, "Wrong arguments");
+  }
+
+  if (!__device)
+  {
+    throw Napi::Error::New(env, "Device not connected.");
+  }
+
+  if (__watcher.running())
+  {
+    throw Napi::Error::New(env, "Watch already started.");
+  }
+
+  Napi::Value options = info.Length() >= 4 ? info[3] : env.Undefined();
+  uint32_t debounceMs = 500;
+  uint32_t pollMs = 1000;
+  if (options.IsObject())
+  {
+    Napi::Object optionsObj = options.As<Napi::Object>();
+    if (optionsObj.Get("debounce").IsNumber())
+      debounceMs = optionsObj.Get("debounce").As<Napi::Number>().Uint32Value();
+    if (optionsObj.Get("pollInterval").IsNumber())
+      pollMs = optionsObj.Get("pollInterval").As<Napi::Number>().Uint32Value();
+  }
+  bool polling = getBoolOption(options, "polling", false);
+  bool initialSync = getBoolOption(options, "initialSync", true);
+
+  string localDir = info[0].As<Napi::String>().Utf8Value();
+  string targetFolderPath = formatMtpPath(info[1].As<Napi::String>().Utf8Value());
+  uint32_t storage = currentStorageId();
+
+  uint32_t folderId = LIBMTP_FILES_AND_FOLDERS_ROOT;
+  if (!targetFolderPath.empty())
+  {
+    PathIndex index(__device, storage);
+    const LIBMTP_file_t *folder = index.find(targetFolderPath);
+    if (!folder || folder->filetype != LIBMTP_FILETYPE_FOLDER)
+    {
+      throw Napi::Error::New(env, "Can not find the target parent folder id.");
+    }
+    folderId = folder->item_id;
+  }
+
+  __watchCallback = Napi::ThreadSafeFunction::New(env, info[2].As<Napi::Function>(), "luck-node-mtp watch", 0, 1);
+  __mirror.reset(new DeviceMirror(__device, storage, folderId, localDir, emitMirrorEvent));
+  DeviceMirror *mirror = __mirror.get();
+  if (!__watcher.start(localDir, debounceMs, pollMs, polling, initialSync, [mirror](WatchBatch &batch)
+                       { mirror->apply(batch); }))
+  {
+    __mirror.reset();
+    __watchCallback.Release();
+    throw Napi::Error::New(env, "Error to read the local directory.");
+  }
+  __deviceJobs++;
+
+  return Napi::Boolean::New(env, true);
+}
+
+/**
+ * stop the watch started by <code>watchAndPush</code>, waits for the operation being applied
+ *
+ * @param info napi callback info
+ * @return true if the operate was successful
+ */
+Napi::Boolean stopWatch(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+
+  if (!__watcher.running())
+  {
+    throw Napi::Error::New(env, "Watch not started.");
+  }
+
+  __mirror->cancel();
+  __watcher.stop();
+  __mirror.reset();
+  __watchCallback.Release();
+  __deviceJobs--;
+
+  return Napi::Boolean::New(env, true);
+}
+
+// the changes kept by default in the change journal
+static const size_t CHANGE_JOURNAL_CAPACITY = 100000;
+
+/**
+ * pass a device event to the change journal, called from the event reader thread
+ */
+void journalDeviceEvent(bool ok, LIBMTP_event_t event, uint32_t param)
+{
+  if (!ok)
+  {
+    __changeJournal.record(__device, CHANGE_RESYNC, 0);
+    return;
+  }
+
+  switch (event)
+  {
+  case LIBMTP_EVENT_OBJECT_ADDED:
+    __changeJournal.record(__device, CHANGE_ADDED, param);
+    break;
+  case LIBMTP_EVENT_OBJECT_REMOVED:
+    __changeJournal.record(__device, CHANGE_REMOVED, param);
+    break;
+  case LIBMTP_EVENT_STORE_ADDED:
+  case LIBMTP_EVENT_STORE_REMOVED:
+    __changeJournal.record(__device, CHANGE_RESYNC, 0);
+    break;
+  default:
+    break;
+  }
+}
+
+/**
+ * start journaling the object changes of the connected device, @see ChangeJournal
+ *
+ * the journal is fed by the changes made through the addon, recorded by the
+ * libmtp wrappers, and by the ObjectAdded and ObjectRemoved events of the
+ * device, read on a background thread. it is stopped when the device is released.
+ *
+ * @param info napi callback info
+               info[0] [object] options
+                                events [boolean] false to journal only the changes made through the addon
+                                path [string] the file the journal state is saved to, so its tokens survive a restart
+                                capacity [number] the number of changes kept, 100000 by default
+ * @return the current token
+ */
+Napi::Value startChangeJournal(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+
+  if (!__device)
+  {
+    throw Napi::Error::New(env, "Device not connected.");
+  }
+
+  if (__changeJournal.running())
+  {
+    throw Napi::Error::New(env, "Change journal already started.");
+  }
+
+  Napi::Value options = info.Length() >= 1 ? info[0] : env.Undefined();
+  string path;
+  size_t capacity = CHANGE_JOURNAL_CAPACITY;
+  if (options.IsObject())
+  {
+    Napi::Object optionsObj = options.As<Napi::Object>();
+    if (optionsObj.Get("path").IsString())
+      path = optionsObj.Get("path").As<Napi::String>().Utf8Value();
+    if (optionsObj.Get("capacity").IsNumber())
+      capacity = (size_t)optionsObj.Get("capacity").As<Napi::Number>().Int64Value();
+  }
+
+  string serial;
+  char *serialNumber = mtpGetSerialnumber(__device);
+  if (serialNumber)
+  {
+    serial = serialNumber;
+    free(serialNumber);
+  }
+
+  __changeJournal.start(__device, serial, capacity, path);
+  if (getBoolOption(options, "events", true))
+    __deviceEvents.start(__device, journalDeviceEvent);
+
+  ChangeSet changes;
+  __changeJournal.changes("", changes);
+  return Napi::String::New(env, changes.token);
+}
+
+/**
+ * stop the change journal, the tokens issued get a resync when it is started again
+ *
+ * @param info napi callback info
+ * @return true if the operate was successful
+ */
+Napi::Boolean stopChangeJournal(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+
+  if (!__changeJournal.running())
+  {
+    throw Napi::Error::New(env, "Change journal not started.");
+  }
+
+  __deviceEvents.stop();
+  __changeJournal.stop();
+
+  return Napi::Boolean::New(env, true);
+}
+
+/**
+ * get the object changes since a token, folded per object
+ *
+ * @param info napi callback info
+               info[0] [string] a token returned by startChangeJournal or getChanges, omitted to get the current token
+ * @return { token, resync, added, removed, modified } the token to pass next time, true if the changes are not
+ *         known and the device has to be listed again, and the object ids added, removed and modified
+ */
+Napi::Object getChanges(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  ApiScope scope(API_getChanges);
+
+  if (info.Length() >= 1 && !info[0].IsString() && !info[0].IsUndefined())
+  {
+    throw Napi::TypeError::New(env, "Wrong arguments");
+  }
+
+  if (!__changeJournal.running())
+  {
+    throw Napi::Error::New(env, "Change journal not started.");
+  }
+
+  string token;
+  if (info.Length() >= 1 && info[0].IsString())
+    token = info[0].As<Napi::String>().Utf8Value();
+
+  ChangeSet changes;
+  __changeJournal.changes(token, changes);
+
+  Napi::Object re = Napi::Object::New(env);
+  re.Set("token", changes.token);
+  re.Set("resync", changes.resync);
+  const vector<uint32_t> *lists[] = {&changes.added, &changes.removed, &changes.modified};
+  const char *names[] = {"added", "removed", "modified"};
+  for (int i = 0; i < 3; i++)
+  {
+    Napi::Array ids = Napi::Array::New(env, lists[i]->size());
+    for (uint32_t j = 0; j < lists[i]->size(); j++)
+      ids[j] = Napi::Number::New(env, (*lists[i])[j]);
+    re.Set(names[i], ids);
+  }
+  return re;
+}
+
+/**
+ * helper function to open a zip archive of the device, only its end records and central directory are read
+ *
+ * @param env napi env
+ * @param path the device path of the archive
+ * @param input receives the input of the archive, owned by the reader, to count the bytes read from the device
+ * @return the reader
+ */
+ZipArchiveReader *openDeviceZip(Napi::Env env, const string &path, PartialObjectInput *&input)
+{
+  if (!__device)
+  {
+    throw Napi::Error::New(env, "Device not connected.");
+  }
+
+  if (!mtpCheckCapability(__device, LIBMTP_DEVICECAP_GetPartialObject))
+  {
+    throw Napi::Error::New(env, "The device can not read a part of a file.");
+  }
+
+  LIBMTP_file_t *file = findFile(__device, path);
+  if (!file || file->filetype == LIBMTP_FILETYPE_FOLDER)
+  {
+    if (file)
+      LIBMTP_destroy_file_t(file);
+    throw Napi::Error::New(env, "Can not find the archive.");
+  }
+  input = new PartialObjectInput(__device, file->item_id, file->filesize);
+  LIBMTP_destroy_file_t(file);
+
+  ZipArchiveReader *reader = openZipReader(input);
+  if (!reader)
+  {
+    throw Napi::Error::New(env, "Error reading the zip archive.");
+  }
+  return reader;
+}
+
+/**
+ * list the entries of a zip archive on the device without downloading it
+ *
+ * the end of central directory record and the central directory are read
+ * with GetPartialObject, usually a few kilobytes whatever the size of the archive
+ *
+ * @param info napi callback info
+               info[0] [string] the device path of the archive
+ * @return { entries, size, bytesRead } the entries { name, size, compressedSize, mtime, folder } in the order
+ *         of their data, the size of the archive and the number of bytes read from the device
+ */
+Napi::Object listZip(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  ApiScope scope(API_listZip);
+
+  if (info.Length() < 1)
+  {
+    throw Napi::Error::New(env, "Wrong number of arguments");
+  }
+
+  if (!info[0].IsString())
+  {
+    throw Napi::TypeError::New(env, "Wrong arguments");
+  }
+
+  PartialObjectInput *input = NULL;
+  unique_ptr<ZipArchiveReader> reader(openDeviceZip(env, formatMtpPath(info[0].As<Napi::String>().Utf8Value()), input));
+
+  const vector<ZipReaderEntry> &entries = reader->entries();
+  Napi::Array list = Napi::Array::New(env, entries.size());
+  for (uint32_t i = 0; i < entries.size(); i++)
+  {
+    Napi::Object entry = Napi::Object::New(env);
+    entry.Set("name", entries[i].entry.name);
+    entry.Set("size", (double)entries[i].entry.size);
+    entry.Set("compressedSize", (double)entries[i].compressedSize);
+    entry.Set("mtime", (double)entries[i].entry.mtime);
+    entry.Set("folder", entries[i].entry.folder);
+    list[i] = entry;
+  }
+
+  Napi::Object re = Napi::Object::New(env);
+  re.Set("entries", list);
+  re.Set("size", (double)input->size());
+  re.Set("bytesRead", (double)input->transferred());
+  return re;
+}
+
+/**
+ * extract a single entry of a zip archive on the device
+ *
+ * only the central directory and the byte range of the entry are read from
+ * the device, the entry is inflated while it arrives and its crc checked
  *
  * @param info napi callback info
-               info[0] [string] the file or folder path to be move
-               info[1] [string] the parent folder path move to
- * @return true if the operate was successful
+               info[0] [string] the device path of the archive
+               info[1] [string] the name of the entry, as listed by listZip
+               info[2] [string|stream] the local file path, or a writable stream the entry is written to
+               info[3] [function] the progress callback function, called with the bytes of the entry,
+               returning false cancels the extraction
+ * @return { size, bytesRead } the size of the entry and the number of bytes read from the device
  */
-Napi::Boolean moveObject(const Napi::CallbackInfo &info)
+Napi::Object extractZipEntry(const Napi::CallbackInfo &info)
 {
   Napi::Env env = info.Env();
+  ApiScope scope(API_extractZipEntry);
 
-  if (info.Length() < 2)
+  if (info.Length() < 3)
   {
     throw Napi::Error::New(env, "Wrong number of arguments");
   }
 
-  if (!info[0].IsString() || !info[1].IsString())
+  bool toStream = info[2].IsObject() && info[2].As<Napi::Object>().Get("write").IsFunction();
+  if (!info[0].IsString() || !info[1].IsString() || (!info[2].IsString() && !toStream) ||
+      (info.Length() >= 4 && !info[3].IsFunction()))
   {
     throw Napi::TypeError::New(env, "Wrong arguments");
   }
 
-  string sourcePath = info[0].As<Napi::String>().Utf8Value();
-  string targetFolderPath = info[1].As<Napi::String>().Utf8Value();
+  string name = info[1].As<Napi::String>().Utf8Value();
+  string targetFilePath = toStream ? "" : info[2].As<Napi::String>().Utf8Value();
 
-  sourcePath = formatMtpPath(sourcePath);
-  targetFolderPath = formatMtpPath(targetFolderPath);
+  PartialObjectInput *input = NULL;
+  unique_ptr<ZipArchiveReader> reader(openDeviceZip(env, formatMtpPath(info[0].As<Napi::String>().Utf8Value()), input));
 
-  if (!__device)
+  const vector<ZipReaderEntry> &entries = reader->entries();
+  size_t index = 0;
+  while (index < entries.size() && entries[index].entry.name != name)
+    index++;
+  if (index == entries.size() || entries[index].entry.folder)
   {
-    throw Napi::Error::New(env, "Device not connected.");
+    throw Napi::Error::New(env, "Can not find the entry in the archive.");
   }
 
-  LIBMTP_file_t *sourceFile = findFile(__device, sourcePath);
+  Napi::Function callback;
+  if (info.Length() >= 4)
+    callback = info[3].As<Napi::Function>();
 
-  if (!sourceFile)
+  FileOutput fileOutput;
+  unique_ptr<StreamOutput> streamOutput;
+  ArchiveOutput *output = &fileOutput;
+  if (toStream)
   {
-    throw Napi::Error::New(env, "Can not find the source file to move.");
+    streamOutput.reset(new StreamOutput(info[2].As<Napi::Object>()));
+    output = streamOutput.get();
   }
-
-  LIBMTP_file_t *parent = findFile(__device, targetFolderPath);
-
-  if (!parent)
+  else if (!fileOutput.open(targetFilePath))
   {
-    throw Napi::Error::New(env, "Can not find the target parent folder move to.");
+    throw Napi::Error::New(env, "Error to create the local file.");
   }
 
-  if (LIBMTP_Move_Object(__device, sourceFile->item_id, __storageId, parent->item_id) != 0)
+  if (extractFromZip(*reader, index, *output, callback ? functionProgress : NULL, &callback) != 0)
   {
-    throw Napi::Error::New(env, "Error to move file");
+    if (toStream)
+    {
+      streamOutput->rethrow();
+    }
+    else
+    {
+      fileOutput.close();
+      remove(targetFilePath.c_str());
+    }
+    throw Napi::Error::New(env, "Error extracting the entry from the zip archive.");
   }
 
-  return Napi::Boolean::New(env, true);
+  Napi::Object re = Napi::Object::New(env);
+  re.Set("size", (double)output->size());
+  re.Set("bytesRead", (double)input->transferred());
+  return re;
 }
 
 /**
@@ -801,6 +3474,7 @@ Napi::Boolean moveObject(const Napi::CallbackInfo &info)
 Napi::Boolean setFileName(const Napi::CallbackInfo &info)
 {
   Napi::Env env = info.Env();
+  ApiScope scope(API_setFileName);
 
   if (info.Length() < 2)
   {
@@ -829,7 +3503,7 @@ Napi::Boolean setFileName(const Napi::CallbackInfo &info)
     throw Napi::Error::New(env, "Can not find the target object.");
   }
 
-  if (LIBMTP_Set_File_Name(__device, file, newName.c_str()) != 0)
+  if (mtpSetFileName(__device, file, newName.c_str()) != 0)
   {
     throw Napi::Error::New(env, "Error to rename file.");
   }
@@ -848,6 +3522,7 @@ Napi::Boolean setFileName(const Napi::CallbackInfo &info)
 Napi::Boolean setFolderName(const Napi::CallbackInfo &info)
 {
   Napi::Env env = info.Env();
+  ApiScope scope(API_setFolderName);
 
   if (info.Length() < 2)
   {
@@ -880,7 +3555,7 @@ Napi::Boolean setFolderName(const Napi::CallbackInfo &info)
   folder->folder_id = file->item_id;
   folder->name = file->filename;
 
-  if (LIBMTP_Set_Folder_Name(__device, folder, newName.c_str()) != 0)
+  if (mtpSetFolderName(__device, folder, newName.c_str()) != 0)
   {
     LIBMTP_destroy_folder_t(folder);
     throw Napi::Error::New(env, "Error to rename folder.");
@@ -907,6 +3582,7 @@ Napi::Boolean setFolderName(const Napi::CallbackInfo &info)
 Napi::Number createFolder(const Napi::CallbackInfo &info)
 {
   Napi::Env env = info.Env();
+  ApiScope scope(API_createFolder);
 
   if (info.Length() < 2)
   {
@@ -940,7 +3616,7 @@ Napi::Number createFolder(const Napi::CallbackInfo &info)
     throw Napi::Error::New(env, "Parent is not a folder.");
   }
 
-  int folderId = LIBMTP_Create_Folder(__device, strdup(newName.c_str()), file->item_id, __storageId);
+  int folderId = mtpCreateFolder(__device, strdup(newName.c_str()), file->item_id, currentStorageId());
 
   if (folderId == 0)
   {
@@ -950,10 +3626,485 @@ Napi::Number createFolder(const Napi::CallbackInfo &info)
   return Napi::Number::New(env, folderId);
 }
 
+/**
+ * helper function to index the persistent ids of the objects below a folder
+ *
+ * folders are listed breadth first, the walk stops early once <code>target</code> is indexed
+ *
+ * @param parentId the folder to start from
+ * @param recursive false to only index the folder itself
+ * @param target a persistent id to stop at, 0 to walk the whole tree
+ * @return the number of objects listed
+ */
+uint32_t indexPersistentIds(uint32_t parentId, bool recursive, uint64_t target)
+{
+  uint32_t count = 0;
+  vector<uint32_t> folders = {parentId};
+
+  for (string::size_type i = 0; i < folders.size(); i++)
+  {
+    LIBMTP_file_t *files = mtpGetFilesAndFolders(__device, currentStorageId(), folders[i]);
+    __persistentIndex.readEach(__device, files);
+
+    bool found = false;
+    LIBMTP_file_t *file, *tmp;
+    file = files;
+    while (file != NULL)
+    {
+      count++;
+      if (recursive && file->filetype == LIBMTP_FILETYPE_FOLDER)
+        folders.push_back(file->item_id);
+      if (target != 0 && __persistentIndex.get(__device, file->item_id) == target)
+        found = true;
+      tmp = file;
+      file = file->next;
+      LIBMTP_destroy_file_t(tmp);
+    }
+
+    if (found)
+      break;
+  }
+
+  return count;
+}
+
+/**
+ * index the persistent unique object ids below a folder
+ *
+ * @param info napi callback info
+               info[0] [string] folder path, the root can be use character / to express
+               info[1] [object] options
+                                recursive [bool] index the whole sub tree, default true
+ * @return the number of objects indexed
+ */
+Napi::Number buildPersistentIndex(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  ApiScope scope(API_buildPersistentIndex);
+
+  if (info.Length() < 1)
+  {
+    throw Napi::Error::New(env, "Wrong number of arguments");
+  }
+
+  if (!info[0].IsString())
+  {
+    throw Napi::TypeError::New(env, "Wrong arguments");
+  }
+
+  string folderPath = info[0].As<Napi::String>().Utf8Value();
+
+  folderPath = formatMtpPath(folderPath);
+
+  if (!__device)
+  {
+    throw Napi::Error::New(env, "Device not connected.");
+  }
+
+  uint32_t folderId = LIBMTP_FILES_AND_FOLDERS_ROOT;
+
+  if (folderPath.length() > 0)
+  {
+    LIBMTP_file_t *folder = findFile(__device, folderPath);
+
+    if (!folder)
+    {
+      throw Napi::Error::New(env, "Can not find the folder.");
+    }
+
+    folderId = folder->item_id;
+    LIBMTP_destroy_file_t(folder);
+  }
+
+  return Napi::Number::New(env, indexPersistentIds(folderId, getBoolOption(info[1], "recursive", true), 0));
+}
+
+/**
+ * find an object by its persistent unique object id
+ *
+ * the id is looked up in the index built by listings made with the <code>persistentId</code>
+ * option and by <code>buildPersistentIndex</code>, the storage is walked if it is not indexed
+ *
+ * @param info napi callback info
+               info[0] [string] the persistent id
+               info[1] [object] options
+                                scan [bool] walk the storage if the id is not indexed, default true
+ * @return the object, null if not found
+ */
+Napi::Value resolveByPersistentId(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  ApiScope scope(API_resolveByPersistentId);
+  PriorityScope priority(PRIORITY_INTERACTIVE);
+
+  if (info.Length() < 1)
+  {
+    throw Napi::Error::New(env, "Wrong number of arguments");
+  }
+
+  uint64_t persistentId;
+  if (!info[0].IsString() || !parsePersistentId(info[0].As<Napi::String>().Utf8Value(), persistentId) || persistentId == 0)
+  {
+    throw Napi::TypeError::New(env, "Wrong arguments");
+  }
+
+  if (!__device)
+  {
+    throw Napi::Error::New(env, "Device not connected.");
+  }
+
+  bool scanned = false;
+  while (true)
+  {
+    uint32_t itemId;
+    if (__persistentIndex.find(persistentId, itemId))
+    {
+      LIBMTP_file_t *file = mtpGetFilemetadata(__device, itemId);
+
+      if (file)
+      {
+        Napi::Object fileObj = Napi::Object::New(env);
+        initFileObj(file, fileObj, true);
+        LIBMTP_destroy_file_t(file);
+        return fileObj;
+      }
+
+      // the object was removed since it was indexed
+      __persistentIndex.remove(itemId);
+    }
+
+    if (scanned || !getBoolOption(info[1], "scan", true))
+      return env.Null();
+
+    indexPersistentIds(LIBMTP_FILES_AND_FOLDERS_ROOT, true, persistentId);
+    scanned = true;
+  }
+}
+
+/**
+ * start recording every libmtp call made by the addon into a trace file
+ *
+ * the trace holds the function, arguments, results and wall time of each call,
+ * a build with the replay backend plays it back without the device
+ *
+ * @param info napi callback info
+               info[0] [string] trace file path, overwritten
+ * @return true if recording started
+ */
+Napi::Boolean startRecording(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+
+  if (info.Length() < 1)
+  {
+    throw Napi::Error::New(env, "Wrong number of arguments");
+  }
+
+  if (!info[0].IsString())
+  {
+    throw Napi::TypeError::New(env, "Wrong arguments");
+  }
+
+  if (!startTraceRecording(info[0].As<Napi::String>().Utf8Value()))
+  {
+    throw Napi::Error::New(env, "Can not start recording.");
+  }
+
+  return Napi::Boolean::New(env, true);
+}
+
+/**
+ * stop recording libmtp calls and close the trace file
+ *
+ * @param info napi callback info
+ * @return the number of calls recorded
+ */
+Napi::Number stopRecording(const Napi::CallbackInfo &info)
+{
+  return Napi::Number::New(info.Env(), stopTraceRecording());
+}
+
+/**
+ * start writing a timeline of the native operations as Chrome trace event json
+ *
+ * the timeline has spans for each export, path resolution, libmtp call,
+ * marshalling and progress callback, on the thread that ran them
+ *
+ * @param info napi callback info
+               info[0] [string] json file path, overwritten
+ * @return true if tracing started
+ */
+Napi::Boolean startTracing(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+
+  if (info.Length() < 1)
+  {
+    throw Napi::Error::New(env, "Wrong number of arguments");
+  }
+
+  if (!info[0].IsString())
+  {
+    throw Napi::TypeError::New(env, "Wrong arguments");
+  }
+
+  if (!startTimeline(info[0].As<Napi::String>().Utf8Value()))
+  {
+    throw Napi::Error::New(env, "Can not start tracing.");
+  }
+
+  return Napi::Boolean::New(env, true);
+}
+
+/**
+ * stop tracing and close the json file
+ *
+ * @param info napi callback info
+ * @return the number of spans written and dropped
+ */
+Napi::Object stopTracing(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  TimelineSummary summary = stopTimeline();
+
+  Napi::Object re = Napi::Object::New(env);
+  re.Set("events", (double)summary.events);
+  re.Set("dropped", (double)summary.dropped);
+  return re;
+}
+
+/**
+ * helper function to convert a latency histogram, values in milliseconds
+ *
+ * @param env napi env
+ * @param latency the histogram
+ * @return latency object
+ */
+Napi::Object latencyObj(Napi::Env env, const LatencyHistogram &latency)
+{
+  uint64_t count = latency.count();
+
+  Napi::Object re = Napi::Object::New(env);
+  re.Set("total", latency.totalNs() / 1e6);
+  re.Set("min", latency.minNs() / 1e6);
+  re.Set("mean", count ? latency.totalNs() / 1e6 / count : 0);
+  re.Set("p50", latency.valueAtPercentile(50) / 1e6);
+  re.Set("p90", latency.valueAtPercentile(90) / 1e6);
+  re.Set("p99", latency.valueAtPercentile(99) / 1e6);
+  re.Set("p999", latency.valueAtPercentile(99.9) / 1e6);
+  re.Set("max", latency.maxNs() / 1e6);
+  return re;
+}
+
+/**
+ * helper function to get the throughput in bytes per second over the time spent in calls
+ */
+double throughput(uint64_t bytes, const LatencyHistogram &latency)
+{
+  uint64_t ns = latency.totalNs();
+  return ns ? bytes * 1e9 / ns : 0;
+}
+
+/**
+ * set the rate limit of each device, or of a named limit shared by the transfers given its name
+ *
+ * the limits are token buckets applied to every chunk in the data handlers,
+ * a change is effective from the next chunk of the transfers running
+ *
+ * @param info napi callback info
+               info[0] [number] bytes per second, 0 for no limit
+               info[1] [string] the name of the limit, the limit of each device when not given
+ * @return true if the operate was successful
+ */
+Napi::Boolean setRateLimit(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+
+  if (info.Length() < 1)
+  {
+    throw Napi::Error::New(env, "Wrong number of arguments");
+  }
+
+  if (!info[0].IsNumber() || info[0].As<Napi::Number>().DoubleValue() < 0 ||
+      (info.Length() > 1 && !info[1].IsString() && !info[1].IsUndefined()))
+  {
+    throw Napi::TypeError::New(env, "Wrong arguments");
+  }
+
+  uint64_t rate = (uint64_t)info[0].As<Napi::Number>().DoubleValue();
+  if (info.Length() > 1 && info[1].IsString())
+    namedRateLimit(info[1].As<Napi::String>().Utf8Value())->setRate(rate);
+  else
+    setDeviceRateLimit(rate);
+  return Napi::Boolean::New(env, true);
+}
+
+/**
+ * helper function to convert the counters of a rate limit
+ */
+Napi::Object rateLimitObj(Napi::Env env, TokenBucket &bucket)
+{
+  TokenBucketStats stats = bucket.stats();
+  Napi::Object re = Napi::Object::New(env);
+  re.Set("limit", (double)stats.rate);
+  re.Set("bytes", (double)stats.bytes);
+  re.Set("delayed", stats.delayedNs / 1e6);
+  re.Set("throughput", stats.activeNs ? stats.bytes * 1e9 / stats.activeNs : 0);
+  return re;
+}
+
+/**
+ * enable or disable the collection of statistics
+ *
+ * statistics are disabled by default, or enabled by the LUCK_MTP_STATS environment variable
+ *
+ * @param info napi callback info
+               info[0] [bool] enabled, default true
+ * @return true if statistics were enabled before the call
+ */
+Napi::Boolean enableStats(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  bool enabled = info.Length() < 1 || info[0].ToBoolean().Value();
+  bool previous = statsEnabled();
+  setStatsEnabled(enabled);
+  return Napi::Boolean::New(env, previous);
+}
+
+/**
+ * get the statistics of the libmtp calls made since the last reset
+ *
+ * calls are broken down by libmtp function, and by exported function with the
+ * number of calls of each libmtp function made while it ran
+ *
+ * @param info napi callback info
+ * @return statistics object
+ */
+Napi::Object getStats(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+
+  Napi::Object functions = Napi::Object::New(env);
+  for (int i = 0; i < MTP_FN_COUNT; i++)
+  {
+    const FunctionStats &stats = functionStats((MtpFunction)i);
+    if (stats.latency.count() == 0)
+      continue;
+
+    Napi::Object functionObj = Napi::Object::New(env);
+    functionObj.Set("calls", (double)stats.latency.count());
+    functionObj.Set("bytes", (double)stats.bytes);
+    functionObj.Set("throughput", throughput(stats.bytes, stats.latency));
+    functionObj.Set("latency", latencyObj(env, stats.latency));
+    functions.Set(mtpFunctionName(i), functionObj);
+  }
+
+  Napi::Object exportsObj = Napi::Object::New(env);
+  for (int i = 0; i < API_COUNT; i++)
+  {
+    const ExportStats &stats = exportStats((ApiExport)i);
+    if (stats.latency.count() == 0)
+      continue;
+
+    uint64_t mtpCalls = 0;
+    Napi::Object callsObj = Napi::Object::New(env);
+    for (int j = 0; j < MTP_FN_COUNT; j++)
+    {
+      uint64_t calls = stats.functions[j];
+      if (calls == 0)
+        continue;
+      mtpCalls += calls;
+      callsObj.Set(mtpFunctionName(j), (double)calls);
+    }
+
+    Napi::Object exportObj = Napi::Object::New(env);
+    exportObj.Set("calls", (double)stats.latency.count());
+    exportObj.Set("errors", (double)stats.errors);
+    exportObj.Set("bytes", (double)stats.bytes);
+    exportObj.Set("throughput", throughput(stats.bytes, stats.latency));
+    exportObj.Set("mtpCalls", (double)mtpCalls);
+    exportObj.Set("functions", callsObj);
+    exportObj.Set("latency", latencyObj(env, stats.latency));
+    exportsObj.Set(apiExportName(i), exportObj);
+  }
+
+  BufferPoolStats pool = poolStats();
+  Napi::Object poolObj = Napi::Object::New(env);
+  poolObj.Set("slabSize", (double)POOL_SLAB_SIZE);
+  poolObj.Set("acquired", (double)pool.acquired);
+  poolObj.Set("hits", (double)pool.hits);
+  poolObj.Set("hitRate", pool.acquired ? (double)pool.hits / pool.acquired : 0);
+  poolObj.Set("allocated", (double)pool.allocated);
+  poolObj.Set("inUse", (double)pool.inUse);
+  poolObj.Set("highWater", (double)pool.highWater);
+
+  ThumbnailCacheStats thumbnails = __thumbnails.stats();
+  Napi::Object thumbnailsObj = Napi::Object::New(env);
+  thumbnailsObj.Set("memoryHits", (double)thumbnails.memoryHits);
+  thumbnailsObj.Set("diskHits", (double)thumbnails.diskHits);
+  thumbnailsObj.Set("misses", (double)thumbnails.misses);
+  thumbnailsObj.Set("entries", (double)thumbnails.entries);
+  thumbnailsObj.Set("bytes", (double)thumbnails.bytes);
+
+  Napi::Object schedulerObj = Napi::Object::New(env);
+  for (int i = 0; i < PRIORITY_COUNT; i++)
+  {
+    SchedulerQueueStats queue = schedulerQueueStats((Priority)i);
+    Napi::Object classObj = Napi::Object::New(env);
+    classObj.Set("queued", (double)queue.queued);
+    classObj.Set("maxQueued", (double)queue.maxQueued);
+    classObj.Set("acquired", (double)queue.acquired);
+    classObj.Set("waited", (double)queue.waited);
+    classObj.Set("wait", latencyObj(env, schedulerWaits((Priority)i)));
+    schedulerObj.Set(priorityName(i), classObj);
+  }
+
+  Napi::Object namedObj = Napi::Object::New(env);
+  for (auto &named : namedRateLimits())
+    namedObj.Set(named.first, rateLimitObj(env, *named.second));
+  Napi::Object rateLimitsObj = Napi::Object::New(env);
+  rateLimitsObj.Set("device", rateLimitObj(env, *deviceRateLimit(__device)));
+  rateLimitsObj.Set("named", namedObj);
+
+  Napi::Object re = Napi::Object::New(env);
+  re.Set("enabled", statsEnabled());
+  re.Set("elapsed", statsElapsedMs());
+  re.Set("functions", functions);
+  re.Set("exports", exportsObj);
+  re.Set("pool", poolObj);
+  re.Set("thumbnails", thumbnailsObj);
+  re.Set("scheduler", schedulerObj);
+  re.Set("rateLimits", rateLimitsObj);
+  return re;
+}
+
+/**
+ * clear the statistics
+ *
+ * @param info napi callback info
+ * @return true if the operate was successful
+ */
+Napi::Boolean resetCallStats(const Napi::CallbackInfo &info)
+{
+  resetStats();
+  resetPoolStats();
+  __thumbnails.resetStats();
+  resetSchedulerStats();
+  for (auto &device : deviceRateLimits())
+    device.second->resetStats();
+  for (auto &named : namedRateLimits())
+    named.second->resetStats();
+  return Napi::Boolean::New(info.Env(), true);
+}
+
 Napi::Object Init(Napi::Env env, Napi::Object exports)
 {
   // multi require only call once
   LIBMTP_Init();
+  if (getenv("LUCK_MTP_STATS"))
+  {
+    setStatsEnabled(true);
+  }
   exports.Set(Napi::String::New(env, "download"),
               Napi::Function::New(env, download));
   exports.Set(Napi::String::New(env, "connect"),
@@ -962,6 +4113,36 @@ Napi::Object Init(Napi::Env env, Napi::Object exports)
               Napi::Function::New(env, release));
   exports.Set(Napi::String::New(env, "upload"),
               Napi::Function::New(env, upload));
+  exports.Set(Napi::String::New(env, "downloadArchive"),
+              Napi::Function::New(env, downloadArchive));
+  exports.Set(Napi::String::New(env, "uploadArchive"),
+              Napi::Function::New(env, uploadArchive));
+  exports.Set(Napi::String::New(env, "readFile"),
+              Napi::Function::New(env, readFile));
+  exports.Set(Napi::String::New(env, "writeFile"),
+              Napi::Function::New(env, writeFile));
+  exports.Set(Napi::String::New(env, "getThumbnails"),
+              Napi::Function::New(env, getThumbnails));
+  exports.Set(Napi::String::New(env, "statMany"),
+              Napi::Function::New(env, statMany));
+  exports.Set(Napi::String::New(env, "transfer"),
+              Napi::Function::New(env, transferBetween));
+  exports.Set(Napi::String::New(env, "broadcastUpload"),
+              Napi::Function::New(env, broadcastUploadFile));
+  exports.Set(Napi::String::New(env, "watchAndPush"),
+              Napi::Function::New(env, watchAndPush));
+  exports.Set(Napi::String::New(env, "stopWatch"),
+              Napi::Function::New(env, stopWatch));
+  exports.Set(Napi::String::New(env, "startChangeJournal"),
+              Napi::Function::New(env, startChangeJournal));
+  exports.Set(Napi::String::New(env, "stopChangeJournal"),
+              Napi::Function::New(env, stopChangeJournal));
+  exports.Set(Napi::String::New(env, "getChanges"),
+              Napi::Function::New(env, getChanges));
+  exports.Set(Napi::String::New(env, "listZip"),
+              Napi::Function::New(env, listZip));
+  exports.Set(Napi::String::New(env, "extractZipEntry"),
+              Napi::Function::New(env, extractZipEntry));
   exports.Set(Napi::String::New(env, "del"),
               Napi::Function::New(env, del));
   exports.Set(Napi::String::New(env, "getList"),
@@ -978,8 +4159,34 @@ Napi::Object Init(Napi::Env env, Napi::Object exports)
               Napi::Function::New(env, setFolderName));
   exports.Set(Napi::String::New(env, "createFolder"),
               Napi::Function::New(env, createFolder));
+  exports.Set(Napi::String::New(env, "buildPersistentIndex"),
+              Napi::Function::New(env, buildPersistentIndex));
+  exports.Set(Napi::String::New(env, "resolveByPersistentId"),
+              Napi::Function::New(env, resolveByPersistentId));
+  exports.Set(Napi::String::New(env, "startRecording"),
+              Napi::Function::New(env, startRecording));
+  exports.Set(Napi::String::New(env, "stopRecording"),
+              Napi::Function::New(env, stopRecording));
+  exports.Set(Napi::String::New(env, "startTracing"),
+              Napi::Function::New(env, startTracing));
+  exports.Set(Napi::String::New(env, "stopTracing"),
+              Napi::Function::New(env, stopTracing));
+  exports.Set(Napi::String::New(env, "setRateLimit"),
+              Napi::Function::New(env, setRateLimit));
+  exports.Set(Napi::String::New(env, "enableStats"),
+              Napi::Function::New(env, enableStats));
+  exports.Set(Napi::String::New(env, "getStats"),
+              Napi::Function::New(env, getStats));
+  exports.Set(Napi::String::New(env, "resetStats"),
+              Napi::Function::New(env, resetCallStats));
   exports.Set(Napi::String::New(env, "getDeviceInfo"),
               Napi::Function::New(env, getDeviceInfo));
+  exports.Set(Napi::String::New(env, "refreshDevices"),
+              Napi::Function::New(env, refreshDevices));
+  exports.Set(Napi::String::New(env, "startDiscovery"),
+              Napi::Function::New(env, startDiscovery));
+  exports.Set(Napi::String::New(env, "stopDiscovery"),
+              Napi::Function::New(env, stopDiscovery));
   exports.Set(Napi::String::New(env, "getCurrentDeviceStorageInfo"),
               Napi::Function::New(env, getCurrentDeviceStorageInfo));
   exports.Set(Napi::String::New(env, "setStorage"),
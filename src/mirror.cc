@@ -0,0 +1,390 @@
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "utils.h"
+#include "mtp_call.h"
+#include "transfer.h"
+#include "mirror.h"
+
+using namespace std;
+
+/**
+ * helper function to get the name of a relative path
+ */
+static string baseName(const string &path)
+{
+  size_t slash = path.rfind('/');
+  return slash == string::npos ? path : path.substr(slash + 1);
+}
+
+/**
+ * helper function to get the parent of a relative path, empty for the mirrored directory itself
+ */
+static string parentPath(const string &path)
+{
+  size_t slash = path.rfind('/');
+  return slash == string::npos ? "" : path.substr(0, slash);
+}
+
+void DeviceMirror::apply(const WatchBatch &batch)
+{
+  if (!_seeded)
+    seed();
+
+  if (batch.overflow)
+  {
+    sync();
+    return;
+  }
+
+  // both sides of a rename are pushed afterwards, which settles a rename that
+  // could not be applied, or a file changed after it was renamed
+  set<string> paths = batch.paths;
+  for (const auto &names : batch.renames)
+  {
+    if (_cancelled)
+      return;
+    rename(names.first, names.second);
+    paths.insert(names.first);
+    paths.insert(names.second);
+  }
+
+  // a parent sorts before its children, a removed folder takes them along first
+  for (const string &path : paths)
+  {
+    if (_cancelled)
+      return;
+    push(path);
+  }
+}
+
+/**
+ * fill the map from a listing of the device folder, the only one made
+ *
+ * the modification dates of the device are not those of the local files, a
+ * seeded file gets none and is compared by its content the first time
+ */
+void DeviceMirror::seed()
+{
+  vector<TreeEntry> entries;
+  listTree(_device, _storage, _folder, entries);
+  for (const TreeEntry &entry : entries)
+    _entries[entry.path] = {entry.id, entry.size, 0, entry.folder};
+  _seeded = true;
+}
+
+/**
+ * compare the whole local tree with the map, push what differs and delete what is gone
+ */
+void DeviceMirror::sync()
+{
+  map<string, LocalEntry> local;
+  scanDirectory(_directory, "", local);
+
+  for (const auto &entry : local)
+  {
+    if (_cancelled)
+      return;
+    push(entry.first);
+  }
+
+  vector<string> extra;
+  for (const auto &entry : _entries)
+  {
+    if (local.find(entry.first) == local.end())
+      extra.push_back(entry.first);
+  }
+  for (const string &path : extra)
+  {
+    if (_cancelled)
+      return;
+    remove(path);
+  }
+}
+
+/**
+ * rename or move the object of a path on the device
+ *
+ * @return false if the rename was not applied, the paths are then pushed as they are
+ */
+bool DeviceMirror::rename(const string &from, const string &to)
+{
+  auto found = _entries.find(from);
+  LocalEntry local;
+  if (found == _entries.end() || !statLocal(_directory + "/" + to, local) || local.folder != found->second.folder)
+    return false;
+  Entry entry = found->second;
+
+  bool sameFolder = parentPath(from) == parentPath(to);
+  if (!sameFolder && mtpCheckCapability(_device, LIBMTP_DEVICECAP_MoveObject) == 0)
+    return false;
+
+  // a file renamed over another one replaces it, as with an atomic save
+  auto replaced = _entries.find(to);
+  if (replaced != _entries.end() && !remove(to))
+    return false;
+
+  if (!sameFolder)
+  {
+    // unlike SendObjectInfo, MoveObject takes 0 for the root of the storage
+    uint32_t parent;
+    if (!parentId(to, parent) ||
+        mtpMoveObject(_device, entry.id, _storage, parent == LIBMTP_FILES_AND_FOLDERS_ROOT ? 0 : parent) != 0)
+    {
+      fail(to, "Error moving the object on the MTP device.");
+      return false;
+    }
+  }
+
+  string name = baseName(to);
+  if (name != baseName(from))
+  {
+    int ret;
+    if (entry.folder)
+    {
+      LIBMTP_folder_t *folder = LIBMTP_new_folder_t();
+      folder->folder_id = entry.id;
+      folder->storage_id = _storage;
+      folder->name = strdup(baseName(from).c_str());
+      ret = mtpSetFolderName(_device, folder, name.c_str());
+      LIBMTP_destroy_folder_t(folder);
+    }
+    else
+    {
+      LIBMTP_file_t *file = LIBMTP_new_file_t();
+      file->item_id = entry.id;
+      file->storage_id = _storage;
+      file->filename = strdup(baseName(from).c_str());
+      file->filetype = find_filetype(file->filename);
+      ret = mtpSetFileName(_device, file, name.c_str());
+      LIBMTP_destroy_file_t(file);
+    }
+    if (ret != 0)
+    {
+      // the object may have moved already, it is known under its new folder
+      if (!sameFolder)
+        moveEntries(from, parentPath(to).empty() ? baseName(from) : parentPath(to) + "/" + baseName(from));
+      fail(to, "Error renaming the object on the MTP device.");
+      return false;
+    }
+  }
+
+  moveEntries(from, to);
+  emit("rename", to, entry.id, from);
+  return true;
+}
+
+/**
+ * bring the object of a path in line with the local file or folder
+ */
+void DeviceMirror::push(const string &path)
+{
+  LocalEntry local;
+  if (!statLocal(_directory + "/" + path, local))
+  {
+    remove(path);
+    return;
+  }
+
+  auto found = _entries.find(path);
+  if (found != _entries.end() && found->second.folder != local.folder && !remove(path))
+    return;
+
+  if (local.folder)
+    pushFolder(path, local);
+  else
+    pushFile(path, local);
+}
+
+/**
+ * create the folder of a path, with its content, if it is not on the device yet
+ */
+bool DeviceMirror::pushFolder(const string &path, const LocalEntry &local)
+{
+  if (_entries.find(path) != _entries.end())
+    return true;
+
+  uint32_t parent;
+  if (!parentId(path, parent))
+    return false;
+
+  char *name = strdup(baseName(path).c_str());
+  uint32_t id = mtpCreateFolder(_device, name, parent, _storage);
+  free(name);
+  if (id == 0)
+  {
+    fail(path, "Error creating the folder on the MTP device.");
+    return false;
+  }
+  _entries[path] = {id, 0, local.mtime, true};
+  emit("create", path, id);
+
+  // a folder moved in from outside the directory comes with its content
+  map<string, LocalEntry> content;
+  scanDirectory(_directory, path, content);
+  for (const auto &entry : content)
+  {
+    if (_cancelled)
+      break;
+    push(entry.first);
+  }
+  return true;
+}
+
+/**
+ * upload the file of a path if it is new or changed, in place when the device can edit objects
+ */
+bool DeviceMirror::pushFile(const string &path, const LocalEntry &local)
+{
+  string localPath = _directory + "/" + path;
+  auto found = _entries.find(path);
+  if (found != _entries.end() && found->second.size == local.size)
+  {
+    if (found->second.mtime == local.mtime)
+      return true;
+
+    uint64_t sampled;
+    if (found->second.mtime == 0 &&
+        sampleCompare(_device, found->second.id, localPath.c_str(), local.size, sampled) == SAMPLE_IDENTICAL)
+    {
+      found->second.mtime = local.mtime;
+      return true;
+    }
+  }
+
+  StreamHash hash;
+  if (found != _entries.end())
+  {
+    DeltaResult changes;
+    int ret = deltaUpload(_device, found->second.id, found->second.size, localPath.c_str(), local.size, hash, NULL,
+                          NULL, changes);
+    if (ret == 0)
+    {
+      found->second.size = local.size;
+      found->second.mtime = local.mtime;
+      emit("update", path, found->second.id);
+      return true;
+    }
+    if (ret < 0)
+    {
+      fail(path, "Error updating the file on the MTP device.");
+      return false;
+    }
+  }
+
+  uint32_t parent;
+  if (!parentId(path, parent))
+    return false;
+
+  string filename = baseName(path);
+  LIBMTP_file_t *genfile = LIBMTP_new_file_t();
+  genfile->filesize = local.size;
+  genfile->filename = strdup(filename.c_str());
+  genfile->filetype = find_filetype(filename.c_str());
+  genfile->parent_id = parent;
+  genfile->storage_id = _storage;
+  int ret = uploadFromFile(_device, localPath.c_str(), genfile, hash, NULL, NULL);
+  uint32_t id = genfile->item_id;
+  LIBMTP_destroy_file_t(genfile);
+  if (ret != 0)
+  {
+    fail(path, "Error upload file to MTP device.");
+    return false;
+  }
+
+  // the previous copy is only removed once the new one is on the device, a
+  // folder replaced by a file went through remove() already
+  bool existed = found != _entries.end();
+  if (existed && deleteTree(_device, _storage, found->second.id, found->second.folder, NULL) != 0)
+    fail(path, "Error deleting the previous file.");
+  _entries[path] = {id, local.size, local.mtime, false};
+  emit(existed ? "update" : "create", path, id);
+  return true;
+}
+
+/**
+ * delete the object of a path, and the entries of its children
+ *
+ * @return true if the path is not on the device anymore
+ */
+bool DeviceMirror::remove(const string &path)
+{
+  auto found = _entries.find(path);
+  if (found == _entries.end())
+    return true;
+
+  // a folder is deleted with everything below it, children first
+  if (deleteTree(_device, _storage, found->second.id, found->second.folder, NULL) != 0)
+  {
+    fail(path, "Error deleting the object on the MTP device.");
+    return false;
+  }
+
+  _entries.erase(found);
+  string prefix = path + "/";
+  for (auto child = _entries.lower_bound(prefix);
+       child != _entries.end() && child->first.compare(0, prefix.size(), prefix) == 0;)
+    child = _entries.erase(child);
+
+  emit("delete", path, 0);
+  return true;
+}
+
+/**
+ * get the device folder of a path, its missing parents are created first
+ */
+bool DeviceMirror::parentId(const string &path, uint32_t &id)
+{
+  string parent = parentPath(path);
+  if (parent.empty())
+  {
+    id = _folder;
+    return true;
+  }
+
+  auto found = _entries.find(parent);
+  if (found == _entries.end())
+  {
+    LocalEntry local;
+    if (!statLocal(_directory + "/" + parent, local) || !local.folder || !pushFolder(parent, local))
+      return false;
+    found = _entries.find(parent);
+  }
+  if (found == _entries.end() || !found->second.folder)
+    return false;
+  id = found->second.id;
+  return true;
+}
+
+/**
+ * move the entry of a path, and those of its children, to a new path
+ */
+void DeviceMirror::moveEntries(const string &from, const string &to)
+{
+  string prefix = from + "/";
+  vector<pair<string, Entry>> moved;
+  for (auto entry = _entries.begin(); entry != _entries.end();)
+  {
+    if (entry->first == from || entry->first.compare(0, prefix.size(), prefix) == 0)
+    {
+      moved.push_back(make_pair(to + entry->first.substr(from.size()), entry->second));
+      entry = _entries.erase(entry);
+    }
+    else
+      entry++;
+  }
+  for (auto &entry : moved)
+    _entries[entry.first] = entry.second;
+}
+
+void DeviceMirror::emit(const string &op, const string &path, uint32_t id, const string &from)
+{
+  if (_callback)
+    _callback({op, path, from, id, ""});
+}
+
+void DeviceMirror::fail(const string &path, const string &error)
+{
+  if (_callback)
+    _callback({"error", path, "", 0, error});
+}
@@ -0,0 +1,108 @@
+#ifndef LUCK_MTP_MIRROR
+#define LUCK_MTP_MIRROR
+
+#include <stdint.h>
+#include <time.h>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <string>
+#include "libmtp.h"
+#include "watcher.h"
+
+using namespace std;
+
+/**
+ * an operation applied to the device by a mirror
+ */
+struct MirrorEvent
+{
+  // create, update, delete, rename or error
+  string op;
+  // the local path, relative to the mirrored directory
+  string path;
+  // the previous path of a rename
+  string from;
+  // the object id on the device, 0 after a delete
+  uint32_t id;
+  // the message of an error
+  string error;
+};
+
+typedef function<void(const MirrorEvent &)> MirrorCallback;
+
+/**
+ * keep a device folder a copy of a local directory
+ *
+ * the object id of every local path pushed is kept in a map, seeded once from
+ * a listing of the device folder, so a change is applied without resolving
+ * any path on the device nor listing a folder again. a batch of changes is
+ * applied from the current state of the paths it names: renames first, with
+ * SetObjectPropValue on the name, and MoveObject when the folder changes and
+ * the device supports it, then every path is created, updated or deleted
+ * after what is on the disk at that time.
+ */
+class DeviceMirror
+{
+public:
+  /**
+   * @param device the connected device
+   * @param storage the storage id
+   * @param folder the device folder id, LIBMTP_FILES_AND_FOLDERS_ROOT for the root of the storage
+   * @param directory the local directory
+   * @param callback called with every operation applied
+   */
+  DeviceMirror(LIBMTP_mtpdevice_t *device, uint32_t storage, uint32_t folder, const string &directory,
+               MirrorCallback callback)
+      : _device(device), _storage(storage), _folder(folder), _directory(directory), _callback(callback)
+  {
+  }
+
+  /**
+   * apply a batch of local changes, a batch with <code>overflow</code> set
+   * compares the whole local tree with the map instead
+   */
+  void apply(const WatchBatch &batch);
+
+  /**
+   * stop the batch being applied after the current operation
+   */
+  void cancel() { _cancelled = true; }
+
+  /**
+   * @return the number of paths in the map
+   */
+  size_t size() const { return _entries.size(); }
+
+private:
+  struct Entry
+  {
+    uint32_t id;
+    uint64_t size;
+    time_t mtime;
+    bool folder;
+  };
+
+  void seed();
+  void sync();
+  bool rename(const string &from, const string &to);
+  void push(const string &path);
+  bool pushFolder(const string &path, const LocalEntry &local);
+  bool pushFile(const string &path, const LocalEntry &local);
+  bool remove(const string &path);
+  bool parentId(const string &path, uint32_t &id);
+  void moveEntries(const string &from, const string &to);
+  void emit(const string &op, const string &path, uint32_t id, const string &from = "");
+  void fail(const string &path, const string &error);
+
+  LIBMTP_mtpdevice_t *_device;
+  uint32_t _storage;
+  uint32_t _folder;
+  string _directory;
+  MirrorCallback _callback;
+  map<string, Entry> _entries;
+  bool _seeded = false;
+  atomic<bool> _cancelled{false};
+};
+
+#endif
@@ -0,0 +1,607 @@
+#include <sys/stat.h>
+#include <atomic>
+#include "mtp_call.h"
+#include "scheduler.h"
+#include "rate_limit.h"
+#include "stats.h"
+#include "timeline.h"
+#include "change_journal.h"
+
+using namespace std;
+
+static TraceWriter __traceWriter;
+static atomic<bool> __traceRecording(false);
+
+/**
+ * helper function to tell the calls that take the session of their device
+ *
+ * a bus scan does not use a device, the discovery thread must not wait for a
+ * long transfer. events come on the interrupt endpoint, outside of the session.
+ */
+static bool scheduledFunction(MtpFunction function)
+{
+  return function != MTP_FN_Detect_Raw_Devices && function != MTP_FN_Read_Event_Async &&
+         function != MTP_FN_Handle_Events_Timeout_Completed;
+}
+
+MtpCall::MtpCall(MtpFunction function, const void *device)
+    : _scheduled(scheduledFunction(function)), _device(device), _function(function), _elapsedNs(0), _excludedNs(0), _bytes(0), _ended(false), _stats(statsEnabled()), _timeline(timelineEnabled()), _record(NULL)
+{
+  if (_scheduled)
+    schedulerAcquire(_device);
+  if (__traceRecording.load(memory_order_relaxed))
+  {
+    _record = new TraceRecord();
+    _record->function = function;
+  }
+  if (timed())
+    _start = chrono::steady_clock::now();
+}
+
+MtpCall::~MtpCall()
+{
+  end();
+  if (_stats)
+    recordMtpCall(_function, _elapsedNs, _bytes);
+  if (_timeline)
+    timelineSpan(mtpFunctionName(_function), "libmtp", _start, _start + chrono::nanoseconds(_elapsedNs), _bytes);
+  if (_record)
+  {
+    _record->elapsedNs = _elapsedNs;
+    __traceWriter.write(*_record);
+    delete _record;
+  }
+  if (_scheduled)
+    schedulerRelease(_device);
+}
+
+void MtpCall::end()
+{
+  if (_ended || !timed())
+    return;
+  _ended = true;
+  _elapsedNs = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - _start).count();
+  _elapsedNs -= min(_excludedNs, _elapsedNs);
+}
+
+void MtpCall::arg(const TraceValue &value)
+{
+  if (_record)
+    _record->args.push_back(value);
+}
+
+void MtpCall::result(const TraceValue &value)
+{
+  if (_record)
+    _record->result = value;
+}
+
+void MtpCall::out(const TraceValue &value)
+{
+  if (_record)
+    _record->outs.push_back(value);
+}
+
+void MtpCall::size(uint64_t bytes)
+{
+  _bytes = bytes;
+  if (_record)
+    _record->size = bytes;
+}
+
+bool startTraceRecording(const string &path)
+{
+  if (!__traceWriter.open(path))
+    return false;
+  __traceRecording = true;
+  return true;
+}
+
+uint64_t stopTraceRecording()
+{
+  __traceRecording = false;
+  return __traceWriter.close();
+}
+
+/**
+ * helper function to get the size of a local file
+ */
+static uint64_t localFileSize(const char *path)
+{
+  struct stat st;
+  return stat(path, &st) == 0 ? st.st_size : 0;
+}
+
+LIBMTP_error_number_t mtpDetectRawDevices(LIBMTP_raw_device_t **devices, int *numdevs)
+{
+  MtpCall call(MTP_FN_Detect_Raw_Devices);
+  LIBMTP_error_number_t err = LIBMTP_Detect_Raw_Devices(devices, numdevs);
+  call.end();
+  if (call.recording())
+  {
+    call.result(traceInt(err));
+    call.out(traceRawDevices(*devices, err == LIBMTP_ERROR_NONE ? *numdevs : 0));
+  }
+  return err;
+}
+
+/**
+ * helper function to record the arguments and result of an open call
+ */
+static void recordOpen(MtpCall &call, LIBMTP_raw_device_t *rawdevice, LIBMTP_mtpdevice_t *device)
+{
+  if (!call.recording())
+    return;
+  call.arg(traceInt(rawdevice ? rawdevice->devnum : 0));
+  call.result(traceInt(device != NULL));
+  if (device)
+    call.out(traceStorages(device->storage));
+}
+
+LIBMTP_mtpdevice_t *mtpOpenRawDevice(LIBMTP_raw_device_t *rawdevice)
+{
+  MtpCall call(MTP_FN_Open_Raw_Device);
+  LIBMTP_mtpdevice_t *device = LIBMTP_Open_Raw_Device(rawdevice);
+  call.end();
+  recordOpen(call, rawdevice, device);
+  return device;
+}
+
+LIBMTP_mtpdevice_t *mtpOpenRawDeviceUncached(LIBMTP_raw_device_t *rawdevice)
+{
+  MtpCall call(MTP_FN_Open_Raw_Device_Uncached);
+  LIBMTP_mtpdevice_t *device = LIBMTP_Open_Raw_Device_Uncached(rawdevice);
+  call.end();
+  recordOpen(call, rawdevice, device);
+  return device;
+}
+
+void mtpReleaseDevice(LIBMTP_mtpdevice_t *device)
+{
+  {
+    MtpCall call(MTP_FN_Release_Device, device);
+    LIBMTP_Release_Device(device);
+  }
+  dropDeviceRateLimit(device);
+}
+
+char *mtpGetSerialnumber(LIBMTP_mtpdevice_t *device)
+{
+  MtpCall call(MTP_FN_Get_Serialnumber, device);
+  char *serial = LIBMTP_Get_Serialnumber(device);
+  call.end();
+  if (call.recording())
+    call.result(traceString(serial));
+  return serial;
+}
+
+int mtpGetStorage(LIBMTP_mtpdevice_t *device, int const sortby)
+{
+  MtpCall call(MTP_FN_Get_Storage, device);
+  int ret = LIBMTP_Get_Storage(device, sortby);
+  call.end();
+  if (call.recording())
+  {
+    call.result(traceInt(ret));
+    call.out(traceStorages(device->storage));
+  }
+  return ret;
+}
+
+LIBMTP_file_t *mtpGetFilesAndFolders(LIBMTP_mtpdevice_t *device, uint32_t const storage, uint32_t const parent)
+{
+  MtpCall call(MTP_FN_Get_Files_And_Folders, device);
+  LIBMTP_file_t *files = LIBMTP_Get_Files_And_Folders(device, storage, parent);
+  call.end();
+  if (call.recording())
+  {
+    call.arg(traceInt(storage));
+    call.arg(traceInt(parent));
+    call.result(traceFiles(files));
+  }
+  return files;
+}
+
+LIBMTP_file_t *mtpGetFilemetadata(LIBMTP_mtpdevice_t *device, uint32_t const id)
+{
+  MtpCall call(MTP_FN_Get_Filemetadata, device);
+  LIBMTP_file_t *file = LIBMTP_Get_Filemetadata(device, id);
+  call.end();
+  if (call.recording())
+  {
+    call.arg(traceInt(id));
+    if (file)
+      call.result(traceFiles(file, false));
+  }
+  return file;
+}
+
+uint64_t mtpGetU64FromObject(LIBMTP_mtpdevice_t *device, uint32_t const id,
+                             LIBMTP_property_t const property, uint64_t const value_default)
+{
+  MtpCall call(MTP_FN_Get_u64_From_Object, device);
+  uint64_t value = LIBMTP_Get_u64_From_Object(device, id, property, value_default);
+  call.end();
+  if (call.recording())
+  {
+    call.arg(traceInt(id));
+    call.arg(traceInt(property));
+    call.arg(traceInt(value_default));
+    call.result(traceInt(value));
+  }
+  return value;
+}
+
+int mtpGetFileToFile(LIBMTP_mtpdevice_t *device, uint32_t id, char const *const path,
+                     LIBMTP_progressfunc_t const callback, void const *const data)
+{
+  MtpCall call(MTP_FN_Get_File_To_File, device);
+  int ret = LIBMTP_Get_File_To_File(device, id, path, callback, data);
+  call.end();
+  if (call.recording())
+  {
+    call.arg(traceInt(id));
+    call.arg(traceString(path, false));
+    call.result(traceInt(ret));
+  }
+  if (call.timed() && ret == 0)
+    call.size(localFileSize(path));
+  return ret;
+}
+
+int mtpSendFileFromFile(LIBMTP_mtpdevice_t *device, char const *const path,
+                        LIBMTP_file_t *const filedata, LIBMTP_progressfunc_t const callback,
+                        void const *const data)
+{
+  MtpCall call(MTP_FN_Send_File_From_File, device);
+  // libmtp fills in the parent and the new handle, record the request first
+  if (call.recording())
+  {
+    call.arg(traceString(path, false));
+    call.arg(traceInt(filedata->parent_id));
+    call.arg(traceString(filedata->filename));
+  }
+  int ret = LIBMTP_Send_File_From_File(device, path, filedata, callback, data);
+  call.end();
+  if (call.recording())
+  {
+    call.result(traceInt(ret));
+    call.out(traceInt(filedata->item_id));
+    call.out(traceInt(filedata->storage_id));
+  }
+  if (ret == 0)
+  {
+    call.size(filedata->filesize);
+    recordChange(device, CHANGE_ADDED, filedata->item_id);
+  }
+  return ret;
+}
+
+int mtpDeleteObject(LIBMTP_mtpdevice_t *device, uint32_t id)
+{
+  MtpCall call(MTP_FN_Delete_Object, device);
+  int ret = LIBMTP_Delete_Object(device, id);
+  call.end();
+  if (call.recording())
+  {
+    call.arg(traceInt(id));
+    call.result(traceInt(ret));
+  }
+  if (ret == 0)
+    recordChange(device, CHANGE_REMOVED, id);
+  return ret;
+}
+
+/**
+ * helper function to record the arguments and result of a move or copy call
+ */
+static void recordMove(MtpCall &call, uint32_t id, uint32_t storage, uint32_t parent, int ret)
+{
+  if (!call.recording())
+    return;
+  call.arg(traceInt(id));
+  call.arg(traceInt(storage));
+  call.arg(traceInt(parent));
+  call.result(traceInt(ret));
+}
+
+int mtpMoveObject(LIBMTP_mtpdevice_t *device, uint32_t id, uint32_t storage, uint32_t parent)
+{
+  MtpCall call(MTP_FN_Move_Object, device);
+  int ret = LIBMTP_Move_Object(device, id, storage, parent);
+  call.end();
+  recordMove(call, id, storage, parent, ret);
+  if (ret == 0)
+    recordChange(device, CHANGE_MODIFIED, id);
+  return ret;
+}
+
+int mtpCopyObject(LIBMTP_mtpdevice_t *device, uint32_t id, uint32_t storage, uint32_t parent)
+{
+  MtpCall call(MTP_FN_Copy_Object, device);
+  int ret = LIBMTP_Copy_Object(device, id, storage, parent);
+  call.end();
+  recordMove(call, id, storage, parent, ret);
+  // libmtp does not return the id of the copy, the content of its folder changed
+  if (ret == 0)
+    recordChange(device, CHANGE_MODIFIED, parent);
+  return ret;
+}
+
+int mtpSetFileName(LIBMTP_mtpdevice_t *device, LIBMTP_file_t *file, const char *newname)
+{
+  MtpCall call(MTP_FN_Set_File_Name, device);
+  uint32_t id = file ? file->item_id : 0;
+  int ret = LIBMTP_Set_File_Name(device, file, newname);
+  call.end();
+  if (call.recording())
+  {
+    call.arg(traceInt(id));
+    call.arg(traceString(newname));
+    call.result(traceInt(ret));
+  }
+  if (ret == 0)
+    recordChange(device, CHANGE_MODIFIED, id);
+  return ret;
+}
+
+int mtpSetFolderName(LIBMTP_mtpdevice_t *device, LIBMTP_folder_t *folder, const char *newname)
+{
+  MtpCall call(MTP_FN_Set_Folder_Name, device);
+  uint32_t id = folder ? folder->folder_id : 0;
+  int ret = LIBMTP_Set_Folder_Name(device, folder, newname);
+  call.end();
+  if (call.recording())
+  {
+    call.arg(traceInt(id));
+    call.arg(traceString(newname));
+    call.result(traceInt(ret));
+  }
+  if (ret == 0)
+    recordChange(device, CHANGE_MODIFIED, id);
+  return ret;
+}
+
+uint32_t mtpCreateFolder(LIBMTP_mtpdevice_t *device, char *name, uint32_t parent_id, uint32_t storage_id)
+{
+  MtpCall call(MTP_FN_Create_Folder, device);
+  // libmtp may rewrite the name in place for devices limited to 7 bit names
+  if (call.recording())
+    call.arg(traceString(name));
+  uint32_t folderId = LIBMTP_Create_Folder(device, name, parent_id, storage_id);
+  call.end();
+  if (call.recording())
+  {
+    call.arg(traceInt(parent_id));
+    call.arg(traceInt(storage_id));
+    call.result(traceInt(folderId));
+  }
+  if (folderId != 0)
+    recordChange(device, CHANGE_ADDED, folderId);
+  return folderId;
+}
+
+/**
+ * the put handler of a download, wrapped to count the bytes it receives and hold them to the rate limits
+ *
+ * a single libmtp transfer keeps the session until it ends, the wait can not
+ * be moved out of it and is only left out of the time of the call. a sliced
+ * download waits between its slices instead, @see mtpGetPartialObject
+ */
+struct CountingPut
+{
+  MTPDataPutFunc put;
+  void *priv;
+  LIBMTP_mtpdevice_t *device;
+  MtpCall *call;
+  uint64_t bytes;
+};
+
+static uint16_t countingPut(void *params, void *priv, uint32_t sendlen, unsigned char *data, uint32_t *putlen)
+{
+  CountingPut *counting = (CountingPut *)priv;
+  uint16_t ret = counting->put(params, counting->priv, sendlen, data, putlen);
+  counting->bytes += *putlen;
+  counting->call->exclude(throttle(counting->device, *putlen));
+  return ret;
+}
+
+int mtpGetFileToHandler(LIBMTP_mtpdevice_t *device, uint32_t const id, MTPDataPutFunc put_func, void *priv,
+                        LIBMTP_progressfunc_t const callback, void const *const data)
+{
+  MtpCall call(MTP_FN_Get_File_To_Handler, device);
+  CountingPut counting = {put_func, priv, device, &call, 0};
+  int ret = LIBMTP_Get_File_To_Handler(device, id, countingPut, &counting, callback, data);
+  call.end();
+  if (call.recording())
+  {
+    call.arg(traceInt(id));
+    call.result(traceInt(ret));
+  }
+  if (ret == 0)
+    call.size(counting.bytes);
+  return ret;
+}
+
+/**
+ * the get handler of an upload, wrapped to hold the chunks to the rate limits, @see CountingPut
+ */
+struct ThrottledGet
+{
+  MTPDataGetFunc get;
+  void *priv;
+  LIBMTP_mtpdevice_t *device;
+  MtpCall *call;
+};
+
+static uint16_t throttledGet(void *params, void *priv, uint32_t wantlen, unsigned char *data, uint32_t *gotlen)
+{
+  ThrottledGet *throttled = (ThrottledGet *)priv;
+  uint16_t ret = throttled->get(params, throttled->priv, wantlen, data, gotlen);
+  if (ret == LIBMTP_HANDLER_RETURN_OK)
+    throttled->call->exclude(throttle(throttled->device, *gotlen));
+  return ret;
+}
+
+int mtpSendFileFromHandler(LIBMTP_mtpdevice_t *device, MTPDataGetFunc get_func, void *priv,
+                           LIBMTP_file_t *const filedata, LIBMTP_progressfunc_t const callback,
+                           void const *const data)
+{
+  MtpCall call(MTP_FN_Send_File_From_Handler, device);
+  if (call.recording())
+  {
+    call.arg(traceInt(filedata->parent_id));
+    call.arg(traceString(filedata->filename));
+  }
+  ThrottledGet throttled = {get_func, priv, device, &call};
+  int ret = LIBMTP_Send_File_From_Handler(device, throttledGet, &throttled, filedata, callback, data);
+  call.end();
+  if (call.recording())
+  {
+    call.result(traceInt(ret));
+    call.out(traceInt(filedata->item_id));
+    call.out(traceInt(filedata->storage_id));
+  }
+  if (ret == 0)
+  {
+    call.size(filedata->filesize);
+    recordChange(device, CHANGE_ADDED, filedata->item_id);
+  }
+  return ret;
+}
+
+int mtpGetThumbnail(LIBMTP_mtpdevice_t *device, uint32_t const id, unsigned char **data, unsigned int *size)
+{
+  MtpCall call(MTP_FN_Get_Thumbnail, device);
+  int ret = LIBMTP_Get_Thumbnail(device, id, data, size);
+  call.end();
+  if (call.recording())
+  {
+    call.arg(traceInt(id));
+    call.result(traceInt(ret));
+  }
+  if (ret == 0)
+    call.size(*size);
+  return ret;
+}
+
+int mtpCheckCapability(LIBMTP_mtpdevice_t *device, LIBMTP_devicecap_t cap)
+{
+  MtpCall call(MTP_FN_Check_Capability, device);
+  int ret = LIBMTP_Check_Capability(device, cap);
+  call.end();
+  if (call.recording())
+  {
+    call.arg(traceInt(cap));
+    call.result(traceInt(ret));
+  }
+  return ret;
+}
+
+int mtpGetPartialObject(LIBMTP_mtpdevice_t *device, uint32_t const id, uint64_t offset, uint32_t maxbytes,
+                        unsigned char **data, unsigned int *size)
+{
+  int ret;
+  {
+    MtpCall call(MTP_FN_GetPartialObject, device);
+    ret = LIBMTP_GetPartialObject(device, id, offset, maxbytes, data, size);
+    call.end();
+    if (call.recording())
+    {
+      call.arg(traceInt(id));
+      call.arg(traceInt(offset));
+      call.arg(traceInt(maxbytes));
+      call.result(traceInt(ret));
+    }
+    if (ret == 0)
+      call.size(*size);
+  }
+  // the session is released first, the calls waiting for it run while this range is held back
+  if (ret == 0)
+    throttle(device, *size);
+  return ret;
+}
+
+int mtpSendPartialObject(LIBMTP_mtpdevice_t *device, uint32_t const id, uint64_t offset,
+                         unsigned char *data, unsigned int size)
+{
+  // held back before the session is taken, @see mtpGetPartialObject
+  throttle(device, size);
+  MtpCall call(MTP_FN_SendPartialObject, device);
+  int ret = LIBMTP_SendPartialObject(device, id, offset, data, size);
+  call.end();
+  if (call.recording())
+  {
+    call.arg(traceInt(id));
+    call.arg(traceInt(offset));
+    call.result(traceInt(ret));
+  }
+  if (ret == 0)
+  {
+    call.size(size);
+    recordChange(device, CHANGE_MODIFIED, id);
+  }
+  return ret;
+}
+
+int mtpTruncateObject(LIBMTP_mtpdevice_t *device, uint32_t const id, uint64_t offset)
+{
+  MtpCall call(MTP_FN_TruncateObject, device);
+  int ret = LIBMTP_TruncateObject(device, id, offset);
+  call.end();
+  if (call.recording())
+  {
+    call.arg(traceInt(id));
+    call.arg(traceInt(offset));
+    call.result(traceInt(ret));
+  }
+  if (ret == 0)
+    recordChange(device, CHANGE_MODIFIED, id);
+  return ret;
+}
+
+int mtpBeginEditObject(LIBMTP_mtpdevice_t *device, uint32_t const id)
+{
+  MtpCall call(MTP_FN_BeginEditObject, device);
+  int ret = LIBMTP_BeginEditObject(device, id);
+  call.end();
+  if (call.recording())
+  {
+    call.arg(traceInt(id));
+    call.result(traceInt(ret));
+  }
+  return ret;
+}
+
+int mtpEndEditObject(LIBMTP_mtpdevice_t *device, uint32_t const id)
+{
+  MtpCall call(MTP_FN_EndEditObject, device);
+  int ret = LIBMTP_EndEditObject(device, id);
+  call.end();
+  if (call.recording())
+  {
+    call.arg(traceInt(id));
+    call.result(traceInt(ret));
+  }
+  return ret;
+}
+
+int mtpReadEventAsync(LIBMTP_mtpdevice_t *device, LIBMTP_event_cb_fn cb, void *user_data)
+{
+  MtpCall call(MTP_FN_Read_Event_Async, device);
+  int ret = LIBMTP_Read_Event_Async(device, cb, user_data);
+  call.end();
+  if (call.recording())
+    call.result(traceInt(ret));
+  return ret;
+}
+
+int mtpHandleEventsTimeoutCompleted(struct timeval *tv, int *completed)
+{
+  MtpCall call(MTP_FN_Handle_Events_Timeout_Completed);
+  int ret = LIBMTP_Handle_Events_Timeout_Completed(tv, completed);
+  call.end();
+  if (call.recording())
+    call.result(traceInt(ret));
+  return ret;
+}
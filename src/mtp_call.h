@@ -0,0 +1,133 @@
+#ifndef LUCK_MTP_MTP_CALL
+#define LUCK_MTP_MTP_CALL
+
+#include <stdint.h>
+#include <string>
+#include <chrono>
+#include "libmtp.h"
+#include "call_trace.h"
+
+using namespace std;
+
+/**
+ * one libmtp call made by the addon
+ *
+ * every libmtp function used by the addon is called through a wrapper below,
+ * and every wrapper goes through this class, so it is the single place where
+ * calls are timed, counted, traced and recorded. when no trace is being recorded the
+ * arguments and results are not captured, and when statistics are disabled
+ * as well the call is not even timed.
+ *
+ * libmtp is not thread safe, so calls on a device are also serialized here
+ * between the main thread and the background jobs, by the priority class of
+ * the calling thread, @see schedulerAcquire. the session is recursive, a
+ * progress callback may call back into the addon, and the time waiting for
+ * it is not counted in the latency of the call.
+ */
+class MtpCall
+{
+public:
+  /**
+   * @param function the libmtp function called
+   * @param device the device whose session the call takes, NULL for the calls made before a device is open
+   */
+  explicit MtpCall(MtpFunction function, const void *device = NULL);
+  ~MtpCall();
+
+  /**
+   * @return true if the arguments and results of the call have to be captured
+   */
+  bool recording() const { return _record != NULL; }
+
+  /**
+   * @return true if the call is timed, for the statistics, the timeline or a trace
+   */
+  bool timed() const { return _stats || _timeline || _record; }
+
+  /**
+   * mark the end of the libmtp call, the time spent capturing results is not counted
+   */
+  void end();
+
+  /**
+   * leave out of the time of the call a wait spent in a data handler, a rate limit wait
+   */
+  void exclude(uint64_t ns) { _excludedNs += ns; }
+
+  void arg(const TraceValue &value);
+  void result(const TraceValue &value);
+  void out(const TraceValue &value);
+
+  /**
+   * @param bytes size of the data transferred by the call
+   */
+  void size(uint64_t bytes);
+
+private:
+  bool _scheduled;
+  const void *_device;
+  MtpFunction _function;
+  chrono::steady_clock::time_point _start;
+  uint64_t _elapsedNs;
+  uint64_t _excludedNs;
+  uint64_t _bytes;
+  bool _ended;
+  bool _stats;
+  bool _timeline;
+  TraceRecord *_record;
+};
+
+/**
+ * start recording every libmtp call into a trace file
+ *
+ * @param path the trace file, overwritten
+ * @return false if a trace is already being recorded or the file can not be created
+ */
+bool startTraceRecording(const string &path);
+
+/**
+ * stop recording and close the trace file
+ *
+ * @return the number of calls recorded
+ */
+uint64_t stopTraceRecording();
+
+LIBMTP_error_number_t mtpDetectRawDevices(LIBMTP_raw_device_t **devices, int *numdevs);
+LIBMTP_mtpdevice_t *mtpOpenRawDevice(LIBMTP_raw_device_t *rawdevice);
+LIBMTP_mtpdevice_t *mtpOpenRawDeviceUncached(LIBMTP_raw_device_t *rawdevice);
+void mtpReleaseDevice(LIBMTP_mtpdevice_t *device);
+char *mtpGetSerialnumber(LIBMTP_mtpdevice_t *device);
+int mtpGetStorage(LIBMTP_mtpdevice_t *device, int const sortby);
+LIBMTP_file_t *mtpGetFilesAndFolders(LIBMTP_mtpdevice_t *device, uint32_t const storage, uint32_t const parent);
+LIBMTP_file_t *mtpGetFilemetadata(LIBMTP_mtpdevice_t *device, uint32_t const id);
+uint64_t mtpGetU64FromObject(LIBMTP_mtpdevice_t *device, uint32_t const id,
+                             LIBMTP_property_t const property, uint64_t const value_default);
+int mtpGetFileToFile(LIBMTP_mtpdevice_t *device, uint32_t id, char const *const path,
+                     LIBMTP_progressfunc_t const callback, void const *const data);
+int mtpSendFileFromFile(LIBMTP_mtpdevice_t *device, char const *const path,
+                        LIBMTP_file_t *const filedata, LIBMTP_progressfunc_t const callback,
+                        void const *const data);
+int mtpDeleteObject(LIBMTP_mtpdevice_t *device, uint32_t id);
+int mtpMoveObject(LIBMTP_mtpdevice_t *device, uint32_t id, uint32_t storage, uint32_t parent);
+int mtpCopyObject(LIBMTP_mtpdevice_t *device, uint32_t id, uint32_t storage, uint32_t parent);
+int mtpSetFileName(LIBMTP_mtpdevice_t *device, LIBMTP_file_t *file, const char *newname);
+int mtpSetFolderName(LIBMTP_mtpdevice_t *device, LIBMTP_folder_t *folder, const char *newname);
+uint32_t mtpCreateFolder(LIBMTP_mtpdevice_t *device, char *name, uint32_t parent_id, uint32_t storage_id);
+int mtpGetFileToHandler(LIBMTP_mtpdevice_t *device, uint32_t const id, MTPDataPutFunc put_func, void *priv,
+                        LIBMTP_progressfunc_t const callback, void const *const data);
+int mtpSendFileFromHandler(LIBMTP_mtpdevice_t *device, MTPDataGetFunc get_func, void *priv,
+                           LIBMTP_file_t *const filedata, LIBMTP_progressfunc_t const callback,
+                           void const *const data);
+int mtpGetThumbnail(LIBMTP_mtpdevice_t *device, uint32_t const id, unsigned char **data, unsigned int *size);
+int mtpCheckCapability(LIBMTP_mtpdevice_t *device, LIBMTP_devicecap_t cap);
+int mtpGetPartialObject(LIBMTP_mtpdevice_t *device, uint32_t const id, uint64_t offset, uint32_t maxbytes,
+                        unsigned char **data, unsigned int *size);
+int mtpSendPartialObject(LIBMTP_mtpdevice_t *device, uint32_t const id, uint64_t offset,
+                         unsigned char *data, unsigned int size);
+int mtpTruncateObject(LIBMTP_mtpdevice_t *device, uint32_t const id, uint64_t offset);
+int mtpBeginEditObject(LIBMTP_mtpdevice_t *device, uint32_t const id);
+int mtpEndEditObject(LIBMTP_mtpdevice_t *device, uint32_t const id);
+int mtpReadEventAsync(LIBMTP_mtpdevice_t *device, LIBMTP_event_cb_fn cb, void *user_data);
+int mtpHandleEventsTimeoutCompleted(struct timeval *tv, int *completed);
+
+#endif
@@ -0,0 +1,84 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include "persistent_index.h"
+#include "mtp_call.h"
+
+using namespace std;
+
+uint64_t PersistentIndex::get(LIBMTP_mtpdevice_t *device, uint32_t itemId)
+{
+  auto it = _byItem.find(itemId);
+  if (it != _byItem.end())
+    return it->second;
+
+  uint64_t persistentId = mtpGetU64FromObject(device, itemId, LIBMTP_PROPERTY_PersistantUniqueObjectIdentifier, 0);
+  add(itemId, persistentId);
+  return persistentId;
+}
+
+void PersistentIndex::readEach(LIBMTP_mtpdevice_t *device, LIBMTP_file_t *files)
+{
+  for (LIBMTP_file_t *file = files; file != NULL; file = file->next)
+  {
+    get(device, file->item_id);
+  }
+}
+
+bool PersistentIndex::find(uint64_t persistentId, uint32_t &itemId)
+{
+  auto it = _byPersistentId.find(persistentId);
+  if (it == _byPersistentId.end())
+    return false;
+
+  itemId = it->second;
+  return true;
+}
+
+void PersistentIndex::remove(uint32_t itemId)
+{
+  auto it = _byItem.find(itemId);
+  if (it == _byItem.end())
+    return;
+
+  auto byPersistentId = _byPersistentId.find(it->second);
+  if (byPersistentId != _byPersistentId.end() && byPersistentId->second == itemId)
+    _byPersistentId.erase(byPersistentId);
+  _byItem.erase(it);
+}
+
+void PersistentIndex::clear()
+{
+  _byItem.clear();
+  _byPersistentId.clear();
+}
+
+size_t PersistentIndex::size()
+{
+  return _byItem.size();
+}
+
+void PersistentIndex::add(uint32_t itemId, uint64_t persistentId)
+{
+  _byItem[itemId] = persistentId;
+  // devices without the property report 0 for every object
+  if (persistentId != 0)
+    _byPersistentId[persistentId] = itemId;
+}
+
+string formatPersistentId(uint64_t persistentId)
+{
+  char text[17];
+  snprintf(text, sizeof(text), "%016" PRIx64, persistentId);
+  return text;
+}
+
+bool parsePersistentId(const string &text, uint64_t &persistentId)
+{
+  if (text.empty() || text.length() > 16)
+    return false;
+
+  char *end = NULL;
+  persistentId = strtoull(text.c_str(), &end, 16);
+  return end && *end == '\0';
+}
@@ -0,0 +1,92 @@
+#ifndef LUCK_MTP_PERSISTENT_INDEX
+#define LUCK_MTP_PERSISTENT_INDEX
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include "libmtp.h"
+
+using namespace std;
+
+/**
+ * index between object handles and persistent unique object identifiers
+ *
+ * object handles (<code>item_id</code>) are only valid for one session, the
+ * persistent unique object identifier stays the same across sessions. the
+ * identifier is read with one property request per object, so each object is
+ * read once per session and the result is kept here.
+ *
+ * the PTP property is 128 bits wide, libmtp only reads it through
+ * <code>LIBMTP_Get_u64_From_Object</code>, which keeps the low 64 bits.
+ */
+class PersistentIndex
+{
+public:
+  /**
+   * get the persistent id of an object, read from the device if not indexed
+   *
+   * @param device the connected device
+   * @param itemId object handle
+   * @return the persistent id, 0 if the device does not report one
+   */
+  uint64_t get(LIBMTP_mtpdevice_t *device, uint32_t itemId);
+
+  /**
+   * read the persistent ids of the files in a file list that are not indexed yet
+   *
+   * this is one property request per object, libmtp has no public call
+   * reading an object property for a whole folder at once
+   *
+   * @param device the connected device
+   * @param files a file list returned by libmtp
+   */
+  void readEach(LIBMTP_mtpdevice_t *device, LIBMTP_file_t *files);
+
+  /**
+   * find the object handle of a persistent id in the index
+   *
+   * @param persistentId the persistent id
+   * @param itemId receives the object handle
+   * @return true if the persistent id is indexed
+   */
+  bool find(uint64_t persistentId, uint32_t &itemId);
+
+  /**
+   * forget an object, e.g. when it has been deleted
+   *
+   * @param itemId object handle
+   */
+  void remove(uint32_t itemId);
+
+  /**
+   * forget all objects, handles are not valid in a new session
+   */
+  void clear();
+
+  /**
+   * @return the number of indexed objects
+   */
+  size_t size();
+
+private:
+  void add(uint32_t itemId, uint64_t persistentId);
+
+  unordered_map<uint32_t, uint64_t> _byItem;
+  unordered_map<uint64_t, uint32_t> _byPersistentId;
+};
+
+/**
+ * format a persistent id as the 16 digits hex string handed to js
+ */
+string formatPersistentId(uint64_t persistentId);
+
+/**
+ * parse a persistent id hex string
+ *
+ * @param text the hex string
+ * @param persistentId receives the persistent id
+ * @return false if the string is not a valid persistent id
+ */
+bool parsePersistentId(const string &text, uint64_t &persistentId);
+
+#endif
@@ -0,0 +1,137 @@
+#include <algorithm>
+#include <thread>
+#include "rate_limit.h"
+
+using namespace std;
+
+// the bucket holds at most this part of a second of data
+static const double RATE_BURST = 0.1;
+
+static mutex __devicesMutex;
+static uint64_t __deviceRate = 0;
+static map<const void *, shared_ptr<TokenBucket>> __devices;
+static mutex __namedMutex;
+static map<string, shared_ptr<TokenBucket>> __named;
+static thread_local TokenBucket *__transfer = NULL;
+
+TokenBucket::TokenBucket(uint64_t rate) : _rate(rate), _tokens(0), _last(chrono::steady_clock::now()), _stats()
+{
+}
+
+void TokenBucket::setRate(uint64_t rate)
+{
+  lock_guard<mutex> lock(_mutex);
+  _rate = rate;
+  // the debt taken at the old rate is forgiven, a full bucket is not carried over
+  _tokens = min(max(_tokens, 0.0), rate * RATE_BURST);
+  _last = chrono::steady_clock::now();
+}
+
+uint64_t TokenBucket::rate()
+{
+  lock_guard<mutex> lock(_mutex);
+  return _rate;
+}
+
+uint64_t TokenBucket::consume(uint64_t bytes)
+{
+  chrono::steady_clock::time_point now = chrono::steady_clock::now();
+  double wait = 0;
+  {
+    lock_guard<mutex> lock(_mutex);
+    if (_stats.bytes == 0)
+      _first = now;
+    _stats.bytes += bytes;
+
+    if (_rate > 0)
+    {
+      double elapsed = chrono::duration<double>(now - _last).count();
+      _tokens = min(_tokens + elapsed * _rate, _rate * RATE_BURST) - bytes;
+      _last = now;
+      if (_tokens < 0)
+        wait = -_tokens / _rate;
+    }
+
+    _stats.delayedNs += (uint64_t)(wait * 1e9);
+    _stats.activeNs = chrono::duration_cast<chrono::nanoseconds>(now - _first).count() + (uint64_t)(wait * 1e9);
+  }
+
+  if (wait > 0)
+    this_thread::sleep_for(chrono::duration<double>(wait));
+  return (uint64_t)(wait * 1e9);
+}
+
+TokenBucketStats TokenBucket::stats()
+{
+  lock_guard<mutex> lock(_mutex);
+  TokenBucketStats stats = _stats;
+  stats.rate = _rate;
+  return stats;
+}
+
+void TokenBucket::resetStats()
+{
+  lock_guard<mutex> lock(_mutex);
+  _stats = TokenBucketStats();
+}
+
+void setDeviceRateLimit(uint64_t rate)
+{
+  lock_guard<mutex> lock(__devicesMutex);
+  __deviceRate = rate;
+  for (auto &device : __devices)
+    device.second->setRate(rate);
+}
+
+shared_ptr<TokenBucket> deviceRateLimit(const void *device)
+{
+  lock_guard<mutex> lock(__devicesMutex);
+  shared_ptr<TokenBucket> &bucket = __devices[device];
+  if (!bucket)
+    bucket = make_shared<TokenBucket>(__deviceRate);
+  return bucket;
+}
+
+void dropDeviceRateLimit(const void *device)
+{
+  lock_guard<mutex> lock(__devicesMutex);
+  __devices.erase(device);
+}
+
+map<const void *, shared_ptr<TokenBucket>> deviceRateLimits()
+{
+  lock_guard<mutex> lock(__devicesMutex);
+  return __devices;
+}
+
+shared_ptr<TokenBucket> namedRateLimit(const string &name)
+{
+  lock_guard<mutex> lock(__namedMutex);
+  shared_ptr<TokenBucket> &bucket = __named[name];
+  if (!bucket)
+    bucket = make_shared<TokenBucket>();
+  return bucket;
+}
+
+map<string, shared_ptr<TokenBucket>> namedRateLimits()
+{
+  lock_guard<mutex> lock(__namedMutex);
+  return __named;
+}
+
+RateScope::RateScope(const shared_ptr<TokenBucket> &bucket) : _previous(__transfer), _bucket(bucket)
+{
+  if (_bucket)
+    __transfer = _bucket.get();
+}
+
+RateScope::~RateScope()
+{
+  __transfer = _previous;
+}
+
+uint64_t throttle(const void *device, uint64_t bytes)
+{
+  uint64_t slept = __transfer ? __transfer->consume(bytes) : 0;
+  return slept + deviceRateLimit(device)->consume(bytes);
+}
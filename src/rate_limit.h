@@ -0,0 +1,124 @@
+#ifndef LUCK_MTP_RATE_LIMIT
+#define LUCK_MTP_RATE_LIMIT
+
+#include <stdint.h>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+using namespace std;
+
+struct TokenBucketStats
+{
+  uint64_t rate;
+  // bytes that went through the bucket, and the time they were held back
+  uint64_t bytes;
+  uint64_t delayedNs;
+  // the time between the first and the last bytes
+  uint64_t activeNs;
+};
+
+/**
+ * token bucket limiting the bytes per second of the transfers going through it
+ *
+ * the bucket fills at the rate, up to a tenth of a second of data. a chunk
+ * takes its size in tokens even when there are not enough, and the thread
+ * then sleeps until the debt is paid, so the threads sharing a bucket queue
+ * up behind each other. the rate can be changed at any time, the next
+ * chunk goes at the new rate. thread safe.
+ */
+class TokenBucket
+{
+public:
+  explicit TokenBucket(uint64_t rate = 0);
+
+  /**
+   * @param rate bytes per second, 0 for no limit
+   */
+  void setRate(uint64_t rate);
+  uint64_t rate();
+
+  /**
+   * take the tokens of a chunk, sleeping until the bucket allows it
+   *
+   * @param bytes the size of the chunk
+   * @return the time slept in nanoseconds
+   */
+  uint64_t consume(uint64_t bytes);
+
+  TokenBucketStats stats();
+  void resetStats();
+
+private:
+  mutex _mutex;
+  uint64_t _rate;
+  double _tokens;
+  chrono::steady_clock::time_point _last;
+  TokenBucketStats _stats;
+  chrono::steady_clock::time_point _first;
+};
+
+/**
+ * set the limit of every device, each device has a bucket of its own so the
+ * transfers of several devices at once do not share a budget
+ *
+ * @param rate bytes per second, 0 for no limit
+ */
+void setDeviceRateLimit(uint64_t rate);
+
+/**
+ * @param device the device
+ * @return the bucket every transfer of the device goes through, created at the device limit the first time
+ */
+shared_ptr<TokenBucket> deviceRateLimit(const void *device);
+
+/**
+ * forget the bucket of a released device
+ */
+void dropDeviceRateLimit(const void *device);
+
+/**
+ * @return the device buckets by device
+ */
+map<const void *, shared_ptr<TokenBucket>> deviceRateLimits();
+
+/**
+ * @param name the name of a limit shared by the transfers given it
+ * @return the bucket, created without limit the first time
+ */
+shared_ptr<TokenBucket> namedRateLimit(const string &name);
+
+/**
+ * @return the named buckets by name
+ */
+map<string, shared_ptr<TokenBucket>> namedRateLimits();
+
+/**
+ * sets the bucket of the transfer running on the current thread for its lifetime
+ */
+class RateScope
+{
+public:
+  explicit RateScope(const shared_ptr<TokenBucket> &bucket);
+  ~RateScope();
+
+private:
+  TokenBucket *_previous;
+  shared_ptr<TokenBucket> _bucket;
+};
+
+/**
+ * hold a chunk of a transfer back to the limits of the transfer and of the device
+ *
+ * called for every chunk sent or received, outside of the device session
+ * where the chunk is a libmtp call of its own
+ *
+ * @param device the device the chunk goes to or comes from
+ * @param bytes the size of the chunk
+ * @return the time slept in nanoseconds
+ */
+uint64_t throttle(const void *device, uint64_t bytes);
+
+#endif
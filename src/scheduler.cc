@@ -0,0 +1,169 @@
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "scheduler.h"
+
+using namespace std;
+
+static const char *__priorityNames[PRIORITY_COUNT] = {"interactive", "normal", "bulk"};
+
+static thread_local Priority __currentPriority = PRIORITY_NORMAL;
+
+/**
+ * a call waiting for the session, on the stack of its thread
+ */
+struct SessionWaiter
+{
+  thread::id owner;
+  bool granted;
+  condition_variable cond;
+};
+
+/**
+ * the session of one device, who holds it and the calls waiting for it
+ */
+struct Session
+{
+  thread::id owner;
+  int depth = 0;
+  deque<SessionWaiter *> queues[PRIORITY_COUNT];
+};
+
+static mutex __mutex;
+static map<const void *, Session> __sessions;
+static SchedulerQueueStats __queueStats[PRIORITY_COUNT];
+static LatencyHistogram __waits[PRIORITY_COUNT];
+
+const char *priorityName(int priority)
+{
+  return priority >= 0 && priority < PRIORITY_COUNT ? __priorityNames[priority] : "unknown";
+}
+
+bool parsePriority(const string &name, Priority &priority)
+{
+  for (int i = 0; i < PRIORITY_COUNT; i++)
+  {
+    if (name == __priorityNames[i])
+    {
+      priority = (Priority)i;
+      return true;
+    }
+  }
+  return false;
+}
+
+Priority currentPriority()
+{
+  return __currentPriority;
+}
+
+PriorityScope::PriorityScope(Priority priority) : _previous(__currentPriority)
+{
+  __currentPriority = priority;
+}
+
+PriorityScope::~PriorityScope()
+{
+  __currentPriority = _previous;
+}
+
+void schedulerAcquire(const void *device)
+{
+  Priority priority = __currentPriority;
+  unique_lock<mutex> lock(__mutex);
+  SchedulerQueueStats &stats = __queueStats[priority];
+  stats.acquired++;
+
+  Session &session = __sessions[device];
+  thread::id self = this_thread::get_id();
+  if (session.depth > 0 && session.owner == self)
+  {
+    session.depth++;
+    return;
+  }
+
+  bool waiting = session.depth > 0;
+  for (int i = 0; i < PRIORITY_COUNT && !waiting; i++)
+    waiting = !session.queues[i].empty();
+  if (!waiting)
+  {
+    session.owner = self;
+    session.depth = 1;
+    return;
+  }
+
+  SessionWaiter waiter;
+  waiter.owner = self;
+  waiter.granted = false;
+  session.queues[priority].push_back(&waiter);
+  stats.waited++;
+  stats.queued++;
+  stats.maxQueued = max(stats.maxQueued, stats.queued);
+
+  bool timed = statsEnabled();
+  chrono::steady_clock::time_point start;
+  if (timed)
+    start = chrono::steady_clock::now();
+
+  // the releasing thread hands the session over, owner and depth are already set
+  waiter.cond.wait(lock, [&waiter] { return waiter.granted; });
+
+  if (timed)
+    __waits[priority].record(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
+}
+
+void schedulerRelease(const void *device)
+{
+  lock_guard<mutex> lock(__mutex);
+  auto found = __sessions.find(device);
+  if (found == __sessions.end())
+    return;
+  Session &session = found->second;
+  if (--session.depth > 0)
+    return;
+
+  for (int i = 0; i < PRIORITY_COUNT; i++)
+  {
+    if (session.queues[i].empty())
+      continue;
+
+    SessionWaiter *waiter = session.queues[i].front();
+    session.queues[i].pop_front();
+    __queueStats[i].queued--;
+    session.owner = waiter->owner;
+    session.depth = 1;
+    waiter->granted = true;
+    waiter->cond.notify_one();
+    return;
+  }
+  // nobody waits, a released device does not keep its entry
+  __sessions.erase(found);
+}
+
+SchedulerQueueStats schedulerQueueStats(Priority priority)
+{
+  lock_guard<mutex> lock(__mutex);
+  return __queueStats[priority];
+}
+
+const LatencyHistogram &schedulerWaits(Priority priority)
+{
+  return __waits[priority];
+}
+
+void resetSchedulerStats()
+{
+  lock_guard<mutex> lock(__mutex);
+  for (int i = 0; i < PRIORITY_COUNT; i++)
+  {
+    uint64_t queued = __queueStats[i].queued;
+    __queueStats[i] = SchedulerQueueStats();
+    __queueStats[i].queued = queued;
+    __queueStats[i].maxQueued = queued;
+    __waits[i].reset();
+  }
+}
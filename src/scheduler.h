@@ -0,0 +1,96 @@
+#ifndef LUCK_MTP_SCHEDULER
+#define LUCK_MTP_SCHEDULER
+
+#include <stdint.h>
+#include "stats.h"
+
+using namespace std;
+
+/**
+ * priority classes of the device session, a waiting call of a higher class
+ * always gets the session before the calls of the lower ones
+ */
+enum Priority
+{
+  // metadata the user waits for, listings and lookups
+  PRIORITY_INTERACTIVE,
+  // transfers started by the user, the default
+  PRIORITY_NORMAL,
+  // background jobs, thumbnails and archives
+  PRIORITY_BULK,
+  PRIORITY_COUNT
+};
+
+const char *priorityName(int priority);
+
+/**
+ * @param name 'interactive', 'normal' or 'bulk'
+ * @param priority receives the class
+ * @return false if the name is not a class
+ */
+bool parsePriority(const string &name, Priority &priority);
+
+/**
+ * @return the class of the libmtp calls made on the current thread
+ */
+Priority currentPriority();
+
+/**
+ * sets the class of the libmtp calls made on the current thread for its lifetime
+ */
+class PriorityScope
+{
+public:
+  explicit PriorityScope(Priority priority);
+  ~PriorityScope();
+
+private:
+  Priority _previous;
+};
+
+/**
+ * take the device session for a libmtp call, with the class of the current thread
+ *
+ * the session is recursive, a thread holding it takes it again without
+ * waiting. when it is released, it is handed to the oldest waiting call of
+ * the highest class, so a listing queued behind a slice of a bulk download
+ * runs as soon as the slice is done. every device has its own session, the
+ * calls on two devices run at the same time.
+ *
+ * @param device the device of the call, NULL for the calls made before a device is open
+ */
+void schedulerAcquire(const void *device);
+
+/**
+ * give the device session back, to the next waiting call if any
+ *
+ * @param device the device given to schedulerAcquire
+ */
+void schedulerRelease(const void *device);
+
+struct SchedulerQueueStats
+{
+  // calls waiting now, and the most that waited at once
+  uint64_t queued;
+  uint64_t maxQueued;
+  // calls that took the session, and how many of them had to wait
+  uint64_t acquired;
+  uint64_t waited;
+};
+
+/**
+ * @return the queue counters of a class, since the last reset for all but queued
+ */
+SchedulerQueueStats schedulerQueueStats(Priority priority);
+
+/**
+ * @return the time the calls of a class waited for the session, recorded when statistics are enabled
+ */
+const LatencyHistogram &schedulerWaits(Priority priority);
+
+/**
+ * clear the counters and the wait times, the high water mark is set to the calls waiting now
+ */
+void resetSchedulerStats();
+
+#endif
@@ -0,0 +1,204 @@
+#include <math.h>
+#include "stats.h"
+#include "utils.h"
+#include "timeline.h"
+
+using namespace std;
+
+atomic<bool> __statsEnabled(false);
+
+static const char *__exportNames[] = {
+#define API_EXPORT_NAME(name) #name,
+    API_EXPORTS(API_EXPORT_NAME)
+#undef API_EXPORT_NAME
+};
+
+static FunctionStats __functionStats[MTP_FN_COUNT];
+static ExportStats __exportStats[API_COUNT];
+static atomic<int64_t> __statsStart(chrono::steady_clock::now().time_since_epoch().count());
+
+// the export running on each thread, -1 outside of any export
+static thread_local int __currentExport = -1;
+
+const char *apiExportName(int api)
+{
+  return api >= 0 && api < API_COUNT ? __exportNames[api] : "unknown";
+}
+
+LatencyHistogram::LatencyHistogram()
+{
+  reset();
+}
+
+int LatencyHistogram::bucketIndex(uint64_t ns)
+{
+  if (ns < (uint64_t)SUB_BUCKETS)
+    return (int)ns;
+
+  int msb = 63 - __builtin_clzll(ns);
+  int index = (msb - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + (int)((ns >> (msb - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1));
+  return index < BUCKETS ? index : BUCKETS - 1;
+}
+
+uint64_t LatencyHistogram::bucketMiddle(int index)
+{
+  if (index < SUB_BUCKETS)
+    return index;
+
+  int shift = index / SUB_BUCKETS - 1;
+  uint64_t lower = (uint64_t)(SUB_BUCKETS + index % SUB_BUCKETS) << shift;
+  return lower + ((1ULL << shift) >> 1);
+}
+
+void LatencyHistogram::record(uint64_t ns)
+{
+  _buckets[bucketIndex(ns)].fetch_add(1, memory_order_relaxed);
+  _count.fetch_add(1, memory_order_relaxed);
+  _totalNs.fetch_add(ns, memory_order_relaxed);
+
+  uint64_t current = _minNs.load(memory_order_relaxed);
+  while (ns < current && !_minNs.compare_exchange_weak(current, ns, memory_order_relaxed))
+    ;
+  current = _maxNs.load(memory_order_relaxed);
+  while (ns > current && !_maxNs.compare_exchange_weak(current, ns, memory_order_relaxed))
+    ;
+}
+
+void LatencyHistogram::reset()
+{
+  for (int i = 0; i < BUCKETS; i++)
+    _buckets[i].store(0, memory_order_relaxed);
+  _count.store(0, memory_order_relaxed);
+  _totalNs.store(0, memory_order_relaxed);
+  _minNs.store(UINT64_MAX, memory_order_relaxed);
+  _maxNs.store(0, memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::count() const
+{
+  return _count.load(memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::totalNs() const
+{
+  return _totalNs.load(memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::minNs() const
+{
+  uint64_t ns = _minNs.load(memory_order_relaxed);
+  return ns == UINT64_MAX ? 0 : ns;
+}
+
+uint64_t LatencyHistogram::maxNs() const
+{
+  return _maxNs.load(memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::valueAtPercentile(double percentile) const
+{
+  uint64_t total = count();
+  if (total == 0)
+    return 0;
+
+  uint64_t target = (uint64_t)ceil(total * percentile / 100);
+  if (target < 1)
+    target = 1;
+
+  uint64_t seen = 0;
+  for (int i = 0; i < BUCKETS; i++)
+  {
+    seen += _buckets[i].load(memory_order_relaxed);
+    if (seen >= target)
+    {
+      // the last bucket also holds every value out of range
+      if (i == BUCKETS - 1)
+        return maxNs();
+      uint64_t ns = bucketMiddle(i);
+      return ns < minNs() ? minNs() : ns > maxNs() ? maxNs() : ns;
+    }
+  }
+  return maxNs();
+}
+
+void setStatsEnabled(bool enabled)
+{
+  __statsEnabled = enabled;
+}
+
+void resetStats()
+{
+  for (FunctionStats &stats : __functionStats)
+  {
+    stats.bytes = 0;
+    stats.latency.reset();
+  }
+  for (ExportStats &stats : __exportStats)
+  {
+    stats.errors = 0;
+    stats.bytes = 0;
+    for (atomic<uint64_t> &calls : stats.functions)
+      calls = 0;
+    stats.latency.reset();
+  }
+  __statsStart = chrono::steady_clock::now().time_since_epoch().count();
+}
+
+double statsElapsedMs()
+{
+  chrono::steady_clock::duration start(__statsStart.load());
+  return msSince(chrono::steady_clock::time_point(start));
+}
+
+void recordMtpCall(MtpFunction function, uint64_t ns, uint64_t bytes)
+{
+  FunctionStats &stats = __functionStats[function];
+  stats.latency.record(ns);
+  if (bytes)
+    stats.bytes.fetch_add(bytes, memory_order_relaxed);
+
+  if (__currentExport >= 0)
+  {
+    ExportStats &api = __exportStats[__currentExport];
+    api.functions[function].fetch_add(1, memory_order_relaxed);
+    if (bytes)
+      api.bytes.fetch_add(bytes, memory_order_relaxed);
+  }
+}
+
+const FunctionStats &functionStats(MtpFunction function)
+{
+  return __functionStats[function];
+}
+
+const ExportStats &exportStats(ApiExport api)
+{
+  return __exportStats[api];
+}
+
+ApiScope::ApiScope(ApiExport api)
+    : _api(api), _previous(__currentExport), _exceptions(uncaught_exceptions()),
+      _stats(statsEnabled()), _timeline(timelineEnabled())
+{
+  __currentExport = api;
+  if (_stats || _timeline)
+    _start = chrono::steady_clock::now();
+}
+
+ApiScope::~ApiScope()
+{
+  __currentExport = _previous;
+  if (!_stats && !_timeline)
+    return;
+
+  chrono::steady_clock::time_point end = chrono::steady_clock::now();
+  if (_timeline)
+    timelineSpan(__exportNames[_api], "export", _start, end);
+  if (!_stats)
+    return;
+
+  ExportStats &stats = __exportStats[_api];
+  stats.latency.record(chrono::duration_cast<chrono::nanoseconds>(end - _start).count());
+  if (uncaught_exceptions() > _exceptions)
+    stats.errors.fetch_add(1, memory_order_relaxed);
+}
@@ -0,0 +1,176 @@
+#ifndef LUCK_MTP_STATS
+#define LUCK_MTP_STATS
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include "call_trace.h"
+
+using namespace std;
+
+/**
+ * the exported functions broken down in the statistics, by their javascript name
+ *
+ * <code>discovery</code> counts the bus scans of the background polling thread
+ */
+#define API_EXPORTS(X)            \
+  X(connect)                      \
+  X(release)                      \
+  X(download)                     \
+  X(upload)                       \
+  X(del)                          \
+  X(getList)                      \
+  X(get)                          \
+  X(copy)                         \
+  X(move)                         \
+  X(setFileName)                  \
+  X(setFolderName)                \
+  X(createFolder)                 \
+  X(buildPersistentIndex)         \
+  X(resolveByPersistentId)        \
+  X(getDeviceInfo)                \
+  X(refreshDevices)               \
+  X(getCurrentDeviceStorageInfo)  \
+  X(setStorage)                   \
+  X(discovery)                    \
+  X(downloadArchive)              \
+  X(uploadArchive)                \
+  X(readFile)                     \
+  X(writeFile)                    \
+  X(getThumbnails)                \
+  X(statMany)                     \
+  X(transfer)                     \
+  X(broadcastUpload)              \
+  X(watchAndPush)                 \
+  X(getChanges)                   \
+  X(listZip)                      \
+  X(extractZipEntry)
+
+enum ApiExport
+{
+#define API_EXPORT_ENUM(name) API_##name,
+  API_EXPORTS(API_EXPORT_ENUM)
+#undef API_EXPORT_ENUM
+      API_COUNT
+};
+
+const char *apiExportName(int api);
+
+/**
+ * latency histogram with log-linear buckets, in the manner of HdrHistogram
+ *
+ * each power of two is split in 16 linear buckets, so a recorded value is
+ * known within 6.25%, from 1ns up to about 4.8 hours. recording is lock free
+ * and can be done from any thread.
+ */
+class LatencyHistogram
+{
+public:
+  static const int SUB_BUCKET_BITS = 4;
+  static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+  static const int BUCKETS = (44 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+  LatencyHistogram();
+
+  void record(uint64_t ns);
+  void reset();
+
+  uint64_t count() const;
+  uint64_t totalNs() const;
+  uint64_t minNs() const;
+  uint64_t maxNs() const;
+
+  /**
+   * @param percentile between 0 and 100
+   * @return the value at the percentile in nanoseconds, 0 if nothing was recorded
+   */
+  uint64_t valueAtPercentile(double percentile) const;
+
+private:
+  static int bucketIndex(uint64_t ns);
+  static uint64_t bucketMiddle(int index);
+
+  atomic<uint64_t> _buckets[BUCKETS];
+  atomic<uint64_t> _count;
+  atomic<uint64_t> _totalNs;
+  atomic<uint64_t> _minNs;
+  atomic<uint64_t> _maxNs;
+};
+
+/**
+ * statistics of one libmtp function
+ */
+struct FunctionStats
+{
+  atomic<uint64_t> bytes;
+  LatencyHistogram latency;
+};
+
+/**
+ * statistics of one exported function, with the libmtp calls made while it ran
+ */
+struct ExportStats
+{
+  atomic<uint64_t> errors;
+  atomic<uint64_t> bytes;
+  atomic<uint64_t> functions[MTP_FN_COUNT];
+  LatencyHistogram latency;
+};
+
+extern atomic<bool> __statsEnabled;
+
+/**
+ * @return true if statistics are collected, the only cost of a call when they are not
+ */
+inline bool statsEnabled()
+{
+  return __statsEnabled.load(memory_order_relaxed);
+}
+
+void setStatsEnabled(bool enabled);
+
+/**
+ * clear all the statistics
+ */
+void resetStats();
+
+/**
+ * @return the milliseconds since the statistics were reset
+ */
+double statsElapsedMs();
+
+/**
+ * count a libmtp call, for its function and for the exported function running on this thread
+ *
+ * @param function the libmtp function
+ * @param ns wall time of the call
+ * @param bytes data transferred by the call
+ */
+void recordMtpCall(MtpFunction function, uint64_t ns, uint64_t bytes);
+
+const FunctionStats &functionStats(MtpFunction function);
+const ExportStats &exportStats(ApiExport api);
+
+/**
+ * marks the exported function running on the current thread for its lifetime
+ *
+ * the libmtp calls made in the scope are counted for the export, and the
+ * time spent in the scope is recorded in the export latency histogram and
+ * as a span of the timeline. a scope left by an exception counts as an error.
+ */
+class ApiScope
+{
+public:
+  explicit ApiScope(ApiExport api);
+  ~ApiScope();
+
+private:
+  ApiExport _api;
+  int _previous;
+  int _exceptions;
+  bool _stats;
+  bool _timeline;
+  chrono::steady_clock::time_point _start;
+};
+
+#endif
@@ -0,0 +1,190 @@
+#include <stdio.h>
+#include <errno.h>
+#include <ctype.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+#include "thumbnail_cache.h"
+
+using namespace std;
+
+// an entry costs a little more than its data
+static const size_t THUMBNAIL_ENTRY_OVERHEAD = 128;
+
+/**
+ * helper function to build the memory key of a thumbnail
+ */
+static string memoryKey(const ThumbnailKey &key)
+{
+  char text[64];
+  snprintf(text, sizeof(text), "/%08x-%llx-%llx", key.id, (unsigned long long)key.size, (unsigned long long)key.mtime);
+  return key.serial + text;
+}
+
+/**
+ * helper function to make a serial number safe as a folder name
+ */
+static string serialFolder(const string &serial)
+{
+  if (serial.empty())
+    return "unknown";
+
+  string folder = serial;
+  for (char &c : folder)
+  {
+    if (!isalnum((unsigned char)c) && c != '-' && c != '_')
+      c = '_';
+  }
+  return folder;
+}
+
+static bool makeFolder(const string &path)
+{
+#ifdef _WIN32
+  return _mkdir(path.c_str()) == 0 || errno == EEXIST;
+#else
+  return mkdir(path.c_str(), 0777) == 0 || errno == EEXIST;
+#endif
+}
+
+/**
+ * helper function to get the cache file of a thumbnail
+ */
+static string diskPath(const ThumbnailKey &key, const string &directory)
+{
+  char name[64];
+  snprintf(name, sizeof(name), "%08x-%llx-%llx.thumb", key.id, (unsigned long long)key.size, (unsigned long long)key.mtime);
+  return directory + "/" + serialFolder(key.serial) + "/" + name;
+}
+
+static size_t entryCost(const Thumbnail &thumbnail)
+{
+  return thumbnail->size() + THUMBNAIL_ENTRY_OVERHEAD;
+}
+
+void ThumbnailCache::setCapacity(size_t capacity)
+{
+  lock_guard<mutex> lock(_mutex);
+  _capacity = capacity;
+  evict();
+}
+
+bool ThumbnailCache::get(const ThumbnailKey &key, const string &directory, Thumbnail &thumbnail)
+{
+  string name = memoryKey(key);
+  {
+    lock_guard<mutex> lock(_mutex);
+    auto found = _index.find(name);
+    if (found != _index.end())
+    {
+      _entries.splice(_entries.begin(), _entries, found->second);
+      thumbnail = found->second->thumbnail;
+      _stats.memoryHits++;
+      return true;
+    }
+  }
+
+  if (!directory.empty())
+  {
+    FILE *fd = fopen(diskPath(key, directory).c_str(), "rb");
+    if (fd)
+    {
+      vector<unsigned char> data;
+      unsigned char buffer[16 * 1024];
+      size_t got;
+      while ((got = fread(buffer, 1, sizeof(buffer), fd)) > 0)
+        data.insert(data.end(), buffer, buffer + got);
+      bool ok = !ferror(fd);
+      fclose(fd);
+
+      if (ok)
+      {
+        thumbnail = make_shared<const vector<unsigned char>>(move(data));
+        lock_guard<mutex> lock(_mutex);
+        insert(name, thumbnail);
+        _stats.diskHits++;
+        return true;
+      }
+    }
+  }
+
+  lock_guard<mutex> lock(_mutex);
+  _stats.misses++;
+  return false;
+}
+
+void ThumbnailCache::put(const ThumbnailKey &key, const string &directory, const Thumbnail &thumbnail)
+{
+  {
+    lock_guard<mutex> lock(_mutex);
+    insert(memoryKey(key), thumbnail);
+  }
+
+  if (directory.empty())
+    return;
+
+  // written under a temporary name, a reader never sees half a thumbnail
+  string folder = directory + "/" + serialFolder(key.serial);
+  if (!makeFolder(directory) || !makeFolder(folder))
+    return;
+
+  string path = diskPath(key, directory);
+  string temporary = path + ".tmp";
+  FILE *fd = fopen(temporary.c_str(), "wb");
+  if (!fd)
+    return;
+  bool ok = fwrite(thumbnail->data(), 1, thumbnail->size(), fd) == thumbnail->size();
+  ok = fclose(fd) == 0 && ok;
+  // rename does not replace an existing file on windows, the entry is the same anyway
+  if (!ok || rename(temporary.c_str(), path.c_str()) != 0)
+    remove(temporary.c_str());
+}
+
+ThumbnailCacheStats ThumbnailCache::stats()
+{
+  lock_guard<mutex> lock(_mutex);
+  ThumbnailCacheStats stats = _stats;
+  stats.entries = _entries.size();
+  stats.bytes = _bytes;
+  return stats;
+}
+
+void ThumbnailCache::resetStats()
+{
+  lock_guard<mutex> lock(_mutex);
+  _stats = ThumbnailCacheStats();
+}
+
+/**
+ * add or refresh an entry at the front of the list, the mutex must be held
+ */
+void ThumbnailCache::insert(const string &key, const Thumbnail &thumbnail)
+{
+  auto found = _index.find(key);
+  if (found != _index.end())
+  {
+    _bytes -= entryCost(found->second->thumbnail);
+    _entries.erase(found->second);
+    _index.erase(found);
+  }
+
+  _entries.push_front({key, thumbnail});
+  _index[key] = _entries.begin();
+  _bytes += entryCost(thumbnail);
+  evict();
+}
+
+/**
+ * drop the least recently used entries until the cache fits, the mutex must be held
+ */
+void ThumbnailCache::evict()
+{
+  while (_bytes > _capacity && !_entries.empty())
+  {
+    Entry &last = _entries.back();
+    _bytes -= entryCost(last.thumbnail);
+    _index.erase(last.key);
+    _entries.pop_back();
+  }
+}
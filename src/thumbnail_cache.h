@@ -0,0 +1,97 @@
+#ifndef LUCK_MTP_THUMBNAIL_CACHE
+#define LUCK_MTP_THUMBNAIL_CACHE
+
+#include <stdint.h>
+#include <time.h>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+/**
+ * what a thumbnail is cached by, a new size or modification time of the object gives a new entry
+ */
+struct ThumbnailKey
+{
+  string serial;
+  uint32_t id;
+  uint64_t size;
+  time_t mtime;
+};
+
+/**
+ * the data of a thumbnail, empty if the object has none
+ */
+typedef shared_ptr<const vector<unsigned char>> Thumbnail;
+
+struct ThumbnailCacheStats
+{
+  uint64_t memoryHits;
+  uint64_t diskHits;
+  uint64_t misses;
+  uint64_t entries;
+  uint64_t bytes;
+};
+
+/**
+ * thumbnails kept in memory with a least recently used eviction, bounded in
+ * bytes, and optionally in a disk directory, one file per thumbnail under a
+ * folder per device serial number. thread safe.
+ */
+class ThumbnailCache
+{
+public:
+  explicit ThumbnailCache(size_t capacity) : _capacity(capacity), _bytes(0), _stats() {}
+
+  /**
+   * @param capacity the memory bound in bytes, the oldest entries are evicted to fit
+   */
+  void setCapacity(size_t capacity);
+
+  /**
+   * look a thumbnail up in memory, then in the disk cache, which moves it to memory
+   *
+   * @param key the object
+   * @param directory the disk cache directory, empty for none
+   * @param thumbnail receives the thumbnail
+   * @return true if found
+   */
+  bool get(const ThumbnailKey &key, const string &directory, Thumbnail &thumbnail);
+
+  /**
+   * @param key the object
+   * @param directory the disk cache directory, empty for none
+   * @param thumbnail the thumbnail, empty to remember the object has none
+   */
+  void put(const ThumbnailKey &key, const string &directory, const Thumbnail &thumbnail);
+
+  ThumbnailCacheStats stats();
+
+  /**
+   * clear the hit and miss counters
+   */
+  void resetStats();
+
+private:
+  struct Entry
+  {
+    string key;
+    Thumbnail thumbnail;
+  };
+
+  void insert(const string &key, const Thumbnail &thumbnail);
+  void evict();
+
+  mutex _mutex;
+  size_t _capacity;
+  size_t _bytes;
+  list<Entry> _entries;
+  unordered_map<string, list<Entry>::iterator> _index;
+  ThumbnailCacheStats _stats;
+};
+
+#endif
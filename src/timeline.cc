@@ -0,0 +1,276 @@
+#include <stdio.h>
+#include <inttypes.h>
+#include <vector>
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include "timeline.h"
+
+using namespace std;
+
+atomic<bool> __timelineEnabled(false);
+
+static const uint32_t TIMELINE_BUFFER_EVENTS = 16384;
+static const int TIMELINE_FLUSH_MS = 100;
+
+struct TimelineEvent
+{
+  const char *name;
+  const char *category;
+  int64_t startNs;
+  int64_t endNs;
+  uint64_t bytes;
+};
+
+/**
+ * single producer single consumer ring buffer of one thread
+ *
+ * only the owning thread advances <code>head</code>, only the flush thread advances <code>tail</code>
+ */
+struct TimelineBuffer
+{
+  uint32_t tid;
+  TimelineEvent events[TIMELINE_BUFFER_EVENTS];
+  atomic<uint64_t> head;
+  atomic<uint64_t> tail;
+  atomic<uint64_t> dropped;
+};
+
+/**
+ * gives the buffer of a thread back when the thread exits
+ *
+ * the spans still in the buffer are written first, then the buffer goes to
+ * a free list for the next thread, so short lived threads don't each leave a
+ * buffer behind
+ */
+struct TimelineBufferOwner
+{
+  TimelineBuffer *buffer = NULL;
+  ~TimelineBufferOwner();
+};
+
+static mutex __buffersMutex;
+static vector<TimelineBuffer *> __buffers;
+static vector<TimelineBuffer *> __freeBuffers;
+static uint32_t __nextTid = 1;
+static thread_local TimelineBufferOwner __owner;
+
+static mutex __timelineMutex;
+static condition_variable __timelineCond;
+static thread __flushThread;
+static bool __flushing = false;
+static FILE *__timelineFile = NULL;
+static int64_t __timelineEpoch = 0;
+static uint64_t __timelineEvents = 0;
+static uint64_t __retiredDropped = 0;
+
+static int64_t steadyNs(const chrono::steady_clock::time_point &time)
+{
+  return chrono::duration_cast<chrono::nanoseconds>(time.time_since_epoch()).count();
+}
+
+static TimelineBuffer *threadBuffer()
+{
+  if (!__owner.buffer)
+  {
+    lock_guard<mutex> lock(__buffersMutex);
+    TimelineBuffer *buffer;
+    if (__freeBuffers.empty())
+    {
+      buffer = new TimelineBuffer();
+    }
+    else
+    {
+      buffer = __freeBuffers.back();
+      __freeBuffers.pop_back();
+    }
+    buffer->head = 0;
+    buffer->tail = 0;
+    buffer->dropped = 0;
+    buffer->tid = __nextTid++;
+    __buffers.push_back(buffer);
+    __owner.buffer = buffer;
+  }
+  return __owner.buffer;
+}
+
+/**
+ * helper function to move the buffered spans of one thread into the file, called with the timeline mutex held
+ */
+static void drainBuffer(TimelineBuffer *buffer, string &out)
+{
+  char line[512];
+  uint64_t tail = buffer->tail.load(memory_order_relaxed);
+  uint64_t head = buffer->head.load(memory_order_acquire);
+  for (; tail < head; tail++)
+  {
+    const TimelineEvent &event = buffer->events[tail % TIMELINE_BUFFER_EVENTS];
+    int length = snprintf(line, sizeof(line),
+                          "%s\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u",
+                          __timelineEvents == 0 ? "" : ",",
+                          event.name, event.category,
+                          (event.startNs - __timelineEpoch) / 1000.0,
+                          (event.endNs - event.startNs) / 1000.0,
+                          buffer->tid);
+    out.append(line, length);
+    if (event.bytes)
+    {
+      length = snprintf(line, sizeof(line), ",\"args\":{\"bytes\":%" PRIu64 "}", event.bytes);
+      out.append(line, length);
+    }
+    out.append("}");
+    __timelineEvents++;
+  }
+  buffer->tail.store(tail, memory_order_release);
+}
+
+/**
+ * helper function to move the buffered spans into the file, called by the flush thread or on stop
+ */
+static void drainBuffers()
+{
+  vector<TimelineBuffer *> buffers;
+  {
+    lock_guard<mutex> lock(__buffersMutex);
+    buffers = __buffers;
+  }
+
+  string out;
+  for (TimelineBuffer *buffer : buffers)
+    drainBuffer(buffer, out);
+
+  if (!out.empty())
+    fwrite(out.data(), 1, out.size(), __timelineFile);
+}
+
+TimelineBufferOwner::~TimelineBufferOwner()
+{
+  if (!buffer)
+    return;
+
+  // the timeline mutex keeps the flush thread off the buffer while it is retired
+  lock_guard<mutex> lock(__timelineMutex);
+  if (__timelineFile)
+  {
+    string out;
+    drainBuffer(buffer, out);
+    if (!out.empty())
+      fwrite(out.data(), 1, out.size(), __timelineFile);
+    __retiredDropped += buffer->dropped;
+  }
+
+  lock_guard<mutex> buffersLock(__buffersMutex);
+  __buffers.erase(find(__buffers.begin(), __buffers.end(), buffer));
+  __freeBuffers.push_back(buffer);
+  buffer = NULL;
+}
+
+static void flushLoop()
+{
+  unique_lock<mutex> lock(__timelineMutex);
+  while (__flushing)
+  {
+    __timelineCond.wait_for(lock, chrono::milliseconds(TIMELINE_FLUSH_MS));
+    drainBuffers();
+  }
+}
+
+bool startTimeline(const string &path)
+{
+  lock_guard<mutex> lock(__timelineMutex);
+  if (__timelineFile)
+    return false;
+
+  __timelineFile = fopen(path.c_str(), "w");
+  if (!__timelineFile)
+    return false;
+
+  fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", __timelineFile);
+
+  // spans left over from a previous timeline are discarded
+  {
+    lock_guard<mutex> buffersLock(__buffersMutex);
+    for (TimelineBuffer *buffer : __buffers)
+    {
+      buffer->tail.store(buffer->head.load(memory_order_acquire), memory_order_release);
+      buffer->dropped = 0;
+    }
+  }
+
+  __timelineEpoch = steadyNs(chrono::steady_clock::now());
+  __timelineEvents = 0;
+  __retiredDropped = 0;
+  __flushing = true;
+  __flushThread = thread(flushLoop);
+  __timelineEnabled = true;
+  return true;
+}
+
+TimelineSummary stopTimeline()
+{
+  TimelineSummary summary = {0, 0};
+
+  {
+    lock_guard<mutex> lock(__timelineMutex);
+    if (!__timelineFile)
+      return summary;
+    __timelineEnabled = false;
+    __flushing = false;
+  }
+  __timelineCond.notify_all();
+  __flushThread.join();
+
+  lock_guard<mutex> lock(__timelineMutex);
+  drainBuffers();
+  {
+    lock_guard<mutex> buffersLock(__buffersMutex);
+    for (TimelineBuffer *buffer : __buffers)
+      summary.dropped += buffer->dropped;
+  }
+  summary.dropped += __retiredDropped;
+  summary.events = __timelineEvents;
+
+  fputs("\n]}\n", __timelineFile);
+  fclose(__timelineFile);
+  __timelineFile = NULL;
+  return summary;
+}
+
+void timelineSpan(const char *name, const char *category,
+                  const chrono::steady_clock::time_point &start,
+                  const chrono::steady_clock::time_point &end,
+                  uint64_t bytes)
+{
+  if (!timelineEnabled())
+    return;
+
+  TimelineBuffer *buffer = threadBuffer();
+  uint64_t head = buffer->head.load(memory_order_relaxed);
+  if (head - buffer->tail.load(memory_order_acquire) >= TIMELINE_BUFFER_EVENTS)
+  {
+    buffer->dropped.fetch_add(1, memory_order_relaxed);
+    return;
+  }
+
+  TimelineEvent &event = buffer->events[head % TIMELINE_BUFFER_EVENTS];
+  event.name = name;
+  event.category = category;
+  event.startNs = steadyNs(start);
+  event.endNs = steadyNs(end);
+  event.bytes = bytes;
+  buffer->head.store(head + 1, memory_order_release);
+}
+
+TimelineScope::TimelineScope(const char *name, const char *category)
+    : _name(name), _category(category), _enabled(timelineEnabled()), _bytes(0)
+{
+  if (_enabled)
+    _start = chrono::steady_clock::now();
+}
+
+TimelineScope::~TimelineScope()
+{
+  if (_enabled)
+    timelineSpan(_name, _category, _start, chrono::steady_clock::now(), _bytes);
+}
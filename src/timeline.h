@@ -0,0 +1,87 @@
+#ifndef LUCK_MTP_TIMELINE
+#define LUCK_MTP_TIMELINE
+
+#include <stdint.h>
+#include <string>
+#include <atomic>
+#include <chrono>
+
+using namespace std;
+
+/**
+ * opt-in timeline of the native operations, written as Chrome trace event json
+ *
+ * spans are buffered in a lock free ring buffer owned by the thread that
+ * ran them, and a background thread drains the buffers into the file, so a
+ * traced call only pays for two clock reads and a few stores. when a ring
+ * buffer is full its new spans are dropped and counted.
+ *
+ * the file can be opened in Perfetto or chrome://tracing.
+ */
+
+struct TimelineSummary
+{
+  uint64_t events;
+  uint64_t dropped;
+};
+
+extern atomic<bool> __timelineEnabled;
+
+/**
+ * @return true if a timeline is being written
+ */
+inline bool timelineEnabled()
+{
+  return __timelineEnabled.load(memory_order_relaxed);
+}
+
+/**
+ * start writing a timeline
+ *
+ * @param path the json file, overwritten
+ * @return false if a timeline is already being written or the file can not be created
+ */
+bool startTimeline(const string &path);
+
+/**
+ * stop the timeline, write the remaining spans and close the file
+ */
+TimelineSummary stopTimeline();
+
+/**
+ * add a complete span to the timeline of the current thread
+ *
+ * @param name span name, must be a string literal or live as long as the process
+ * @param category span category, same lifetime as name
+ * @param start start of the span
+ * @param end end of the span
+ * @param bytes bytes transferred in the span, 0 for none
+ */
+void timelineSpan(const char *name, const char *category,
+                  const chrono::steady_clock::time_point &start,
+                  const chrono::steady_clock::time_point &end,
+                  uint64_t bytes = 0);
+
+/**
+ * a span of the timeline for the lifetime of the object
+ */
+class TimelineScope
+{
+public:
+  TimelineScope(const char *name, const char *category);
+  ~TimelineScope();
+
+  /**
+   * @param bytes bytes transferred in the span
+   */
+  void bytes(uint64_t bytes) { _bytes = bytes; }
+
+private:
+  const char *_name;
+  const char *_category;
+  bool _enabled;
+  uint64_t _bytes;
+  chrono::steady_clock::time_point _start;
+};
+
+#endif
@@ -0,0 +1,1060 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <thread>
+#include "utils.h"
+#include "mtp_call.h"
+#include "device_pipe.h"
+#include "transfer.h"
+
+using namespace std;
+
+struct FileStream
+{
+  FILE *fd;
+  StreamHash *hash;
+};
+
+static uint16_t getFromFile(void *params, void *priv, uint32_t wantlen, unsigned char *data, uint32_t *gotlen)
+{
+  FileStream *stream = (FileStream *)priv;
+  // libmtp always asks for the first packet, 0 bytes for an empty file
+  *gotlen = wantlen > 0 ? fread(data, 1, wantlen, stream->fd) : 0;
+  // the file is shorter than announced to the device
+  if (*gotlen == 0 && wantlen > 0)
+    return LIBMTP_HANDLER_RETURN_ERROR;
+  stream->hash->update(data, *gotlen);
+  return LIBMTP_HANDLER_RETURN_OK;
+}
+
+static uint16_t putToWriter(void *params, void *priv, uint32_t sendlen, unsigned char *data, uint32_t *putlen)
+{
+  FileWriter *writer = (FileWriter *)priv;
+  *putlen = sendlen;
+  return writer->write(data, sendlen) ? LIBMTP_HANDLER_RETURN_OK : LIBMTP_HANDLER_RETURN_ERROR;
+}
+
+/**
+ * helper function to download a file in slices read with GetPartialObject
+ *
+ * @return 0 if the transfer was successful, 1 if the first slice can not be read and nothing was written
+ */
+static int downloadSlices(LIBMTP_mtpdevice_t *device, uint32_t id, uint64_t size, uint32_t sliceSize,
+                          FileWriter &writer, LIBMTP_progressfunc_t const callback, void const *const data)
+{
+  for (uint64_t offset = 0; offset < size;)
+  {
+    uint32_t wanted = (uint32_t)min<uint64_t>(sliceSize, size - offset);
+    unsigned char *slice = NULL;
+    unsigned int got = 0;
+    if (mtpGetPartialObject(device, id, offset, wanted, &slice, &got) != 0 || got == 0)
+    {
+      free(slice);
+      return offset == 0 ? 1 : -1;
+    }
+
+    bool ok = writer.write(slice, got);
+    free(slice);
+    offset += got;
+    if (!ok || (callback && callback(offset, size, data) != 0))
+      return -1;
+  }
+  return 0;
+}
+
+int downloadToFile(LIBMTP_mtpdevice_t *device, uint32_t id, const char *path, uint64_t size, StreamHash &hash,
+                   const FileWriterOptions &options, uint32_t sliceSize, LIBMTP_progressfunc_t const callback,
+                   void const *const data)
+{
+  FileWriter writer;
+  if (!writer.open(path, size, hash.empty() ? NULL : &hash, options))
+    return -1;
+
+  int ret = 1;
+  if (sliceSize > 0 && size > sliceSize && mtpCheckCapability(device, LIBMTP_DEVICECAP_GetPartialObject))
+    ret = downloadSlices(device, id, size, sliceSize, writer, callback, data);
+  // some devices announce partial reads they do not support
+  if (ret == 1)
+    ret = mtpGetFileToHandler(device, id, putToWriter, &writer, callback, data);
+  if (ret == 0)
+  {
+    if (!writer.close())
+      ret = -1;
+  }
+  else
+  {
+    writer.abort();
+  }
+
+  // like LIBMTP_Get_File_To_File, do not leave a partial file behind
+  if (ret != 0)
+    remove(path);
+  return ret;
+}
+
+int uploadFromFile(LIBMTP_mtpdevice_t *device, const char *path, LIBMTP_file_t *filedata, StreamHash &hash,
+                   LIBMTP_progressfunc_t const callback, void const *const data)
+{
+  FileStream stream = {fopen(path, "rb"), &hash};
+  if (!stream.fd)
+    return -1;
+
+  int ret = mtpSendFileFromHandler(device, getFromFile, &stream, filedata, callback, data);
+  fclose(stream.fd);
+  return ret;
+}
+
+struct MemoryStream
+{
+  unsigned char *buffer;
+  uint64_t capacity;
+  uint64_t position;
+  vector<unsigned char> *overflow;
+};
+
+// the size of a sampled range, and the number of ranges of a large file
+static const uint32_t SAMPLE_RANGE = 64 * 1024;
+static const uint64_t SAMPLE_RANGES = 8;
+
+SampleMatch sampleCompare(LIBMTP_mtpdevice_t *device, uint32_t id, const char *path, uint64_t size, uint64_t &sampled)
+{
+  sampled = 0;
+  if (!mtpCheckCapability(device, LIBMTP_DEVICECAP_GetPartialObject))
+    return SAMPLE_UNAVAILABLE;
+
+  FILE *fd = fopen(path, "rb");
+  if (!fd)
+    return SAMPLE_UNAVAILABLE;
+
+  // a file of up to SAMPLE_RANGES ranges is read in consecutive ranges
+  bool whole = size <= SAMPLE_RANGE * SAMPLE_RANGES;
+  uint64_t ranges = whole ? (size + SAMPLE_RANGE - 1) / SAMPLE_RANGE : SAMPLE_RANGES;
+  vector<unsigned char> local(SAMPLE_RANGE);
+  SampleMatch match = SAMPLE_IDENTICAL;
+
+  for (uint64_t i = 0; i < ranges && match == SAMPLE_IDENTICAL; i++)
+  {
+    uint64_t offset = whole ? i * SAMPLE_RANGE : (size - SAMPLE_RANGE) * i / (SAMPLE_RANGES - 1);
+    uint32_t length = (uint32_t)min<uint64_t>(SAMPLE_RANGE, size - offset);
+
+    if (!seekFile(fd, offset) || fread(local.data(), 1, length, fd) != length)
+    {
+      match = SAMPLE_UNAVAILABLE;
+      break;
+    }
+
+    unsigned char *remote = NULL;
+    unsigned int got = 0;
+    if (mtpGetPartialObject(device, id, offset, length, &remote, &got) != 0)
+    {
+      free(remote);
+      match = SAMPLE_UNAVAILABLE;
+      break;
+    }
+    sampled += got;
+    if (got != length || memcmp(remote, local.data(), length) != 0)
+      match = SAMPLE_DIFFERENT;
+    free(remote);
+  }
+
+  fclose(fd);
+  return match;
+}
+
+// a delta upload reads the files in windows, and compares and sends them in blocks
+static const uint32_t DELTA_WINDOW = 1024 * 1024;
+static const uint32_t DELTA_BLOCK = 64 * 1024;
+
+/**
+ * helper function to compare and update one window of a file being edited
+ *
+ * @return false if a read or write failed
+ */
+static bool deltaWindow(LIBMTP_mtpdevice_t *device, uint32_t id, uint64_t offset, unsigned char *local,
+                        uint32_t length, uint64_t deviceSize, DeltaResult &result)
+{
+  unsigned char *remote = NULL;
+  unsigned int got = 0;
+  if (offset < deviceSize)
+  {
+    uint32_t wanted = (uint32_t)min<uint64_t>(length, deviceSize - offset);
+    if (mtpGetPartialObject(device, id, offset, wanted, &remote, &got) != 0 || got != wanted)
+    {
+      free(remote);
+      return false;
+    }
+    result.read += got;
+  }
+
+  // the start of the run of different blocks, or length when none is pending
+  uint32_t run = length;
+  bool ok = true;
+  for (uint32_t block = 0; block < length && ok; block += DELTA_BLOCK)
+  {
+    uint32_t end = min(block + DELTA_BLOCK, length);
+    bool different = end > got || memcmp(remote + block, local + block, end - block) != 0;
+    if (different && run == length)
+      run = block;
+    if (!different && run != length)
+    {
+      ok = mtpSendPartialObject(device, id, offset + run, local + run, block - run) == 0;
+      result.sent += block - run;
+      run = length;
+    }
+  }
+  if (ok && run != length)
+  {
+    ok = mtpSendPartialObject(device, id, offset + run, local + run, length - run) == 0;
+    result.sent += length - run;
+  }
+
+  free(remote);
+  return ok;
+}
+
+int deltaUpload(LIBMTP_mtpdevice_t *device, uint32_t id, uint64_t deviceSize, const char *path, uint64_t size,
+                StreamHash &hash, LIBMTP_progressfunc_t const callback, void const *const data, DeltaResult &result)
+{
+  result = DeltaResult();
+  if (!mtpCheckCapability(device, LIBMTP_DEVICECAP_GetPartialObject) ||
+      !mtpCheckCapability(device, LIBMTP_DEVICECAP_SendPartialObject) ||
+      !mtpCheckCapability(device, LIBMTP_DEVICECAP_EditObjects))
+    return 1;
+
+  FILE *fd = fopen(path, "rb");
+  if (!fd)
+    return -1;
+
+  if (mtpBeginEditObject(device, id) != 0)
+  {
+    fclose(fd);
+    return 1;
+  }
+
+  vector<unsigned char> local(DELTA_WINDOW);
+  bool ok = true;
+  for (uint64_t offset = 0; offset < size && ok; offset += DELTA_WINDOW)
+  {
+    uint32_t length = (uint32_t)min<uint64_t>(DELTA_WINDOW, size - offset);
+    ok = fread(local.data(), 1, length, fd) == length;
+    if (ok)
+    {
+      hash.update(local.data(), length);
+      ok = deltaWindow(device, id, offset, local.data(), length, deviceSize, result);
+    }
+    if (ok && callback)
+      ok = callback(offset + length, size, data) == 0;
+  }
+  fclose(fd);
+
+  if (ok && size < deviceSize)
+    ok = mtpTruncateObject(device, id, size) == 0;
+
+  // the edit is always closed, the device keeps the object locked otherwise
+  ok = mtpEndEditObject(device, id) == 0 && ok;
+  return ok ? 0 : -1;
+}
+
+static uint16_t putToMemory(void *params, void *priv, uint32_t sendlen, unsigned char *data, uint32_t *putlen)
+{
+  MemoryStream *stream = (MemoryStream *)priv;
+  uint64_t fits = stream->position < stream->capacity ? min<uint64_t>(sendlen, stream->capacity - stream->position) : 0;
+  if (fits > 0)
+    memcpy(stream->buffer + stream->position, data, fits);
+  if (fits < sendlen)
+    stream->overflow->insert(stream->overflow->end(), data + fits, data + sendlen);
+  stream->position += sendlen;
+  *putlen = sendlen;
+  return LIBMTP_HANDLER_RETURN_OK;
+}
+
+static uint16_t getFromMemory(void *params, void *priv, uint32_t wantlen, unsigned char *data, uint32_t *gotlen)
+{
+  MemoryStream *stream = (MemoryStream *)priv;
+  *gotlen = (uint32_t)min<uint64_t>(wantlen, stream->capacity - stream->position);
+  if (*gotlen > 0)
+    memcpy(data, stream->buffer + stream->position, *gotlen);
+  stream->position += *gotlen;
+  // the first packet of an empty file asks for 0 bytes
+  return *gotlen > 0 || wantlen == 0 ? LIBMTP_HANDLER_RETURN_OK : LIBMTP_HANDLER_RETURN_ERROR;
+}
+
+int downloadToMemory(LIBMTP_mtpdevice_t *device, uint32_t id, unsigned char *buffer, uint64_t capacity,
+                     vector<unsigned char> &overflow, uint64_t &received)
+{
+  MemoryStream stream = {buffer, capacity, 0, &overflow};
+  int ret = mtpGetFileToHandler(device, id, putToMemory, &stream, NULL, NULL);
+  received = stream.position;
+  return ret;
+}
+
+int uploadFromMemory(LIBMTP_mtpdevice_t *device, const unsigned char *data, uint64_t length, LIBMTP_file_t *filedata)
+{
+  MemoryStream stream = {(unsigned char *)data, length, 0, NULL};
+  filedata->filesize = length;
+  return mtpSendFileFromHandler(device, getFromMemory, &stream, filedata, NULL, NULL);
+}
+
+PathIndex::~PathIndex()
+{
+  for (LIBMTP_file_t *file : _files)
+    LIBMTP_destroy_file_t(file);
+}
+
+const LIBMTP_file_t *PathIndex::find(const string &path)
+{
+  auto known = _paths.find(path);
+  if (known != _paths.end())
+    return known->second;
+
+  size_t slash = path.find_last_of('/');
+  string name = slash == string::npos ? path : path.substr(slash + 1);
+  uint32_t folder = LIBMTP_FILES_AND_FOLDERS_ROOT;
+  const LIBMTP_file_t *file = NULL;
+  if (slash != string::npos)
+  {
+    const LIBMTP_file_t *parent = find(path.substr(0, slash));
+    folder = parent && parent->filetype == LIBMTP_FILETYPE_FOLDER ? parent->item_id : 0;
+  }
+
+  if (folder != 0 && !name.empty())
+  {
+    const map<string, LIBMTP_file_t *> &listing = children(folder);
+    auto child = listing.find(name);
+    if (child != listing.end())
+      file = child->second;
+  }
+
+  _paths[path] = file;
+  return file;
+}
+
+/**
+ * @return the children of a folder by name, listed on the first call
+ */
+const map<string, LIBMTP_file_t *> &PathIndex::children(uint32_t folder)
+{
+  auto listed = _folders.find(folder);
+  if (listed != _folders.end())
+    return listed->second;
+
+  map<string, LIBMTP_file_t *> &listing = _folders[folder];
+  LIBMTP_file_t *file = mtpGetFilesAndFolders(_device, _storage, folder);
+  while (file)
+  {
+    LIBMTP_file_t *tmp = file;
+    file = file->next;
+    tmp->next = NULL;
+    _files.push_back(tmp);
+    // like findFile, the first of two objects with the same name wins
+    listing.insert({tmp->filename, tmp});
+  }
+  return listing;
+}
+
+void listTree(LIBMTP_mtpdevice_t *device, uint32_t storage, uint32_t folder, vector<TreeEntry> &entries)
+{
+  // depth first, so the entries of one folder stay together in the archive
+  vector<pair<uint32_t, string>> folders;
+  folders.push_back({folder, ""});
+  while (!folders.empty())
+  {
+    uint32_t parent = folders.back().first;
+    string prefix = folders.back().second;
+    folders.pop_back();
+
+    size_t first = entries.size();
+    LIBMTP_file_t *file = mtpGetFilesAndFolders(device, storage, parent);
+    while (file)
+    {
+      bool isFolder = file->filetype == LIBMTP_FILETYPE_FOLDER;
+      entries.push_back({prefix + file->filename, file->item_id, isFolder ? 0 : file->filesize,
+                         file->modificationdate, isFolder});
+
+      LIBMTP_file_t *tmp = file;
+      file = file->next;
+      LIBMTP_destroy_file_t(tmp);
+    }
+
+    for (size_t i = entries.size(); i > first; i--)
+    {
+      if (entries[i - 1].folder)
+        folders.push_back({entries[i - 1].id, entries[i - 1].path + "/"});
+    }
+  }
+}
+
+int deleteTree(LIBMTP_mtpdevice_t *device, uint32_t storage, uint32_t id, bool folder, vector<uint32_t> *deleted)
+{
+  vector<TreeEntry> entries;
+  if (folder)
+    listTree(device, storage, id, entries);
+  entries.insert(entries.begin(), {"", id, 0, 0, folder});
+
+  // parents come first in the listing
+  for (size_t i = entries.size(); i > 0; i--)
+  {
+    if (mtpDeleteObject(device, entries[i - 1].id) != 0)
+      return -1;
+    if (deleted)
+      deleted->push_back(entries[i - 1].id);
+  }
+  return 0;
+}
+
+struct ArchiveStream
+{
+  ArchiveWriter *writer;
+  LIBMTP_progressfunc_t callback;
+  void const *data;
+  uint64_t done;
+  uint64_t total;
+};
+
+static uint16_t putToArchive(void *params, void *priv, uint32_t sendlen, unsigned char *data, uint32_t *putlen)
+{
+  ArchiveStream *stream = (ArchiveStream *)priv;
+  if (!stream->writer->write(data, sendlen))
+    return LIBMTP_HANDLER_RETURN_ERROR;
+  *putlen = sendlen;
+  return LIBMTP_HANDLER_RETURN_OK;
+}
+
+/**
+ * helper function to report the progress of one file as the progress of the whole archive
+ */
+static int archiveProgress(const uint64_t sent, const uint64_t total, void const *const data)
+{
+  ArchiveStream *stream = (ArchiveStream *)data;
+  return stream->callback(stream->done + sent, stream->total, stream->data);
+}
+
+int downloadToArchive(LIBMTP_mtpdevice_t *device, const vector<TreeEntry> &entries, ArchiveWriter &writer,
+                      LIBMTP_progressfunc_t const callback, void const *const data)
+{
+  ArchiveStream stream = {&writer, callback, data, 0, 0};
+  for (const TreeEntry &entry : entries)
+    stream.total += entry.size;
+
+  for (const TreeEntry &entry : entries)
+  {
+    if (entry.folder)
+    {
+      if (!writer.addFolder(entry.path, entry.mtime))
+        return -1;
+      continue;
+    }
+
+    if (!writer.beginFile(entry.path, entry.size, entry.mtime))
+      return -1;
+    if (entry.size > 0 &&
+        mtpGetFileToHandler(device, entry.id, putToArchive, &stream, callback ? archiveProgress : NULL, &stream) != 0)
+      return -1;
+    if (!writer.endFile())
+      return -1;
+    stream.done += entry.size;
+  }
+
+  return writer.finish() ? 0 : -1;
+}
+
+/**
+ * the device folders of an archive upload, by path relative to the target folder
+ */
+class FolderResolver
+{
+public:
+  FolderResolver(LIBMTP_mtpdevice_t *device, uint32_t storage, uint32_t folder)
+      : _device(device), _storage(storage), _created(0)
+  {
+    _folders[""] = folder;
+  }
+
+  /**
+   * @param path folder path relative to the target folder
+   * @return the folder id, 0 if it could not be created
+   */
+  uint32_t resolve(const string &path)
+  {
+    auto found = _folders.find(path);
+    if (found != _folders.end())
+      return found->second;
+
+    size_t slash = path.find_last_of('/');
+    string parentPath = slash == string::npos ? "" : path.substr(0, slash);
+    string name = slash == string::npos ? path : path.substr(slash + 1);
+
+    uint32_t parent = resolve(parentPath);
+    if (parent == 0 && !parentPath.empty())
+      return 0;
+
+    // the children of an existing folder are listed once, the folders they hold are reused
+    if (_listed.insert(parent).second)
+    {
+      string prefix = parentPath.empty() ? "" : parentPath + "/";
+      LIBMTP_file_t *file = mtpGetFilesAndFolders(_device, _storage, parent);
+      while (file)
+      {
+        if (file->filetype == LIBMTP_FILETYPE_FOLDER)
+          _folders.insert({prefix + file->filename, file->item_id});
+        LIBMTP_file_t *tmp = file;
+        file = file->next;
+        LIBMTP_destroy_file_t(tmp);
+      }
+
+      found = _folders.find(path);
+      if (found != _folders.end())
+        return found->second;
+    }
+
+    char *folderName = strdup(name.c_str());
+    uint32_t id = mtpCreateFolder(_device, folderName, parent, _storage);
+    free(folderName);
+    if (id == 0)
+      return 0;
+
+    _folders[path] = id;
+    // a new folder is empty, no need to list it
+    _listed.insert(id);
+    _created++;
+    return id;
+  }
+
+  uint32_t created() const { return _created; }
+
+private:
+  LIBMTP_mtpdevice_t *_device;
+  uint32_t _storage;
+  map<string, uint32_t> _folders;
+  set<uint32_t> _listed;
+  uint32_t _created;
+};
+
+struct ArchiveSource
+{
+  ArchiveReader *reader;
+  LIBMTP_progressfunc_t callback;
+  void const *data;
+  uint64_t total;
+};
+
+static uint16_t getFromArchive(void *params, void *priv, uint32_t wantlen, unsigned char *data, uint32_t *gotlen)
+{
+  ArchiveSource *source = (ArchiveSource *)priv;
+  *gotlen = (uint32_t)source->reader->read(data, wantlen);
+  // the first packet of an empty entry asks for 0 bytes
+  return *gotlen > 0 || wantlen == 0 ? LIBMTP_HANDLER_RETURN_OK : LIBMTP_HANDLER_RETURN_ERROR;
+}
+
+/**
+ * helper function to report the progress of one entry as the part of the archive read
+ */
+static int archiveSourceProgress(const uint64_t sent, const uint64_t total, void const *const data)
+{
+  ArchiveSource *source = (ArchiveSource *)data;
+  return source->callback(source->reader->consumed(), source->total, source->data);
+}
+
+int uploadFromArchive(LIBMTP_mtpdevice_t *device, uint32_t storage, uint32_t folder, ArchiveReader &reader,
+                      uint64_t archiveSize, LIBMTP_progressfunc_t const callback, void const *const data,
+                      ArchiveUploadResult &result)
+{
+  FolderResolver folders(device, storage, folder);
+  ArchiveSource source = {&reader, callback, data, archiveSize};
+  result = {0, 0, 0};
+
+  ArchiveEntry entry;
+  while (reader.next(entry))
+  {
+    if (entry.folder)
+    {
+      if (folders.resolve(entry.name) == 0)
+        return -1;
+      continue;
+    }
+
+    size_t slash = entry.name.find_last_of('/');
+    uint32_t parent = slash == string::npos ? folder : folders.resolve(entry.name.substr(0, slash));
+    if (parent == 0 && slash != string::npos)
+      return -1;
+
+    string filename = slash == string::npos ? entry.name : entry.name.substr(slash + 1);
+    LIBMTP_file_t *genfile = LIBMTP_new_file_t();
+    genfile->filesize = entry.size;
+    genfile->filename = strdup(filename.c_str());
+    genfile->filetype = find_filetype(filename.c_str());
+    genfile->modificationdate = entry.mtime;
+    genfile->parent_id = parent;
+    genfile->storage_id = storage;
+
+    int ret = mtpSendFileFromHandler(device, getFromArchive, &source, genfile,
+                                     callback ? archiveSourceProgress : NULL, &source);
+    LIBMTP_destroy_file_t(genfile);
+    if (ret != 0)
+      return -1;
+
+    result.files++;
+    result.bytes += entry.size;
+  }
+
+  result.folders = folders.created();
+  return reader.failed() ? -1 : 0;
+}
+
+// a copy through the host is read and written in ranges of this size
+static const uint32_t HOST_COPY_RANGE = 1024 * 1024;
+// the largest file copied through memory by a device that can not edit objects
+static const uint64_t HOST_COPY_MEMORY_LIMIT = 256 * 1024 * 1024;
+
+struct HostCopy
+{
+  LIBMTP_mtpdevice_t *device;
+  uint32_t storage;
+  bool edit;
+  bool verify;
+  LIBMTP_progressfunc_t callback;
+  void const *data;
+  // bytes of the files already copied, and of all the files
+  uint64_t done;
+  uint64_t total;
+  // the file being copied through memory, read then sent
+  uint64_t size;
+  bool sending;
+};
+
+/**
+ * helper function to report the read and the send of a file copied through
+ * memory as the two halves of its copy
+ */
+static int hostCopyProgress(const uint64_t sent, const uint64_t total, void const *const data)
+{
+  HostCopy *copy = (HostCopy *)data;
+  uint64_t position = copy->sending ? copy->size + sent : sent;
+  return copy->callback(copy->done + position / 2, copy->total, copy->data);
+}
+
+/**
+ * helper function to fill an empty copy range by range
+ *
+ * @return false if a range could not be copied or the copy was cancelled
+ */
+static bool copyRanges(HostCopy &copy, uint32_t source, uint32_t target, uint64_t size)
+{
+  if (mtpBeginEditObject(copy.device, target) != 0)
+    return false;
+
+  bool ok = true;
+  for (uint64_t offset = 0; ok && offset < size;)
+  {
+    uint32_t length = (uint32_t)min<uint64_t>(HOST_COPY_RANGE, size - offset);
+    unsigned char *range = NULL;
+    unsigned int got = 0;
+    ok = mtpGetPartialObject(copy.device, source, offset, length, &range, &got) == 0 && got == length &&
+         mtpSendPartialObject(copy.device, target, offset, range, got) == 0;
+    free(range);
+    offset += length;
+
+    if (ok && copy.callback && copy.callback(copy.done + offset, copy.total, copy.data) != 0)
+      ok = false;
+  }
+
+  // the edit is always closed, the device keeps the object locked otherwise
+  ok = mtpEndEditObject(copy.device, target) == 0 && ok;
+  return ok;
+}
+
+/**
+ * helper function to check a copy has the size of its source, and the same first and last ranges
+ */
+static bool verifyCopy(HostCopy &copy, uint32_t source, uint32_t target, uint64_t size)
+{
+  LIBMTP_file_t *file = mtpGetFilemetadata(copy.device, target);
+  bool ok = file && file->filesize == size;
+  if (file)
+    LIBMTP_destroy_file_t(file);
+  if (!ok || size == 0 || !mtpCheckCapability(copy.device, LIBMTP_DEVICECAP_GetPartialObject))
+    return ok;
+
+  uint32_t length = (uint32_t)min<uint64_t>(SAMPLE_RANGE, size);
+  uint64_t offsets[] = {0, size - length};
+  for (uint64_t offset : offsets)
+  {
+    unsigned char *first = NULL, *second = NULL;
+    unsigned int firstSize = 0, secondSize = 0;
+    ok = mtpGetPartialObject(copy.device, source, offset, length, &first, &firstSize) == 0 &&
+         mtpGetPartialObject(copy.device, target, offset, length, &second, &secondSize) == 0 &&
+         firstSize == length && secondSize == length && memcmp(first, second, length) == 0;
+    free(first);
+    free(second);
+    if (!ok || offset == size - length)
+      break;
+  }
+  return ok;
+}
+
+/**
+ * helper function to copy one file into a folder
+ *
+ * @param id receives the id of the copy, set as soon as it exists on the device, even if the copy fails
+ * @return false if the copy failed
+ */
+static bool copyFile(HostCopy &copy, const LIBMTP_file_t *source, uint32_t parent, uint32_t &id)
+{
+  uint64_t size = source->filesize;
+  id = 0;
+  if (!copy.edit && size > HOST_COPY_MEMORY_LIMIT)
+    return false;
+
+  LIBMTP_file_t *genfile = LIBMTP_new_file_t();
+  genfile->filename = strdup(source->filename);
+  genfile->filetype = source->filetype;
+  genfile->modificationdate = source->modificationdate;
+  genfile->parent_id = parent;
+  genfile->storage_id = copy.storage;
+
+  bool ok;
+  if (copy.edit)
+  {
+    // created empty, then filled in place
+    ok = uploadFromMemory(copy.device, NULL, 0, genfile) == 0;
+    id = genfile->item_id;
+    ok = ok && copyRanges(copy, source->item_id, id, size);
+  }
+  else
+  {
+    vector<unsigned char> buffer(size);
+    vector<unsigned char> overflow;
+    MemoryStream stream = {buffer.data(), size, 0, &overflow};
+    LIBMTP_progressfunc_t callback = copy.callback ? hostCopyProgress : NULL;
+    copy.size = size;
+    copy.sending = false;
+    ok = mtpGetFileToHandler(copy.device, source->item_id, putToMemory, &stream, callback, &copy) == 0 &&
+         stream.position == size;
+
+    if (ok)
+    {
+      copy.sending = true;
+      stream = {buffer.data(), size, 0, NULL};
+      genfile->filesize = size;
+      ok = mtpSendFileFromHandler(copy.device, getFromMemory, &stream, genfile, callback, &copy) == 0;
+      id = genfile->item_id;
+    }
+  }
+  LIBMTP_destroy_file_t(genfile);
+
+  if (ok && copy.verify)
+    ok = verifyCopy(copy, source->item_id, id, size);
+  copy.done += size;
+  return ok;
+}
+
+/**
+ * helper function to copy the content of a folder tree into the folder created for its copy
+ */
+static bool copyFolder(HostCopy &copy, const vector<TreeEntry> &entries, uint32_t folder, CopyResult &result)
+{
+  map<string, uint32_t> folders;
+  folders[""] = folder;
+
+  for (const TreeEntry &entry : entries)
+  {
+    size_t slash = entry.path.find_last_of('/');
+    string name = slash == string::npos ? entry.path : entry.path.substr(slash + 1);
+    uint32_t parent = folders[slash == string::npos ? "" : entry.path.substr(0, slash)];
+
+    if (entry.folder)
+    {
+      char *folderName = strdup(name.c_str());
+      uint32_t id = mtpCreateFolder(copy.device, folderName, parent, copy.storage);
+      free(folderName);
+      if (id == 0)
+        return false;
+      folders[entry.path] = id;
+      result.folders++;
+      continue;
+    }
+
+    LIBMTP_file_t *file = LIBMTP_new_file_t();
+    file->item_id = entry.id;
+    file->filename = strdup(name.c_str());
+    file->filetype = find_filetype(name.c_str());
+    file->filesize = entry.size;
+    file->modificationdate = entry.mtime;
+    uint32_t id;
+    bool ok = copyFile(copy, file, parent, id);
+    LIBMTP_destroy_file_t(file);
+    if (!ok)
+      return false;
+    result.files++;
+    result.bytes += entry.size;
+  }
+  return true;
+}
+
+int copyThroughHost(LIBMTP_mtpdevice_t *device, uint32_t storage, const LIBMTP_file_t *source, uint32_t parent,
+                    bool verify, LIBMTP_progressfunc_t const callback, void const *const data,
+                    CopyResult &result)
+{
+  result = {0, 0, 0, 0};
+  bool edit = mtpCheckCapability(device, LIBMTP_DEVICECAP_GetPartialObject) &&
+              mtpCheckCapability(device, LIBMTP_DEVICECAP_SendPartialObject) &&
+              mtpCheckCapability(device, LIBMTP_DEVICECAP_EditObjects);
+  HostCopy copy = {device, storage, edit, verify, callback, data, 0, 0, 0, false};
+
+  bool ok;
+  if (source->filetype != LIBMTP_FILETYPE_FOLDER)
+  {
+    copy.total = source->filesize;
+    ok = copyFile(copy, source, parent, result.id);
+    if (ok)
+    {
+      result.files = 1;
+      result.bytes = source->filesize;
+    }
+  }
+  else
+  {
+    vector<TreeEntry> entries;
+    listTree(device, storage, source->item_id, entries);
+    for (const TreeEntry &entry : entries)
+      copy.total += entry.size;
+
+    char *folderName = strdup(source->filename);
+    result.id = mtpCreateFolder(device, folderName, parent, storage);
+    free(folderName);
+    ok = result.id != 0;
+    if (ok)
+    {
+      result.folders = 1;
+      ok = copyFolder(copy, entries, result.id, result);
+    }
+  }
+
+  // a partial copy is not left behind
+  if (!ok && result.id != 0)
+    deleteTree(device, storage, result.id, source->filetype == LIBMTP_FILETYPE_FOLDER, NULL);
+  return ok ? 0 : -1;
+}
+
+static uint16_t putToPipe(void *params, void *priv, uint32_t sendlen, unsigned char *data, uint32_t *putlen)
+{
+  DevicePipe *pipe = (DevicePipe *)priv;
+  if (!pipe->write(data, sendlen))
+    return LIBMTP_HANDLER_RETURN_ERROR;
+  *putlen = sendlen;
+  return LIBMTP_HANDLER_RETURN_OK;
+}
+
+static uint16_t getFromPipe(void *params, void *priv, uint32_t wantlen, unsigned char *data, uint32_t *gotlen)
+{
+  DevicePipe *pipe = (DevicePipe *)priv;
+  *gotlen = (uint32_t)pipe->read(data, wantlen);
+  // the first packet of an empty file asks for 0 bytes
+  return *gotlen > 0 || wantlen == 0 ? LIBMTP_HANDLER_RETURN_OK : LIBMTP_HANDLER_RETURN_ERROR;
+}
+
+struct PipeProgress
+{
+  LIBMTP_progressfunc_t callback;
+  void const *data;
+  uint64_t done;
+  uint64_t total;
+};
+
+/**
+ * helper function to report the progress of one file as the progress of the whole transfer
+ */
+static int pipeProgress(const uint64_t sent, const uint64_t total, void const *const data)
+{
+  PipeProgress *progress = (PipeProgress *)data;
+  return progress->callback(progress->done + sent, progress->total, progress->data);
+}
+
+/**
+ * helper function to read the files of a transfer into the pipe, on the thread of the source device
+ */
+static void readToPipe(LIBMTP_mtpdevice_t *source, const vector<TreeEntry> &entries, DevicePipe &pipe)
+{
+  for (const TreeEntry &entry : entries)
+  {
+    if (entry.folder)
+      continue;
+    if (mtpGetFileToHandler(source, entry.id, putToPipe, &pipe, NULL, NULL) != 0 || !pipe.endFile())
+    {
+      pipe.fail();
+      return;
+    }
+  }
+}
+
+int transferBetweenDevices(LIBMTP_mtpdevice_t *source, uint32_t sourceStorage, const LIBMTP_file_t *file,
+                           LIBMTP_mtpdevice_t *target, uint32_t targetStorage, uint32_t parent,
+                           LIBMTP_progressfunc_t const callback, void const *const data, CopyResult &result)
+{
+  result = {0, 0, 0, 0};
+  bool tree = file->filetype == LIBMTP_FILETYPE_FOLDER;
+  vector<TreeEntry> entries;
+  if (tree)
+    listTree(source, sourceStorage, file->item_id, entries);
+  else
+    entries.push_back({file->filename, file->item_id, file->filesize, file->modificationdate, false});
+
+  PipeProgress progress = {callback, data, 0, 0};
+  for (const TreeEntry &entry : entries)
+    progress.total += entry.size;
+
+  map<string, uint32_t> folders;
+  folders[""] = parent;
+  if (tree)
+  {
+    char *folderName = strdup(file->filename);
+    result.id = mtpCreateFolder(target, folderName, parent, targetStorage);
+    free(folderName);
+    if (result.id == 0)
+      return -1;
+    folders[""] = result.id;
+    result.folders = 1;
+  }
+
+  DevicePipe pipe;
+  bool ok = pipe.open();
+  thread reader;
+  if (ok)
+    reader = thread(readToPipe, source, cref(entries), ref(pipe));
+
+  for (size_t i = 0; ok && i < entries.size(); i++)
+  {
+    const TreeEntry &entry = entries[i];
+    size_t slash = entry.path.find_last_of('/');
+    string name = slash == string::npos ? entry.path : entry.path.substr(slash + 1);
+    uint32_t folder = folders[slash == string::npos ? "" : entry.path.substr(0, slash)];
+
+    if (entry.folder)
+    {
+      char *folderName = strdup(name.c_str());
+      uint32_t id = mtpCreateFolder(target, folderName, folder, targetStorage);
+      free(folderName);
+      ok = id != 0;
+      folders[entry.path] = id;
+      result.folders++;
+      continue;
+    }
+
+    LIBMTP_file_t *genfile = LIBMTP_new_file_t();
+    genfile->filesize = entry.size;
+    genfile->filename = strdup(name.c_str());
+    genfile->filetype = find_filetype(name.c_str());
+    genfile->modificationdate = entry.mtime;
+    genfile->parent_id = folder;
+    genfile->storage_id = targetStorage;
+
+    ok = mtpSendFileFromHandler(target, getFromPipe, &pipe, genfile, callback ? pipeProgress : NULL, &progress) == 0 &&
+         pipe.nextFile();
+    if (!tree)
+      result.id = genfile->item_id;
+    LIBMTP_destroy_file_t(genfile);
+
+    progress.done += entry.size;
+    if (ok)
+    {
+      result.files++;
+      result.bytes += entry.size;
+    }
+  }
+
+  // a failed send stops the reader as well
+  if (!ok)
+    pipe.fail();
+  if (reader.joinable())
+    reader.join();
+
+  if (!ok && result.id != 0)
+    deleteTree(target, targetStorage, result.id, tree, NULL);
+  return ok ? 0 : -1;
+}
+
+// a read of a device file fetches at least this much, and at most this much per request
+static const uint64_t PARTIAL_READ_AHEAD = 64 * 1024;
+static const uint32_t PARTIAL_READ_MAX = 8 * 1024 * 1024;
+
+bool PartialObjectInput::readAt(uint64_t offset, unsigned char *data, size_t length)
+{
+  while (length > 0)
+  {
+    if ((offset < _bufferOffset || offset >= _bufferOffset + _buffer.size()) && !fetch(offset, length))
+      return false;
+
+    size_t take = (size_t)min<uint64_t>(length, _bufferOffset + _buffer.size() - offset);
+    memcpy(data, _buffer.data() + (offset - _bufferOffset), take);
+    data += take;
+    offset += take;
+    length -= take;
+  }
+  return true;
+}
+
+void PartialObjectInput::expect(uint64_t offset, uint64_t length)
+{
+  _expectEnd = min(offset + length, _size);
+}
+
+/**
+ * replace the buffer with a range of the file starting at <code>offset</code>,
+ * at least <code>length</code> bytes, and the rest of the expected range up to
+ * PARTIAL_READ_MAX bytes, or PARTIAL_READ_AHEAD bytes outside of it
+ */
+bool PartialObjectInput::fetch(uint64_t offset, uint64_t length)
+{
+  if (offset >= _size)
+    return false;
+
+  uint64_t ahead = offset < _expectEnd ? min<uint64_t>(_expectEnd - offset, PARTIAL_READ_MAX) : PARTIAL_READ_AHEAD;
+  uint64_t wanted = min(max(length, ahead), _size - offset);
+
+  _buffer.clear();
+  _bufferOffset = offset;
+  while (_buffer.size() < wanted)
+  {
+    uint32_t request = (uint32_t)min<uint64_t>(wanted - _buffer.size(), PARTIAL_READ_MAX);
+    unsigned char *range = NULL;
+    unsigned int got = 0;
+    if (mtpGetPartialObject(_device, _id, offset + _buffer.size(), request, &range, &got) != 0 || got == 0)
+    {
+      free(range);
+      _buffer.clear();
+      return false;
+    }
+    _buffer.insert(_buffer.end(), range, range + min(got, request));
+    _transferred += got;
+    free(range);
+  }
+  return true;
+}
+
+// the data of a zip entry is written in parts of this size
+static const size_t ZIP_EXTRACT_CHUNK = 256 * 1024;
+
+int extractFromZip(ZipArchiveReader &reader, size_t index, ArchiveOutput &output,
+                   LIBMTP_progressfunc_t const callback, void const *const data)
+{
+  ArchiveEntry entry;
+  if (!reader.select(index, entry) || entry.folder)
+    return -1;
+
+  vector<unsigned char> buffer((size_t)min<uint64_t>(ZIP_EXTRACT_CHUNK, max<uint64_t>(entry.size, 1)));
+  for (uint64_t done = 0; done < entry.size;)
+  {
+    // the reader checks the crc of the entry with its last bytes
+    size_t got = reader.read(buffer.data(), buffer.size());
+    if (got == 0 || !output.write(buffer.data(), got))
+      return -1;
+
+    done += got;
+    if (callback && callback(done, entry.size, data) != 0)
+      return -1;
+  }
+  return output.close() ? 0 : -1;
+}
@@ -0,0 +1,385 @@
+#ifndef LUCK_MTP_TRANSFER
+#define LUCK_MTP_TRANSFER
+
+#include <stdint.h>
+#include <time.h>
+#include <string>
+#include <vector>
+#include <map>
+#include "libmtp.h"
+#include "checksum.h"
+#include "archive.h"
+#include "file_writer.h"
+
+using namespace std;
+
+/**
+ * download a file through the libmtp data handler into a double buffered
+ * writer, so the usb transfer goes on while the disk writes, and every chunk
+ * can be hashed while it is still in the cache instead of reading the file again
+ *
+ * a file larger than <code>sliceSize</code> is read in ranges of that size
+ * with GetPartialObject, each its own libmtp call, so the calls of a higher
+ * priority class waiting for the session run between two slices. a device
+ * without partial reads gets a single transfer.
+ *
+ * @param device the connected device
+ * @param id the object id of the file
+ * @param path the local file path, removed if the download fails
+ * @param size the size of the file reported by the device, used to preallocate the local file
+ * @param hash the checksums updated with every chunk
+ * @param options the fsync policy of the local file
+ * @param sliceSize the size of a slice, 0 to transfer the file in a single call
+ * @param callback libmtp progress callback
+ * @param data user data of the progress callback
+ * @return 0 if the transfer was successful
+ */
+int downloadToFile(LIBMTP_mtpdevice_t *device, uint32_t id, const char *path, uint64_t size, StreamHash &hash,
+                   const FileWriterOptions &options, uint32_t sliceSize, LIBMTP_progressfunc_t const callback,
+                   void const *const data);
+
+/**
+ * upload a file through the libmtp data handler, hashing every chunk as it is read
+ *
+ * @param device the connected device
+ * @param path the local file path
+ * @param filedata the new file, <code>filesize</code> must be the size of the local file
+ * @param hash the checksums updated with every chunk
+ * @param callback libmtp progress callback
+ * @param data user data of the progress callback
+ * @return 0 if the transfer was successful
+ */
+int uploadFromFile(LIBMTP_mtpdevice_t *device, const char *path, LIBMTP_file_t *filedata, StreamHash &hash,
+                   LIBMTP_progressfunc_t const callback, void const *const data);
+
+/**
+ * outcome of comparing a device file with a local file through sampled ranges
+ */
+enum SampleMatch
+{
+  SAMPLE_DIFFERENT,
+  SAMPLE_IDENTICAL,
+  // the device can not read a part of an object, or a file can not be read
+  SAMPLE_UNAVAILABLE
+};
+
+/**
+ * compare a device file with a local file of the same size without downloading it
+ *
+ * a few ranges of the device file are read with GetPartialObject and compared
+ * with the same ranges of the local file: the first and the last ones and
+ * some evenly spaced in between. a small file is compared entirely.
+ *
+ * @param device the connected device
+ * @param id the object id of the device file
+ * @param path the local file path
+ * @param size the size of both files
+ * @param sampled receives the number of bytes read from the device
+ * @return whether the sampled ranges are identical
+ */
+SampleMatch sampleCompare(LIBMTP_mtpdevice_t *device, uint32_t id, const char *path, uint64_t size, uint64_t &sampled);
+
+/**
+ * totals of a delta upload
+ */
+struct DeltaResult
+{
+  // bytes read from the device to compare
+  uint64_t read;
+  // bytes written to the device
+  uint64_t sent;
+};
+
+/**
+ * update a device file in place to the content of a local file, only the blocks that differ are sent
+ *
+ * the device file is read in large ranges with GetPartialObject, each block
+ * is compared with the same block of the local file, and runs of different
+ * blocks are written with SendPartialObject, inside a BeginEditObject and
+ * EndEditObject bracket. a longer local file is appended, a shorter one truncates the device file.
+ *
+ * @param device the connected device
+ * @param id the object id of the device file
+ * @param deviceSize the size of the device file
+ * @param path the local file path
+ * @param size the size of the local file
+ * @param hash the checksums updated with every block of the local file
+ * @param callback libmtp progress callback, called with the bytes of the local file compared
+ * @param data user data of the progress callback
+ * @param result receives the number of bytes read and sent
+ * @return 0 if the file was updated, 1 if the device can not edit files and nothing was done,
+ *         -1 if the update failed, the device file may then be partly updated
+ */
+int deltaUpload(LIBMTP_mtpdevice_t *device, uint32_t id, uint64_t deviceSize, const char *path, uint64_t size,
+                StreamHash &hash, LIBMTP_progressfunc_t const callback, void const *const data, DeltaResult &result);
+
+/**
+ * download a file into memory
+ *
+ * the data is copied straight from the libmtp chunks into the buffer, sized
+ * from the file size known before the transfer. if the file grew in the
+ * meantime, the extra bytes are kept in <code>overflow</code>.
+ *
+ * @param device the connected device
+ * @param id the object id of the file
+ * @param buffer the buffer, usually the size of the file
+ * @param capacity the size of the buffer
+ * @param overflow receives the bytes that did not fit in the buffer
+ * @param received receives the number of bytes downloaded
+ * @return 0 if the transfer was successful
+ */
+int downloadToMemory(LIBMTP_mtpdevice_t *device, uint32_t id, unsigned char *buffer, uint64_t capacity,
+                     vector<unsigned char> &overflow, uint64_t &received);
+
+/**
+ * upload a file from memory, the chunks are sent from the buffer without copying it first
+ *
+ * @param device the connected device
+ * @param data the file content
+ * @param length the size of the file
+ * @param filedata the new file, its size is set to <code>length</code>
+ * @return 0 if the transfer was successful
+ */
+int uploadFromMemory(LIBMTP_mtpdevice_t *device, const unsigned char *data, uint64_t length, LIBMTP_file_t *filedata);
+
+/**
+ * device paths looked up through folder listings
+ *
+ * each folder is listed at most once whatever the number of paths under it,
+ * so looking up many paths costs one listing per distinct parent folder
+ * instead of one per ancestor of every path. nothing of the connection state
+ * is touched, it can be used from a background job.
+ */
+class PathIndex
+{
+public:
+  /**
+   * @param device the connected device
+   * @param storage the storage id
+   */
+  PathIndex(LIBMTP_mtpdevice_t *device, uint32_t storage) : _device(device), _storage(storage) {}
+  PathIndex(const PathIndex &) = delete;
+  PathIndex &operator=(const PathIndex &) = delete;
+  ~PathIndex();
+
+  /**
+   * @param path the path from the root of the storage, '/' separated, @see formatMtpPath
+   * @return the file, owned by the index, NULL if not found
+   */
+  const LIBMTP_file_t *find(const string &path);
+
+private:
+  const map<string, LIBMTP_file_t *> &children(uint32_t folder);
+
+  LIBMTP_mtpdevice_t *_device;
+  uint32_t _storage;
+  map<string, const LIBMTP_file_t *> _paths;
+  map<uint32_t, map<string, LIBMTP_file_t *>> _folders;
+  vector<LIBMTP_file_t *> _files;
+};
+
+/**
+ * a file or folder of a device folder tree
+ */
+struct TreeEntry
+{
+  string path;
+  uint32_t id;
+  uint64_t size;
+  time_t mtime;
+  bool folder;
+};
+
+/**
+ * list a device folder tree, parents come before their children
+ *
+ * @param device the connected device
+ * @param storage the storage id
+ * @param folder the folder id, LIBMTP_FILES_AND_FOLDERS_ROOT for the root of the storage
+ * @param entries receives the entries, paths relative to the folder
+ */
+void listTree(LIBMTP_mtpdevice_t *device, uint32_t storage, uint32_t folder, vector<TreeEntry> &entries);
+
+/**
+ * delete a file, or a folder and everything below it
+ *
+ * a device may not delete the children of a folder along with it, and leave
+ * them as objects whose parent does not exist, so the folder tree is listed
+ * and deleted from the leaves up, children before their parent.
+ *
+ * @param device the connected device
+ * @param storage the storage id
+ * @param id the object id
+ * @param folder true if the object is a folder
+ * @param deleted receives the ids of the objects deleted, may be NULL
+ * @return 0 if everything was deleted, -1 otherwise, the deletion then stops at the first failure
+ */
+int deleteTree(LIBMTP_mtpdevice_t *device, uint32_t storage, uint32_t id, bool folder, vector<uint32_t> *deleted);
+
+/**
+ * download the files of a folder tree straight into an archive, without intermediate files
+ *
+ * @param device the connected device
+ * @param entries the folder tree, @see listTree
+ * @param writer the archive, finished when all the entries are written
+ * @param callback libmtp progress callback, called with the bytes of all the files
+ * @param data user data of the progress callback
+ * @return 0 if the transfer was successful
+ */
+int downloadToArchive(LIBMTP_mtpdevice_t *device, const vector<TreeEntry> &entries, ArchiveWriter &writer,
+                      LIBMTP_progressfunc_t const callback, void const *const data);
+
+/**
+ * totals of a copy of a file or folder tree
+ */
+struct CopyResult
+{
+  // the object id of the copy
+  uint32_t id;
+  uint32_t files;
+  uint32_t folders;
+  uint64_t bytes;
+};
+
+/**
+ * copy a file or a folder tree to another folder of the same device through
+ * the host, for a device without CopyObject or MoveObject. nothing is written
+ * to the local disk.
+ *
+ * MTP runs one operation at a time in a session, so the download and the
+ * upload of the same device can not overlap. a device that can edit objects
+ * gets each copy created empty and filled range by range, a range read with
+ * GetPartialObject and written with SendPartialObject, so at most one range
+ * is held in memory whatever the size of the file. other devices get each
+ * file read into memory with Get_File_To_Handler and sent from there with
+ * Send_File_From_Handler, up to HOST_COPY_MEMORY_LIMIT bytes per file.
+ *
+ * @param device the connected device
+ * @param storage the storage id of the source and the target
+ * @param source the file or folder to copy
+ * @param parent the target folder id, 0 for the root of the storage
+ * @param verify true to check every copied file against its source, its size
+ * and its first and last ranges, before the next one is copied
+ * @param callback libmtp progress callback, called with the bytes of all the
+ * files, a nonzero return cancels the copy
+ * @param data user data of the progress callback
+ * @param result receives the id of the copy and the number of files, folders and bytes copied
+ * @return 0 if the copy was successful, -1 otherwise, what was already copied is then deleted
+ */
+int copyThroughHost(LIBMTP_mtpdevice_t *device, uint32_t storage, const LIBMTP_file_t *source, uint32_t parent,
+                    bool verify, LIBMTP_progressfunc_t const callback, void const *const data,
+                    CopyResult &result);
+
+/**
+ * copy a file or a folder tree from one device to another, without intermediate files
+ *
+ * the source device is read with Get_File_To_Handler on a thread of its own
+ * while the calling thread sends to the target device with
+ * Send_File_From_Handler, through a bounded ring of slabs, @see DevicePipe.
+ * the files of a folder tree go through the same pipe one after the other,
+ * the next file is read while the previous one is still being sent.
+ *
+ * @param source the device to read
+ * @param sourceStorage the storage id of the source
+ * @param file the file or folder to copy
+ * @param target the device to write, not the source device
+ * @param targetStorage the storage id of the target
+ * @param parent the target folder id, LIBMTP_FILES_AND_FOLDERS_ROOT for the root of the storage
+ * @param callback libmtp progress callback, called on the calling thread with the bytes of all the files
+ * sent, a nonzero return cancels the transfer
+ * @param data user data of the progress callback
+ * @param result receives the id of the copy and the number of files, folders and bytes copied
+ * @return 0 if the transfer was successful, -1 otherwise, what was already copied is then deleted
+ */
+int transferBetweenDevices(LIBMTP_mtpdevice_t *source, uint32_t sourceStorage, const LIBMTP_file_t *file,
+                           LIBMTP_mtpdevice_t *target, uint32_t targetStorage, uint32_t parent,
+                           LIBMTP_progressfunc_t const callback, void const *const data, CopyResult &result);
+
+/**
+ * totals of an archive upload
+ */
+struct ArchiveUploadResult
+{
+  uint32_t files;
+  uint32_t folders;
+  uint64_t bytes;
+};
+
+/**
+ * upload the entries of an archive into a device folder, each file is streamed
+ * from the decompressor into libmtp without extracting it to disk
+ *
+ * missing folders are created, existing ones are reused. the folders of the
+ * device are listed once, the first time one of their children is needed.
+ *
+ * @param device the connected device
+ * @param storage the storage id
+ * @param folder the target folder id, LIBMTP_FILES_AND_FOLDERS_ROOT for the root of the storage
+ * @param reader the archive
+ * @param archiveSize the size of the archive file, the progress is reported over it
+ * @param callback libmtp progress callback
+ * @param data user data of the progress callback
+ * @param result receives the number of files uploaded and folders created
+ * @return 0 if the upload was successful
+ */
+int uploadFromArchive(LIBMTP_mtpdevice_t *device, uint32_t storage, uint32_t folder, ArchiveReader &reader,
+                      uint64_t archiveSize, LIBMTP_progressfunc_t const callback, void const *const data,
+                      ArchiveUploadResult &result);
+
+
+/**
+ * random access to a device file through GetPartialObject
+ *
+ * a read outside the buffered range fetches the rest of the range announced
+ * with <code>expect</code>, or PARTIAL_READ_AHEAD bytes outside of it, so
+ * reading a zip entry costs one request per PARTIAL_READ_MAX bytes of
+ * compressed data instead of one per inflate chunk.
+ */
+class PartialObjectInput : public ArchiveInput
+{
+public:
+  /**
+   * @param device the connected device, must be able to read a part of an object
+   * @param id the object id of the file
+   * @param size the size of the file
+   */
+  PartialObjectInput(LIBMTP_mtpdevice_t *device, uint32_t id, uint64_t size)
+      : _device(device), _id(id), _size(size), _bufferOffset(0), _expectEnd(0), _transferred(0) {}
+
+  uint64_t size() const override { return _size; }
+
+  bool readAt(uint64_t offset, unsigned char *data, size_t length) override;
+
+  void expect(uint64_t offset, uint64_t length) override;
+
+  /**
+   * @return the number of bytes read from the device
+   */
+  uint64_t transferred() const { return _transferred; }
+
+private:
+  bool fetch(uint64_t offset, uint64_t length);
+
+  LIBMTP_mtpdevice_t *_device;
+  uint32_t _id;
+  uint64_t _size;
+  vector<unsigned char> _buffer;
+  uint64_t _bufferOffset;
+  uint64_t _expectEnd;
+  uint64_t _transferred;
+};
+
+/**
+ * inflate one entry of a zip archive into an output, its checksum is verified
+ *
+ * @param reader the archive
+ * @param index the index of the entry, @see ZipArchiveReader::entries
+ * @param output where the data of the entry is written, closed at the end
+ * @param callback libmtp progress callback, called with the bytes of the entry, a nonzero return cancels
+ * @param data user data of the progress callback
+ * @return 0 if the entry was extracted
+ */
+int extractFromZip(ZipArchiveReader &reader, size_t index, ArchiveOutput &output,
+                   LIBMTP_progressfunc_t const callback, void const *const data);
+
+#endif
@@ -1,6 +1,9 @@
+#include <stdio.h>
+#include <stdint.h>
 #include <string.h>
 #include <regex>
 #include <vector>
+#include <chrono>
 #include "libmtp.h"
 
 using namespace std;
@@ -26,8 +29,8 @@ string formatMtpPath(const string &path)
      re = path.substr(1, path.length() - 1);
   }
 
-  char lastCharacter = re[re.length() - 1];
-  if (lastCharacter == '/')
+  // the root "/" is empty by now
+  if (!re.empty() && re[re.length() - 1] == '/')
   {
      re = re.substr(0, re.length() - 1);
   }
@@ -35,6 +38,20 @@ string formatMtpPath(const string &path)
   return re;
 }
 
+double msSince(const chrono::steady_clock::time_point &start)
+{
+  return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+bool seekFile(FILE *fd, uint64_t offset)
+{
+#ifdef _WIN32
+  return _fseeki64(fd, (__int64)offset, SEEK_SET) == 0;
+#else
+  return fseeko(fd, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
 LIBMTP_filetype_t
 find_filetype(const char *filename)
 {
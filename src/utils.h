@@ -1,9 +1,12 @@
 #ifndef LUCK_MTP_UTILS
 #define LUCK_MTP_UTILS
 
+#include <stdio.h>
+#include <stdint.h>
 #include <string.h>
 #include <regex>
 #include <vector>
+#include <chrono>
 #include "libmtp.h"
 
 using namespace std;
@@ -18,6 +21,16 @@ vector<string> split(const string &input, const string &regex);
 */
 string formatMtpPath(const string &path);
 
+/**
+ * milliseconds elapsed since a steady clock time point
+*/
+double msSince(const chrono::steady_clock::time_point &start);
+
+/**
+ * seek in a large file
+ */
+bool seekFile(FILE *fd, uint64_t offset);
+
 /**
  * find file type
 */
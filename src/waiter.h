@@ -0,0 +1,62 @@
+#ifndef LUCK_MTP_WAITER
+#define LUCK_MTP_WAITER
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+using namespace std;
+
+/**
+ * sleeping side of the lock free queues between two threads
+ *
+ * <code>wait</code> spins a little before sleeping, and <code>wake</code>
+ * only takes the mutex when someone sleeps, so a transfer that keeps both
+ * threads busy never locks.
+ */
+class Waiter
+{
+public:
+  /**
+   * block until <code>ready</code> returns true
+   *
+   * @param ready checked while spinning and under the mutex once sleeping
+   */
+  template <typename Ready>
+  void wait(Ready ready)
+  {
+    for (int i = 0; i < 64; i++)
+    {
+      if (ready())
+        return;
+      this_thread::yield();
+    }
+
+    unique_lock<mutex> lock(_mutex);
+    _sleepers++;
+    atomic_thread_fence(memory_order_seq_cst);
+    _cond.wait(lock, ready);
+    _sleepers--;
+  }
+
+  /**
+   * wake the sleeping side, called after every change <code>ready</code> may see
+   */
+  void wake()
+  {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (_sleepers.load() > 0)
+    {
+      lock_guard<mutex> lock(_mutex);
+      _cond.notify_all();
+    }
+  }
+
+private:
+  mutex _mutex;
+  condition_variable _cond;
+  atomic<int> _sleepers{0};
+};
+
+#endif
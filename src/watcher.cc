@@ -0,0 +1,396 @@
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <dirent.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+#include "watcher.h"
+
+using namespace std;
+
+#ifdef __linux__
+static const uint32_t WATCH_MASK = IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_MOVED_FROM |
+                                   IN_MOVED_TO | IN_DELETE_SELF | IN_ONLYDIR;
+#endif
+
+// a tree that never gets quiet is still flushed after this many debounce delays
+static const int WATCH_MAX_DELAYS = 10;
+
+/**
+ * helper function to join a relative path and a name
+ */
+static string childPath(const string &relative, const string &name)
+{
+  return relative.empty() ? name : relative + "/" + name;
+}
+
+bool statLocal(const string &path, LocalEntry &entry)
+{
+#ifdef _WIN32
+  struct _stat64 info;
+  if (_stat64(path.c_str(), &info) != 0)
+    return false;
+  entry.folder = (info.st_mode & _S_IFDIR) != 0;
+#else
+  struct stat info;
+  if (stat(path.c_str(), &info) != 0)
+    return false;
+  entry.folder = S_ISDIR(info.st_mode);
+#endif
+  entry.size = entry.folder ? 0 : (uint64_t)info.st_size;
+  entry.mtime = info.st_mtime;
+  return true;
+}
+
+void scanDirectory(const string &root, const string &relative, map<string, LocalEntry> &entries)
+{
+  string folder = relative.empty() ? root : root + "/" + relative;
+  vector<string> children;
+#ifdef _WIN32
+  struct __finddata64_t found;
+  intptr_t handle = _findfirst64((folder + "/*").c_str(), &found);
+  if (handle == -1)
+    return;
+  do
+  {
+    if (strcmp(found.name, ".") && strcmp(found.name, ".."))
+      children.push_back(found.name);
+  } while (_findnext64(handle, &found) == 0);
+  _findclose(handle);
+#else
+  DIR *dir = opendir(folder.c_str());
+  if (!dir)
+    return;
+  struct dirent *found;
+  while ((found = readdir(dir)) != NULL)
+  {
+    if (strcmp(found->d_name, ".") && strcmp(found->d_name, ".."))
+      children.push_back(found->d_name);
+  }
+  closedir(dir);
+#endif
+
+  for (const string &name : children)
+  {
+    string path = childPath(relative, name);
+    LocalEntry entry;
+    if (!statLocal(root + "/" + path, entry))
+      continue;
+    entries[path] = entry;
+    if (entry.folder)
+      scanDirectory(root, path, entries);
+  }
+}
+
+bool DirectoryWatcher::start(const string &directory, uint32_t debounceMs, uint32_t pollMs, bool forcePolling,
+                             bool initial, WatchCallback callback)
+{
+  lock_guard<mutex> lock(_mutex);
+  if (_running)
+    return false;
+
+  LocalEntry root;
+  if (!statLocal(directory, root) || !root.folder)
+    return false;
+
+  _directory = directory;
+  while (_directory.size() > 1 && (_directory.back() == '/' || _directory.back() == '\\'))
+    _directory.pop_back();
+  _debounceMs = debounceMs;
+  _pollMs = pollMs > 0 ? pollMs : 1000;
+  _callback = callback;
+  _batch = WatchBatch();
+  _batch.overflow = initial;
+  _first = _last = chrono::steady_clock::now();
+  _watches.clear();
+  _moves.clear();
+  _snapshot.clear();
+
+  _inotify = -1;
+#ifdef __linux__
+  if (!forcePolling)
+  {
+    _inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (_inotify >= 0)
+    {
+      addWatches("", false);
+      // out of watches, the limit is per user, polling still works
+      if (_watches.empty())
+      {
+        close(_inotify);
+        _inotify = -1;
+      }
+    }
+  }
+#endif
+  if (_inotify < 0)
+    scanDirectory(_directory, "", _snapshot);
+
+  _running = true;
+  _thread = thread(&DirectoryWatcher::run, this);
+  return true;
+}
+
+void DirectoryWatcher::stop()
+{
+  {
+    lock_guard<mutex> lock(_mutex);
+    if (!_running)
+      return;
+    _running = false;
+  }
+  _cond.notify_all();
+  if (_thread.joinable() && _thread.get_id() != this_thread::get_id())
+    _thread.join();
+  else if (_thread.joinable())
+    _thread.detach();
+
+#ifdef __linux__
+  if (_inotify >= 0)
+    close(_inotify);
+#endif
+  _inotify = -1;
+  _watches.clear();
+  _snapshot.clear();
+}
+
+bool DirectoryWatcher::running()
+{
+  lock_guard<mutex> lock(_mutex);
+  return _running;
+}
+
+/**
+ * watcher thread, collects changes and hands over the batch once the tree is quiet
+ */
+void DirectoryWatcher::run()
+{
+  for (;;)
+  {
+    {
+      lock_guard<mutex> lock(_mutex);
+      if (!_running)
+        return;
+    }
+
+    auto now = chrono::steady_clock::now();
+    if (pending())
+    {
+      auto quiet = chrono::duration_cast<chrono::milliseconds>(now - _last).count();
+      auto waited = chrono::duration_cast<chrono::milliseconds>(now - _first).count();
+      if (_batch.overflow || quiet >= _debounceMs || waited >= (int64_t)_debounceMs * WATCH_MAX_DELAYS)
+      {
+        // a rename of which only the first half came is a removal
+        for (auto &move : _moves)
+          _batch.paths.insert(move.second);
+        _moves.clear();
+
+        WatchBatch batch;
+        swap(batch, _batch);
+        _callback(batch);
+        continue;
+      }
+    }
+
+    if (_inotify >= 0)
+    {
+      int timeout = !pending() ? 200 : (int)min<uint32_t>(_debounceMs, 200);
+      collectInotify(timeout);
+    }
+    else
+    {
+      unique_lock<mutex> lock(_mutex);
+      uint32_t wait = _batch.empty() ? _pollMs : min(_pollMs, max<uint32_t>(_debounceMs, 10));
+      _cond.wait_for(lock, chrono::milliseconds(wait), [this] { return !_running; });
+      if (!_running)
+        return;
+      lock.unlock();
+      collectPolling();
+    }
+  }
+}
+
+/**
+ * remember a change, which restarts the debounce delay
+ */
+void DirectoryWatcher::touch()
+{
+  auto now = chrono::steady_clock::now();
+  if (_batch.paths.empty() && _batch.renames.empty() && _moves.empty())
+    _first = now;
+  _last = now;
+}
+
+/**
+ * watch a folder and all its subfolders
+ *
+ * @param relative the folder, relative to the watched directory
+ * @param markContent true to add the content to the batch, for a folder that
+ * appeared with files already in it
+ */
+void DirectoryWatcher::addWatches(const string &relative, bool markContent)
+{
+#ifdef __linux__
+  string folder = relative.empty() ? _directory : _directory + "/" + relative;
+  int wd = inotify_add_watch(_inotify, folder.c_str(), WATCH_MASK);
+  if (wd < 0)
+    return;
+  _watches[wd] = relative;
+
+  map<string, LocalEntry> content;
+  scanDirectory(_directory, relative, content);
+  for (auto &entry : content)
+  {
+    if (markContent)
+      _batch.paths.insert(entry.first);
+    if (entry.second.folder)
+    {
+      int child = inotify_add_watch(_inotify, (_directory + "/" + entry.first).c_str(), WATCH_MASK);
+      if (child >= 0)
+        _watches[child] = entry.first;
+    }
+  }
+#else
+  (void)relative;
+  (void)markContent;
+#endif
+}
+
+/**
+ * follow a renamed folder, its watches keep working under the new path
+ */
+void DirectoryWatcher::renameWatches(const string &from, const string &to)
+{
+  string prefix = from + "/";
+  for (auto &watch : _watches)
+  {
+    if (watch.second == from)
+      watch.second = to;
+    else if (watch.second.compare(0, prefix.size(), prefix) == 0)
+      watch.second = to + watch.second.substr(from.size());
+  }
+}
+
+/**
+ * read the pending inotify events
+ *
+ * @param timeoutMs how long to wait for the first event
+ * @return false on error
+ */
+bool DirectoryWatcher::collectInotify(int timeoutMs)
+{
+#ifdef __linux__
+  struct pollfd pfd = {_inotify, POLLIN, 0};
+  int ready = poll(&pfd, 1, timeoutMs);
+  if (ready <= 0)
+    return ready == 0 || errno == EINTR;
+
+  alignas(struct inotify_event) char buffer[64 * 1024];
+  for (;;)
+  {
+    ssize_t length = read(_inotify, buffer, sizeof(buffer));
+    if (length <= 0)
+      break;
+
+    for (char *at = buffer; at < buffer + length;)
+    {
+      struct inotify_event *event = (struct inotify_event *)at;
+      at += sizeof(struct inotify_event) + event->len;
+
+      if (event->mask & IN_Q_OVERFLOW)
+      {
+        _batch.overflow = true;
+        continue;
+      }
+      if (event->mask & IN_IGNORED)
+      {
+        _watches.erase(event->wd);
+        continue;
+      }
+      auto watch = _watches.find(event->wd);
+      if (watch == _watches.end() || event->len == 0)
+        continue;
+
+      string path = childPath(watch->second, event->name);
+      bool folder = (event->mask & IN_ISDIR) != 0;
+      touch();
+
+      if (event->mask & IN_MOVED_FROM)
+      {
+        _moves[event->cookie] = path;
+      }
+      else if (event->mask & IN_MOVED_TO)
+      {
+        auto from = _moves.find(event->cookie);
+        if (from != _moves.end())
+        {
+          _batch.renames.push_back(make_pair(from->second, path));
+          if (folder)
+            renameWatches(from->second, path);
+          _moves.erase(from);
+        }
+        else
+        {
+          // moved in from outside the tree
+          _batch.paths.insert(path);
+          if (folder)
+            addWatches(path, true);
+        }
+      }
+      else
+      {
+        _batch.paths.insert(path);
+        if (folder && (event->mask & IN_CREATE))
+          addWatches(path, true);
+      }
+    }
+  }
+  return true;
+#else
+  (void)timeoutMs;
+  return false;
+#endif
+}
+
+/**
+ * compare the tree with the last snapshot, polling can not see renames,
+ * they come as a removal and a creation
+ */
+void DirectoryWatcher::collectPolling()
+{
+  map<string, LocalEntry> current;
+  scanDirectory(_directory, "", current);
+
+  bool changed = false;
+  for (auto &entry : current)
+  {
+    auto previous = _snapshot.find(entry.first);
+    if (previous == _snapshot.end() || previous->second.folder != entry.second.folder ||
+        previous->second.size != entry.second.size || previous->second.mtime != entry.second.mtime)
+    {
+      if (!changed)
+        touch();
+      changed = true;
+      _batch.paths.insert(entry.first);
+    }
+  }
+  for (auto &entry : _snapshot)
+  {
+    if (current.find(entry.first) == current.end())
+    {
+      if (!changed)
+        touch();
+      changed = true;
+      _batch.paths.insert(entry.first);
+    }
+  }
+
+  _snapshot.swap(current);
+}
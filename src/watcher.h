@@ -0,0 +1,134 @@
+#ifndef LUCK_MTP_WATCHER
+#define LUCK_MTP_WATCHER
+
+#include <stdint.h>
+#include <time.h>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/**
+ * a file or folder of a local directory tree
+ */
+struct LocalEntry
+{
+  uint64_t size;
+  time_t mtime;
+  bool folder;
+};
+
+/**
+ * @param path the local path
+ * @param entry receives the size, modification date and type
+ * @return false if the path does not exist
+ */
+bool statLocal(const string &path, LocalEntry &entry);
+
+/**
+ * list a local directory tree
+ *
+ * @param root the local directory
+ * @param relative the folder to list, relative to the root, empty for the root itself
+ * @param entries receives the entries, paths relative to the root, '/' separated
+ */
+void scanDirectory(const string &root, const string &relative, map<string, LocalEntry> &entries);
+
+/**
+ * the local changes of a debounced period
+ */
+struct WatchBatch
+{
+  // paths created, modified or removed, relative to the watched directory, '/' separated.
+  // only the path is kept, its state is read when the batch is applied
+  set<string> paths;
+  // renames, from and to, in the order they happened
+  vector<pair<string, string>> renames;
+  // changes were lost, or none is known yet, the whole tree has to be compared
+  bool overflow = false;
+
+  bool empty() const { return paths.empty() && renames.empty() && !overflow; }
+};
+
+typedef function<void(WatchBatch &)> WatchCallback;
+
+/**
+ * watch a local directory tree on a background thread
+ *
+ * changes come from inotify on linux, with a watch per folder, and from
+ * comparing snapshots of the tree at every interval elsewhere or when
+ * inotify can not be used. they are collected into a batch that is handed
+ * over once the tree has been quiet for the debounce delay, so a file
+ * written in many steps, or saved through a temporary file, is handled once.
+ */
+class DirectoryWatcher
+{
+public:
+  DirectoryWatcher() {}
+  DirectoryWatcher(const DirectoryWatcher &) = delete;
+  DirectoryWatcher &operator=(const DirectoryWatcher &) = delete;
+  ~DirectoryWatcher() { stop(); }
+
+  /**
+   * @param directory the local directory
+   * @param debounceMs the quiet delay before a batch is handed over
+   * @param pollMs the polling interval, used when inotify is not
+   * @param forcePolling true to poll even if inotify is available
+   * @param initial true to hand over a first batch comparing the whole tree
+   * @param callback called on the watcher thread with every batch
+   * @return false if already running or the directory can not be read
+   */
+  bool start(const string &directory, uint32_t debounceMs, uint32_t pollMs, bool forcePolling, bool initial,
+             WatchCallback callback);
+
+  /**
+   * stop the watcher thread and wait for it to exit, a pending batch is dropped
+   */
+  void stop();
+
+  bool running();
+
+  /**
+   * @return true if the tree is polled rather than watched with inotify
+   */
+  bool polling() const { return _inotify < 0; }
+
+private:
+  void run();
+  bool collectInotify(int timeoutMs);
+  void collectPolling();
+  void addWatches(const string &relative, bool markContent);
+  void renameWatches(const string &from, const string &to);
+  void touch();
+  // a lone first half of a rename is a change too, a file moved out of the tree
+  bool pending() const { return !_batch.empty() || !_moves.empty(); }
+
+  string _directory;
+  uint32_t _debounceMs = 0;
+  uint32_t _pollMs = 0;
+  WatchCallback _callback;
+
+  int _inotify = -1;
+  map<int, string> _watches;
+  // the first half of a rename, by inotify cookie
+  map<uint32_t, string> _moves;
+  map<string, LocalEntry> _snapshot;
+
+  WatchBatch _batch;
+  chrono::steady_clock::time_point _first;
+  chrono::steady_clock::time_point _last;
+
+  thread _thread;
+  mutex _mutex;
+  condition_variable _cond;
+  bool _running = false;
+};
+
+#endif
@@ -0,0 +1,51 @@
+const mtp = require("./binding.js");
+const assert = require("assert");
+const fs = require("fs");
+const os = require("os");
+const path = require("path");
+
+// the phones plugged in, their serial numbers as shown by adb devices, comma separated
+const serials = (process.env.MTP_SERIALS || "").split(",").filter(serial => serial);
+
+function testBasic()
+{
+    const localPath = path.join(os.tmpdir(),"broadcast.bin");
+
+    const content = Buffer.alloc(32 * 1024 * 1024);
+
+    for (let i = 0; i < content.length; i++)
+        content[i] = i * 13 % 241;
+
+    fs.writeFileSync(localPath,content);
+
+    let last = 0;
+
+    result = mtp.broadcastUpload(localPath,serials.concat(["not-a-device"]),"data/com.ahyungui.android/db",(sent,total)=>{
+        last = sent;
+        assert.strictEqual(total,content.length * serials.length);
+    });
+
+    assert.strictEqual(result.uploaded,serials.length);
+
+    assert.strictEqual(last,content.length * serials.length);
+
+    // read once unless a device lagged behind the window
+    if (!result.devices.some(device => device.lagged))
+        assert.strictEqual(result.bytesRead,content.length);
+
+    assert.strictEqual(result.devices[serials.length].uploaded,false);
+
+    assert.ok(result.devices[serials.length].error);
+
+    result = mtp.broadcastUpload(content,serials,"data/com.ahyungui.android/db",undefined,{ name: "broadcast_buffer.bin" });
+
+    assert.strictEqual(result.uploaded,serials.length);
+
+    assert.strictEqual(result.bytesRead,0);
+
+    fs.unlinkSync(localPath);
+}
+
+assert.doesNotThrow(testBasic, undefined, "testBasic threw an expection");
+
+console.log("Tests passed- everything looks OK!");
@@ -0,0 +1,43 @@
+const mtp = require("./binding.js");
+const assert = require("assert");
+const crypto = require("crypto");
+
+function testBasic()
+{
+    const data = crypto.randomBytes(64 * 1024);
+
+    result = mtp.connect();
+
+    assert.strictEqual(result,true);
+
+    result = mtp.writeFile("data/com.ahyungui.android/db","pool.bin",data);
+
+    assert.ok(result > 0);
+
+    mtp.resetStats();
+
+    const buffers = [];
+
+    for (let i = 0; i < 16; i++)
+    {
+        buffers.push(mtp.readFile("data/com.ahyungui.android/db/pool.bin"));
+    }
+
+    buffers.forEach(buffer => assert.ok(buffer.equals(data)));
+
+    let pool = mtp.getStats().pool;
+
+    assert.strictEqual(pool.acquired,16);
+
+    assert.ok(pool.highWater >= 16);
+
+    assert.ok(pool.inUse >= 16);
+
+    mtp.del("data/com.ahyungui.android/db/pool.bin");
+
+    mtp.release();
+}
+
+assert.doesNotThrow(testBasic, undefined, "testBasic threw an expection");
+
+console.log("Tests passed- everything looks OK!");
@@ -0,0 +1,51 @@
+const mtp = require("./binding.js");
+const assert = require("assert");
+
+function testBasic()
+{
+    result = mtp.connect();
+
+    assert.strictEqual(result,true);
+
+    let token = mtp.startChangeJournal();
+
+    assert.strictEqual(typeof token,"string");
+
+    result = mtp.getChanges(token);
+
+    assert.strictEqual(result.resync,false);
+
+    assert.strictEqual(result.added.length,0);
+
+    token = result.token;
+
+    const id = mtp.createFolder("data/com.ahyungui.android/db","journal");
+
+    result = mtp.getChanges(token);
+
+    assert.strictEqual(result.resync,false);
+
+    assert.ok(result.added.includes(id));
+
+    token = result.token;
+
+    mtp.del("data/com.ahyungui.android/db/journal");
+
+    result = mtp.getChanges(token);
+
+    assert.ok(result.removed.includes(id));
+
+    assert.strictEqual(mtp.getChanges("not-a-token").resync,true);
+
+    result = mtp.stopChangeJournal();
+
+    assert.strictEqual(result,true);
+
+    assert.throws(()=>mtp.getChanges(token));
+
+    mtp.release();
+}
+
+assert.doesNotThrow(testBasic, undefined, "testBasic threw an expection");
+
+console.log("Tests passed- everything looks OK!");
@@ -0,0 +1,49 @@
+const mtp = require("./binding.js");
+const assert = require("assert");
+const crypto = require("crypto");
+const fs = require("fs");
+const os = require("os");
+const path = require("path");
+
+function testBasic()
+{
+    const localPath = path.join(os.tmpdir(), "upload.zip");
+
+    result = mtp.connect();
+
+    assert.strictEqual(result,true);
+
+    result = mtp.download("data/com.ahyungui.android/db/upload.zip",localPath,{
+        hash:["sha256","xxh3","crc32c"]
+    });
+
+    console.log("download:",result);
+
+    assert.strictEqual(result.size,fs.statSync(localPath).size);
+
+    assert.strictEqual(result.hash.sha256,crypto.createHash("sha256").update(fs.readFileSync(localPath)).digest("hex"));
+
+    assert.ok(/^[0-9a-f]{16}$/.test(result.hash.xxh3));
+
+    assert.ok(/^[0-9a-f]{8}$/.test(result.hash.crc32c));
+
+    const downloaded = result;
+
+    result = mtp.upload(localPath,"data/com.ahyungui.android/db/test",(send,total)=>{
+        console.log("progress",send,total);
+    },{
+        hash:"sha256"
+    });
+
+    console.log("upload:",result);
+
+    assert.strictEqual(result.hash.sha256,downloaded.hash.sha256);
+
+    assert.throws(()=>mtp.download("data/com.ahyungui.android/db/upload.zip",localPath,{hash:"md5"}),TypeError);
+
+    mtp.release();
+}
+
+assert.doesNotThrow(testBasic, undefined, "testBasic threw an expection");
+
+console.log("Tests passed- everything looks OK!");
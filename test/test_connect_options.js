@@ -0,0 +1,38 @@
+const mtp = require("./binding.js");
+const assert = require("assert");
+
+async function testBasic()
+{
+    const connecting = mtp.connect({mode:'uncached'});
+
+    // a connect is in progress, the sync connect must not open a second session
+    assert.throws(()=>mtp.connect(),/Device is connecting/);
+
+    result = await connecting;
+
+    console.log("connect:",result);
+
+    assert.notStrictEqual(result.storage_id,0);
+    assert.throws(()=>mtp.connect(),/Device already connected/);
+
+    const serial = result.serial;
+
+    mtp.release();
+
+    // the serial number is remembered, the device is opened directly
+    result = await mtp.connect({serial:serial});
+
+    console.log("connect:",result);
+
+    assert.strictEqual(result.serial,serial);
+    assert.strictEqual(result.opened,1);
+
+    mtp.release();
+}
+
+testBasic().then(()=>{
+    console.log("Tests passed- everything looks OK!");
+},(e)=>{
+    console.error("testBasic threw an expection",e);
+    process.exitCode = 1;
+});
@@ -0,0 +1,46 @@
+// the fake device (npm run build:fake) is set up without CopyObject, a real device needs edit support
+process.env.LUCK_MTP_FAKE = process.env.LUCK_MTP_FAKE || "copyObject=0;editObjects=1;partialObject=1";
+
+const mtp = require("./binding.js");
+const assert = require("assert");
+const crypto = require("crypto");
+
+function testBasic()
+{
+    const data = crypto.randomBytes(300 * 1024);
+
+    result = mtp.connect();
+
+    assert.strictEqual(result,true);
+
+    mtp.writeFile("data/com.ahyungui.android/db","edit_copy.bin",data);
+
+    mtp.writeFile("data/com.ahyungui.android/db","edit_empty.bin",Buffer.alloc(0));
+
+    mtp.createFolder("data/com.ahyungui.android/db","edit");
+
+    // each copy is created empty, then filled range by range
+    result = mtp.copy("data/com.ahyungui.android/db/edit_copy.bin","data/com.ahyungui.android/db/edit",{ stream: true });
+
+    assert.strictEqual(result,true);
+
+    assert.ok(mtp.readFile("data/com.ahyungui.android/db/edit/edit_copy.bin").equals(data));
+
+    result = mtp.copy("data/com.ahyungui.android/db/edit_empty.bin","data/com.ahyungui.android/db/edit",{ stream: true });
+
+    assert.strictEqual(result,true);
+
+    assert.strictEqual(mtp.readFile("data/com.ahyungui.android/db/edit/edit_empty.bin").length,0);
+
+    mtp.del("data/com.ahyungui.android/db/edit");
+
+    mtp.del("data/com.ahyungui.android/db/edit_copy.bin");
+
+    mtp.del("data/com.ahyungui.android/db/edit_empty.bin");
+
+    mtp.release();
+}
+
+assert.doesNotThrow(testBasic, undefined, "testBasic threw an expection");
+
+console.log("Tests passed- everything looks OK!");
@@ -0,0 +1,71 @@
+const mtp = require("./binding.js");
+const assert = require("assert");
+const fs = require("fs");
+const os = require("os");
+const path = require("path");
+
+function testBasic()
+{
+    result = mtp.connect();
+
+    assert.strictEqual(result,true);
+
+    const localPath = path.join(os.tmpdir(),"stream_copy.bin");
+
+    const downloadPath = path.join(os.tmpdir(),"stream_copy_check.bin");
+
+    const content = Buffer.alloc(3 * 1024 * 1024);
+
+    for (let i = 0; i < content.length; i++)
+        content[i] = i * 17 % 253;
+
+    fs.writeFileSync(localPath,content);
+
+    mtp.upload(localPath,"data/com.ahyungui.android/db");
+
+    mtp.createFolder("data/com.ahyungui.android/db","stream");
+
+    // a cancelled copy leaves nothing behind
+    assert.throws(() => mtp.copy("data/com.ahyungui.android/db/stream_copy.bin","data/com.ahyungui.android/db/stream",
+        (copied,total) => copied < total / 2,{ stream: true }));
+
+    assert.strictEqual(mtp.getList("data/com.ahyungui.android/db/stream").length,0);
+
+    let last = 0;
+
+    result = mtp.copy("data/com.ahyungui.android/db/stream_copy.bin","data/com.ahyungui.android/db/stream",
+        (copied,total) => { last = copied; assert.strictEqual(total,content.length); },{ stream: true });
+
+    assert.strictEqual(result,true);
+
+    assert.strictEqual(last,content.length);
+
+    mtp.download("data/com.ahyungui.android/db/stream/stream_copy.bin",downloadPath);
+
+    assert.ok(fs.readFileSync(downloadPath).equals(content));
+
+    mtp.del("data/com.ahyungui.android/db/stream/stream_copy.bin");
+
+    // the source of a move is deleted once the copy is verified
+    result = mtp.move("data/com.ahyungui.android/db/stream_copy.bin","data/com.ahyungui.android/db/stream",{ stream: true });
+
+    assert.strictEqual(result,true);
+
+    assert.strictEqual(mtp.getList("data/com.ahyungui.android/db").some(file => file.name === "stream_copy.bin"),false);
+
+    mtp.download("data/com.ahyungui.android/db/stream/stream_copy.bin",downloadPath);
+
+    assert.ok(fs.readFileSync(downloadPath).equals(content));
+
+    mtp.del("data/com.ahyungui.android/db/stream");
+
+    fs.unlinkSync(localPath);
+
+    fs.unlinkSync(downloadPath);
+
+    mtp.release();
+}
+
+assert.doesNotThrow(testBasic, undefined, "testBasic threw an expection");
+
+console.log("Tests passed- everything looks OK!");
@@ -0,0 +1,28 @@
+const mtp = require("./binding.js");
+const assert = require("assert");
+
+function testBasic()
+{
+    result = mtp.refreshDevices();
+
+    console.log("objArr:",result);
+
+    result = mtp.startDiscovery(500,(event,device)=>{
+        console.log(event,device);
+    });
+
+    assert.strictEqual(result,true);
+
+    // plug or unplug a device in the next 10 seconds
+    setTimeout(()=>{
+        result = mtp.stopDiscovery();
+
+        assert.strictEqual(result,true);
+
+        console.log("objArr:",mtp.getDeviceInfo());
+    },10000);
+}
+
+assert.doesNotThrow(testBasic, undefined, "testBasic threw an expection");
+
+console.log("Tests passed- everything looks OK!");
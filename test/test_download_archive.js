@@ -0,0 +1,51 @@
+const mtp = require("./binding.js");
+const assert = require("assert");
+const fs = require("fs");
+const os = require("os");
+const path = require("path");
+
+function testBasic()
+{
+    const localPath = path.join(os.tmpdir(), "db.tar");
+
+    result = mtp.connect();
+
+    assert.strictEqual(result,true);
+
+    result = mtp.downloadArchive("data/com.ahyungui.android/db",localPath,(send,total)=>{
+        console.log("progress",send,total);
+    });
+
+    console.log("tar:",result);
+
+    assert.strictEqual(result.size,fs.statSync(localPath).size);
+
+    assert.strictEqual(result.size % 10240,0);
+
+    result = mtp.downloadArchive("data/com.ahyungui.android/db",path.join(os.tmpdir(), "db.zip"),{
+        compression:"deflate"
+    });
+
+    console.log("zip:",result);
+
+    assert.ok(result.files > 0);
+
+    const chunks = [];
+
+    result = mtp.downloadArchive("data/com.ahyungui.android/db",{
+        write:(chunk)=>chunks.push(chunk)
+    },{
+        format:"tar",
+        compression:"gzip"
+    });
+
+    assert.strictEqual(Buffer.concat(chunks).length,result.size);
+
+    assert.throws(()=>mtp.downloadArchive("data/com.ahyungui.android/db",localPath,{format:"rar"}),TypeError);
+
+    mtp.release();
+}
+
+assert.doesNotThrow(testBasic, undefined, "testBasic threw an expection");
+
+console.log("Tests passed- everything looks OK!");
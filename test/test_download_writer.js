@@ -0,0 +1,28 @@
+const mtp = require("./binding.js");
+const assert = require("assert");
+const fs = require("fs");
+
+function testBasic()
+{
+    result = mtp.connect();
+
+    assert.strictEqual(result,true);
+
+    result = mtp.download("data/com.ahyungui.android/db/upload.zip","/Users/tmp/upload.zip",{ fsync: "end", hash: "sha256" });
+
+    assert.strictEqual(fs.statSync("/Users/tmp/upload.zip").size,result.size);
+
+    result = mtp.download("data/com.ahyungui.android/db/upload.zip","/Users/tmp/upload2.zip",{ fsync: 1024 * 1024 });
+
+    assert.strictEqual(result,true);
+
+    assert.ok(fs.readFileSync("/Users/tmp/upload.zip").equals(fs.readFileSync("/Users/tmp/upload2.zip")));
+
+    assert.throws(() => mtp.download("data/com.ahyungui.android/db/upload.zip","/Users/tmp/upload3.zip",{ fsync: "always" }));
+
+    mtp.release();
+}
+
+assert.doesNotThrow(testBasic, undefined, "testBasic threw an expection");
+
+console.log("Tests passed- everything looks OK!");
@@ -0,0 +1,38 @@
+const mtp = require("./binding.js");
+const assert = require("assert");
+
+function testBasic()
+{
+    result = mtp.connect();
+
+    assert.strictEqual(result,true);
+
+    result = mtp.getList("/data/com.ahyungui.android/db/",{persistentId:true});
+
+    console.log("objArr:",result);
+
+    const target = result[0];
+
+    mtp.release();
+
+    // object ids may change in a new session, the persistent id does not
+    result = mtp.connect();
+
+    assert.strictEqual(result,true);
+
+    result = mtp.buildPersistentIndex("/data/com.ahyungui.android/db/");
+
+    console.log("indexed:",result);
+
+    result = mtp.resolveByPersistentId(target.persistent_id);
+
+    console.log("obj:",result);
+
+    assert.strictEqual(result.name,target.name);
+
+    mtp.release();
+}
+
+assert.doesNotThrow(testBasic, undefined, "testBasic threw an expection");
+
+console.log("Tests passed- everything looks OK!");
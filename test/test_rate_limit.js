@@ -0,0 +1,45 @@
+const mtp = require("./binding.js");
+const assert = require("assert");
+const os = require("os");
+const path = require("path");
+
+function testBasic()
+{
+    result = mtp.connect();
+
+    assert.strictEqual(result,true);
+
+    const localPath = path.join(os.tmpdir(),"rate_limit.zip");
+
+    mtp.resetStats();
+
+    mtp.setRateLimit(1024 * 1024);
+
+    let start = Date.now();
+
+    const file = mtp.get("data/com.ahyungui.android/db/upload.zip");
+
+    mtp.download("data/com.ahyungui.android/db/upload.zip",localPath);
+
+    assert.ok(Date.now() - start >= file.size / (1024 * 1024) * 1000 * 0.8);
+
+    mtp.setRateLimit(0);
+
+    mtp.setRateLimit(2 * 1024 * 1024,"backup");
+
+    mtp.download("data/com.ahyungui.android/db/upload.zip",localPath,{ rateLimit: "backup" });
+
+    const stats = mtp.getStats().rateLimits;
+
+    assert.strictEqual(stats.device.bytes,file.size * 2);
+
+    assert.strictEqual(stats.named.backup.limit,2 * 1024 * 1024);
+
+    assert.ok(stats.named.backup.throughput <= 2 * 1024 * 1024 * 1.2);
+
+    mtp.release();
+}
+
+assert.doesNotThrow(testBasic, undefined, "testBasic threw an expection");
+
+console.log("Tests passed- everything looks OK!");
@@ -0,0 +1,40 @@
+const mtp = require("./binding.js");
+const assert = require("assert");
+const crypto = require("crypto");
+
+function testBasic()
+{
+    const data = crypto.randomBytes(100 * 1024);
+
+    result = mtp.connect();
+
+    assert.strictEqual(result,true);
+
+    result = mtp.writeFile("data/com.ahyungui.android/db","buffer.bin",data);
+
+    assert.ok(result > 0);
+
+    result = mtp.readFile("data/com.ahyungui.android/db/buffer.bin");
+
+    assert.ok(Buffer.isBuffer(result));
+
+    assert.ok(result.equals(data));
+
+    result = mtp.writeFile("data/com.ahyungui.android/db","empty.bin",Buffer.alloc(0));
+
+    assert.ok(result > 0);
+
+    result = mtp.readFile("data/com.ahyungui.android/db/empty.bin");
+
+    assert.strictEqual(result.length,0);
+
+    mtp.del("data/com.ahyungui.android/db/buffer.bin");
+
+    mtp.del("data/com.ahyungui.android/db/empty.bin");
+
+    mtp.release();
+}
+
+assert.doesNotThrow(testBasic, undefined, "testBasic threw an expection");
+
+console.log("Tests passed- everything looks OK!");
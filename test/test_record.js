@@ -0,0 +1,42 @@
+const mtp = require("./binding.js");
+const assert = require("assert");
+const fs = require("fs");
+const os = require("os");
+const path = require("path");
+
+function testBasic()
+{
+    const tracePath = path.join(os.tmpdir(),"luck-node-mtp.trace");
+
+    result = mtp.startRecording(tracePath);
+
+    assert.strictEqual(result,true);
+
+    // only one trace at a time
+    assert.throws(() => mtp.startRecording(tracePath));
+
+    result = mtp.connect();
+
+    assert.strictEqual(result,true);
+
+    result = mtp.getList("/data/com.ahyungui.android/db/");
+
+    console.log("objArr:",result);
+
+    mtp.release();
+
+    result = mtp.stopRecording();
+
+    console.log("records:",result);
+
+    assert.ok(result > 0);
+
+    assert.ok(fs.statSync(tracePath).size > 0);
+
+    // nothing left to stop
+    assert.strictEqual(mtp.stopRecording(),0);
+}
+
+assert.doesNotThrow(testBasic, undefined, "testBasic threw an expection");
+
+console.log("Tests passed- everything looks OK!");
@@ -0,0 +1,52 @@
+const mtp = require("./binding.js");
+const assert = require("assert");
+const os = require("os");
+const path = require("path");
+
+async function testBasic()
+{
+    result = mtp.connect();
+
+    assert.strictEqual(result,true);
+
+    mtp.enableStats();
+
+    mtp.resetStats();
+
+    const localPath = path.join(os.tmpdir(),"scheduler.zip");
+
+    let progressed = 0;
+
+    const pending = mtp.download("data/com.ahyungui.android/db/upload.zip",localPath,(sent, total) => {
+        progressed++;
+    },{ async: true, priority: "bulk", hash: "sha256", sliceSize: 1024 * 1024 });
+
+    assert.throws(() => mtp.release());
+
+    const list = mtp.getList("data/com.ahyungui.android/db");
+
+    assert.ok(list.length > 0);
+
+    const downloaded = await pending;
+
+    assert.ok(downloaded.hash.sha256);
+
+    assert.ok(progressed > 0);
+
+    const scheduler = mtp.getStats().scheduler;
+
+    assert.ok(scheduler.interactive.acquired > 0);
+
+    assert.ok(scheduler.bulk.acquired > 0);
+
+    assert.strictEqual(scheduler.normal.queued,0);
+
+    mtp.release();
+}
+
+testBasic().then(() => {
+    console.log("Tests passed- everything looks OK!");
+}, (e) => {
+    console.error(e);
+    process.exit(1);
+});
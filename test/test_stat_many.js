@@ -0,0 +1,33 @@
+const mtp = require("./binding.js");
+const assert = require("assert");
+
+function testBasic()
+{
+    result = mtp.connect();
+
+    assert.strictEqual(result,true);
+
+    const paths = ["data/com.ahyungui.android/db/upload.zip", "data/com.ahyungui.android/db/missing.zip", "/data/com.ahyungui.android/db/"];
+
+    result = mtp.statMany(paths);
+
+    assert.strictEqual(result.length,3);
+
+    assert.deepStrictEqual(result[0],mtp.get(paths[0]));
+
+    assert.strictEqual(result[1],null);
+
+    assert.strictEqual(result[2].type,"FOLDER");
+
+    result = mtp.statMany(paths, { columnar: true });
+
+    assert.deepStrictEqual(Array.from(result.found),[1, 0, 1]);
+
+    assert.deepStrictEqual(Array.from(result.folder),[0, 0, 1]);
+
+    mtp.release();
+}
+
+assert.doesNotThrow(testBasic, undefined, "testBasic threw an expection");
+
+console.log("Tests passed- everything looks OK!");
@@ -0,0 +1,44 @@
+const mtp = require("./binding.js");
+const assert = require("assert");
+
+function testBasic()
+{
+    mtp.enableStats(true);
+
+    mtp.resetStats();
+
+    result = mtp.connect();
+
+    assert.strictEqual(result,true);
+
+    result = mtp.getList("/data/com.ahyungui.android/db/");
+
+    console.log("objArr:",result);
+
+    mtp.release();
+
+    result = mtp.getStats();
+
+    console.log("stats:",JSON.stringify(result,null,2));
+
+    assert.strictEqual(result.enabled,true);
+
+    // the path is resolved one folder at a time
+    assert.ok(result.exports.getList.functions.Get_Files_And_Folders >= 4);
+
+    assert.strictEqual(result.exports.getList.calls,1);
+
+    assert.ok(result.functions.Get_Files_And_Folders.latency.p99 >= result.functions.Get_Files_And_Folders.latency.p50);
+
+    mtp.resetStats();
+
+    result = mtp.getStats();
+
+    assert.deepStrictEqual(result.exports,{});
+
+    mtp.enableStats(false);
+}
+
+assert.doesNotThrow(testBasic, undefined, "testBasic threw an expection");
+
+console.log("Tests passed- everything looks OK!");
@@ -0,0 +1,42 @@
+const mtp = require("./binding.js");
+const assert = require("assert");
+const os = require("os");
+const path = require("path");
+
+async function testBasic()
+{
+    result = mtp.connect();
+
+    assert.strictEqual(result,true);
+
+    const files = mtp.getList("DCIM/Camera").filter(file => file.type === "FILE").slice(0, 20);
+
+    const cacheDir = path.join(os.tmpdir(), "luck-node-mtp-thumbnails");
+
+    const delivered = [];
+
+    let thumbnails = await mtp.getThumbnails(files.map(file => file.id), (index, thumbnail) => {
+        delivered.push(index);
+    }, { cacheDir: cacheDir });
+
+    assert.strictEqual(thumbnails.length,files.length);
+
+    assert.strictEqual(delivered.length,files.length);
+
+    mtp.resetStats();
+
+    let again = await mtp.getThumbnails(files.map(file => "DCIM/Camera/" + file.name), { cacheDir: cacheDir });
+
+    again.forEach((thumbnail, i) => assert.ok(thumbnail === thumbnails[i] || thumbnail.equals(thumbnails[i])));
+
+    assert.strictEqual(mtp.getStats().thumbnails.misses,0);
+
+    mtp.release();
+}
+
+testBasic().then(() => {
+    console.log("Tests passed- everything looks OK!");
+}, (e) => {
+    console.error(e);
+    process.exit(1);
+});
@@ -0,0 +1,40 @@
+const mtp = require("./binding.js");
+const assert = require("assert");
+const fs = require("fs");
+const os = require("os");
+const path = require("path");
+
+function testBasic()
+{
+    const jsonPath = path.join(os.tmpdir(),"luck-node-mtp-trace.json");
+
+    result = mtp.startTracing(jsonPath);
+
+    assert.strictEqual(result,true);
+
+    result = mtp.connect();
+
+    assert.strictEqual(result,true);
+
+    result = mtp.getList("/data/com.ahyungui.android/db/");
+
+    mtp.release();
+
+    result = mtp.stopTracing();
+
+    console.log("tracing:",result);
+
+    const trace = JSON.parse(fs.readFileSync(jsonPath,"utf8"));
+
+    assert.strictEqual(trace.traceEvents.length,result.events);
+
+    const names = trace.traceEvents.map((event) => event.name);
+
+    assert.ok(names.includes("getList"));
+    assert.ok(names.includes("findFile"));
+    assert.ok(names.includes("Get_Files_And_Folders"));
+}
+
+assert.doesNotThrow(testBasic, undefined, "testBasic threw an expection");
+
+console.log("Tests passed- everything looks OK!");
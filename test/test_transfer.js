@@ -0,0 +1,37 @@
+const mtp = require("./binding.js");
+const assert = require("assert");
+
+// two phones plugged in, their serial numbers as shown by adb devices
+const sourceSerial = process.env.MTP_SOURCE_SERIAL;
+const targetSerial = process.env.MTP_TARGET_SERIAL;
+
+function testBasic()
+{
+    let last = 0;
+
+    result = mtp.transfer(sourceSerial,"data/com.ahyungui.android/db",targetSerial,"/",(sent,total)=>{
+        last = sent;
+        assert.ok(sent <= total);
+    });
+
+    assert.ok(result.files > 0);
+
+    assert.ok(result.folders > 0);
+
+    assert.strictEqual(last,result.bytes);
+
+    // a cancelled transfer leaves nothing on the target
+    assert.throws(() => mtp.transfer(sourceSerial,"data/com.ahyungui.android/db",targetSerial,"/",() => false));
+
+    mtp.connect({ serial: targetSerial }).then(() => {
+        assert.strictEqual(mtp.getList("db").length > 0,true);
+
+        mtp.del("db");
+
+        mtp.release();
+
+        console.log("Tests passed- everything looks OK!");
+    });
+}
+
+assert.doesNotThrow(testBasic, undefined, "testBasic threw an expection");
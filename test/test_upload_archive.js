@@ -0,0 +1,41 @@
+const mtp = require("./binding.js");
+const assert = require("assert");
+const os = require("os");
+const path = require("path");
+
+function testBasic()
+{
+    const localPath = path.join(os.tmpdir(), "db.zip");
+
+    result = mtp.connect();
+
+    assert.strictEqual(result,true);
+
+    result = mtp.downloadArchive("data/com.ahyungui.android/db",localPath);
+
+    const downloaded = result;
+
+    result = mtp.createFolder("data/com.ahyungui.android","archive");
+
+    result = mtp.uploadArchive(localPath,"data/com.ahyungui.android/archive",(send,total)=>{
+        console.log("progress",send,total);
+    });
+
+    console.log("upload:",result);
+
+    assert.strictEqual(result.files,downloaded.files);
+
+    assert.strictEqual(result.bytes,downloaded.bytes);
+
+    assert.strictEqual(result.folders,downloaded.folders);
+
+    assert.throws(()=>mtp.uploadArchive(__filename,"data/com.ahyungui.android/archive"));
+
+    mtp.del("data/com.ahyungui.android/archive");
+
+    mtp.release();
+}
+
+assert.doesNotThrow(testBasic, undefined, "testBasic threw an expection");
+
+console.log("Tests passed- everything looks OK!");
@@ -0,0 +1,58 @@
+const mtp = require("./binding.js");
+const assert = require("assert");
+const fs = require("fs");
+const os = require("os");
+const path = require("path");
+
+function testBasic()
+{
+    result = mtp.connect();
+
+    assert.strictEqual(result,true);
+
+    const localPath = path.join(os.tmpdir(),"delta.bin");
+
+    const downloadPath = path.join(os.tmpdir(),"delta_check.bin");
+
+    const content = Buffer.alloc(8 * 1024 * 1024);
+
+    for (let i = 0; i < content.length; i++)
+        content[i] = i * 31 % 251;
+
+    fs.writeFileSync(localPath,content);
+
+    mtp.upload(localPath,"data/com.ahyungui.android/db");
+
+    content[100] ^= 1;
+
+    content[5 * 1024 * 1024] ^= 1;
+
+    fs.writeFileSync(localPath,content);
+
+    result = mtp.upload(localPath,"data/com.ahyungui.android/db",{ delta: true });
+
+    assert.strictEqual(result.uploaded,true);
+
+    if (result.delta)
+    {
+        assert.ok(result.bytesAvoided >= content.length - 2 * 64 * 1024);
+
+        assert.strictEqual(result.sampled,content.length);
+    }
+
+    mtp.download("data/com.ahyungui.android/db/delta.bin",downloadPath);
+
+    assert.ok(fs.readFileSync(downloadPath).equals(content));
+
+    mtp.del("data/com.ahyungui.android/db/delta.bin");
+
+    fs.unlinkSync(localPath);
+
+    fs.unlinkSync(downloadPath);
+
+    mtp.release();
+}
+
+assert.doesNotThrow(testBasic, undefined, "testBasic threw an expection");
+
+console.log("Tests passed- everything looks OK!");
@@ -0,0 +1,50 @@
+const mtp = require("./binding.js");
+const assert = require("assert");
+const fs = require("fs");
+const os = require("os");
+const path = require("path");
+
+function testBasic()
+{
+    result = mtp.connect();
+
+    assert.strictEqual(result,true);
+
+    const localPath = path.join(os.tmpdir(),"if_changed.bin");
+
+    fs.writeFileSync(localPath,Buffer.alloc(2 * 1024 * 1024,1));
+
+    mtp.upload(localPath,"data/com.ahyungui.android/db",{ ifChanged: true });
+
+    result = mtp.upload(localPath,"data/com.ahyungui.android/db",{ ifChanged: true });
+
+    assert.strictEqual(result.uploaded,false);
+
+    assert.strictEqual(result.bytesAvoided,2 * 1024 * 1024);
+
+    const content = Buffer.alloc(2 * 1024 * 1024,1);
+
+    content[content.length - 1] = 2;
+
+    fs.writeFileSync(localPath,content);
+
+    result = mtp.upload(localPath,"data/com.ahyungui.android/db",{ ifChanged: true, hash: "sha256" });
+
+    assert.strictEqual(result.uploaded,true);
+
+    assert.strictEqual(result.bytesAvoided,0);
+
+    assert.ok(result.hash.sha256);
+
+    assert.strictEqual(mtp.get("data/com.ahyungui.android/db/if_changed.bin").id,result.id);
+
+    mtp.del("data/com.ahyungui.android/db/if_changed.bin");
+
+    fs.unlinkSync(localPath);
+
+    mtp.release();
+}
+
+assert.doesNotThrow(testBasic, undefined, "testBasic threw an expection");
+
+console.log("Tests passed- everything looks OK!");
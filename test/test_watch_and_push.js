@@ -0,0 +1,67 @@
+const mtp = require("./binding.js");
+const assert = require("assert");
+const fs = require("fs");
+const os = require("os");
+const path = require("path");
+
+function testBasic()
+{
+    const localDir = fs.mkdtempSync(path.join(os.tmpdir(),"watch-"));
+
+    fs.writeFileSync(path.join(localDir,"first.txt"),"first");
+
+    result = mtp.connect();
+
+    assert.strictEqual(result,true);
+
+    mtp.createFolder("data/com.ahyungui.android/db","watch");
+
+    const events = [];
+
+    result = mtp.watchAndPush(localDir,"data/com.ahyungui.android/db/watch",(event)=>{
+        console.log(event);
+        events.push(event);
+    },{ debounce: 200 });
+
+    assert.strictEqual(result,true);
+
+    // the device can not be released while watching
+    assert.throws(()=>mtp.release());
+
+    setTimeout(()=>{
+        fs.writeFileSync(path.join(localDir,"second.txt"),"second");
+        fs.mkdirSync(path.join(localDir,"sub"));
+        fs.writeFileSync(path.join(localDir,"sub","third.txt"),"third");
+    },1000);
+
+    setTimeout(()=>{
+        fs.renameSync(path.join(localDir,"second.txt"),path.join(localDir,"renamed.txt"));
+        fs.unlinkSync(path.join(localDir,"first.txt"));
+    },2000);
+
+    setTimeout(()=>{
+        result = mtp.stopWatch();
+
+        assert.strictEqual(result,true);
+
+        assert.ok(!events.some(event => event.op == "error"));
+
+        assert.ok(events.some(event => event.op == "create" && event.path == "sub/third.txt"));
+
+        assert.ok(events.some(event => event.op == "delete" && event.path == "first.txt"));
+
+        const file = mtp.getObject("data/com.ahyungui.android/db/watch/renamed.txt");
+
+        assert.strictEqual(file.size,6);
+
+        mtp.del("data/com.ahyungui.android/db/watch");
+
+        mtp.release();
+
+        fs.rmSync(localDir,{ recursive: true });
+
+        console.log("Tests passed- everything looks OK!");
+    },4000);
+}
+
+assert.doesNotThrow(testBasic, undefined, "testBasic threw an expection");
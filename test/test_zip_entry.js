@@ -0,0 +1,62 @@
+const mtp = require("./binding.js");
+const assert = require("assert");
+const fs = require("fs");
+const os = require("os");
+const path = require("path");
+
+function testBasic()
+{
+    const archivePath = path.join(os.tmpdir(), "entries.zip");
+    const localPath = path.join(os.tmpdir(), "entry.bin");
+
+    result = mtp.connect();
+
+    assert.strictEqual(result,true);
+
+    // a zip of a device folder, sent back to the device to read it from there
+    mtp.downloadArchive("data/com.ahyungui.android/db",archivePath,{compression:"deflate"});
+
+    result = mtp.upload(archivePath,"data/com.ahyungui.android");
+
+    assert.strictEqual(result,true);
+
+    const zip = mtp.listZip("data/com.ahyungui.android/entries.zip");
+
+    console.log("listing:",zip.entries.length,"entries,",zip.bytesRead,"of",zip.size,"bytes read");
+
+    assert.strictEqual(zip.size,fs.statSync(archivePath).size);
+
+    const entry = zip.entries.find(entry=>!entry.folder);
+
+    assert.ok(entry);
+
+    result = mtp.extractZipEntry("data/com.ahyungui.android/entries.zip",entry.name,localPath,(send,total)=>{
+        console.log("progress",send,total);
+    });
+
+    console.log("entry:",entry.name,result);
+
+    assert.strictEqual(result.size,entry.size);
+
+    assert.strictEqual(fs.statSync(localPath).size,entry.size);
+
+    const chunks = [];
+
+    result = mtp.extractZipEntry("data/com.ahyungui.android/entries.zip",entry.name,{
+        write:(chunk)=>chunks.push(chunk)
+    });
+
+    assert.ok(Buffer.concat(chunks).equals(fs.readFileSync(localPath)));
+
+    assert.throws(()=>mtp.extractZipEntry("data/com.ahyungui.android/entries.zip","no/such/entry",localPath));
+
+    assert.throws(()=>mtp.listZip("data/com.ahyungui.android/db"));
+
+    mtp.del("data/com.ahyungui.android/entries.zip");
+
+    mtp.release();
+}
+
+assert.doesNotThrow(testBasic, undefined, "testBasic threw an expection");
+
+console.log("Tests passed- everything looks OK!");